@@ -0,0 +1,150 @@
+/*
+    协程上下文切换的基准测试
+    用法: bench_fiber [-n 切换次数] [-o 结果json]
+    分别测量：
+        asm/ucontext    两种上下文实现在两个栈之间来回切换一次的耗时
+        fiber           Fiber::swapIn + Fiber::YieldToHole 来回一次的耗时(使用构建时选择的实现)
+        create          Fiber::Create + 运行到结束 + 释放(回收)一次的耗时
+    结果以 ns/次 输出到终端(stderr)并写入json文件。
+*/
+#include "fiber.h"
+#include "clock.h"
+#include "bench_util.h"
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace caizi;
+
+struct Options{
+    size_t iterations = 1000000;
+    std::string output = "bench_fiber.json";
+};
+
+struct Result{
+    std::string name;
+    std::string context;
+    size_t iterations = 0;
+    double ns_per_op = 0;
+};
+
+// 直接使用上下文实现，不经过Fiber，测量的只是切换本身
+template<class Context>
+struct RawSwitch{
+    static Context s_main;
+    static Context s_child;
+    static size_t s_count;
+
+    static void Entry(){
+        while(true){
+            ++s_count;
+            Context::Swap(&s_child, &s_main);
+        }
+    }
+
+    static Result Run(size_t iterations){
+        const size_t stack_size = 64 * 1024;
+        void* stack = mmap(nullptr, stack_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        s_child.make(stack, stack_size, &Entry);
+        s_count = 0;
+        // 预热
+        for(size_t i = 0; i < 1000; ++i){
+            Context::Swap(&s_main, &s_child);
+        }
+        uint64_t start = BenchNowNS();
+        for(size_t i = 0; i < iterations; ++i){
+            Context::Swap(&s_main, &s_child);
+        }
+        uint64_t end = BenchNowNS();
+        if(s_count != iterations + 1000){
+            fprintf(stderr, "%s: unexpected switch count %zu\n", Context::Name(), s_count);
+        }
+        // 子上下文停在Swap里，直接丢弃它的栈
+        munmap(stack, stack_size);
+        Result r;
+        r.name = std::string("raw_") + Context::Name();
+        r.context = Context::Name();
+        r.iterations = iterations;
+        r.ns_per_op = (double)(end - start) / iterations;
+        return r;
+    }
+};
+template<class Context> Context RawSwitch<Context>::s_main;
+template<class Context> Context RawSwitch<Context>::s_child;
+template<class Context> size_t RawSwitch<Context>::s_count = 0;
+
+static Result runFiberSwitch(size_t iterations){
+    bool stop = false;
+    Fiber::GetThis();
+    Fiber::ptr fiber = Fiber::Create([&stop](){
+        while(!stop){
+            Fiber::YieldToHole();
+        }
+    });
+    for(size_t i = 0; i < 1000; ++i){
+        fiber->swapIn();
+    }
+    uint64_t start = BenchNowNS();
+    for(size_t i = 0; i < iterations; ++i){
+        fiber->swapIn();
+    }
+    uint64_t end = BenchNowNS();
+    stop = true;
+    fiber->swapIn();
+    Result r;
+    r.name = "fiber_swap";
+    r.context = FiberContext::Name();
+    r.iterations = iterations;
+    r.ns_per_op = (double)(end - start) / iterations;
+    return r;
+}
+
+static Result runFiberCreate(size_t iterations){
+    size_t count = 0;
+    Fiber::GetThis();
+    uint64_t start = BenchNowNS();
+    for(size_t i = 0; i < iterations; ++i){
+        Fiber::ptr fiber = Fiber::Create([&count](){ ++count; });
+        fiber->swapIn();
+    }
+    uint64_t end = BenchNowNS();
+    Result r;
+    r.name = "fiber_create";
+    r.context = FiberContext::Name();
+    r.iterations = iterations;
+    r.ns_per_op = (double)(end - start) / iterations;
+    return r;
+}
+
+int main(int argc, char** argv){
+    Options opt;
+    BenchArgs args;
+    args.addSize('n', "iterations", &opt.iterations);
+    args.addString('o', "result.json", &opt.output);
+    if(!args.parse(argc, argv)){
+        return 1;
+    }
+
+    std::vector<Result> results;
+#ifdef CAIZI_HAS_ASM_CONTEXT
+    results.push_back(RawSwitch<AsmContext>::Run(opt.iterations));
+#endif
+    results.push_back(RawSwitch<UContext>::Run(opt.iterations));
+    results.push_back(runFiberSwitch(opt.iterations));
+    results.push_back(runFiberCreate(opt.iterations));
+
+    BenchReport report("bench_fiber");
+    report.addField("fiber_context", FiberContext::Name());
+    fprintf(stderr, "%-14s %-9s %12s %10s\n", "name", "context", "iterations", "ns/op");
+    for(auto& r : results){
+        fprintf(stderr, "%-14s %-9s %12zu %10.2f\n", r.name.c_str(), r.context.c_str(), r.iterations, r.ns_per_op);
+        report.addResult("\"name\": \"%s\", \"context\": \"%s\", \"iterations\": %zu, \"ns_per_op\": %.2f",
+                r.name.c_str(), r.context.c_str(), r.iterations, r.ns_per_op);
+    }
+    report.write(opt.output);
+    return 0;
+}
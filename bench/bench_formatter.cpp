@@ -0,0 +1,52 @@
+/*
+    LogFormatter(运行时解析) 与 StaticLogFormatter(编译期解析) 的格式化耗时对比
+    用法: bench_formatter [次数]
+*/
+#include "log.h"
+#include <chrono>
+#include <cstdlib>
+
+using namespace caizi;
+
+static constexpr char kDefaultPattern[] = CAIZI_LOG_DEFAULT_PATTERN;
+static constexpr char kLiteralPattern[] = "[%p] %n(%t) %f:%l - %m";
+
+// 防止编译器把格式化结果优化掉
+static volatile size_t s_sink = 0;
+
+static double bench(LogFormatter& formatter, const LogEvent& ev, size_t loops){
+    LogBuffer buffer;
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < loops; ++i){
+        buffer.reset();
+        formatter.format(buffer, ev.getLevel(), ev);
+        s_sink += buffer.size();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / loops;
+}
+
+template<const char* PATTERN>
+static void run(const LogEvent& ev, size_t loops){
+    LogFormatter runtime(PATTERN);
+    StaticLogFormatter<PATTERN> compiled;
+    // 预热
+    bench(runtime, ev, loops / 10);
+    bench(compiled, ev, loops / 10);
+
+    double rt = bench(runtime, ev, loops);
+    double ct = bench(compiled, ev, loops);
+    printf("%-28s runtime %8.2f ns/event   static %8.2f ns/event   x%.2f\n",
+            PATTERN, rt, ct, rt / ct);
+}
+
+int main(int argc, char** argv){
+    size_t loops = argc > 1 ? strtoull(argv[1], nullptr, 10) : 5000000;
+
+    LogEventGuard ev(LogLevel::INFO, __FILE__, __LINE__);
+    ev->setContent("benchmark message with some payload 1234567890\n");
+
+    run<kDefaultPattern>(*ev, loops);
+    run<kLiteralPattern>(*ev, loops);
+    return 0;
+}
@@ -0,0 +1,204 @@
+/*
+    日志吞吐量与调用方延迟的基准测试
+    用法: bench_log [-n 每线程条数] [-t 最大线程数] [-o 结果json] [-d 日志目录]
+    线程数从1开始按2倍递增，最后一轮总是使用最大线程数，对每种输出地和调用方式分别测量：
+        输出地   stdout(重定向到/dev/null) / file / file_async / binary / binary_async
+        调用方式 string(LOG_INFO拼接字符串) / fmt(LOG_FMT_INFO) / disabled(级别被过滤)
+    吞吐量为 总条数 / 所有线程写完的时间，异步模式另外记录后台线程排空队列的时间。
+    延迟为每次日志调用在调用线程上的耗时，结果汇总到终端(stderr)并写入json文件。
+*/
+#include "log.h"
+#include "log_binary.h"
+#include "bench_util.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace caizi;
+
+struct Options{
+    size_t events = 200000;
+    size_t max_threads = 4;
+    std::string output = "bench_log.json";
+    std::string dir = "/tmp";
+};
+
+struct Result{
+    std::string appender;
+    std::string call;
+    size_t threads = 0;
+    size_t events = 0;
+    double seconds = 0;
+    double drain_ms = 0;
+    uint64_t p50 = 0;
+    uint64_t p99 = 0;
+    uint64_t p999 = 0;
+    uint64_t max = 0;
+    uint64_t dropped = 0;
+};
+
+// 删除上一次运行留下的日志文件和二进制文件段
+static void removeFiles(const std::string& path){
+    unlink(path.c_str());
+    char suffix[32];
+    for(int i = 0; ; ++i){
+        snprintf(suffix, sizeof(suffix), ".%06d", i);
+        if(unlink((path + suffix).c_str())){
+            break;
+        }
+    }
+}
+
+// 按输出地名称构造日志器，异步模式由调用方开启
+static Logger::ptr makeLogger(const std::string& appender, const Options& opt){
+    Logger::ptr logger(new Logger("bench_" + appender));
+    std::string path = opt.dir + "/caizi_bench_" + appender + ".log";
+    removeFiles(path);
+    if(appender == "stdout"){
+        logger->addAppender(std::make_shared<StdoutLogAppender>());
+    }else if(appender == "file" || appender == "file_async"){
+        logger->addAppender(std::make_shared<FileLogAppender>(path));
+    }else if(appender == "binary" || appender == "binary_async"){
+        logger->addAppender(std::make_shared<BinaryLogAppender>(path));
+    }
+    return logger;
+}
+
+static void writeLogs(Logger::ptr logger, const std::string& call, size_t events, std::vector<uint32_t>& latency){
+    latency.resize(events);
+    if(call == "string"){
+        for(size_t i = 0; i < events; ++i){
+            uint64_t start = BenchNowNS();
+            LOG_INFO(logger, "bench string " + std::to_string(i) + " payload abcdefghijklmnopqrstuvwxyz\n");
+            latency[i] = BenchNowNS() - start;
+        }
+    }else{
+        // fmt和disabled；disabled的日志器级别为WARN，INFO日志在宏里就被过滤
+        for(size_t i = 0; i < events; ++i){
+            uint64_t start = BenchNowNS();
+            LOG_FMT_INFO(logger, "bench fmt %zu %s %.2f\n", i, "payload abcdefghijklmnopqrstuvwxyz", i * 0.5);
+            latency[i] = BenchNowNS() - start;
+        }
+    }
+}
+
+static Result runCase(const std::string& appender, const std::string& call, size_t threads, const Options& opt){
+    Result result;
+    result.appender = appender;
+    result.call = call;
+    result.threads = threads;
+    result.events = opt.events * threads;
+
+    Logger::ptr logger = makeLogger(appender, opt);
+    if(call == "disabled"){
+        logger->setLevel(LogLevel::WARN);
+    }
+    auto worker = AsyncLogWorker::getInstance();
+    uint64_t dropped = worker->getDroppedCount();
+    if(appender == "file_async" || appender == "binary_async"){
+        worker->setOverflowPolicy(LogOverflowPolicy::BLOCK);
+        logger->setAsync(true);
+    }
+
+    std::vector<std::vector<uint32_t>> latency(threads);
+    std::vector<Thread::ptr> workers;
+    std::atomic<size_t> ready{0};
+    std::atomic<bool> go{false};
+    for(size_t i = 0; i < threads; ++i){
+        workers.push_back(std::make_shared<Thread>([&, i](){
+            ready.fetch_add(1);
+            while(!go.load(std::memory_order_acquire)){
+            }
+            writeLogs(logger, call, opt.events, latency[i]);
+        }, "bench_" + std::to_string(i)));
+    }
+    while(ready.load() != threads){
+    }
+    uint64_t start = BenchNowNS();
+    go.store(true, std::memory_order_release);
+    for(auto& t : workers){
+        t->join();
+    }
+    uint64_t end = BenchNowNS();
+    if(logger->isAsync()){
+        worker->flush();
+        result.drain_ms = (BenchNowNS() - end) / 1e6;
+        result.dropped = worker->getDroppedCount() - dropped;
+    }
+    logger->flush();
+    result.seconds = (end - start) / 1e9;
+
+    std::vector<uint32_t> all;
+    all.reserve(result.events);
+    for(auto& v : latency){
+        all.insert(all.end(), v.begin(), v.end());
+    }
+    std::sort(all.begin(), all.end());
+    auto percentile = [&all](double p){
+        return (uint64_t)all[std::min(all.size() - 1, (size_t)(all.size() * p))];
+    };
+    result.p50 = percentile(0.5);
+    result.p99 = percentile(0.99);
+    result.p999 = percentile(0.999);
+    result.max = all.back();
+    return result;
+}
+
+int main(int argc, char** argv){
+    Options opt;
+    BenchArgs args;
+    args.addSize('n', "events_per_thread", &opt.events);
+    args.addSize('t', "max_threads", &opt.max_threads);
+    args.addString('o', "result.json", &opt.output);
+    args.addString('d', "log_dir", &opt.dir);
+    if(!args.parse(argc, argv)){
+        return 1;
+    }
+
+    // StdoutLogAppender的输出丢到/dev/null，结果输出到stderr
+    int devnull = open("/dev/null", O_WRONLY);
+    if(devnull < 0 || dup2(devnull, STDOUT_FILENO) < 0){
+        perror("redirect stdout");
+        return 1;
+    }
+    close(devnull);
+
+    const char* appenders[] = {"stdout", "file", "file_async", "binary", "binary_async"};
+    const char* calls[] = {"string", "fmt", "disabled"};
+    BenchReport report("bench_log");
+    report.addField("events_per_thread", opt.events);
+    // 1, 2, 4, ...，最大线程数不是2的幂时也包括它
+    std::vector<size_t> thread_counts;
+    for(size_t threads = 1; threads < opt.max_threads; threads *= 2){
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(opt.max_threads);
+    fprintf(stderr, "%-12s %-9s %7s %14s %9s %9s %9s %10s\n",
+            "appender", "call", "threads", "events/s", "p50(ns)", "p99(ns)", "p999(ns)", "drain(ms)");
+    for(size_t threads : thread_counts){
+        for(const char* appender : appenders){
+            for(const char* call : calls){
+                Result r = runCase(appender, call, threads, opt);
+                fprintf(stderr, "%-12s %-9s %7zu %14.0f %9llu %9llu %9llu %10.3f\n",
+                        r.appender.c_str(), r.call.c_str(), r.threads, r.events / r.seconds,
+                        (unsigned long long)r.p50, (unsigned long long)r.p99,
+                        (unsigned long long)r.p999, r.drain_ms);
+                report.addResult("\"appender\": \"%s\", \"call\": \"%s\", \"threads\": %zu, \"events\": %zu, "
+                        "\"seconds\": %.6f, \"events_per_sec\": %.0f, \"drain_ms\": %.3f, \"dropped\": %llu, "
+                        "\"latency_ns\": {\"p50\": %llu, \"p99\": %llu, \"p999\": %llu, \"max\": %llu}",
+                        r.appender.c_str(), r.call.c_str(), r.threads, r.events,
+                        r.seconds, r.events / r.seconds, r.drain_ms, (unsigned long long)r.dropped,
+                        (unsigned long long)r.p50, (unsigned long long)r.p99,
+                        (unsigned long long)r.p999, (unsigned long long)r.max);
+            }
+        }
+    }
+    report.write(opt.output);
+    return 0;
+}
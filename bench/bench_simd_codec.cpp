@@ -0,0 +1,186 @@
+/*
+    批量字节序转换和varint编解码的基准测试
+    用法: bench_simd_codec [-n 元素数量] [-r 轮数] [-o 结果json]
+    每个用例对n个元素重复r轮，分别测量：
+        loop        逐个元素调用byteswap的循环(对照，Release构建时编译器可能自动向量化)
+        bytearray   ByteArray::writeUint32/readUint32逐个编解码(对照)
+        scalar/ssse3/avx2   ByteswapArray/VarintEncodeArray/VarintDecodeArray在各级别下的实现
+    varint分两种数据：small全部小于128，mixed是1~5字节长度均匀分布
+    结果以 ns/元素 输出到终端(stderr)并写入json文件。
+*/
+#include "simd_codec.h"
+#include "bytearray.h"
+#include "clock.h"
+#include "bench_util.h"
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace caizi;
+
+struct Options{
+    size_t count = 1 << 16;
+    size_t rounds = 200;
+    std::string output = "bench_simd_codec.json";
+};
+
+struct Result{
+    std::string name;
+    std::string impl;
+    size_t count = 0;
+    double ns_per_op = 0;
+};
+
+static Result MakeResult(const std::string& name, const std::string& impl, size_t count, uint64_t ns){
+    Result r;
+    r.name = name;
+    r.impl = impl;
+    r.count = count;
+    r.ns_per_op = (double)ns / count;
+    return r;
+}
+
+// 防止结果被优化掉
+static volatile uint64_t s_sink = 0;
+
+static std::vector<SimdLevel> Levels(){
+    std::vector<SimdLevel> levels;
+    for(int level = 0; level <= (int)GetCpuSimdLevel(); ++level){
+        levels.push_back((SimdLevel)level);
+    }
+    return levels;
+}
+
+static std::string LevelName(SimdLevel level){
+    std::string name = SimdLevelToString(level);
+    for(auto& c : name){
+        c = tolower(c);
+    }
+    return name;
+}
+
+template<class T>
+static void runByteswap(const Options& opt, std::vector<Result>& results){
+    std::string name = "byteswap" + std::to_string(sizeof(T) * 8);
+    std::mt19937_64 rng(42);
+    std::vector<T> src(opt.count);
+    for(auto& v : src){
+        v = (T)rng();
+    }
+    std::vector<T> dst(opt.count);
+    size_t total = opt.count * opt.rounds;
+
+    uint64_t start = BenchNowNS();
+    for(size_t r = 0; r < opt.rounds; ++r){
+        for(size_t i = 0; i < opt.count; ++i){
+            dst[i] = byteswap(src[i]);
+        }
+        s_sink += dst[r % opt.count];
+    }
+    results.push_back(MakeResult(name, "loop", total, BenchNowNS() - start));
+
+    for(SimdLevel level : Levels()){
+        SetSimdLevel(level);
+        start = BenchNowNS();
+        for(size_t r = 0; r < opt.rounds; ++r){
+            ByteswapArray(dst.data(), src.data(), opt.count);
+            s_sink += dst[r % opt.count];
+        }
+        results.push_back(MakeResult(name, LevelName(level), total, BenchNowNS() - start));
+    }
+    SetSimdLevel(GetCpuSimdLevel());
+}
+
+static void runVarint(const Options& opt, const char* data, std::vector<Result>& results){
+    std::mt19937_64 rng(42);
+    std::vector<uint32_t> values(opt.count);
+    bool small = std::string(data) == "small";
+    for(auto& v : values){
+        if(small){
+            v = rng() % 128;
+        }else{
+            // 长度1~5字节均匀分布
+            int bytes = rng() % 5;
+            v = bytes == 4 ? (uint32_t)rng() | 0xf0000000 : (uint32_t)(rng() % (1u << (7 * (bytes + 1))));
+        }
+    }
+    std::string encode_name = std::string("encode_") + data;
+    std::string decode_name = std::string("decode_") + data;
+    size_t total = opt.count * opt.rounds;
+    std::vector<uint8_t> buf(opt.count * kMaxVarint32Size);
+    std::vector<uint32_t> out(opt.count);
+
+    // ByteArray逐个编解码，块大小足够大，只测编码本身
+    ByteArray ba(opt.count * kMaxVarint32Size);
+    uint64_t start = BenchNowNS();
+    for(size_t r = 0; r < opt.rounds; ++r){
+        ba.clear();
+        for(auto v : values){
+            ba.writeUint32(v);
+        }
+        s_sink += ba.getSize();
+    }
+    results.push_back(MakeResult(encode_name, "bytearray", total, BenchNowNS() - start));
+    start = BenchNowNS();
+    for(size_t r = 0; r < opt.rounds; ++r){
+        ba.setPosition(0);
+        for(size_t i = 0; i < opt.count; ++i){
+            out[i] = ba.readUint32();
+        }
+        s_sink += out[r % opt.count];
+    }
+    results.push_back(MakeResult(decode_name, "bytearray", total, BenchNowNS() - start));
+
+    for(SimdLevel level : Levels()){
+        SetSimdLevel(level);
+        size_t len = 0;
+        start = BenchNowNS();
+        for(size_t r = 0; r < opt.rounds; ++r){
+            len = VarintEncodeArray(values.data(), opt.count, buf.data());
+            s_sink += len;
+        }
+        results.push_back(MakeResult(encode_name, LevelName(level), total, BenchNowNS() - start));
+        start = BenchNowNS();
+        for(size_t r = 0; r < opt.rounds; ++r){
+            s_sink += VarintDecodeArray(buf.data(), len, out.data(), opt.count);
+        }
+        results.push_back(MakeResult(decode_name, LevelName(level), total, BenchNowNS() - start));
+        if(out != values){
+            fprintf(stderr, "%s decode mismatch\n", LevelName(level).c_str());
+            exit(1);
+        }
+    }
+    SetSimdLevel(GetCpuSimdLevel());
+}
+
+int main(int argc, char** argv){
+    Options opt;
+    BenchArgs args;
+    args.addSize('n', "elements", &opt.count);
+    args.addSize('r', "rounds", &opt.rounds);
+    args.addString('o', "result.json", &opt.output);
+    if(!args.parse(argc, argv)){
+        return 1;
+    }
+
+    std::vector<Result> results;
+    runByteswap<uint16_t>(opt, results);
+    runByteswap<uint32_t>(opt, results);
+    runByteswap<uint64_t>(opt, results);
+    runVarint(opt, "small", results);
+    runVarint(opt, "mixed", results);
+
+    BenchReport report("bench_simd_codec");
+    report.addField("cpu_simd_level", LevelName(GetCpuSimdLevel()));
+    fprintf(stderr, "%-14s %-10s %12s %10s\n", "name", "impl", "count", "ns/op");
+    for(auto& r : results){
+        fprintf(stderr, "%-14s %-10s %12zu %10.3f\n", r.name.c_str(), r.impl.c_str(), r.count, r.ns_per_op);
+        report.addResult("\"name\": \"%s\", \"impl\": \"%s\", \"count\": %zu, \"ns_per_op\": %.3f",
+                r.name.c_str(), r.impl.c_str(), r.count, r.ns_per_op);
+    }
+    report.write(opt.output);
+    return 0;
+}
@@ -0,0 +1,148 @@
+/*
+    定时器的基准测试
+    用法: bench_timer [-n 定时器数量] [-o 结果json]
+    模拟大量连接的超时：先添加n个1~60秒随机超时的定时器，再逐个刷新，最后逐个取消。
+    分别测量：
+        wheel   TimerManager(分层时间轮)
+        set     按到期时间排序的std::set(常见的实现方式，作为对照)
+    结果以 ns/次 输出到终端(stderr)并写入json文件。
+*/
+#include "timer.h"
+#include "clock.h"
+#include "bench_util.h"
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace caizi;
+
+struct Options{
+    size_t count = 1000000;
+    std::string output = "bench_timer.json";
+};
+
+struct Result{
+    std::string name;
+    std::string impl;
+    size_t count = 0;
+    double ns_per_op = 0;
+};
+
+static Result MakeResult(const char* name, const char* impl, size_t count, uint64_t ns){
+    Result r;
+    r.name = name;
+    r.impl = impl;
+    r.count = count;
+    r.ns_per_op = (double)ns / count;
+    return r;
+}
+
+class BenchTimerManager : public TimerManager{
+protected:
+    void onTimerInsertedAtFront() override{}
+};
+
+static void runWheel(const std::vector<uint64_t>& timeouts, std::vector<Result>& results){
+    BenchTimerManager manager;
+    std::vector<Timer::ptr> timers;
+    timers.reserve(timeouts.size());
+    uint64_t start = BenchNowNS();
+    for(uint64_t ms : timeouts){
+        timers.push_back(manager.addTimer(ms, [](){}));
+    }
+    uint64_t added = BenchNowNS();
+    for(auto& timer : timers){
+        timer->refresh();
+    }
+    uint64_t refreshed = BenchNowNS();
+    for(auto& timer : timers){
+        timer->cancel();
+    }
+    uint64_t cancelled = BenchNowNS();
+    results.push_back(MakeResult("add", "wheel", timeouts.size(), added - start));
+    results.push_back(MakeResult("refresh", "wheel", timeouts.size(), refreshed - added));
+    results.push_back(MakeResult("cancel", "wheel", timeouts.size(), cancelled - refreshed));
+}
+
+// 对照组：按到期时间排序的集合，添加、刷新、取消都是O(log n)
+struct SetTimer{
+    typedef std::shared_ptr<SetTimer> ptr;
+    uint64_t ms;
+    uint64_t expire;
+    std::function<void()> cb;
+};
+
+struct SetTimerCompare{
+    bool operator()(const SetTimer::ptr& lhs, const SetTimer::ptr& rhs) const{
+        if(lhs->expire != rhs->expire){
+            return lhs->expire < rhs->expire;
+        }
+        return lhs.get() < rhs.get();
+    }
+};
+
+static void runSet(const std::vector<uint64_t>& timeouts, std::vector<Result>& results){
+    Mutex mutex;
+    std::set<SetTimer::ptr, SetTimerCompare> set;
+    std::vector<SetTimer::ptr> timers;
+    timers.reserve(timeouts.size());
+    uint64_t start = BenchNowNS();
+    for(uint64_t ms : timeouts){
+        SetTimer::ptr timer(new SetTimer{ms, TimerManager::NowMS() + ms, [](){}});
+        ScopeLock lock(&mutex);
+        set.insert(timer);
+        timers.push_back(timer);
+    }
+    uint64_t added = BenchNowNS();
+    for(auto& timer : timers){
+        ScopeLock lock(&mutex);
+        set.erase(timer);
+        timer->expire = TimerManager::NowMS() + timer->ms;
+        set.insert(timer);
+    }
+    uint64_t refreshed = BenchNowNS();
+    for(auto& timer : timers){
+        ScopeLock lock(&mutex);
+        set.erase(timer);
+    }
+    uint64_t cancelled = BenchNowNS();
+    results.push_back(MakeResult("add", "set", timeouts.size(), added - start));
+    results.push_back(MakeResult("refresh", "set", timeouts.size(), refreshed - added));
+    results.push_back(MakeResult("cancel", "set", timeouts.size(), cancelled - refreshed));
+}
+
+int main(int argc, char** argv){
+    Options opt;
+    BenchArgs args;
+    args.addSize('n', "timers", &opt.count);
+    args.addString('o', "result.json", &opt.output);
+    if(!args.parse(argc, argv)){
+        return 1;
+    }
+
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<uint64_t> dist(1000, 60000);
+    std::vector<uint64_t> timeouts(opt.count);
+    for(auto& ms : timeouts){
+        ms = dist(rng);
+    }
+
+    std::vector<Result> results;
+    runWheel(timeouts, results);
+    runSet(timeouts, results);
+
+    BenchReport report("bench_timer");
+    fprintf(stderr, "%-8s %-6s %10s %10s\n", "name", "impl", "count", "ns/op");
+    for(auto& r : results){
+        fprintf(stderr, "%-8s %-6s %10zu %10.2f\n", r.name.c_str(), r.impl.c_str(), r.count, r.ns_per_op);
+        report.addResult("\"name\": \"%s\", \"impl\": \"%s\", \"count\": %zu, \"ns_per_op\": %.2f",
+                r.name.c_str(), r.impl.c_str(), r.count, r.ns_per_op);
+    }
+    report.write(opt.output);
+    return 0;
+}
@@ -0,0 +1,165 @@
+/*
+    @file bench_util.h
+    @brief 基准测试共用的计时、命令行解析和json结果输出
+*/
+
+#ifndef __CAIZI_BENCH_UTIL_H__
+#define __CAIZI_BENCH_UTIL_H__
+
+#include "clock.h"
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace caizi{
+
+inline uint64_t BenchNowNS(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+    命令行参数，每个选项都带一个值：
+        addSize     解析为size_t，必须大于0
+        addString   原样保存
+    parse失败(未知选项、数值为0)时输出用法并返回false。
+*/
+class BenchArgs{
+public:
+    void addSize(char opt, const char* name, size_t* value){
+        m_options.push_back({opt, name, value, nullptr});
+    }
+
+    void addString(char opt, const char* name, std::string* value){
+        m_options.push_back({opt, name, nullptr, value});
+    }
+
+    bool parse(int argc, char** argv){
+        std::string optstring;
+        for(auto& o : m_options){
+            optstring += o.opt;
+            optstring += ':';
+        }
+        optstring += 'h';
+        int c;
+        while((c = getopt(argc, argv, optstring.c_str())) != -1){
+            Option* option = find(c);
+            if(!option){
+                usage(argv[0]);
+                return false;
+            }
+            if(option->size){
+                *option->size = strtoull(optarg, nullptr, 10);
+            }else{
+                *option->str = optarg;
+            }
+        }
+        for(auto& o : m_options){
+            if(o.size && *o.size == 0){
+                usage(argv[0]);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void usage(const char* prog) const{
+        std::string text;
+        for(auto& o : m_options){
+            text += std::string(" [-") + o.opt + " " + o.name + "]";
+        }
+        fprintf(stderr, "usage: %s%s\n", prog, text.c_str());
+    }
+
+private:
+    struct Option{
+        char opt;
+        const char* name;
+        size_t* size;
+        std::string* str;
+    };
+
+    Option* find(int c){
+        for(auto& o : m_options){
+            if(o.opt == c){
+                return &o;
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    std::vector<Option> m_options;
+};
+
+/*
+    json结果文件：
+        {"benchmark": 名称, "timestamp_ms", "build", "hardware_threads", 附加字段..., "results": [每个用例一个对象]}
+    addField/addResult 传入的是已经格式化好的json片段，不做转义。
+*/
+class BenchReport{
+public:
+    explicit BenchReport(const std::string& benchmark)
+        :m_benchmark(benchmark){
+    }
+
+    void addField(const std::string& key, const std::string& value){
+        m_fields.push_back("\"" + key + "\": \"" + value + "\"");
+    }
+
+    void addField(const std::string& key, uint64_t value){
+        m_fields.push_back("\"" + key + "\": " + std::to_string(value));
+    }
+
+    // 一个用例的结果，fmt为对象内部的键值对，不含外层的大括号
+    void addResult(const char* fmt, ...) __attribute__((format(printf, 2, 3))){
+        char buf[1024];
+        va_list ap;
+        va_start(ap, fmt);
+        vsnprintf(buf, sizeof(buf), fmt, ap);
+        va_end(ap);
+        m_results.push_back(buf);
+    }
+
+    bool write(const std::string& path) const{
+        FILE* fp = fopen(path.c_str(), "w");
+        if(!fp){
+            fprintf(stderr, "cannot write %s\n", path.c_str());
+            return false;
+        }
+        fprintf(fp, "{\n");
+        fprintf(fp, "  \"benchmark\": \"%s\",\n", m_benchmark.c_str());
+        fprintf(fp, "  \"timestamp_ms\": %llu,\n", (unsigned long long)CoarseClock::NowMS());
+#ifdef NDEBUG
+        fprintf(fp, "  \"build\": \"release\",\n");
+#else
+        fprintf(fp, "  \"build\": \"debug\",\n");
+#endif
+        fprintf(fp, "  \"hardware_threads\": %u,\n", std::thread::hardware_concurrency());
+        for(auto& field : m_fields){
+            fprintf(fp, "  %s,\n", field.c_str());
+        }
+        fprintf(fp, "  \"results\": [\n");
+        for(size_t i = 0; i < m_results.size(); ++i){
+            fprintf(fp, "    {%s}%s\n", m_results[i].c_str(), i + 1 == m_results.size() ? "" : ",");
+        }
+        fprintf(fp, "  ]\n}\n");
+        fclose(fp);
+        fprintf(stderr, "results written to %s\n", path.c_str());
+        return true;
+    }
+
+private:
+    std::string m_benchmark;
+    std::vector<std::string> m_fields;
+    std::vector<std::string> m_results;
+};
+
+}
+
+#endif
@@ -6,6 +6,8 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netdb.h>
+#include <stddef.h>
+#include <string.h>
 
 namespace caizi{
 
@@ -34,6 +36,15 @@ Address::ptr Address::create(const sockaddr* addr, socklen_t addrlen){
         case AF_INET6:
             result.reset(new IPv6Address(*(sockaddr_in6*)(addr)));
             break;
+        case AF_UNIX:
+            {
+                UnixAddress::ptr unix_addr(new UnixAddress());
+                socklen_t len = std::min(addrlen, (socklen_t)sizeof(sockaddr_un));
+                memcpy(unix_addr->getAddr(), addr, len);
+                unix_addr->setAddrLen(len);
+                result = unix_addr;
+            }
+            break;
         default:
             result.reset(new UnknownAddress(*addr));
             break;
@@ -107,7 +118,7 @@ IPAddress::ptr IPAddress::create(const char* address, uint16_t port){
 IPv4Address::ptr IPv4Address::create(const char* address, uint16_t port){
     IPv4Address::ptr rt(new IPv4Address());
     rt->m_addr.sin_family = AF_INET;
-    rt->m_addr.sin_port = port;
+    rt->m_addr.sin_port = byteswapOnLitterEndian(port);
     int result = inet_pton(AF_INET, address, &rt->m_addr.sin_addr);
     if(result <= 0){
         LOG_FMT_DEBUG(g_logger, "IPv4Address::create:%s, %d, 创建IPv4失败！已返回空指针",address,result);
@@ -120,6 +131,7 @@ IPv4Address::IPv4Address(const sockaddr_in& address){
     m_addr = address;
 }
 IPv4Address::IPv4Address(uint32_t address, uint16_t port){
+    memset(&m_addr, 0, sizeof(m_addr));
     m_addr.sin_family = AF_INET;
     m_addr.sin_port = byteswapOnLitterEndian(port);
     m_addr.sin_addr.s_addr = byteswapOnLitterEndian(address);
@@ -257,36 +269,74 @@ void IPv6Address::set_port(uint16_t port){
 /*
     UnixAddress地址
 */
-UnixAddress::UnixAddress(const std::string& path){
+static const size_t MAX_PATH_LEN = sizeof(((sockaddr_un*)0)->sun_path) - 1;
+
+UnixAddress::UnixAddress(){
+    memset(&m_addr, 0, sizeof(m_addr));
+    m_addr.sun_family = AF_UNIX;
+    m_length = offsetof(sockaddr_un, sun_path) + MAX_PATH_LEN;
+}
 
+UnixAddress::UnixAddress(const std::string& path){
+    memset(&m_addr, 0, sizeof(m_addr));
+    m_addr.sun_family = AF_UNIX;
+    size_t len = std::min(path.size(), MAX_PATH_LEN);
+    memcpy(m_addr.sun_path, path.c_str(), len);
+    // 普通路径包含结尾的'\0'，抽象地址按实际长度
+    if(len && path[0] != '\0'){
+        ++len;
+    }
+    m_length = offsetof(sockaddr_un, sun_path) + len;
 }
 
 const sockaddr* UnixAddress::getAddr() const{
     return (sockaddr*)&m_addr;
 };
+sockaddr* UnixAddress::getAddr(){
+    return (sockaddr*)&m_addr;
+};
 socklen_t UnixAddress::getAddrLen() const{
     return m_length;
 };
+void UnixAddress::setAddrLen(socklen_t v){
+    m_length = v;
+}
+std::string UnixAddress::getPath() const{
+    size_t len = m_length > offsetof(sockaddr_un, sun_path) ? m_length - offsetof(sockaddr_un, sun_path) : 0;
+    if(len && m_addr.sun_path[0] != '\0'){
+        return std::string(m_addr.sun_path, strnlen(m_addr.sun_path, len));
+    }
+    return std::string(m_addr.sun_path, len);
+}
 std::ostream& UnixAddress::insert(std::ostream& os) const{
-    return os;
+    std::string path = getPath();
+    if(!path.empty() && path[0] == '\0'){
+        return os << "\\0" << path.substr(1);
+    }
+    return os << path;
 };
 
 /*
     未知地址
 */
-UnknownAddress::UnknownAddress(int family){};
-UnknownAddress::UnknownAddress(const sockaddr& addr){};
+UnknownAddress::UnknownAddress(int family){
+    memset(&m_addr, 0, sizeof(m_addr));
+    m_addr.sa_family = family;
+};
+UnknownAddress::UnknownAddress(const sockaddr& addr){
+    m_addr = addr;
+};
 const sockaddr* UnknownAddress::getAddr() const{
-    return nullptr;
+    return &m_addr;
 };
 sockaddr* UnknownAddress::getAddr() {
-    return nullptr;
+    return &m_addr;
 };
 socklen_t UnknownAddress::getAddrLen() const{
-    return 0;
+    return sizeof(m_addr);
 };
 std::ostream& UnknownAddress::insert(std::ostream& os) const{
-    return os;
+    return os << "[UnknownAddress family=" << m_addr.sa_family << "]";
 };
 
 }
\ No newline at end of file
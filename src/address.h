@@ -102,21 +102,26 @@ private:
     sockaddr_in6 m_addr;
 };
 
-// 待实现
+// Unix域套接字地址，path以'\0'开头时为抽象地址
 class UnixAddress : public Address{
 public:
     typedef std::shared_ptr<UnixAddress> ptr;
+    // 空地址，用于getsockname等填充
+    UnixAddress();
     UnixAddress(const std::string& path);
 
     const sockaddr* getAddr() const override;
+    sockaddr* getAddr() override;
     socklen_t getAddrLen() const override;
+    void setAddrLen(socklen_t v);
+    std::string getPath() const;
     std::ostream& insert(std::ostream& os) const override;
 private:
     struct sockaddr_un m_addr;
     socklen_t m_length;
 };
 
-// 待实现
+// 不支持的协议簇，只保存原始地址
 class UnknownAddress: public Address{
 public:
     typedef std::shared_ptr<UnknownAddress> ptr;
@@ -0,0 +1,574 @@
+#include "bytearray.h"
+#include "config.h"
+#include "endiant.h"
+#include "log.h"
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string.h>
+
+namespace caizi{
+
+static Logger::ptr g_logger = CAIZI_GET_LOGGER("system");
+
+static ConfigVar<uint32_t>::ptr g_block_size =
+    Config::Lookup<uint32_t>("bytearray.block_size", 4096, "bytearray block size");
+static ConfigVar<uint32_t>::ptr g_block_pool_size =
+    Config::Lookup<uint32_t>("bytearray.pool_size", 1024, "idle bytearray blocks kept per thread");
+
+// 配置值缓存在原子变量里，分配块时不需要读配置的锁
+static std::atomic<uint32_t> s_block_size{g_block_size->getValue()};
+static std::atomic<uint32_t> s_block_pool_size{g_block_pool_size->getValue()};
+
+struct ByteArrayConfigIniter{
+    ByteArrayConfigIniter(){
+        g_block_size->addListener([](const uint32_t& old_value, const uint32_t& new_value){
+            s_block_size.store(new_value, std::memory_order_relaxed);
+        });
+        g_block_pool_size->addListener([](const uint32_t& old_value, const uint32_t& new_value){
+            s_block_pool_size.store(new_value, std::memory_order_relaxed);
+        });
+    }
+};
+static ByteArrayConfigIniter __bytearray_config_init;
+
+// 线程局部的空闲块链表，只缓存默认大小的块，线程退出时释放
+struct BlockFreeList{
+    std::vector<void*> blocks;
+    size_t size = 0;            // 缓存的块大小，配置改变后丢弃旧的块
+    bool destroyed = false;
+    ~BlockFreeList(){
+        destroyed = true;
+        for(auto block : blocks){
+            ::operator delete(block);
+        }
+    }
+};
+static thread_local BlockFreeList t_free_blocks;
+
+ByteArray::Node* ByteArray::NewNode(size_t size){
+    BlockFreeList& list = t_free_blocks;
+    void* mem = nullptr;
+    if(!list.destroyed && size == list.size && !list.blocks.empty()){
+        mem = list.blocks.back();
+        list.blocks.pop_back();
+    }else{
+        mem = ::operator new(sizeof(Node) + size);
+    }
+    Node* node = (Node*)mem;
+    node->ptr = (char*)(node + 1);
+    node->next = nullptr;
+    node->size = size;
+    return node;
+}
+
+void ByteArray::DeleteNode(Node* node){
+    BlockFreeList& list = t_free_blocks;
+    size_t size = node->size;
+    if(!list.destroyed && size == s_block_size.load(std::memory_order_relaxed)){
+        if(list.size != size){
+            for(auto block : list.blocks){
+                ::operator delete(block);
+            }
+            list.blocks.clear();
+            list.size = size;
+        }
+        if(list.blocks.size() < s_block_pool_size.load(std::memory_order_relaxed)){
+            list.blocks.push_back(node);
+            return;
+        }
+    }
+    ::operator delete(node);
+}
+
+ByteArray::ByteArray(size_t base_size)
+    :m_baseSize(base_size ? base_size : s_block_size.load(std::memory_order_relaxed))
+    ,m_position(0)
+    ,m_capacity(m_baseSize)
+    ,m_size(0)
+    ,m_endian(CAIZI_BIG_ENDIAN)
+    ,m_root(NewNode(m_baseSize))
+    ,m_tail(m_root)
+    ,m_cur(m_root){
+}
+
+ByteArray::~ByteArray(){
+    Node* node = m_root;
+    while(node){
+        Node* next = node->next;
+        DeleteNode(node);
+        node = next;
+    }
+}
+
+bool ByteArray::isLittleEndian() const{
+    return m_endian == CAIZI_LITTLE_ENDIAN;
+}
+
+void ByteArray::setIsLittleEndian(bool val){
+    m_endian = val ? CAIZI_LITTLE_ENDIAN : CAIZI_BIG_ENDIAN;
+}
+
+template<class T>
+void ByteArray::writeFixed(T value){
+    if(m_endian != CAIZI_BYTE_ORDER){
+        value = byteswap(value);
+    }
+    write(&value, sizeof(value));
+}
+
+template<class T>
+T ByteArray::readFixed(){
+    T value;
+    read(&value, sizeof(value));
+    if(m_endian != CAIZI_BYTE_ORDER){
+        value = byteswap(value);
+    }
+    return value;
+}
+
+// zigzag把符号位移到最低位，绝对值小的负数也编码成小的无符号数
+static uint64_t EncodeZigzag(int64_t value){
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t DecodeZigzag(uint64_t value){
+    return (int64_t)((value >> 1) ^ (~(value & 1) + 1));
+}
+
+void ByteArray::writeVarint(uint64_t value){
+    uint8_t tmp[10];
+    size_t i = 0;
+    while(value >= 0x80){
+        tmp[i++] = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    tmp[i++] = value;
+    write(tmp, i);
+}
+
+uint64_t ByteArray::readVarint(){
+    // 整个varint在当前块内时直接解码
+    if(m_cur){
+        size_t npos = m_position % m_baseSize;
+        size_t avail = std::min(m_cur->size - npos, getReadSize());
+        const uint8_t* p = (const uint8_t*)m_cur->ptr + npos;
+        uint64_t result = 0;
+        for(size_t i = 0; i < avail && i < 10; ++i){
+            result |= (uint64_t)(p[i] & 0x7f) << (7 * i);
+            if(!(p[i] & 0x80)){
+                skipInNode(i + 1);
+                return result;
+            }
+        }
+    }
+    uint64_t result = 0;
+    for(size_t i = 0; i < 10; ++i){
+        uint8_t b = readFuint8();
+        result |= (uint64_t)(b & 0x7f) << (7 * i);
+        if(!(b & 0x80)){
+            break;
+        }
+    }
+    return result;
+}
+
+void ByteArray::writeFint8(int8_t value){
+    write(&value, sizeof(value));
+}
+void ByteArray::writeFuint8(uint8_t value){
+    write(&value, sizeof(value));
+}
+void ByteArray::writeFint16(int16_t value){
+    writeFixed(value);
+}
+void ByteArray::writeFuint16(uint16_t value){
+    writeFixed(value);
+}
+void ByteArray::writeFint32(int32_t value){
+    writeFixed(value);
+}
+void ByteArray::writeFuint32(uint32_t value){
+    writeFixed(value);
+}
+void ByteArray::writeFint64(int64_t value){
+    writeFixed(value);
+}
+void ByteArray::writeFuint64(uint64_t value){
+    writeFixed(value);
+}
+
+void ByteArray::writeInt16(int16_t value){
+    writeVarint(EncodeZigzag(value));
+}
+void ByteArray::writeUint16(uint16_t value){
+    writeVarint(value);
+}
+void ByteArray::writeInt32(int32_t value){
+    writeVarint(EncodeZigzag(value));
+}
+void ByteArray::writeUint32(uint32_t value){
+    writeVarint(value);
+}
+void ByteArray::writeInt64(int64_t value){
+    writeVarint(EncodeZigzag(value));
+}
+void ByteArray::writeUint64(uint64_t value){
+    writeVarint(value);
+}
+
+void ByteArray::writeFloat(float value){
+    uint32_t v;
+    memcpy(&v, &value, sizeof(value));
+    writeFuint32(v);
+}
+void ByteArray::writeDouble(double value){
+    uint64_t v;
+    memcpy(&v, &value, sizeof(value));
+    writeFuint64(v);
+}
+
+void ByteArray::writeStringF16(const std::string& value){
+    writeFuint16(value.size());
+    write(value.c_str(), value.size());
+}
+void ByteArray::writeStringF32(const std::string& value){
+    writeFuint32(value.size());
+    write(value.c_str(), value.size());
+}
+void ByteArray::writeStringF64(const std::string& value){
+    writeFuint64(value.size());
+    write(value.c_str(), value.size());
+}
+void ByteArray::writeStringVint(const std::string& value){
+    writeUint64(value.size());
+    write(value.c_str(), value.size());
+}
+void ByteArray::writeStringWithoutLength(const std::string& value){
+    write(value.c_str(), value.size());
+}
+
+int8_t ByteArray::readFint8(){
+    int8_t v;
+    read(&v, sizeof(v));
+    return v;
+}
+uint8_t ByteArray::readFuint8(){
+    uint8_t v;
+    read(&v, sizeof(v));
+    return v;
+}
+int16_t ByteArray::readFint16(){
+    return readFixed<int16_t>();
+}
+uint16_t ByteArray::readFuint16(){
+    return readFixed<uint16_t>();
+}
+int32_t ByteArray::readFint32(){
+    return readFixed<int32_t>();
+}
+uint32_t ByteArray::readFuint32(){
+    return readFixed<uint32_t>();
+}
+int64_t ByteArray::readFint64(){
+    return readFixed<int64_t>();
+}
+uint64_t ByteArray::readFuint64(){
+    return readFixed<uint64_t>();
+}
+
+int16_t ByteArray::readInt16(){
+    return (int16_t)DecodeZigzag(readVarint());
+}
+uint16_t ByteArray::readUint16(){
+    return (uint16_t)readVarint();
+}
+int32_t ByteArray::readInt32(){
+    return (int32_t)DecodeZigzag(readVarint());
+}
+uint32_t ByteArray::readUint32(){
+    return (uint32_t)readVarint();
+}
+int64_t ByteArray::readInt64(){
+    return DecodeZigzag(readVarint());
+}
+uint64_t ByteArray::readUint64(){
+    return readVarint();
+}
+
+float ByteArray::readFloat(){
+    uint32_t v = readFuint32();
+    float value;
+    memcpy(&value, &v, sizeof(v));
+    return value;
+}
+double ByteArray::readDouble(){
+    uint64_t v = readFuint64();
+    double value;
+    memcpy(&value, &v, sizeof(v));
+    return value;
+}
+
+// 先检查长度，错误的长度字段不会导致分配巨大的字符串
+std::string ByteArray::readString(uint64_t len){
+    if(len > getReadSize()){
+        throw std::out_of_range("ByteArray::readString not enough data");
+    }
+    std::string buf;
+    buf.resize(len);
+    read(&buf[0], len);
+    return buf;
+}
+
+std::string ByteArray::readStringF16(){
+    return readString(readFuint16());
+}
+std::string ByteArray::readStringF32(){
+    return readString(readFuint32());
+}
+std::string ByteArray::readStringF64(){
+    return readString(readFuint64());
+}
+std::string ByteArray::readStringVint(){
+    return readString(readUint64());
+}
+
+void ByteArray::clear(){
+    m_position = m_size = 0;
+    m_capacity = m_baseSize;
+    Node* node = m_root->next;
+    while(node){
+        Node* next = node->next;
+        DeleteNode(node);
+        node = next;
+    }
+    m_root->next = nullptr;
+    m_tail = m_cur = m_root;
+}
+
+void ByteArray::write(const void* buf, size_t size){
+    if(size == 0){
+        return;
+    }
+    addCapacity(size);
+    const char* src = (const char*)buf;
+    size_t npos = m_position % m_baseSize;
+    while(size > 0){
+        size_t ncap = m_cur->size - npos;
+        size_t n = std::min(ncap, size);
+        memcpy(m_cur->ptr + npos, src, n);
+        src += n;
+        size -= n;
+        m_position += n;
+        if(n == ncap){
+            m_cur = m_cur->next;
+        }
+        npos = 0;
+    }
+    if(m_position > m_size){
+        m_size = m_position;
+    }
+}
+
+void ByteArray::read(void* buf, size_t size){
+    if(size > getReadSize()){
+        throw std::out_of_range("ByteArray::read not enough data");
+    }
+    char* dst = (char*)buf;
+    size_t npos = m_position % m_baseSize;
+    while(size > 0){
+        size_t ncap = m_cur->size - npos;
+        size_t n = std::min(ncap, size);
+        memcpy(dst, m_cur->ptr + npos, n);
+        dst += n;
+        size -= n;
+        m_position += n;
+        if(n == ncap){
+            m_cur = m_cur->next;
+        }
+        npos = 0;
+    }
+}
+
+void ByteArray::read(void* buf, size_t size, size_t position) const{
+    if(position > m_size || size > m_size - position){
+        throw std::out_of_range("ByteArray::read not enough data");
+    }
+    Node* cur = m_root;
+    size_t skip = position / m_baseSize;
+    while(skip--){
+        cur = cur->next;
+    }
+    char* dst = (char*)buf;
+    size_t npos = position % m_baseSize;
+    while(size > 0){
+        size_t n = std::min(cur->size - npos, size);
+        memcpy(dst, cur->ptr + npos, n);
+        dst += n;
+        size -= n;
+        cur = cur->next;
+        npos = 0;
+    }
+}
+
+void ByteArray::skipInNode(size_t n){
+    size_t npos = m_position % m_baseSize;
+    m_position += n;
+    if(npos + n == m_cur->size){
+        m_cur = m_cur->next;
+    }
+}
+
+void ByteArray::setPosition(size_t v){
+    if(v > m_capacity){
+        throw std::out_of_range("ByteArray::setPosition out of range");
+    }
+    m_position = v;
+    if(m_position > m_size){
+        m_size = m_position;
+    }
+    m_cur = m_root;
+    while(m_cur && v >= m_cur->size){
+        v -= m_cur->size;
+        m_cur = m_cur->next;
+    }
+}
+
+bool ByteArray::writeToFile(const std::string& name) const{
+    std::ofstream ofs(name, std::ios::trunc | std::ios::binary);
+    if(!ofs){
+        LOG_FMT_ERROR(g_logger, "writeToFile name=%s error errno=%d %s\n", name.c_str(), errno, strerror(errno));
+        return false;
+    }
+    std::vector<iovec> buffers;
+    getReadBuffers(buffers);
+    for(auto& iov : buffers){
+        ofs.write((const char*)iov.iov_base, iov.iov_len);
+    }
+    return (bool)ofs;
+}
+
+bool ByteArray::readFromFile(const std::string& name){
+    std::ifstream ifs(name, std::ios::binary);
+    if(!ifs){
+        LOG_FMT_ERROR(g_logger, "readFromFile name=%s error errno=%d %s\n", name.c_str(), errno, strerror(errno));
+        return false;
+    }
+    // 直接读入块中
+    while(true){
+        std::vector<iovec> buffers;
+        getWriteBuffers(buffers, m_baseSize);
+        size_t total = 0;
+        for(auto& iov : buffers){
+            ifs.read((char*)iov.iov_base, iov.iov_len);
+            total += ifs.gcount();
+            if((size_t)ifs.gcount() < iov.iov_len){
+                break;
+            }
+        }
+        setPosition(m_position + total);
+        if(!ifs){
+            break;
+        }
+    }
+    return true;
+}
+
+void ByteArray::addCapacity(size_t size){
+    size_t old_cap = getCapacity();
+    if(old_cap >= size){
+        return;
+    }
+    size -= old_cap;
+    size_t count = (size + m_baseSize - 1) / m_baseSize;
+    Node* first = nullptr;
+    for(size_t i = 0; i < count; ++i){
+        Node* node = NewNode(m_baseSize);
+        m_tail->next = node;
+        m_tail = node;
+        if(!first){
+            first = node;
+        }
+        m_capacity += m_baseSize;
+    }
+    if(old_cap == 0){
+        m_cur = first;
+    }
+}
+
+std::string ByteArray::toString() const{
+    std::string str;
+    str.resize(getReadSize());
+    if(str.empty()){
+        return str;
+    }
+    read(&str[0], str.size(), m_position);
+    return str;
+}
+
+std::string ByteArray::toHexString() const{
+    std::string str = toString();
+    std::stringstream ss;
+    for(size_t i = 0; i < str.size(); ++i){
+        if(i > 0 && i % 32 == 0){
+            ss << std::endl;
+        }
+        ss << std::setw(2) << std::setfill('0') << std::hex << (int)(uint8_t)str[i] << " ";
+    }
+    return ss.str();
+}
+
+uint64_t ByteArray::getReadBuffers(std::vector<iovec>& buffers, uint64_t len) const{
+    return getReadBuffers(buffers, len, m_position);
+}
+
+uint64_t ByteArray::getReadBuffers(std::vector<iovec>& buffers, uint64_t len, uint64_t position) const{
+    if(position > m_size){
+        return 0;
+    }
+    len = std::min(len, (uint64_t)(m_size - position));
+    if(len == 0){
+        return 0;
+    }
+    Node* cur = m_root;
+    size_t skip = position / m_baseSize;
+    while(skip--){
+        cur = cur->next;
+    }
+    uint64_t size = len;
+    size_t npos = position % m_baseSize;
+    while(len > 0){
+        iovec iov;
+        iov.iov_base = cur->ptr + npos;
+        iov.iov_len = std::min((uint64_t)(cur->size - npos), len);
+        len -= iov.iov_len;
+        buffers.push_back(iov);
+        cur = cur->next;
+        npos = 0;
+    }
+    return size;
+}
+
+uint64_t ByteArray::getWriteBuffers(std::vector<iovec>& buffers, uint64_t len){
+    if(len == 0){
+        return 0;
+    }
+    addCapacity(len);
+    uint64_t size = len;
+    Node* cur = m_cur;
+    size_t npos = m_position % m_baseSize;
+    while(len > 0){
+        iovec iov;
+        iov.iov_base = cur->ptr + npos;
+        iov.iov_len = std::min((uint64_t)(cur->size - npos), len);
+        len -= iov.iov_len;
+        buffers.push_back(iov);
+        cur = cur->next;
+        npos = 0;
+    }
+    return size;
+}
+
+}
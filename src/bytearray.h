@@ -0,0 +1,167 @@
+/*
+    @file bytearray.h
+    @brief 二进制序列化缓冲区
+*/
+
+#ifndef __CAIZI_BYTEARRAY_H__
+#define __CAIZI_BYTEARRAY_H__
+
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <vector>
+
+namespace caizi{
+
+/*
+    由固定大小的块串成的链表，容量不够时在尾部追加块，已写入的数据不会搬移。
+    默认大小的块(bytearray.block_size)释放后放回线程局部的空闲链表，下次分配直接复用。
+    整数有两种编码：
+        定长(Fint/Fuint)    按设置的字节序写入，默认网络字节序(大端)
+        变长(Int/Uint)      varint，每字节7位，有符号数先做zigzag编码，8位整数只有定长
+    读越界时抛出std::out_of_range。
+    getReadBuffers/getWriteBuffers直接返回块内的内存，配合Socket的iovec收发不需要中间拷贝。
+*/
+class ByteArray{
+public:
+    typedef std::shared_ptr<ByteArray> ptr;
+
+    // @param base_size 块大小，0表示使用配置bytearray.block_size
+    ByteArray(size_t base_size = 0);
+    ~ByteArray();
+
+    ByteArray(const ByteArray&) = delete;
+    ByteArray& operator=(const ByteArray&) = delete;
+
+    // 定长整数
+    void writeFint8(int8_t value);
+    void writeFuint8(uint8_t value);
+    void writeFint16(int16_t value);
+    void writeFuint16(uint16_t value);
+    void writeFint32(int32_t value);
+    void writeFuint32(uint32_t value);
+    void writeFint64(int64_t value);
+    void writeFuint64(uint64_t value);
+
+    // 变长整数
+    void writeInt16(int16_t value);
+    void writeUint16(uint16_t value);
+    void writeInt32(int32_t value);
+    void writeUint32(uint32_t value);
+    void writeInt64(int64_t value);
+    void writeUint64(uint64_t value);
+
+    void writeFloat(float value);
+    void writeDouble(double value);
+
+    // 字符串，长度分别以uint16、uint32、uint64定长和uint64变长写在前面
+    void writeStringF16(const std::string& value);
+    void writeStringF32(const std::string& value);
+    void writeStringF64(const std::string& value);
+    void writeStringVint(const std::string& value);
+    void writeStringWithoutLength(const std::string& value);
+
+    int8_t   readFint8();
+    uint8_t  readFuint8();
+    int16_t  readFint16();
+    uint16_t readFuint16();
+    int32_t  readFint32();
+    uint32_t readFuint32();
+    int64_t  readFint64();
+    uint64_t readFuint64();
+
+    int16_t  readInt16();
+    uint16_t readUint16();
+    int32_t  readInt32();
+    uint32_t readUint32();
+    int64_t  readInt64();
+    uint64_t readUint64();
+
+    float    readFloat();
+    double   readDouble();
+
+    std::string readStringF16();
+    std::string readStringF32();
+    std::string readStringF64();
+    std::string readStringVint();
+
+    // 清空数据，只保留第一个块
+    void clear();
+
+    // 在当前位置写入/读出，位置随之前移
+    void write(const void* buf, size_t size);
+    void read(void* buf, size_t size);
+    // 从position处读出，不改变当前位置
+    void read(void* buf, size_t size, size_t position) const;
+
+    size_t getPosition() const{ return m_position; };
+    // 设置当前位置，超过已有数据时数据大小随之增加(例如recv到getWriteBuffers之后)
+    void setPosition(size_t v);
+
+    // 把可读的数据写入文件/从文件读入数据
+    bool writeToFile(const std::string& name) const;
+    bool readFromFile(const std::string& name);
+
+    size_t getBaseSize() const{ return m_baseSize; };
+    // 当前位置之后还可以读的字节数
+    size_t getReadSize() const{ return m_size - m_position; };
+    // 数据的总大小
+    size_t getSize() const{ return m_size; };
+
+    bool isLittleEndian() const;
+    void setIsLittleEndian(bool val);
+
+    // 可读的数据，不改变当前位置
+    std::string toString() const;
+    std::string toHexString() const;
+
+    /*
+        取得从当前位置(或position)开始最多len字节可读数据所在的内存，不改变当前位置
+        @return 实际的字节数
+    */
+    uint64_t getReadBuffers(std::vector<iovec>& buffers, uint64_t len = ~0ull) const;
+    uint64_t getReadBuffers(std::vector<iovec>& buffers, uint64_t len, uint64_t position) const;
+    // 保证当前位置之后有len字节的空间并取得它们所在的内存，写入后用setPosition前移
+    uint64_t getWriteBuffers(std::vector<iovec>& buffers, uint64_t len);
+
+private:
+    // 块的数据紧跟在Node之后，一次分配
+    struct Node{
+        char* ptr;
+        Node* next;
+        size_t size;
+    };
+
+    static Node* NewNode(size_t size);
+    static void DeleteNode(Node* node);
+
+    // 保证当前位置之后至少有size字节的容量
+    void addCapacity(size_t size);
+    size_t getCapacity() const{ return m_capacity - m_position; };
+    // 在当前块内前移n字节
+    void skipInNode(size_t n);
+
+    template<class T>
+    void writeFixed(T value);
+    template<class T>
+    T readFixed();
+    void writeVarint(uint64_t value);
+    uint64_t readVarint();
+    std::string readString(uint64_t len);
+
+private:
+    size_t m_baseSize;          // 块大小
+    size_t m_position;          // 当前位置
+    size_t m_capacity;          // 总容量
+    size_t m_size;              // 数据大小
+    int8_t m_endian;            // 定长整数的字节序
+    Node* m_root;
+    Node* m_tail;
+    Node* m_cur;                // 当前位置所在的块，位置恰好在容量末尾时为nullptr
+};
+
+}
+
+#endif
@@ -2,10 +2,22 @@
 #define __CAIZI_H__
 
 #include "address.h"
+#include "bytearray.h"
 #include "config.h"
+#include "fiber.h"
+#include "http.h"
+#include "http_parser.h"
+#include "http_server.h"
+#include "http_session.h"
+#include "http_writer.h"
+#include "iomanager.h"
 #include "log.h"
 #include "macro.h"
+#include "scheduler.h"
+#include "servlet.h"
+#include "simd_codec.h"
 #include "socket.h"
+#include "tcp_server.h"
 #include "thread.h"
 
 #endif
\ No newline at end of file
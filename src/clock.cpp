@@ -0,0 +1,109 @@
+#include "clock.h"
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <time.h>
+#include <unistd.h>
+#include "thread.h"
+#include "util.h"
+
+namespace caizi{
+
+namespace{
+
+// 每毫秒更新一次时间的后台线程
+class ClockThread{
+public:
+    ClockThread(){
+        m_start_ms = GetCurrentMS();
+        m_now_ms.store(m_start_ms, std::memory_order_relaxed);
+        m_thread.reset(new Thread(std::bind(&ClockThread::run, this), "clock"));
+        m_running.store(true, std::memory_order_release);
+    }
+
+    ~ClockThread(){
+        m_running.store(false, std::memory_order_release);
+        m_stopping.store(true, std::memory_order_release);
+        if(m_thread){
+            m_thread->join();
+        }
+    }
+
+    uint64_t now() const {
+        // 线程未运行(创建中或已停止)时直接读取系统时间
+        if(!m_running.load(std::memory_order_acquire)){
+            return GetCurrentMS();
+        }
+        return m_now_ms.load(std::memory_order_relaxed);
+    }
+    uint64_t start() const { return m_start_ms; }
+
+private:
+    void run(){
+        while(!m_stopping.load(std::memory_order_acquire)){
+            m_now_ms.store(GetCurrentMS(), std::memory_order_relaxed);
+            usleep(1000);
+        }
+    }
+
+    uint64_t m_start_ms = 0;
+    std::atomic<uint64_t> m_now_ms{0};
+    std::atomic<bool> m_running{false};
+    std::atomic<bool> m_stopping{false};
+    std::unique_ptr<Thread> m_thread;
+};
+
+// 创建后台线程的过程中可能再次读取时钟(例如线程创建失败时写日志)，此时直接读取系统时间
+static thread_local bool t_clock_initializing = false;
+
+ClockThread* GetClockThread(){
+    if(t_clock_initializing){
+        return nullptr;
+    }
+    t_clock_initializing = true;
+    static ClockThread s_clock;
+    t_clock_initializing = false;
+    return &s_clock;
+}
+
+// 进程启动时就创建时钟，保证StartMS()接近进程启动时间
+static ClockThread* s_clock_init = GetClockThread();
+
+}
+
+uint64_t CoarseClock::NowMS(){
+    ClockThread* clock = GetClockThread();
+    return clock ? clock->now() : GetCurrentMS();
+}
+
+uint64_t CoarseClock::StartMS(){
+    ClockThread* clock = GetClockThread();
+    return clock ? clock->start() : GetCurrentMS();
+}
+
+uint64_t CoarseClock::ElapseMS(){
+    ClockThread* clock = GetClockThread();
+    return clock ? clock->now() - clock->start() : 0;
+}
+
+size_t CoarseClock::FormatDateTime(uint64_t ms, char* out){
+    static thread_local int64_t t_cached_second = -1;
+    static thread_local char t_cached[20];
+
+    time_t second = ms / 1000;
+    if(second != t_cached_second){
+        struct tm tm;
+        localtime_r(&second, &tm);
+        strftime(t_cached, sizeof(t_cached), "%Y-%m-%d %H:%M:%S", &tm);
+        t_cached_second = second;
+    }
+    memcpy(out, t_cached, 19);
+    uint32_t milli = ms % 1000;
+    out[19] = '.';
+    out[20] = '0' + milli / 100;
+    out[21] = '0' + milli / 10 % 10;
+    out[22] = '0' + milli % 10;
+    return DATETIME_SIZE;
+}
+
+}
@@ -0,0 +1,35 @@
+/*
+    @file clock.h
+    @brief 粗粒度时钟：后台线程每毫秒更新一次当前时间，读取只是一次原子读
+*/
+
+#ifndef __CAIZI_CLOCK_H__
+#define __CAIZI_CLOCK_H__
+
+#include <cstddef>
+#include <cstdint>
+
+namespace caizi{
+
+class CoarseClock{
+public:
+    // "YYYY-mm-dd HH:MM:SS.mmm" 的长度
+    static const size_t DATETIME_SIZE = 23;
+
+    // 当前时间(自1970年起的毫秒数)，精度约1毫秒
+    static uint64_t NowMS();
+    // 进程启动时间(毫秒)
+    static uint64_t StartMS();
+    // 进程启动至今的毫秒数
+    static uint64_t ElapseMS();
+
+    /*
+        把毫秒时间戳格式化为本地时间 "YYYY-mm-dd HH:MM:SS.mmm"，写入out(至少DATETIME_SIZE字节)
+        每个线程缓存上一次格式化的秒，同一秒内只需改写毫秒部分，不调用localtime_r和strftime
+    */
+    static size_t FormatDateTime(uint64_t ms, char* out);
+};
+
+}
+
+#endif
@@ -1,11 +1,18 @@
 #ifndef __CAIZI_CONFIG_H__
 #define __CAIZI_CONFIG_H__
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <memory>
 #include <string>
 #include <boost/lexical_cast.hpp>
 #include <iostream>
+#include <list>
 #include <map>
+#include <set>
+#include <sstream>
+#include <vector>
 #include <yaml-cpp/yaml.h>
 
 #include "thread.h"
@@ -31,6 +38,7 @@ protected:
     std::string m_description;
 };
 
+// 类型转换，默认使用boost::lexical_cast，容器类型通过YAML字符串转换
 template <typename Source, typename Target>
 class LexicalCast{
 public:
@@ -39,24 +47,170 @@ public:
     }
 };
 
+// YAML字符串 -> std::vector<T>
+template<class T>
+class LexicalCast<std::string, std::vector<T>>{
+public:
+    std::vector<T> operator()(const std::string& source){
+        YAML::Node node = YAML::Load(source);
+        std::vector<T> vec;
+        std::stringstream ss;
+        for(size_t i = 0; i < node.size(); ++i){
+            ss.str("");
+            ss << node[i];
+            vec.push_back(LexicalCast<std::string, T>()(ss.str()));
+        }
+        return vec;
+    }
+};
+
+// std::vector<T> -> YAML字符串
+template<class T>
+class LexicalCast<std::vector<T>, std::string>{
+public:
+    std::string operator()(const std::vector<T>& source){
+        YAML::Node node(YAML::NodeType::Sequence);
+        for(auto& i : source){
+            node.push_back(YAML::Load(LexicalCast<T, std::string>()(i)));
+        }
+        std::stringstream ss;
+        ss << node;
+        return ss.str();
+    }
+};
+
+// YAML字符串 -> std::list<T>
+template<class T>
+class LexicalCast<std::string, std::list<T>>{
+public:
+    std::list<T> operator()(const std::string& source){
+        YAML::Node node = YAML::Load(source);
+        std::list<T> list;
+        std::stringstream ss;
+        for(size_t i = 0; i < node.size(); ++i){
+            ss.str("");
+            ss << node[i];
+            list.push_back(LexicalCast<std::string, T>()(ss.str()));
+        }
+        return list;
+    }
+};
+
+// std::list<T> -> YAML字符串
+template<class T>
+class LexicalCast<std::list<T>, std::string>{
+public:
+    std::string operator()(const std::list<T>& source){
+        YAML::Node node(YAML::NodeType::Sequence);
+        for(auto& i : source){
+            node.push_back(YAML::Load(LexicalCast<T, std::string>()(i)));
+        }
+        std::stringstream ss;
+        ss << node;
+        return ss.str();
+    }
+};
+
+// YAML字符串 -> std::set<T>
+template<class T>
+class LexicalCast<std::string, std::set<T>>{
+public:
+    std::set<T> operator()(const std::string& source){
+        YAML::Node node = YAML::Load(source);
+        std::set<T> set;
+        std::stringstream ss;
+        for(size_t i = 0; i < node.size(); ++i){
+            ss.str("");
+            ss << node[i];
+            set.insert(LexicalCast<std::string, T>()(ss.str()));
+        }
+        return set;
+    }
+};
+
+// std::set<T> -> YAML字符串
+template<class T>
+class LexicalCast<std::set<T>, std::string>{
+public:
+    std::string operator()(const std::set<T>& source){
+        YAML::Node node(YAML::NodeType::Sequence);
+        for(auto& i : source){
+            node.push_back(YAML::Load(LexicalCast<T, std::string>()(i)));
+        }
+        std::stringstream ss;
+        ss << node;
+        return ss.str();
+    }
+};
+
+// YAML字符串 -> std::map<std::string, T>
+template<class T>
+class LexicalCast<std::string, std::map<std::string, T>>{
+public:
+    std::map<std::string, T> operator()(const std::string& source){
+        YAML::Node node = YAML::Load(source);
+        std::map<std::string, T> map;
+        std::stringstream ss;
+        for(auto it = node.begin(); it != node.end(); ++it){
+            ss.str("");
+            ss << it->second;
+            map.insert(std::make_pair(it->first.Scalar(), LexicalCast<std::string, T>()(ss.str())));
+        }
+        return map;
+    }
+};
+
+// std::map<std::string, T> -> YAML字符串
+template<class T>
+class LexicalCast<std::map<std::string, T>, std::string>{
+public:
+    std::string operator()(const std::map<std::string, T>& source){
+        YAML::Node node(YAML::NodeType::Map);
+        for(auto& i : source){
+            node[i.first] = YAML::Load(LexicalCast<T, std::string>()(i.second));
+        }
+        std::stringstream ss;
+        ss << node;
+        return ss.str();
+    }
+};
+
 /*  
     通用型配置项类模板，继承自 ConfigVarBase，用于管理各种类型的配置项。
     包含了配置项的具体值和相关操作方法，如获取值、设置值、转换为字符串等。
+    FromStr/ToStr 负责与YAML字符串互相转换，自定义类型可以特化LexicalCast。
+    值变化时依次通知监听器，监听器在setValue的调用线程上执行。
 */
 template<
-    class T
-    // class FromStringFN = LexicalCast<std::string, T>>
+    class T,
+    class FromStr = LexicalCast<std::string, T>,
+    class ToStr = LexicalCast<T, std::string>
 >
 class ConfigVar : public ConfigVarBase{
 public:
     typedef std::shared_ptr<ConfigVar> ptr;
+    // 配置变化的回调，参数为旧值和新值
+    typedef std::function<void(const T& old_value, const T& new_value)> OnChangeCallback;
 
     ConfigVar(const std::string &name, const T &value, const std::string &descriptopm):
         ConfigVarBase(name, descriptopm), m_value(value){};
 
+    // 值有变化时更新并通知监听器
     void setValue(const T value){
-        WriteScopeLock lock(&m_mutex);
-        m_value = value;
+        std::map<uint64_t, OnChangeCallback> listeners;
+        T old_value;
+        {
+            WriteScopeLock lock(&m_mutex);
+            if(value == m_value){
+                return;
+            }
+            old_value = m_value;
+            m_value = value;
+            listeners = m_listeners;
+        }
+        for(auto& i : listeners){
+            i.second(old_value, value);
+        }
     }
     T getValue() const{ 
         ReadScopeLock lock(&m_mutex);
@@ -65,7 +219,7 @@ public:
 
     std::string toString() const override{
         try{
-            return boost::lexical_cast<std::string>(m_value);
+            return ToStr()(getValue());
         }catch(std::exception &e){
             std::cerr << "ConfogVal::toString exception " 
                 << e.what()
@@ -78,7 +232,8 @@ public:
 
     bool fromString(const std::string &val) override{
         try{
-            m_value = boost::lexical_cast<T>(val);
+            setValue(FromStr()(val));
+            return true;
         }catch(std::exception &e){
                 std::cerr << "ConfogVal::fromString exception " 
                 << e.what()
@@ -89,8 +244,26 @@ public:
         return false;
     }
 
+    // 添加监听器，返回用于删除的id
+    uint64_t addListener(OnChangeCallback cb){
+        static std::atomic<uint64_t> s_listener_id{0};
+        uint64_t id = ++s_listener_id;
+        WriteScopeLock lock(&m_mutex);
+        m_listeners[id] = cb;
+        return id;
+    }
+    void delListener(uint64_t id){
+        WriteScopeLock lock(&m_mutex);
+        m_listeners.erase(id);
+    }
+    void clearListener(){
+        WriteScopeLock lock(&m_mutex);
+        m_listeners.clear();
+    }
+
 private:
     T m_value;
+    std::map<uint64_t, OnChangeCallback> m_listeners;
     mutable RWLock m_mutex;
 };
 
@@ -7,6 +7,7 @@
 
 #include <cstdint>    // 用于 uint16_t 类型的定义
 #include <byteswap.h> // 用于 bswap_16 函数的定义
+#include <endian.h>   // BYTE_ORDER
 #include <type_traits>
 /*
     字节序处理
@@ -43,29 +44,29 @@ byteswap(T value){
 
 #if CAIZI_BYTE_ORDER == CAIZI_BIG_ENDIAN
 
-// 转小端字节序
+// 只在小端机器上转换字节序(主机序和网络序互转)
 template <class T>
 T byteswapOnLitterEndian(T value){
-    return byteswap(value);
+    return value;
 }
 
-// 转大端字节序
+// 只在大端机器上转换字节序
 template <class T>
 T byteswapOnBigEndian(T value){
-    return value;
+    return byteswap(value);
 };
 #else
 
-// 转小端字节序
+// 只在小端机器上转换字节序(主机序和网络序互转)
 template <class T>
 T byteswapOnLitterEndian(T value){
-    return value;
+    return byteswap(value);
 }
 
-// 转大端字节序
+// 只在大端机器上转换字节序
 template <class T>
 T byteswapOnBigEndian(T value){
-    return byteswap(value);
+    return value;
 }
 
 #endif
@@ -0,0 +1,106 @@
+#include "fd_manager.h"
+#include "hook.h"
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+namespace caizi{
+
+bool FdCtx::init(int fd){
+    ScopeLock lock(&m_mutex);
+    if(isInit()){
+        return true;
+    }
+    struct stat st;
+    if(fstat(fd, &st) == -1){
+        return false;
+    }
+    bool is_socket = S_ISSOCK(st.st_mode);
+    bool user_nonblock = false;
+    bool sys_nonblock = false;
+    if(is_socket){
+        // fcntl被hook，这里直接用原函数
+        int flags = fcntl_f(fd, F_GETFL, 0);
+        if(flags != -1 && (flags & O_NONBLOCK)){
+            user_nonblock = true;
+        }else if(flags != -1){
+            fcntl_f(fd, F_SETFL, flags | O_NONBLOCK);
+        }
+        sys_nonblock = flags != -1;
+    }
+    m_isSocket.store(is_socket, std::memory_order_relaxed);
+    m_userNonblock.store(user_nonblock, std::memory_order_relaxed);
+    m_sysNonblock.store(sys_nonblock, std::memory_order_relaxed);
+    m_recvTimeout.store(~0ull, std::memory_order_relaxed);
+    m_sendTimeout.store(~0ull, std::memory_order_relaxed);
+    m_isInit.store(true, std::memory_order_release);
+    return true;
+}
+
+void FdCtx::reset(){
+    ScopeLock lock(&m_mutex);
+    m_isInit.store(false, std::memory_order_release);
+    m_isSocket.store(false, std::memory_order_relaxed);
+    m_userNonblock.store(false, std::memory_order_relaxed);
+    m_sysNonblock.store(false, std::memory_order_relaxed);
+    m_recvTimeout.store(~0ull, std::memory_order_relaxed);
+    m_sendTimeout.store(~0ull, std::memory_order_relaxed);
+}
+
+void FdCtx::setTimeout(int type, uint64_t v){
+    if(type == SO_RCVTIMEO){
+        m_recvTimeout.store(v, std::memory_order_relaxed);
+    }else{
+        m_sendTimeout.store(v, std::memory_order_relaxed);
+    }
+}
+
+uint64_t FdCtx::getTimeout(int type) const{
+    if(type == SO_RCVTIMEO){
+        return m_recvTimeout.load(std::memory_order_relaxed);
+    }
+    return m_sendTimeout.load(std::memory_order_relaxed);
+}
+
+FdManager::FdManager(){
+    for(auto& chunk : m_chunks){
+        chunk.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+FdCtx* FdManager::get(int fd, bool auto_create){
+    if(fd < 0 || (size_t)fd >= FD_CHUNK_SIZE * FD_MAX_CHUNKS){
+        return nullptr;
+    }
+    std::atomic<FdCtx*>& slot = m_chunks[fd >> FD_CHUNK_BITS];
+    FdCtx* chunk = slot.load(std::memory_order_acquire);
+    if(!chunk){
+        if(!auto_create){
+            return nullptr;
+        }
+        FdCtx* fresh = new FdCtx[FD_CHUNK_SIZE];
+        // 多个线程同时分配同一块时只保留一个
+        if(slot.compare_exchange_strong(chunk, fresh, std::memory_order_acq_rel)){
+            chunk = fresh;
+        }else{
+            delete[] fresh;
+        }
+    }
+    FdCtx* ctx = &chunk[fd & (FD_CHUNK_SIZE - 1)];
+    if(ctx->isInit()){
+        return ctx;
+    }
+    if(!auto_create || !ctx->init(fd)){
+        return nullptr;
+    }
+    return ctx;
+}
+
+void FdManager::del(int fd){
+    FdCtx* ctx = get(fd);
+    if(ctx){
+        ctx->reset();
+    }
+}
+
+}
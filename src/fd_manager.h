@@ -0,0 +1,81 @@
+/*
+    @file fd_manager.h
+    @brief 文件描述符状态表，hook据此决定一个fd上的阻塞调用是否转为协程等待
+*/
+
+#ifndef __CAIZI_FD_MANAGER_H__
+#define __CAIZI_FD_MANAGER_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "noncopyable.h"
+#include "singleton.h"
+#include "thread.h"
+
+namespace caizi{
+
+/*
+    一个fd的状态。
+    开启hook的线程创建的套接字由框架设为非阻塞(sysNonblock)，用户自己设置的非阻塞(userNonblock)单独记录：
+    用户没有设置非阻塞时，hook把读写转为在协程中等待就绪，对用户仍然表现为阻塞调用。
+    超时时间来自setsockopt的SO_RCVTIMEO/SO_SNDTIMEO(Socket::setRecvTimeout/setSendTimeout)。
+*/
+class FdCtx : public Noncopyable{
+public:
+    // 读取fd的类型，套接字设为非阻塞，创建时已经是非阻塞的视为用户设置
+    bool init(int fd);
+    // fd关闭后清除状态
+    void reset();
+
+    bool isInit() const{ return m_isInit.load(std::memory_order_acquire); };
+    bool isSocket() const{ return m_isSocket.load(std::memory_order_relaxed); };
+
+    void setUserNonblock(bool v){ m_userNonblock.store(v, std::memory_order_relaxed); };
+    bool getUserNonblock() const{ return m_userNonblock.load(std::memory_order_relaxed); };
+    void setSysNonblock(bool v){ m_sysNonblock.store(v, std::memory_order_relaxed); };
+    bool getSysNonblock() const{ return m_sysNonblock.load(std::memory_order_relaxed); };
+
+    // type为SO_RCVTIMEO或SO_SNDTIMEO，单位毫秒，~0ull表示没有超时
+    void setTimeout(int type, uint64_t v);
+    uint64_t getTimeout(int type) const;
+
+private:
+    Mutex m_mutex;                                  // 串行化init和reset
+    std::atomic<bool> m_isInit{false};
+    std::atomic<bool> m_isSocket{false};
+    std::atomic<bool> m_sysNonblock{false};
+    std::atomic<bool> m_userNonblock{false};
+    std::atomic<uint64_t> m_recvTimeout{~0ull};
+    std::atomic<uint64_t> m_sendTimeout{~0ull};
+};
+
+/*
+    按fd直接索引的状态表，和IOManager的fd上下文表一样分块按需分配，查找不加锁。
+    FdCtx对象不会释放，fd关闭时只清除状态，同一个fd号复用时重新初始化；
+    进程退出时其他静态对象析构仍可能关闭fd，所以块也不在析构时释放。
+*/
+class FdManager : public Noncopyable{
+public:
+    FdManager();
+
+    // 取得fd的状态，没有初始化时auto_create为true则初始化，否则返回nullptr
+    FdCtx* get(int fd, bool auto_create = false);
+    // fd关闭时调用
+    void del(int fd);
+
+private:
+    static const size_t FD_CHUNK_BITS = 10;
+    static const size_t FD_CHUNK_SIZE = 1 << FD_CHUNK_BITS;
+    static const size_t FD_MAX_CHUNKS = 1024;
+
+    std::atomic<FdCtx*> m_chunks[FD_MAX_CHUNKS];
+};
+
+typedef Singleton<FdManager> FdMgr;
+
+}
+
+#endif
@@ -0,0 +1,337 @@
+#include "fiber.h"
+#include "config.h"
+#include "log.h"
+#include "macro.h"
+#include "scheduler.h"
+#include <atomic>
+#include <map>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+namespace caizi{
+
+static Logger::ptr g_logger = CAIZI_GET_LOGGER("system");
+
+static std::atomic<uint64_t> s_fiber_id{0};
+static std::atomic<uint64_t> s_fiber_count{0};
+
+// 当前线程正在运行的协程
+static thread_local Fiber* t_fiber = nullptr;
+// 线程主协程
+static thread_local Fiber::ptr t_threadFiber = nullptr;
+// 刚执行完的协程，由切换回来的一方在切换完成后释放，协程不会在自己的栈上被销毁
+static thread_local Fiber::ptr t_exitingFiber = nullptr;
+
+static ConfigVar<uint32_t>::ptr g_fiber_stack_size =
+    Config::Lookup<uint32_t>("fiber.stack_size", 128 * 1024, "fiber stack size");
+static ConfigVar<uint32_t>::ptr g_fiber_pool_size =
+    Config::Lookup<uint32_t>("fiber.pool_size", 256, "idle fibers kept per thread");
+static ConfigVar<uint32_t>::ptr g_stack_pool_size =
+    Config::Lookup<uint32_t>("fiber.stack_pool_size", 1024, "idle fiber stacks kept per process");
+
+// 配置值缓存在原子变量里，Create/Recycle的热路径上不需要读配置的锁
+static std::atomic<uint32_t> s_stack_size{g_fiber_stack_size->getValue()};
+static std::atomic<uint32_t> s_pool_size{g_fiber_pool_size->getValue()};
+
+struct FiberConfigIniter{
+    FiberConfigIniter(){
+        g_fiber_stack_size->addListener([](const uint32_t& old_value, const uint32_t& new_value){
+            s_stack_size.store(new_value, std::memory_order_relaxed);
+        });
+        g_fiber_pool_size->addListener([](const uint32_t& old_value, const uint32_t& new_value){
+            s_pool_size.store(new_value, std::memory_order_relaxed);
+        });
+    }
+};
+static FiberConfigIniter __fiber_config_init;
+
+/*
+    协程栈池
+    栈用mmap分配，最低一页设为不可访问作为保护页，栈向下增长，溢出时访问保护页触发SIGSEGV。
+    释放的栈按大小放回空闲链表，复用时不需要mmap/mprotect/munmap三次系统调用。
+*/
+class FiberStackPool{
+public:
+    static FiberStackPool& Instance(){
+        static FiberStackPool* s_pool = new FiberStackPool;
+        return *s_pool;
+    }
+
+    void* allocate(size_t size){
+        {
+            ScopeLock lock(&m_mutex);
+            auto& list = m_free[size];
+            if(!list.empty()){
+                void* stack = list.back();
+                list.pop_back();
+                --m_free_count;
+                return stack;
+            }
+        }
+        size_t page = pageSize();
+        void* base = mmap(nullptr, size + page, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+        if(base == MAP_FAILED){
+            LOG_FMT_ERROR(g_logger, "FiberStackPool mmap失败 size=%zu errno=%d", size, errno);
+            throw std::bad_alloc();
+        }
+        if(mprotect(base, page, PROT_NONE)){
+            LOG_FMT_ERROR(g_logger, "FiberStackPool 设置保护页失败 errno=%d", errno);
+        }
+        return (char*)base + page;
+    }
+
+    void deallocate(void* stack, size_t size){
+        {
+            ScopeLock lock(&m_mutex);
+            if(m_free_count < g_stack_pool_size->getValue()){
+                m_free[size].push_back(stack);
+                ++m_free_count;
+                return;
+            }
+        }
+        size_t page = pageSize();
+        munmap((char*)stack - page, size + page);
+    }
+
+private:
+    static size_t pageSize(){
+        static size_t s_page = sysconf(_SC_PAGESIZE);
+        return s_page;
+    }
+
+    Mutex m_mutex;
+    std::map<size_t, std::vector<void*>> m_free;
+    size_t m_free_count = 0;
+};
+
+// 线程局部的空闲协程链表，线程退出时释放
+struct FiberFreeList{
+    std::vector<Fiber*> fibers;
+    bool destroyed = false;
+    ~FiberFreeList(){
+        destroyed = true;
+        for(auto fiber : fibers){
+            delete fiber;
+        }
+    }
+};
+static thread_local FiberFreeList t_free_fibers;
+
+// 栈大小按页对齐
+static size_t StackSize(size_t stacksize){
+    if(!stacksize){
+        stacksize = s_stack_size.load(std::memory_order_relaxed);
+    }
+    static size_t page = sysconf(_SC_PAGESIZE);
+    return (stacksize + page - 1) / page * page;
+}
+
+Fiber::Fiber(){
+    m_state = EXEC;
+    SetThis(this);
+    ++s_fiber_count;
+}
+
+Fiber::Fiber(std::function<void()> callback, size_t stacksize, bool use_caller):
+    m_id(++s_fiber_id), m_use_caller(use_caller), m_callback(callback){
+    ++s_fiber_count;
+    m_stacksize = StackSize(stacksize);
+    m_stack = FiberStackPool::Instance().allocate(m_stacksize);
+    m_context.make(m_stack, m_stacksize, use_caller ? &Fiber::CallMainFunction : &Fiber::MainFunction);
+}
+
+Fiber::~Fiber(){
+    --s_fiber_count;
+    if(m_stack){
+        CAIZI_ASSERT(m_state != EXEC);
+        if(m_state == HOLD || m_state == READY){
+            // 没有执行完就被销毁：栈上的对象不会析构，可能仍被等待的事件或请求引用，栈不归还栈池
+            LOG_FMT_ERROR(g_logger, "Fiber::~Fiber fiber_id=%llu state=%d 未执行完，协程栈泄漏\n",
+                          (unsigned long long)m_id, (int)m_state);
+        }else{
+            FiberStackPool::Instance().deallocate(m_stack, m_stacksize);
+        }
+    }else{
+        // 线程主协程没有自己的栈
+        CAIZI_ASSERT(!m_callback);
+        CAIZI_ASSERT(m_state == EXEC);
+        if(t_fiber == this){
+            SetThis(nullptr);
+        }
+    }
+}
+
+Fiber::ptr Fiber::Create(std::function<void()> callback, size_t stacksize, bool use_caller){
+    size_t size = StackSize(stacksize);
+    auto& list = t_free_fibers.fibers;
+    if(!t_free_fibers.destroyed && !list.empty()){
+        Fiber* fiber = list.back();
+        if(fiber->m_stacksize == size){
+            list.pop_back();
+            fiber->m_id = ++s_fiber_id;
+            fiber->m_use_caller = use_caller;
+            fiber->reset(std::move(callback));
+            return Fiber::ptr(fiber, &Fiber::Recycle);
+        }
+    }
+    return Fiber::ptr(new Fiber(std::move(callback), size, use_caller), &Fiber::Recycle);
+}
+
+void Fiber::Recycle(Fiber* fiber){
+    auto& list = t_free_fibers.fibers;
+    if(!t_free_fibers.destroyed && fiber->m_state != HOLD && fiber->m_state != EXEC
+            && fiber->m_state != READY && list.size() < s_pool_size.load(std::memory_order_relaxed)){
+        // 放回空闲链表前释放回调持有的资源
+        fiber->m_callback = nullptr;
+        fiber->m_state = TERM;
+        list.push_back(fiber);
+        return;
+    }
+    delete fiber;
+}
+
+// 重置协程函数，并重置状态
+void Fiber::reset(std::function<void()> callback){
+    CAIZI_ASSERT(m_stack);
+    CAIZI_ASSERT(m_state == TERM || m_state == EXCEPT || m_state == INIT);
+    m_callback = std::move(callback);
+    m_context.make(m_stack, m_stacksize, m_use_caller ? &Fiber::CallMainFunction : &Fiber::MainFunction);
+    m_state = INIT;
+    m_pinned_thread = -1;
+}
+
+static inline void CpuRelax(){
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// 调度协程，没有调度器时为线程主协程
+static inline Fiber* MainFiber(){
+    Fiber* fiber = Scheduler::GetMainFiber();
+    return fiber ? fiber : t_threadFiber.get();
+}
+
+void Fiber::swapIn(){
+    GetThis();
+    // 协程让出后可能立即被其他线程调度，等让出它的线程保存完上下文再切入
+    while(m_switching.exchange(true, std::memory_order_acquire)){
+        CpuRelax();
+    }
+    SetThis(this);
+    CAIZI_ASSERT(m_state != EXEC);
+    m_state = EXEC;
+    FiberContext::Swap(&MainFiber()->m_context, &m_context);
+    m_switching.store(false, std::memory_order_release);
+    t_exitingFiber.reset();
+}
+
+void Fiber::swapOut(){
+    Fiber* main_fiber = MainFiber();
+    SetThis(main_fiber);
+    FiberContext::Swap(&m_context, &main_fiber->m_context);
+}
+
+void Fiber::call(){
+    GetThis();
+    SetThis(this);
+    m_state = EXEC;
+    FiberContext::Swap(&t_threadFiber->m_context, &m_context);
+    t_exitingFiber.reset();
+}
+
+void Fiber::back(){
+    SetThis(t_threadFiber.get());
+    FiberContext::Swap(&m_context, &t_threadFiber->m_context);
+}
+
+void Fiber::SetThis(Fiber* fiber){
+    t_fiber = fiber;
+}
+
+Fiber::ptr Fiber::GetThis(){
+    if(t_fiber){
+        return t_fiber->shared_from_this();
+    }
+    Fiber::ptr main_fiber(new Fiber);
+    CAIZI_ASSERT(t_fiber == main_fiber.get());
+    t_threadFiber = main_fiber;
+    return t_fiber->shared_from_this();
+}
+
+void Fiber::YieldToReady(){
+    Fiber::ptr cur = GetThis();
+    CAIZI_ASSERT(cur->m_state == EXEC);
+    cur->m_state = READY;
+    cur->swapOut();
+}
+
+void Fiber::YieldToHole(){
+    Fiber::ptr cur = GetThis();
+    CAIZI_ASSERT(cur->m_state == EXEC);
+    cur->m_state = HOLD;
+    cur->swapOut();
+}
+
+uint64_t Fiber::GetTotalFiberCount(){
+    return s_fiber_count;
+}
+
+uint64_t Fiber::GetFiberID(){
+    return t_fiber ? t_fiber->getId() : 0;
+}
+
+/*
+    协程函数执行完后切换回去。这一帧不会再恢复，局部的shared_ptr永远不会析构，
+    因此把引用交给t_exitingFiber，由swapIn/call在切换回来之后释放；
+    切换期间协程对象一直有引用，即使调用方没有持有它也不会在自己的栈上被销毁
+*/
+void Fiber::MainFunction(){
+    Fiber::ptr cur = GetThis();
+    CAIZI_ASSERT(cur);
+    try{
+        cur->m_callback();
+        cur->m_callback = nullptr;
+        cur->m_state = TERM;
+    }catch(std::exception& e){
+        cur->m_state = EXCEPT;
+        LOG_ERROR(g_logger, std::string("Fiber exception: ") + e.what() + " fiber_id="
+                  + std::to_string(cur->getId()) + "\n" + BacktraceToString(10));
+    }catch(...){
+        cur->m_state = EXCEPT;
+        LOG_ERROR(g_logger, "Fiber exception fiber_id=" + std::to_string(cur->getId())
+                  + "\n" + BacktraceToString(10));
+    }
+    Fiber* raw = cur.get();
+    t_exitingFiber = std::move(cur);
+    raw->swapOut();
+    CAIZI_ASSERT2(false, "never reach fiber_id=" + std::to_string(raw->getId()));
+}
+
+void Fiber::CallMainFunction(){
+    Fiber::ptr cur = GetThis();
+    CAIZI_ASSERT(cur);
+    try{
+        cur->m_callback();
+        cur->m_callback = nullptr;
+        cur->m_state = TERM;
+    }catch(std::exception& e){
+        cur->m_state = EXCEPT;
+        LOG_ERROR(g_logger, std::string("Fiber exception: ") + e.what() + " fiber_id="
+                  + std::to_string(cur->getId()) + "\n" + BacktraceToString(10));
+    }catch(...){
+        cur->m_state = EXCEPT;
+        LOG_ERROR(g_logger, "Fiber exception fiber_id=" + std::to_string(cur->getId())
+                  + "\n" + BacktraceToString(10));
+    }
+    Fiber* raw = cur.get();
+    t_exitingFiber = std::move(cur);
+    raw->back();
+    CAIZI_ASSERT2(false, "never reach fiber_id=" + std::to_string(raw->getId()));
+}
+
+}
@@ -1,12 +1,26 @@
 #ifndef __CAIZI__FIBER_H__
 #define __CAIZI__FIBER_H__
 
+#include <atomic>
 #include <memory>
 #include <functional>
-#include <ucontext.h>
+#include "fiber_context.h"
 
 namespace caizi{
 
+/*
+    协程
+    每个线程第一次使用协程时创建主协程(线程本身的上下文)，子协程与主协程之间切换：
+        swapIn/swapOut  子协程与调度协程之间切换
+        call/back       子协程与线程主协程之间切换(use_caller的调度协程使用)
+    上下文切换默认使用汇编实现(fiber_context.h)，不支持的平台或定义CAIZI_FIBER_UCONTEXT时使用ucontext。
+    协程栈从全局的栈池中分配，栈底有一页保护页，栈溢出时触发SIGSEGV而不是破坏相邻内存。
+    用Fiber::Create创建的协程结束后回到线程局部的空闲链表，下次Create时只需reset，
+    不需要再分配栈和协程对象。
+    生命周期：协程运行后入口函数持有自身的引用，挂起(HOLD/READY)的协程即使外部不再引用
+    也不会被释放，必须恢复执行完才会释放；执行完后由切换回来的一方释放最后的引用。
+    未执行完的协程被直接delete时栈上的对象不会析构，为避免悬空引用，栈不再复用(泄漏)并记录错误日志。
+*/
 class Fiber: public std::enable_shared_from_this<Fiber> {
 public:
     typedef std::shared_ptr<Fiber> ptr;
@@ -20,41 +34,69 @@ public:
         EXCEPT
     };
 
+    // @param stacksize 栈大小，0表示使用配置项fiber.stack_size
     Fiber(std::function<void()> callback,  size_t stacksize = 0, bool use_caller = false);
     ~Fiber();
 
+    // 从空闲链表取出一个已结束的协程并重置，没有空闲协程时新建
+    static Fiber::ptr Create(std::function<void()> callback, size_t stacksize = 0, bool use_caller = false);
+
+    // 复用已结束(INIT/TERM/EXCEPT)的协程和它的栈
     void reset(std::function<void()> callback);
+    // 切换到当前协程执行
     void swapIn();
+    // 切换回调度协程
     void swapOut();
+    // 从线程主协程切换到当前协程执行
     void call();
+    // 切换回线程主协程
     void back();
-    
+
     uint64_t getId() const{ return m_id; };
     State getcurrentState() const{ return m_state; };
+    void setState(State state){ m_state = state; };
+    size_t getStackSize() const{ return m_stacksize; };
+    // 固定执行的线程id，-1表示任意线程，由调度器在调度时设置，reset后恢复为-1
+    int getPinnedThread() const{ return m_pinned_thread; };
+    void setPinnedThread(int thread){ m_pinned_thread = thread; };
 
+    // 设置当前线程正在运行的协程
     static void SetThis(Fiber* fiber);
+    // 返回当前线程正在运行的协程，第一次调用时创建线程主协程
     static Fiber::ptr GetThis();
+    // 切换到后台，并设置为READY状态
     static void YieldToReady();
+    // 切换到后台，并设置为HOLD状态
     static void YieldToHole();
+    // 存活的协程数量
     static uint64_t GetTotalFiberCount();
 
+    // 协程入口，执行完返回调度协程
     static void MainFunction();
+    // 协程入口，执行完返回线程主协程
     static void CallMainFunction();
 
+    // 当前协程的id，不在协程中返回0
     static uint64_t GetFiberID();
 
 private:
+    // 线程主协程
     Fiber();
+    // Create返回的shared_ptr的删除器，把结束的协程放回空闲链表
+    static void Recycle(Fiber* fiber);
 
 private:
     uint64_t m_id = 0;                  // 协程id
     uint32_t m_stacksize = 0;           // 协程运行栈大小
     State m_state = INIT;               // 协程运行状态
-    ucontext_t m_context;               // 协程上下文
+    bool m_use_caller = false;          // 结束后是否返回线程主协程
+    int m_pinned_thread = -1;           // 固定执行的线程id
+    std::atomic<bool> m_switching{false};   // 正在某个线程上执行，上下文还没有保存
+    FiberContext m_context;             // 协程上下文
     void* m_stack = nullptr;            // 协程运行栈指针
     std::function<void()> m_callback;   // 协程运行函数
 };
 
 }
 
-#endif
\ No newline at end of file
+#endif
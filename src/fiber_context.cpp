@@ -0,0 +1,148 @@
+#include "fiber_context.h"
+#include "macro.h"
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__)
+/*
+    栈布局(从低地址到高地址)，与caizi_swap_context的压栈顺序对应：
+        mxcsr(4字节) x87控制字(4字节) r12 r13 r14 r15 rbx rbp 返回地址
+    新上下文的返回地址是caizi_context_entry，r12中保存入口函数
+*/
+__asm__(
+    ".text\n"
+    ".globl caizi_swap_context\n"
+    ".type caizi_swap_context,@function\n"
+    ".align 16\n"
+    "caizi_swap_context:\n"
+    "    pushq %rbp\n"
+    "    pushq %rbx\n"
+    "    pushq %r15\n"
+    "    pushq %r14\n"
+    "    pushq %r13\n"
+    "    pushq %r12\n"
+    "    subq $8, %rsp\n"
+    "    stmxcsr (%rsp)\n"
+    "    fnstcw 4(%rsp)\n"
+    "    movq %rsp, (%rdi)\n"
+    "    movq %rsi, %rsp\n"
+    "    ldmxcsr (%rsp)\n"
+    "    fldcw 4(%rsp)\n"
+    "    addq $8, %rsp\n"
+    "    popq %r12\n"
+    "    popq %r13\n"
+    "    popq %r14\n"
+    "    popq %r15\n"
+    "    popq %rbx\n"
+    "    popq %rbp\n"
+    "    ret\n"
+    ".size caizi_swap_context,.-caizi_swap_context\n"
+
+    ".globl caizi_context_entry\n"
+    ".type caizi_context_entry,@function\n"
+    ".align 16\n"
+    "caizi_context_entry:\n"
+    "    callq *%r12\n"
+    "    ud2\n"
+    ".size caizi_context_entry,.-caizi_context_entry\n"
+);
+#elif defined(__aarch64__)
+/*
+    栈布局(从低地址到高地址)，共0xb0字节：
+        d8-d15 x19-x28 x29 x30(lr)
+    新上下文的lr是caizi_context_entry，x19中保存入口函数
+*/
+__asm__(
+    ".text\n"
+    ".globl caizi_swap_context\n"
+    ".type caizi_swap_context,%function\n"
+    ".align 4\n"
+    "caizi_swap_context:\n"
+    "    sub sp, sp, #0xb0\n"
+    "    stp d8, d9, [sp, #0x00]\n"
+    "    stp d10, d11, [sp, #0x10]\n"
+    "    stp d12, d13, [sp, #0x20]\n"
+    "    stp d14, d15, [sp, #0x30]\n"
+    "    stp x19, x20, [sp, #0x40]\n"
+    "    stp x21, x22, [sp, #0x50]\n"
+    "    stp x23, x24, [sp, #0x60]\n"
+    "    stp x25, x26, [sp, #0x70]\n"
+    "    stp x27, x28, [sp, #0x80]\n"
+    "    stp x29, x30, [sp, #0x90]\n"
+    "    mov x9, sp\n"
+    "    str x9, [x0]\n"
+    "    mov sp, x1\n"
+    "    ldp d8, d9, [sp, #0x00]\n"
+    "    ldp d10, d11, [sp, #0x10]\n"
+    "    ldp d12, d13, [sp, #0x20]\n"
+    "    ldp d14, d15, [sp, #0x30]\n"
+    "    ldp x19, x20, [sp, #0x40]\n"
+    "    ldp x21, x22, [sp, #0x50]\n"
+    "    ldp x23, x24, [sp, #0x60]\n"
+    "    ldp x25, x26, [sp, #0x70]\n"
+    "    ldp x27, x28, [sp, #0x80]\n"
+    "    ldp x29, x30, [sp, #0x90]\n"
+    "    add sp, sp, #0xb0\n"
+    "    ret\n"
+    ".size caizi_swap_context,.-caizi_swap_context\n"
+
+    ".globl caizi_context_entry\n"
+    ".type caizi_context_entry,%function\n"
+    ".align 4\n"
+    "caizi_context_entry:\n"
+    "    blr x19\n"
+    "    brk #0\n"
+    ".size caizi_context_entry,.-caizi_context_entry\n"
+);
+#endif
+
+#ifdef CAIZI_HAS_ASM_CONTEXT
+extern "C" void caizi_context_entry();
+#endif
+
+namespace caizi{
+
+#ifdef CAIZI_HAS_ASM_CONTEXT
+void AsmContext::make(void* stack, size_t size, void (*entry)()){
+    uintptr_t top = ((uintptr_t)stack + size) & ~(uintptr_t)15;
+#if defined(__x86_64__)
+    // 返回地址所在位置模16余8，ret之后rsp按16字节对齐，正好满足call之前的对齐要求
+    uint64_t* sp = (uint64_t*)(top - 64);
+    uint32_t* fpu = (uint32_t*)sp;
+    fpu[0] = 0x1f80;                    // mxcsr默认值
+    fpu[1] = 0x037f;                    // x87控制字默认值
+    sp[1] = (uint64_t)entry;            // r12
+    sp[2] = 0;                          // r13
+    sp[3] = 0;                          // r14
+    sp[4] = 0;                          // r15
+    sp[5] = 0;                          // rbx
+    sp[6] = 0;                          // rbp，栈回溯到这里结束
+    sp[7] = (uint64_t)&caizi_context_entry;
+#else
+    uint64_t* sp = (uint64_t*)(top - 0xb0);
+    memset(sp, 0, 0xb0);
+    sp[8] = (uint64_t)entry;            // x19
+    sp[18] = 0;                         // x29，栈回溯到这里结束
+    sp[19] = (uint64_t)&caizi_context_entry;    // x30
+#endif
+    m_sp = sp;
+}
+#endif
+
+void UContext::make(void* stack, size_t size, void (*entry)()){
+    if(getcontext(&m_context)){
+        CAIZI_ASSERT2(false, "getcontext");
+    }
+    m_context.uc_link = nullptr;
+    m_context.uc_stack.ss_sp = stack;
+    m_context.uc_stack.ss_size = size;
+    makecontext(&m_context, entry, 0);
+}
+
+void UContext::Swap(UContext* from, UContext* to){
+    if(swapcontext(&from->m_context, &to->m_context)){
+        CAIZI_ASSERT2(false, "swapcontext");
+    }
+}
+
+}
@@ -0,0 +1,77 @@
+/*
+    @file fiber_context.h
+    @brief 协程上下文切换
+*/
+
+#ifndef __CAIZI_FIBER_CONTEXT_H__
+#define __CAIZI_FIBER_CONTEXT_H__
+
+#include <cstddef>
+#include <ucontext.h>
+
+// x86-64和aarch64上提供汇编实现的上下文切换
+#if defined(__x86_64__) || defined(__aarch64__)
+#define CAIZI_HAS_ASM_CONTEXT 1
+#endif
+
+// Fiber使用的实现，构建时定义CAIZI_FIBER_UCONTEXT(cmake -DCAIZI_FIBER_UCONTEXT=ON)强制使用ucontext
+#if defined(CAIZI_HAS_ASM_CONTEXT) && !defined(CAIZI_FIBER_UCONTEXT)
+#define CAIZI_FIBER_ASM_CONTEXT 1
+#endif
+
+#ifdef CAIZI_HAS_ASM_CONTEXT
+extern "C" {
+// 把当前的被调用者保存寄存器压到当前栈上，栈顶写入*from_sp，再切换到to_sp并恢复
+void caizi_swap_context(void** from_sp, void* to_sp);
+}
+#endif
+
+namespace caizi{
+
+#ifdef CAIZI_HAS_ASM_CONTEXT
+/*
+    汇编实现：只保存ABI规定的被调用者保存寄存器和栈指针，切换不进入内核
+        x86-64  rbx rbp r12-r15 mxcsr x87控制字
+        aarch64 x19-x29 lr d8-d15
+    上下文只是保存在栈上的一个栈顶指针，线程主协程的上下文在第一次切出时填写
+*/
+class AsmContext{
+public:
+    // 在栈[stack, stack + size)上构造从entry开始执行的上下文，entry不能返回
+    void make(void* stack, size_t size, void (*entry)());
+
+    static void Swap(AsmContext* from, AsmContext* to){
+        caizi_swap_context(&from->m_sp, to->m_sp);
+    }
+
+    static const char* Name(){ return "asm"; }
+
+private:
+    void* m_sp = nullptr;
+};
+#endif
+
+/*
+    ucontext实现：glibc的swapcontext每次切换都要调用rt_sigprocmask保存信号掩码
+*/
+class UContext{
+public:
+    void make(void* stack, size_t size, void (*entry)());
+
+    static void Swap(UContext* from, UContext* to);
+
+    static const char* Name(){ return "ucontext"; }
+
+private:
+    ucontext_t m_context;
+};
+
+#ifdef CAIZI_FIBER_ASM_CONTEXT
+typedef AsmContext FiberContext;
+#else
+typedef UContext FiberContext;
+#endif
+
+}
+
+#endif
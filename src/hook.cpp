@@ -0,0 +1,283 @@
+#include "hook.h"
+#include "config.h"
+#include "fd_manager.h"
+#include "iomanager.h"
+#include "log.h"
+#include <dlfcn.h>
+#include <errno.h>
+#include <stdarg.h>
+
+namespace caizi{
+
+static Logger::ptr g_logger = CAIZI_GET_LOGGER("system");
+
+static thread_local bool t_hook_enable = false;
+
+static ConfigVar<uint64_t>::ptr g_tcp_connect_timeout =
+    Config::Lookup<uint64_t>("tcp.connect.timeout", 5000, "tcp connect timeout(ms) of hooked connect");
+
+static std::atomic<uint64_t> s_connect_timeout{g_tcp_connect_timeout->getValue()};
+
+#define HOOK_FUN(XX) \
+    XX(sleep) \
+    XX(usleep) \
+    XX(nanosleep) \
+    XX(socket) \
+    XX(connect) \
+    XX(accept) \
+    XX(read) \
+    XX(recv) \
+    XX(write) \
+    XX(send) \
+    XX(close) \
+    XX(fcntl) \
+    XX(ioctl) \
+    XX(setsockopt)
+
+// 取得所有原函数，可以重复调用
+static void HookInit(){
+#define XX(name) name ## _f = (name ## _fun)dlsym(RTLD_NEXT, #name);
+    HOOK_FUN(XX)
+#undef XX
+}
+
+struct HookIniter{
+    HookIniter(){
+        if(!sleep_f){
+            HookInit();
+        }
+        g_tcp_connect_timeout->addListener([](const uint64_t& old_value, const uint64_t& new_value){
+            LOG_FMT_INFO(g_logger, "tcp connect timeout changed from %lu to %lu\n", old_value, new_value);
+            s_connect_timeout.store(new_value, std::memory_order_relaxed);
+        });
+    }
+};
+static HookIniter s_hook_initer;
+
+bool IsHookEnable(){
+    return t_hook_enable;
+}
+
+void SetHookEnable(bool flag){
+    t_hook_enable = flag;
+}
+
+// 开启hook且用户没有设置非阻塞的套接字，返回它的状态，否则返回nullptr表示直接调用原函数
+static FdCtx* HookedSocket(int fd){
+    if(!t_hook_enable){
+        return nullptr;
+    }
+    FdCtx* ctx = FdMgr::getInstance()->get(fd);
+    if(!ctx || !ctx->isSocket() || ctx->getUserNonblock()){
+        return nullptr;
+    }
+    return ctx;
+}
+
+// SO_RCVTIMEO/SO_SNDTIMEO超时时阻塞调用返回EAGAIN
+static ssize_t TimeoutToEagain(ssize_t rt){
+    if(rt == -1 && errno == ETIMEDOUT){
+        errno = EAGAIN;
+    }
+    return rt;
+}
+
+}
+
+// 在static初始化完成之前被调用时(例如其他全局对象的构造函数中)先取得原函数
+#define ENSURE_HOOK(name) \
+    if(__builtin_expect(!name ## _f, 0)){ \
+        caizi::HookInit(); \
+    }
+
+extern "C"{
+
+#define XX(name) name ## _fun name ## _f = nullptr;
+    HOOK_FUN(XX)
+#undef XX
+
+unsigned int sleep(unsigned int seconds){
+    ENSURE_HOOK(sleep);
+    if(!caizi::t_hook_enable){
+        return sleep_f(seconds);
+    }
+    caizi::IOManager::Sleep(seconds * 1000ull);
+    return 0;
+}
+
+int usleep(useconds_t usec){
+    ENSURE_HOOK(usleep);
+    if(!caizi::t_hook_enable){
+        return usleep_f(usec);
+    }
+    caizi::IOManager::Sleep((usec + 999) / 1000);
+    return 0;
+}
+
+int nanosleep(const struct timespec* req, struct timespec* rem){
+    ENSURE_HOOK(nanosleep);
+    if(!caizi::t_hook_enable){
+        return nanosleep_f(req, rem);
+    }
+    if(!req || req->tv_nsec < 0 || req->tv_nsec >= 1000000000){
+        errno = EINVAL;
+        return -1;
+    }
+    caizi::IOManager::Sleep(req->tv_sec * 1000ull + (req->tv_nsec + 999999) / 1000000);
+    if(rem){
+        rem->tv_sec = 0;
+        rem->tv_nsec = 0;
+    }
+    return 0;
+}
+
+int socket(int domain, int type, int protocol){
+    ENSURE_HOOK(socket);
+    int fd = socket_f(domain, type, protocol);
+    if(fd != -1 && caizi::t_hook_enable){
+        caizi::FdMgr::getInstance()->get(fd, true);
+    }
+    return fd;
+}
+
+int connect(int sockfd, const struct sockaddr* addr, socklen_t addrlen){
+    ENSURE_HOOK(connect);
+    if(!caizi::HookedSocket(sockfd)){
+        return connect_f(sockfd, addr, addrlen);
+    }
+    uint64_t timeout = caizi::s_connect_timeout.load(std::memory_order_relaxed);
+    return caizi::IOManager::Connect(sockfd, addr, addrlen, timeout);
+}
+
+int accept(int sockfd, struct sockaddr* addr, socklen_t* addrlen){
+    ENSURE_HOOK(accept);
+    caizi::FdCtx* ctx = caizi::HookedSocket(sockfd);
+    if(!ctx){
+        return accept_f(sockfd, addr, addrlen);
+    }
+    int fd = caizi::TimeoutToEagain(caizi::IOManager::Accept(sockfd, addr, addrlen, 0,
+                                                             ctx->getTimeout(SO_RCVTIMEO)));
+    if(fd != -1){
+        caizi::FdMgr::getInstance()->get(fd, true);
+    }
+    return fd;
+}
+
+// 套接字上的read/write等同于flags为0的recv/send
+ssize_t read(int fd, void* buf, size_t count){
+    ENSURE_HOOK(read);
+    caizi::FdCtx* ctx = caizi::HookedSocket(fd);
+    if(!ctx){
+        return read_f(fd, buf, count);
+    }
+    return caizi::TimeoutToEagain(caizi::IOManager::Recv(fd, buf, count, 0, ctx->getTimeout(SO_RCVTIMEO)));
+}
+
+ssize_t recv(int sockfd, void* buf, size_t len, int flags){
+    ENSURE_HOOK(recv);
+    caizi::FdCtx* ctx = caizi::HookedSocket(sockfd);
+    if(!ctx){
+        return recv_f(sockfd, buf, len, flags);
+    }
+    return caizi::TimeoutToEagain(caizi::IOManager::Recv(sockfd, buf, len, flags, ctx->getTimeout(SO_RCVTIMEO)));
+}
+
+ssize_t write(int fd, const void* buf, size_t count){
+    ENSURE_HOOK(write);
+    caizi::FdCtx* ctx = caizi::HookedSocket(fd);
+    if(!ctx){
+        return write_f(fd, buf, count);
+    }
+    return caizi::TimeoutToEagain(caizi::IOManager::Send(fd, buf, count, 0, ctx->getTimeout(SO_SNDTIMEO)));
+}
+
+ssize_t send(int sockfd, const void* buf, size_t len, int flags){
+    ENSURE_HOOK(send);
+    caizi::FdCtx* ctx = caizi::HookedSocket(sockfd);
+    if(!ctx){
+        return send_f(sockfd, buf, len, flags);
+    }
+    return caizi::TimeoutToEagain(caizi::IOManager::Send(sockfd, buf, len, flags, ctx->getTimeout(SO_SNDTIMEO)));
+}
+
+// 不论是否开启hook都清除fd的状态，唤醒等待它的协程(以EBADF返回)
+int close(int fd){
+    ENSURE_HOOK(close);
+    if(caizi::FdMgr::getInstance()->get(fd)){
+        caizi::IOManager* iom = caizi::IOManager::GetThis();
+        if(iom){
+            iom->closeFd(fd);
+        }
+        caizi::FdMgr::getInstance()->del(fd);
+    }
+    return close_f(fd);
+}
+
+/*
+    框架设置的非阻塞对用户不可见：F_SETFL只记录用户的非阻塞标志，内核中的O_NONBLOCK保持不变，
+    F_GETFL返回用户设置的标志。其他命令直接转发(和glibc一样按指针取参数)。
+*/
+int fcntl(int fd, int cmd, ... /* arg */ ){
+    ENSURE_HOOK(fcntl);
+    va_list va;
+    va_start(va, cmd);
+    void* arg = va_arg(va, void*);
+    va_end(va);
+    if(cmd != F_SETFL && cmd != F_GETFL){
+        return fcntl_f(fd, cmd, arg);
+    }
+    caizi::FdCtx* ctx = caizi::FdMgr::getInstance()->get(fd);
+    if(!ctx || !ctx->isSocket()){
+        return fcntl_f(fd, cmd, arg);
+    }
+    if(cmd == F_SETFL){
+        int flags = (int)(intptr_t)arg;
+        ctx->setUserNonblock(flags & O_NONBLOCK);
+        if(ctx->getSysNonblock()){
+            flags |= O_NONBLOCK;
+        }else{
+            flags &= ~O_NONBLOCK;
+        }
+        return fcntl_f(fd, cmd, flags);
+    }
+    int flags = fcntl_f(fd, cmd);
+    if(flags == -1){
+        return flags;
+    }
+    return ctx->getUserNonblock() ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+}
+
+int ioctl(int fd, unsigned long request, ...){
+    ENSURE_HOOK(ioctl);
+    va_list va;
+    va_start(va, request);
+    void* arg = va_arg(va, void*);
+    va_end(va);
+    if(request == FIONBIO && arg){
+        caizi::FdCtx* ctx = caizi::FdMgr::getInstance()->get(fd);
+        if(ctx && ctx->isSocket() && ctx->getSysNonblock()){
+            // 内核中保持非阻塞，只记录用户的设置
+            ctx->setUserNonblock(*(int*)arg != 0);
+            return 0;
+        }
+    }
+    return ioctl_f(fd, request, arg);
+}
+
+// 记录SO_RCVTIMEO/SO_SNDTIMEO，供hook和Socket的超时使用
+int setsockopt(int sockfd, int level, int optname, const void* optval, socklen_t optlen){
+    ENSURE_HOOK(setsockopt);
+    if(level == SOL_SOCKET && (optname == SO_RCVTIMEO || optname == SO_SNDTIMEO)
+            && optval && optlen >= sizeof(struct timeval)){
+        caizi::FdCtx* ctx = caizi::FdMgr::getInstance()->get(sockfd);
+        if(ctx){
+            const struct timeval* tv = (const struct timeval*)optval;
+            uint64_t ms = tv->tv_sec * 1000ull + tv->tv_usec / 1000;
+            // 和内核一样，0表示没有超时
+            ctx->setTimeout(optname, ms ? ms : ~0ull);
+        }
+    }
+    return setsockopt_f(sockfd, level, optname, optval, optlen);
+}
+
+}
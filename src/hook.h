@@ -0,0 +1,79 @@
+/*
+    @file hook.h
+    @brief 系统调用hook
+    开启hook的线程上，协程中对阻塞套接字的读写、accept、connect以及sleep系列调用
+    不再阻塞线程，而是挂起协程，由IOManager在fd就绪或定时器到期后恢复。
+    通过定义同名函数覆盖libc的符号，原函数用dlsym(RTLD_NEXT)取得，保存在 名字_f 中。
+*/
+
+#ifndef __CAIZI_HOOK_H__
+#define __CAIZI_HOOK_H__
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace caizi{
+
+// 当前线程是否开启hook，调度器的工作线程在调度循环中开启
+bool IsHookEnable();
+void SetHookEnable(bool flag);
+
+}
+
+extern "C"{
+
+// sleep
+typedef unsigned int (*sleep_fun)(unsigned int seconds);
+extern sleep_fun sleep_f;
+
+typedef int (*usleep_fun)(useconds_t usec);
+extern usleep_fun usleep_f;
+
+typedef int (*nanosleep_fun)(const struct timespec* req, struct timespec* rem);
+extern nanosleep_fun nanosleep_f;
+
+// socket
+typedef int (*socket_fun)(int domain, int type, int protocol);
+extern socket_fun socket_f;
+
+typedef int (*connect_fun)(int sockfd, const struct sockaddr* addr, socklen_t addrlen);
+extern connect_fun connect_f;
+
+typedef int (*accept_fun)(int sockfd, struct sockaddr* addr, socklen_t* addrlen);
+extern accept_fun accept_f;
+
+// read
+typedef ssize_t (*read_fun)(int fd, void* buf, size_t count);
+extern read_fun read_f;
+
+typedef ssize_t (*recv_fun)(int sockfd, void* buf, size_t len, int flags);
+extern recv_fun recv_f;
+
+// write
+typedef ssize_t (*write_fun)(int fd, const void* buf, size_t count);
+extern write_fun write_f;
+
+typedef ssize_t (*send_fun)(int sockfd, const void* buf, size_t len, int flags);
+extern send_fun send_f;
+
+// fd状态
+typedef int (*close_fun)(int fd);
+extern close_fun close_f;
+
+typedef int (*fcntl_fun)(int fd, int cmd, ... /* arg */ );
+extern fcntl_fun fcntl_f;
+
+typedef int (*ioctl_fun)(int fd, unsigned long request, ...);
+extern ioctl_fun ioctl_f;
+
+typedef int (*setsockopt_fun)(int sockfd, int level, int optname, const void* optval, socklen_t optlen);
+extern setsockopt_fun setsockopt_f;
+
+}
+
+#endif
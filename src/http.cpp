@@ -0,0 +1,307 @@
+#include "http.h"
+#include "http_writer.h"
+#include <fcntl.h>
+#include <sstream>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace caizi{
+
+HttpMethod StringToHttpMethod(std::string_view m){
+#define XX(num, name, string) \
+    if(m == #string){ \
+        return HttpMethod::name; \
+    }
+    HTTP_METHOD_MAP(XX);
+#undef XX
+    return HttpMethod::INVALID_METHOD;
+}
+
+static const char* s_method_string[] = {
+#define XX(num, name, string) #string,
+    HTTP_METHOD_MAP(XX)
+#undef XX
+};
+
+const char* HttpMethodToString(HttpMethod m){
+    uint32_t idx = (uint32_t)m;
+    if(idx >= (sizeof(s_method_string) / sizeof(s_method_string[0]))){
+        return "<unknown>";
+    }
+    return s_method_string[idx];
+}
+
+const char* HttpStatusToString(HttpStatus s){
+    switch(s){
+#define XX(code, name, msg) \
+        case HttpStatus::name: \
+            return #msg;
+        HTTP_STATUS_MAP(XX);
+#undef XX
+        default:
+            return "Unknown";
+    }
+}
+
+bool EqualsIgnoreCase(std::string_view lhs, std::string_view rhs){
+    return lhs.size() == rhs.size() && strncasecmp(lhs.data(), rhs.data(), lhs.size()) == 0;
+}
+
+static std::string_view FindHeader(const std::vector<HttpHeader>& headers, std::string_view key,
+                                   std::string_view def, bool* found){
+    for(auto& h : headers){
+        if(EqualsIgnoreCase(h.name, key)){
+            if(found){
+                *found = true;
+            }
+            return h.value;
+        }
+    }
+    if(found){
+        *found = false;
+    }
+    return def;
+}
+
+static void DumpVersion(std::ostream& os, uint8_t version){
+    os << "HTTP/" << (uint32_t)(version >> 4) << "." << (uint32_t)(version & 0x0f);
+}
+
+std::string_view HttpRequest::getHeader(std::string_view key, std::string_view def) const{
+    return FindHeader(m_headers, key, def, nullptr);
+}
+
+bool HttpRequest::hasHeader(std::string_view key, std::string_view* value) const{
+    bool found = false;
+    std::string_view v = FindHeader(m_headers, key, std::string_view(), &found);
+    if(found && value){
+        *value = v;
+    }
+    return found;
+}
+
+bool HttpRequest::getParam(std::string_view key, std::string_view& value) const{
+    std::string_view query = m_query;
+    while(!query.empty()){
+        size_t amp = query.find('&');
+        std::string_view item = query.substr(0, amp);
+        query = amp == std::string_view::npos ? std::string_view() : query.substr(amp + 1);
+        size_t eq = item.find('=');
+        if(item.substr(0, eq) == key){
+            value = eq == std::string_view::npos ? std::string_view() : item.substr(eq + 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+std::ostream& HttpRequest::dump(std::ostream& os) const{
+    os << HttpMethodToString(m_method) << " " << m_uri << " ";
+    DumpVersion(os, m_version);
+    os << "\r\n";
+    for(auto& h : m_headers){
+        os << h.name << ": " << h.value << "\r\n";
+    }
+    os << "\r\n" << m_body;
+    return os;
+}
+
+std::string HttpRequest::toString() const{
+    std::stringstream ss;
+    dump(ss);
+    return ss.str();
+}
+
+std::string_view HttpResponseView::getHeader(std::string_view key, std::string_view def) const{
+    return FindHeader(m_headers, key, def, nullptr);
+}
+
+std::ostream& HttpResponseView::dump(std::ostream& os) const{
+    DumpVersion(os, m_version);
+    os << " " << (uint32_t)m_status << " " << m_reason << "\r\n";
+    for(auto& h : m_headers){
+        os << h.name << ": " << h.value << "\r\n";
+    }
+    os << "\r\n" << m_body;
+    return os;
+}
+
+std::string HttpResponseView::toString() const{
+    std::stringstream ss;
+    dump(ss);
+    return ss.str();
+}
+
+// 在"name: value\r\n"组成的头部块中查找key所在的行，返回行的起始位置，行的长度写入len
+static size_t FindHeaderLine(std::string_view block, std::string_view key, size_t& len){
+    size_t pos = 0;
+    while(pos < block.size()){
+        size_t end = block.find("\r\n", pos);
+        end = end == std::string_view::npos ? block.size() : end + 2;
+        std::string_view line = block.substr(pos, end - pos);
+        if(line.size() > key.size() && line[key.size()] == ':'
+                && EqualsIgnoreCase(line.substr(0, key.size()), key)){
+            len = line.size();
+            return pos;
+        }
+        pos = end;
+    }
+    return std::string_view::npos;
+}
+
+HttpResponse::HttpResponse(uint8_t version, bool close)
+    :m_status(HttpStatus::OK)
+    ,m_version(version)
+    ,m_close(close)
+    ,m_ownFd(false)
+    ,m_fileFd(-1)
+    ,m_fileOffset(0)
+    ,m_fileLength(0){
+}
+
+HttpResponse::~HttpResponse(){
+    closeFile();
+}
+
+void HttpResponse::reset(uint8_t version, bool close){
+    m_status = HttpStatus::OK;
+    m_version = version;
+    m_close = close;
+    closeFile();
+    m_body.clear();
+    m_bodyRef = std::string_view();
+    m_reason.clear();
+    m_headers.clear();
+    m_contentTypeLine = std::string_view();
+}
+
+void HttpResponse::closeFile(){
+    if(m_fileFd >= 0 && m_ownFd){
+        ::close(m_fileFd);
+    }
+    m_fileFd = -1;
+    m_ownFd = false;
+    m_fileOffset = 0;
+    m_fileLength = 0;
+}
+
+void HttpResponse::setBody(std::string_view v){
+    closeFile();
+    m_body.assign(v.data(), v.size());
+    m_bodyRef = m_body;
+}
+
+void HttpResponse::setBodyRef(std::string_view v){
+    closeFile();
+    m_bodyRef = v;
+}
+
+void HttpResponse::setFile(int fd, off_t offset, size_t len, bool owned){
+    closeFile();
+    m_bodyRef = std::string_view();
+    m_fileFd = fd;
+    m_ownFd = owned;
+    m_fileOffset = offset;
+    m_fileLength = len;
+}
+
+bool HttpResponse::setFile(const std::string& path){
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) || !S_ISREG(st.st_mode)){
+        ::close(fd);
+        return false;
+    }
+    setFile(fd, 0, st.st_size, true);
+    if(getHeader("content-type").empty()){
+        setContentType(HttpResponseWriter::MimeTypeByPath(path));
+    }
+    return true;
+}
+
+std::string_view HttpResponse::getHeader(std::string_view key, std::string_view def) const{
+    if(!m_contentTypeLine.empty() && EqualsIgnoreCase(key, "content-type")){
+        // "content-type: "和"\r\n"
+        return m_contentTypeLine.substr(14, m_contentTypeLine.size() - 16);
+    }
+    size_t len = 0;
+    size_t pos = FindHeaderLine(m_headers, key, len);
+    if(pos == std::string_view::npos){
+        return def;
+    }
+    std::string_view value = std::string_view(m_headers).substr(pos + key.size() + 1, len - key.size() - 3);
+    while(!value.empty() && value[0] == ' '){
+        value.remove_prefix(1);
+    }
+    return value;
+}
+
+void HttpResponse::setHeader(std::string_view key, std::string_view val){
+    if(EqualsIgnoreCase(key, "content-length") || EqualsIgnoreCase(key, "connection")){
+        return;
+    }
+    if(EqualsIgnoreCase(key, "content-type")){
+        setContentType(val);
+        return;
+    }
+    delHeader(key);
+    m_headers.append(key.data(), key.size());
+    m_headers.append(": ", 2);
+    m_headers.append(val.data(), val.size());
+    m_headers.append("\r\n", 2);
+}
+
+void HttpResponse::delHeader(std::string_view key){
+    if(EqualsIgnoreCase(key, "content-type")){
+        m_contentTypeLine = std::string_view();
+    }
+    size_t len = 0;
+    size_t pos = FindHeaderLine(m_headers, key, len);
+    if(pos != std::string_view::npos){
+        m_headers.erase(pos, len);
+    }
+}
+
+void HttpResponse::setContentType(std::string_view mime){
+    delHeader("content-type");
+    m_contentTypeLine = HttpResponseWriter::ContentTypeLine(mime);
+    if(m_contentTypeLine.empty()){
+        m_headers.append("content-type: ", 14);
+        m_headers.append(mime.data(), mime.size());
+        m_headers.append("\r\n", 2);
+    }
+}
+
+std::ostream& HttpResponse::dump(std::ostream& os, bool with_body) const{
+    HttpResponseWriter writer;
+    size_t count = writer.build(*this, with_body);
+    const iovec* iov = writer.getIovecs();
+    for(size_t i = 0; i < count; ++i){
+        os.write((const char*)iov[i].iov_base, iov[i].iov_len);
+    }
+    return os;
+}
+
+std::string HttpResponse::toString(bool with_body) const{
+    std::stringstream ss;
+    dump(ss, with_body);
+    return ss.str();
+}
+
+std::ostream& operator<<(std::ostream& os, const HttpRequest& req){
+    return req.dump(os);
+}
+
+std::ostream& operator<<(std::ostream& os, const HttpResponseView& rsp){
+    return rsp.dump(os);
+}
+
+std::ostream& operator<<(std::ostream& os, const HttpResponse& rsp){
+    return rsp.dump(os);
+}
+
+}
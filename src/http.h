@@ -0,0 +1,251 @@
+/*
+    @file http.h
+    @brief HTTP/1.1的方法、状态码、请求和响应
+*/
+
+#ifndef __CAIZI_HTTP_H__
+#define __CAIZI_HTTP_H__
+
+#include <memory>
+#include <ostream>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <vector>
+
+#include "noncopyable.h"
+
+namespace caizi{
+
+#define HTTP_METHOD_MAP(XX)         \
+    XX(0,  DELETE,      DELETE)     \
+    XX(1,  GET,         GET)        \
+    XX(2,  HEAD,        HEAD)       \
+    XX(3,  POST,        POST)       \
+    XX(4,  PUT,         PUT)        \
+    XX(5,  CONNECT,     CONNECT)    \
+    XX(6,  OPTIONS,     OPTIONS)    \
+    XX(7,  TRACE,       TRACE)      \
+    XX(8,  PATCH,       PATCH)      \
+
+#define HTTP_STATUS_MAP(XX)                                                 \
+    XX(100, CONTINUE,                        Continue)                        \
+    XX(101, SWITCHING_PROTOCOLS,             Switching Protocols)             \
+    XX(200, OK,                              OK)                              \
+    XX(201, CREATED,                         Created)                         \
+    XX(202, ACCEPTED,                        Accepted)                        \
+    XX(204, NO_CONTENT,                      No Content)                      \
+    XX(206, PARTIAL_CONTENT,                 Partial Content)                 \
+    XX(301, MOVED_PERMANENTLY,               Moved Permanently)               \
+    XX(302, FOUND,                           Found)                           \
+    XX(304, NOT_MODIFIED,                    Not Modified)                    \
+    XX(307, TEMPORARY_REDIRECT,              Temporary Redirect)              \
+    XX(308, PERMANENT_REDIRECT,              Permanent Redirect)              \
+    XX(400, BAD_REQUEST,                     Bad Request)                     \
+    XX(401, UNAUTHORIZED,                    Unauthorized)                    \
+    XX(403, FORBIDDEN,                       Forbidden)                       \
+    XX(404, NOT_FOUND,                       Not Found)                       \
+    XX(405, METHOD_NOT_ALLOWED,              Method Not Allowed)              \
+    XX(408, REQUEST_TIMEOUT,                 Request Timeout)                 \
+    XX(411, LENGTH_REQUIRED,                 Length Required)                 \
+    XX(413, PAYLOAD_TOO_LARGE,               Payload Too Large)               \
+    XX(414, URI_TOO_LONG,                    URI Too Long)                    \
+    XX(416, RANGE_NOT_SATISFIABLE,           Range Not Satisfiable)           \
+    XX(431, REQUEST_HEADER_FIELDS_TOO_LARGE, Request Header Fields Too Large) \
+    XX(500, INTERNAL_SERVER_ERROR,           Internal Server Error)           \
+    XX(501, NOT_IMPLEMENTED,                 Not Implemented)                 \
+    XX(502, BAD_GATEWAY,                     Bad Gateway)                     \
+    XX(503, SERVICE_UNAVAILABLE,             Service Unavailable)             \
+    XX(504, GATEWAY_TIMEOUT,                 Gateway Timeout)                 \
+    XX(505, HTTP_VERSION_NOT_SUPPORTED,      HTTP Version Not Supported)      \
+
+enum class HttpMethod{
+#define XX(num, name, string) name = num,
+    HTTP_METHOD_MAP(XX)
+#undef XX
+    INVALID_METHOD
+};
+
+enum class HttpStatus{
+#define XX(code, name, desc) name = code,
+    HTTP_STATUS_MAP(XX)
+#undef XX
+};
+
+HttpMethod StringToHttpMethod(std::string_view m);
+const char* HttpMethodToString(HttpMethod m);
+// 不认识的状态码返回"Unknown"
+const char* HttpStatusToString(HttpStatus s);
+
+// 忽略大小写比较(头部名称)
+bool EqualsIgnoreCase(std::string_view lhs, std::string_view rhs);
+
+// 头部，指向接收缓冲区
+struct HttpHeader{
+    std::string_view name;
+    std::string_view value;
+};
+
+/*
+    解析得到的HTTP请求
+    所有字段都是指向接收缓冲区的string_view，不拷贝数据，
+    只在解析下一个请求之前有效(HttpSession::recvRequest)。
+    路径和参数是原始的字节，没有做百分号解码。
+*/
+class HttpRequest{
+friend class HttpRequestParser;
+public:
+    HttpMethod getMethod() const{ return m_method; };
+    // 0x11表示HTTP/1.1，0x10表示HTTP/1.0
+    uint8_t getVersion() const{ return m_version; };
+    // 请求行中的原始目标，包括参数
+    std::string_view getUri() const{ return m_uri; };
+    std::string_view getPath() const{ return m_path; };
+    std::string_view getQuery() const{ return m_query; };
+    std::string_view getFragment() const{ return m_fragment; };
+    // 分块编码的请求体已在缓冲区中原地拼接成连续的一段
+    std::string_view getBody() const{ return m_body; };
+    const std::vector<HttpHeader>& getHeaders() const{ return m_headers; };
+
+    // 同名头部出现多次时返回第一个
+    std::string_view getHeader(std::string_view key, std::string_view def = std::string_view()) const;
+    bool hasHeader(std::string_view key, std::string_view* value = nullptr) const;
+    // 查询参数key的值(未解码)，不存在时返回false
+    bool getParam(std::string_view key, std::string_view& value) const;
+
+    // 根据版本和Connection头部判断处理完是否关闭连接
+    bool isClose() const{ return m_close; };
+    bool isChunked() const{ return m_chunked; };
+
+    std::ostream& dump(std::ostream& os) const;
+    std::string toString() const;
+
+private:
+    HttpMethod m_method = HttpMethod::INVALID_METHOD;
+    uint8_t m_version = 0x11;
+    bool m_close = false;
+    bool m_chunked = false;
+    std::string_view m_uri;
+    std::string_view m_path;
+    std::string_view m_query;
+    std::string_view m_fragment;
+    std::string_view m_body;
+    std::vector<HttpHeader> m_headers;
+};
+
+/*
+    解析得到的HTTP响应(客户端使用)，字段同样指向接收缓冲区
+*/
+class HttpResponseView{
+friend class HttpResponseParser;
+public:
+    HttpStatus getStatus() const{ return m_status; };
+    uint8_t getVersion() const{ return m_version; };
+    std::string_view getReason() const{ return m_reason; };
+    std::string_view getBody() const{ return m_body; };
+    const std::vector<HttpHeader>& getHeaders() const{ return m_headers; };
+    std::string_view getHeader(std::string_view key, std::string_view def = std::string_view()) const;
+    bool isClose() const{ return m_close; };
+    bool isChunked() const{ return m_chunked; };
+
+    std::ostream& dump(std::ostream& os) const;
+    std::string toString() const;
+
+private:
+    HttpStatus m_status = HttpStatus::OK;
+    uint8_t m_version = 0x11;
+    bool m_close = false;
+    bool m_chunked = false;
+    std::string_view m_reason;
+    std::string_view m_body;
+    std::vector<HttpHeader> m_headers;
+};
+
+/*
+    服务器要发送的HTTP响应，由HttpResponseWriter用writev发送
+    为了小响应不分配内存，一个连接上的响应对象用reset重复使用：
+    头部按"name: value\r\n"追加在一块连续的内存中，body可以引用外部数据(setBodyRef)，
+    常见的Content-Type使用预先序列化的头部行。
+    Content-Length和Connection在发送时根据body和isClose生成，setHeader设置它们会被忽略。
+*/
+class HttpResponse : public Noncopyable{
+public:
+    typedef std::shared_ptr<HttpResponse> ptr;
+
+    HttpResponse(uint8_t version = 0x11, bool close = true);
+    ~HttpResponse();
+
+    // 清空状态、头部、body和文件，保留已分配的内存
+    void reset(uint8_t version, bool close);
+
+    HttpStatus getStatus() const{ return m_status; };
+    void setStatus(HttpStatus v){ m_status = v; };
+    uint8_t getVersion() const{ return m_version; };
+    void setVersion(uint8_t v){ m_version = v; };
+    // 为空时使用状态码的默认描述
+    const std::string& getReason() const{ return m_reason; };
+    void setReason(const std::string& v){ m_reason = v; };
+    bool isClose() const{ return m_close; };
+    void setClose(bool v){ m_close = v; };
+
+    std::string_view getBody() const{ return m_bodyRef; };
+    // 拷贝到响应自己的body中
+    void setBody(std::string_view v);
+    // 只引用数据，调用者保证发送完成之前有效(常量、缓存的内容)
+    void setBodyRef(std::string_view v);
+
+    /*
+        发送文件的[offset, offset+len)作为body，用sendfile发送，不经过用户态
+        @param owned 为true时响应负责关闭fd
+    */
+    void setFile(int fd, off_t offset, size_t len, bool owned);
+    // 打开普通文件作为body，没有设置Content-Type时按扩展名设置
+    bool setFile(const std::string& path);
+    bool hasFile() const{ return m_fileFd >= 0; };
+    int getFileFd() const{ return m_fileFd; };
+    off_t getFileOffset() const{ return m_fileOffset; };
+    // body的长度(Content-Length)
+    size_t getContentLength() const{ return hasFile() ? m_fileLength : m_bodyRef.size(); };
+
+    std::string_view getHeader(std::string_view key, std::string_view def = std::string_view()) const;
+    // 替换同名的头部
+    void setHeader(std::string_view key, std::string_view val);
+    void delHeader(std::string_view key);
+    // 常见类型使用缓存的头部行
+    void setContentType(std::string_view mime);
+
+    // 已序列化的头部，不含Content-Type
+    std::string_view getHeaderBlock() const{ return m_headers; };
+    // 预先序列化的"content-type: ...\r\n"，没有时为空
+    std::string_view getContentTypeLine() const{ return m_contentTypeLine; };
+
+    // @param with_body 为false时不输出body(HEAD请求)，Content-Length仍是body的长度；文件body不输出
+    std::ostream& dump(std::ostream& os, bool with_body = true) const;
+    std::string toString(bool with_body = true) const;
+
+private:
+    void closeFile();
+
+private:
+    HttpStatus m_status;
+    uint8_t m_version;
+    bool m_close;
+    bool m_ownFd;
+    int m_fileFd;
+    off_t m_fileOffset;
+    size_t m_fileLength;
+    std::string m_body;
+    std::string_view m_bodyRef;         // 指向m_body或外部数据
+    std::string m_reason;
+    std::string m_headers;
+    std::string_view m_contentTypeLine;
+};
+
+std::ostream& operator<<(std::ostream& os, const HttpRequest& req);
+std::ostream& operator<<(std::ostream& os, const HttpResponseView& rsp);
+std::ostream& operator<<(std::ostream& os, const HttpResponse& rsp);
+
+}
+
+#endif
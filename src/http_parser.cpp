@@ -0,0 +1,539 @@
+#include "http_parser.h"
+#include "config.h"
+#include <atomic>
+#include <string.h>
+
+namespace caizi{
+
+static ConfigVar<uint64_t>::ptr g_http_max_header_size =
+    Config::Lookup<uint64_t>("http.parser.max_header_size", 8 * 1024, "max size of http start line and headers");
+static ConfigVar<uint64_t>::ptr g_http_max_body_size =
+    Config::Lookup<uint64_t>("http.parser.max_body_size", 64 * 1024 * 1024, "max size of http body");
+
+static std::atomic<uint64_t> s_http_max_header_size{g_http_max_header_size->getValue()};
+static std::atomic<uint64_t> s_http_max_body_size{g_http_max_body_size->getValue()};
+
+struct HttpParserConfigIniter{
+    HttpParserConfigIniter(){
+        g_http_max_header_size->addListener([](const uint64_t& old_value, const uint64_t& new_value){
+            s_http_max_header_size.store(new_value, std::memory_order_relaxed);
+        });
+        g_http_max_body_size->addListener([](const uint64_t& old_value, const uint64_t& new_value){
+            s_http_max_body_size.store(new_value, std::memory_order_relaxed);
+        });
+    }
+};
+static HttpParserConfigIniter __http_parser_config_init;
+
+// 块大小行和trailer行的最大长度
+static const size_t kMaxChunkLineSize = 4096;
+
+uint64_t HttpParser::GetMaxHeaderSize(){
+    return s_http_max_header_size.load(std::memory_order_relaxed);
+}
+
+uint64_t HttpParser::GetMaxBodySize(){
+    return s_http_max_body_size.load(std::memory_order_relaxed);
+}
+
+HttpStatus HttpParser::ErrorToStatus(Error error){
+    switch(error){
+        case OK:
+            return HttpStatus::OK;
+        case HEADER_TOO_LARGE:
+            return HttpStatus::REQUEST_HEADER_FIELDS_TOO_LARGE;
+        case BODY_TOO_LARGE:
+            return HttpStatus::PAYLOAD_TOO_LARGE;
+        case UNSUPPORTED_METHOD:
+            return HttpStatus::NOT_IMPLEMENTED;
+        case UNSUPPORTED_VERSION:
+            return HttpStatus::HTTP_VERSION_NOT_SUPPORTED;
+        default:
+            return HttpStatus::BAD_REQUEST;
+    }
+}
+
+// RFC 7230 token
+static inline bool IsTokenChar(char c){
+    static const char* s_specials = "!#$%&'*+-.^_`|~";
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+        || (c && strchr(s_specials, c));
+}
+
+static inline bool IsSpace(char c){
+    return c == ' ' || c == '\t';
+}
+
+static std::string_view Trim(std::string_view str){
+    while(!str.empty() && IsSpace(str.front())){
+        str.remove_prefix(1);
+    }
+    while(!str.empty() && IsSpace(str.back())){
+        str.remove_suffix(1);
+    }
+    return str;
+}
+
+// 逐个处理逗号分隔的列表中的元素
+template<class F>
+static void ForEachToken(std::string_view list, F fun){
+    while(!list.empty()){
+        size_t comma = list.find(',');
+        std::string_view item = Trim(list.substr(0, comma));
+        if(!item.empty()){
+            fun(item);
+        }
+        list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+    }
+}
+
+HttpParser::HttpParser(){
+    HttpParser::reset();
+}
+
+void HttpParser::reset(){
+    m_version = 0x11;
+    m_close = false;
+    m_chunked = false;
+    m_hasTransferEncoding = false;
+    m_hasContentLength = false;
+    m_expectContinue = false;
+    m_contentLength = 0;
+    m_state = START_LINE;
+    m_error = OK;
+    m_closeToken = false;
+    m_keepAliveToken = false;
+    m_pos = 0;
+    m_searchFrom = 0;
+    m_bodyStart = 0;
+    m_bodyEnd = 0;
+    m_chunkSize = 0;
+    m_headerSpans.clear();
+}
+
+int64_t HttpParser::fail(Error error){
+    m_state = ERROR;
+    m_error = error;
+    return -1;
+}
+
+HttpParser::Error HttpParser::ParseVersion(std::string_view str, uint8_t& version){
+    if(str.size() != 8 || str.substr(0, 5) != "HTTP/" || str[6] != '.'
+            || str[5] < '0' || str[5] > '9' || str[7] < '0' || str[7] > '9'){
+        return INVALID_MESSAGE;
+    }
+    if(str[5] != '1' || (str[7] != '0' && str[7] != '1')){
+        return UNSUPPORTED_VERSION;
+    }
+    version = 0x10 | (str[7] - '0');
+    return OK;
+}
+
+int64_t HttpParser::execute(char* data, size_t len){
+    while(true){
+        switch(m_state){
+            case START_LINE:
+            case HEADERS:
+            case CHUNK_SIZE:
+            case CHUNK_TRAILER:{
+                bool in_header = m_state == START_LINE || m_state == HEADERS;
+                const char* nl = m_searchFrom < len
+                    ? (const char*)memchr(data + m_searchFrom, '\n', len - m_searchFrom) : nullptr;
+                if(!nl){
+                    m_searchFrom = len;
+                    if(in_header && len > GetMaxHeaderSize()){
+                        return fail(HEADER_TOO_LARGE);
+                    }
+                    if(!in_header && len - m_pos > kMaxChunkLineSize){
+                        return fail(INVALID_MESSAGE);
+                    }
+                    return 0;
+                }
+                size_t eol = nl - data;
+                if(in_header && eol + 1 > GetMaxHeaderSize()){
+                    return fail(HEADER_TOO_LARGE);
+                }
+                size_t begin = m_pos;
+                size_t end = eol > begin && data[eol - 1] == '\r' ? eol - 1 : eol;
+                m_pos = eol + 1;
+                m_searchFrom = m_pos;
+                Error error = processLine(data, begin, end);
+                if(error != OK){
+                    return fail(error);
+                }
+                break;
+            }
+            case BODY:
+                if(len - m_pos < m_contentLength){
+                    return 0;
+                }
+                m_bodyStart = m_pos;
+                m_bodyEnd = m_pos + m_contentLength;
+                m_pos = m_bodyEnd;
+                m_state = DONE;
+                break;
+            case CHUNK_DATA:{
+                // 块数据和之后的行尾都到齐后搬到已解码数据的后面
+                size_t avail = len - m_pos;
+                if(avail < m_chunkSize + 1){
+                    return 0;
+                }
+                size_t crlf = 0;
+                if(data[m_pos + m_chunkSize] == '\n'){
+                    crlf = 1;
+                }else if(data[m_pos + m_chunkSize] == '\r'){
+                    if(avail < m_chunkSize + 2){
+                        return 0;
+                    }
+                    if(data[m_pos + m_chunkSize + 1] != '\n'){
+                        return fail(INVALID_MESSAGE);
+                    }
+                    crlf = 2;
+                }else{
+                    return fail(INVALID_MESSAGE);
+                }
+                if(m_bodyEnd != m_pos){
+                    memmove(data + m_bodyEnd, data + m_pos, m_chunkSize);
+                }
+                m_bodyEnd += m_chunkSize;
+                m_pos += m_chunkSize + crlf;
+                m_searchFrom = m_pos;
+                m_state = CHUNK_SIZE;
+                break;
+            }
+            case BODY_UNTIL_CLOSE:
+                if(len - m_bodyStart > GetMaxBodySize()){
+                    return fail(BODY_TOO_LARGE);
+                }
+                m_bodyEnd = len;
+                m_pos = len;
+                return 0;
+            case DONE:
+                // 每次都重新生成结果，缓冲区可能已经搬移
+                onMessageComplete(data);
+                return m_pos;
+            default:
+                return -1;
+        }
+    }
+}
+
+HttpParser::Error HttpParser::processLine(const char* data, size_t begin, size_t end){
+    switch(m_state){
+        case START_LINE:
+            // 请求之间多余的空行忽略(RFC 7230 3.5)
+            if(begin == end){
+                return OK;
+            }
+            m_state = HEADERS;
+            return parseStartLine(data, begin, end);
+        case HEADERS:{
+            if(begin != end){
+                return parseHeader(data, begin, end);
+            }
+            if(m_version == 0x10){
+                m_close = m_closeToken || !m_keepAliveToken;
+            }else{
+                m_close = m_closeToken;
+            }
+            if(m_hasContentLength && m_contentLength > GetMaxBodySize()){
+                return BODY_TOO_LARGE;
+            }
+            return onHeaderComplete();
+        }
+        case CHUNK_SIZE:
+            return parseChunkSize(std::string_view(data + begin, end - begin));
+        case CHUNK_TRAILER:
+            // trailer不保留
+            if(begin == end){
+                m_state = DONE;
+            }
+            return OK;
+        default:
+            return INVALID_MESSAGE;
+    }
+}
+
+HttpParser::Error HttpParser::parseHeader(const char* data, size_t begin, size_t end){
+    // 不支持折行(obs-fold)
+    if(IsSpace(data[begin])){
+        return INVALID_MESSAGE;
+    }
+    const char* colon = (const char*)memchr(data + begin, ':', end - begin);
+    if(!colon || colon == data + begin){
+        return INVALID_MESSAGE;
+    }
+    size_t name_end = colon - data;
+    for(size_t i = begin; i < name_end; ++i){
+        if(!IsTokenChar(data[i])){
+            return INVALID_MESSAGE;
+        }
+    }
+    std::string_view name(data + begin, name_end - begin);
+    std::string_view value = Trim(std::string_view(data + name_end + 1, end - name_end - 1));
+    size_t value_begin = value.empty() ? end : value.data() - data;
+    m_headerSpans.push_back(std::make_pair(MakeSpan(begin, name_end),
+                                           MakeSpan(value_begin, value_begin + value.size())));
+
+    if(EqualsIgnoreCase(name, "content-length")){
+        if(value.empty() || value.size() > 19){
+            return value.empty() ? INVALID_MESSAGE : BODY_TOO_LARGE;
+        }
+        uint64_t v = 0;
+        for(char c : value){
+            if(c < '0' || c > '9'){
+                return INVALID_MESSAGE;
+            }
+            v = v * 10 + (c - '0');
+        }
+        if(m_hasContentLength && v != m_contentLength){
+            return INVALID_MESSAGE;
+        }
+        m_hasContentLength = true;
+        m_contentLength = v;
+    }else if(EqualsIgnoreCase(name, "transfer-encoding")){
+        m_hasTransferEncoding = true;
+        ForEachToken(value, [this](std::string_view coding){
+            m_chunked = EqualsIgnoreCase(coding, "chunked");
+        });
+    }else if(EqualsIgnoreCase(name, "connection")){
+        ForEachToken(value, [this](std::string_view option){
+            if(EqualsIgnoreCase(option, "close")){
+                m_closeToken = true;
+            }else if(EqualsIgnoreCase(option, "keep-alive")){
+                m_keepAliveToken = true;
+            }
+        });
+    }else if(EqualsIgnoreCase(name, "expect")){
+        m_expectContinue = EqualsIgnoreCase(value, "100-continue");
+    }
+    return OK;
+}
+
+HttpParser::Error HttpParser::parseChunkSize(std::string_view line){
+    uint64_t size = 0;
+    size_t i = 0;
+    for(; i < line.size(); ++i){
+        char c = line[i];
+        int digit = 0;
+        if(c >= '0' && c <= '9'){
+            digit = c - '0';
+        }else if(c >= 'a' && c <= 'f'){
+            digit = c - 'a' + 10;
+        }else if(c >= 'A' && c <= 'F'){
+            digit = c - 'A' + 10;
+        }else{
+            break;
+        }
+        if(size > (GetMaxBodySize() >> 4)){
+            return BODY_TOO_LARGE;
+        }
+        size = (size << 4) | digit;
+    }
+    // 块扩展(;name=value)忽略
+    if(i == 0 || (i < line.size() && line[i] != ';' && !IsSpace(line[i]))){
+        return INVALID_MESSAGE;
+    }
+    if(m_bodyEnd - m_bodyStart + size > GetMaxBodySize()){
+        return BODY_TOO_LARGE;
+    }
+    m_chunkSize = size;
+    m_state = size ? CHUNK_DATA : CHUNK_TRAILER;
+    return OK;
+}
+
+void HttpParser::setBodyNone(){
+    m_bodyStart = m_bodyEnd = m_pos;
+    m_state = DONE;
+}
+
+void HttpParser::setBodyLength(uint64_t len){
+    m_bodyStart = m_bodyEnd = m_pos;
+    m_contentLength = len;
+    m_state = len ? BODY : DONE;
+}
+
+void HttpParser::setBodyChunked(){
+    m_bodyStart = m_bodyEnd = m_pos;
+    m_state = CHUNK_SIZE;
+}
+
+void HttpParser::setBodyUntilClose(){
+    m_bodyStart = m_bodyEnd = m_pos;
+    m_close = true;
+    m_state = BODY_UNTIL_CLOSE;
+}
+
+int64_t HttpParser::finishUntilClose(size_t len){
+    if(m_state != BODY_UNTIL_CLOSE){
+        return m_state == DONE ? (int64_t)m_pos : fail(INVALID_MESSAGE);
+    }
+    m_bodyEnd = len;
+    m_pos = len;
+    m_state = DONE;
+    return m_pos;
+}
+
+void HttpParser::fillHeaders(const char* data, std::vector<HttpHeader>& headers) const{
+    headers.clear();
+    for(auto& i : m_headerSpans){
+        HttpHeader header;
+        header.name = View(data, i.first);
+        header.value = View(data, i.second);
+        headers.push_back(header);
+    }
+}
+
+void HttpRequestParser::reset(){
+    HttpParser::reset();
+    m_method = HttpMethod::INVALID_METHOD;
+    m_uri = m_path = m_query = m_fragment = Span();
+}
+
+HttpParser::Error HttpRequestParser::parseStartLine(const char* data, size_t begin, size_t end){
+    std::string_view line(data + begin, end - begin);
+    size_t sp1 = line.find(' ');
+    if(sp1 == std::string_view::npos || sp1 == 0){
+        return INVALID_MESSAGE;
+    }
+    size_t sp2 = line.find(' ', sp1 + 1);
+    if(sp2 == std::string_view::npos || sp2 == sp1 + 1){
+        return INVALID_MESSAGE;
+    }
+    std::string_view method = line.substr(0, sp1);
+    for(char c : method){
+        if(!IsTokenChar(c)){
+            return INVALID_MESSAGE;
+        }
+    }
+    Error error = ParseVersion(line.substr(sp2 + 1), m_version);
+    if(error != OK){
+        return error;
+    }
+    m_method = StringToHttpMethod(method);
+    if(m_method == HttpMethod::INVALID_METHOD){
+        return UNSUPPORTED_METHOD;
+    }
+
+    // 请求目标拆分为 path?query#fragment
+    size_t uri_begin = begin + sp1 + 1;
+    size_t uri_end = begin + sp2;
+    for(size_t i = uri_begin; i < uri_end; ++i){
+        if((unsigned char)data[i] <= ' ' || data[i] == 0x7f){
+            return INVALID_MESSAGE;
+        }
+    }
+    m_uri = MakeSpan(uri_begin, uri_end);
+    std::string_view uri = View(data, m_uri);
+    size_t hash = uri.find('#');
+    size_t path_end = hash == std::string_view::npos ? uri_end : uri_begin + hash;
+    m_fragment = hash == std::string_view::npos ? MakeSpan(uri_end, uri_end) : MakeSpan(path_end + 1, uri_end);
+    size_t question = uri.substr(0, path_end - uri_begin).find('?');
+    if(question == std::string_view::npos){
+        m_path = MakeSpan(uri_begin, path_end);
+        m_query = MakeSpan(path_end, path_end);
+    }else{
+        m_path = MakeSpan(uri_begin, uri_begin + question);
+        m_query = MakeSpan(uri_begin + question + 1, path_end);
+    }
+    return OK;
+}
+
+HttpParser::Error HttpRequestParser::onHeaderComplete(){
+    // 请求的长度无法可靠确定时拒绝(RFC 7230 3.3.3)
+    if(m_hasTransferEncoding){
+        if(!m_chunked || m_hasContentLength){
+            return INVALID_MESSAGE;
+        }
+        setBodyChunked();
+    }else if(m_hasContentLength){
+        setBodyLength(m_contentLength);
+    }else{
+        setBodyNone();
+    }
+    return OK;
+}
+
+void HttpRequestParser::onMessageComplete(const char* data){
+    m_data.m_method = m_method;
+    m_data.m_version = m_version;
+    m_data.m_close = m_close;
+    m_data.m_chunked = m_chunked;
+    m_data.m_uri = View(data, m_uri);
+    m_data.m_path = View(data, m_path);
+    m_data.m_query = View(data, m_query);
+    m_data.m_fragment = View(data, m_fragment);
+    m_data.m_body = getBody(data);
+    fillHeaders(data, m_data.m_headers);
+}
+
+void HttpResponseParser::reset(){
+    HttpParser::reset();
+    m_status = 0;
+    m_reason = Span();
+}
+
+int64_t HttpResponseParser::finish(char* data, size_t len){
+    int64_t rt = finishUntilClose(len);
+    if(rt > 0){
+        onMessageComplete(data);
+    }
+    return rt;
+}
+
+HttpParser::Error HttpResponseParser::parseStartLine(const char* data, size_t begin, size_t end){
+    // HTTP/1.1 200 OK，描述可以为空
+    std::string_view line(data + begin, end - begin);
+    size_t sp = line.find(' ');
+    if(sp == std::string_view::npos){
+        return INVALID_MESSAGE;
+    }
+    Error error = ParseVersion(line.substr(0, sp), m_version);
+    if(error != OK){
+        return error;
+    }
+    std::string_view rest = line.substr(sp + 1);
+    if(rest.size() < 3 || (rest.size() > 3 && rest[3] != ' ')){
+        return INVALID_MESSAGE;
+    }
+    m_status = 0;
+    for(size_t i = 0; i < 3; ++i){
+        if(rest[i] < '0' || rest[i] > '9'){
+            return INVALID_MESSAGE;
+        }
+        m_status = m_status * 10 + (rest[i] - '0');
+    }
+    size_t reason_begin = rest.size() > 3 ? begin + sp + 5 : end;
+    m_reason = MakeSpan(reason_begin, end);
+    return OK;
+}
+
+HttpParser::Error HttpResponseParser::onHeaderComplete(){
+    if(m_headRequest || m_status / 100 == 1 || m_status == 204 || m_status == 304){
+        setBodyNone();
+    }else if(m_hasTransferEncoding){
+        // 响应中Transfer-Encoding优先于Content-Length，最后不是chunked时以关闭为结束
+        if(m_chunked){
+            setBodyChunked();
+        }else{
+            setBodyUntilClose();
+        }
+    }else if(m_hasContentLength){
+        setBodyLength(m_contentLength);
+    }else{
+        setBodyUntilClose();
+    }
+    return OK;
+}
+
+void HttpResponseParser::onMessageComplete(const char* data){
+    m_data.m_status = (HttpStatus)m_status;
+    m_data.m_version = m_version;
+    m_data.m_close = m_close;
+    m_data.m_chunked = m_chunked;
+    m_data.m_reason = View(data, m_reason);
+    m_data.m_body = getBody(data);
+    fillHeaders(data, m_data.m_headers);
+}
+
+}
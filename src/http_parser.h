@@ -0,0 +1,188 @@
+/*
+    @file http_parser.h
+    @brief 增量、零拷贝的HTTP/1.1请求和响应解析器
+*/
+
+#ifndef __CAIZI_HTTP_PARSER_H__
+#define __CAIZI_HTTP_PARSER_H__
+
+#include "http.h"
+#include <stddef.h>
+#include <stdint.h>
+
+namespace caizi{
+
+/*
+    在接收缓冲区上原地解析一个消息，结果是指向缓冲区的string_view。
+    用法：每收到一批数据，用从消息开头到已收数据末尾的整段调用execute，
+    返回0时继续接收并再次调用(缓冲区可以搬移或扩容，已解析的部分以偏移记录，不会重新扫描)，
+    返回值>0时消息完整，值是消息占用的字节数，之后的数据是下一个消息(pipelining)，
+    解析下一个消息前调用reset。
+    分块编码的数据在缓冲区中原地前移拼接，body是连续的一段；消息占用的字节中body之后的部分不再有意义。
+    同时有Transfer-Encoding和Content-Length的请求视为错误(防止请求走私)。
+*/
+class HttpParser{
+public:
+    enum Error{
+        OK = 0,
+        INVALID_MESSAGE,        // 格式错误
+        HEADER_TOO_LARGE,       // 起始行和头部超过http.parser.max_header_size
+        BODY_TOO_LARGE,         // body超过http.parser.max_body_size
+        UNSUPPORTED_METHOD,     // 不认识的方法
+        UNSUPPORTED_VERSION,    // 不是HTTP/1.0和HTTP/1.1
+    };
+
+    HttpParser();
+    virtual ~HttpParser(){}
+
+    /*
+        @param data 消息开头，分块编码的body会在其中原地改写
+        @param len 已收到的字节数
+        @return >0 消息完整，消息的字节数；0 需要更多数据；-1 出错(getError)
+    */
+    int64_t execute(char* data, size_t len);
+    // 准备解析下一个消息，保留已分配的内存
+    virtual void reset();
+
+    bool isFinished() const{ return m_state == DONE; };
+    bool hasError() const{ return m_state == ERROR; };
+    Error getError() const{ return m_error; };
+    // 头部已经解析完，正在等待body
+    bool isHeaderComplete() const{ return m_state > HEADERS && m_state != ERROR; };
+    // 请求头部有Expect: 100-continue
+    bool isExpectContinue() const{ return m_expectContinue; };
+
+    // 错误对应的响应状态码
+    static HttpStatus ErrorToStatus(Error error);
+    static uint64_t GetMaxHeaderSize();
+    static uint64_t GetMaxBodySize();
+
+protected:
+    // 相对消息开头的偏移，缓冲区搬移后仍然有效
+    struct Span{
+        uint32_t off = 0;
+        uint32_t len = 0;
+    };
+    static std::string_view View(const char* data, Span span){
+        return std::string_view(data + span.off, span.len);
+    }
+    static Span MakeSpan(size_t begin, size_t end){
+        Span span;
+        span.off = begin;
+        span.len = end - begin;
+        return span;
+    }
+
+    // 解析起始行[begin, end)，不含行尾
+    virtual Error parseStartLine(const char* data, size_t begin, size_t end) = 0;
+    // 头部结束，根据头部决定body的格式(setBody*)
+    virtual Error onHeaderComplete() = 0;
+    // 消息完整，生成指向data的结果
+    virtual void onMessageComplete(const char* data) = 0;
+
+    // 解析HTTP/1.0或HTTP/1.1
+    static Error ParseVersion(std::string_view str, uint8_t& version);
+
+    void setBodyNone();
+    void setBodyLength(uint64_t len);
+    void setBodyChunked();
+    void setBodyUntilClose();
+    // 连接关闭，以关闭为结束的body完整
+    int64_t finishUntilClose(size_t len);
+
+    std::string_view getBody(const char* data) const{
+        return std::string_view(data + m_bodyStart, m_bodyEnd - m_bodyStart);
+    }
+    void fillHeaders(const char* data, std::vector<HttpHeader>& headers) const;
+
+private:
+    enum State{
+        START_LINE,
+        HEADERS,
+        BODY,
+        CHUNK_SIZE,
+        CHUNK_DATA,
+        CHUNK_TRAILER,
+        BODY_UNTIL_CLOSE,
+        DONE,
+        ERROR,
+    };
+
+    int64_t fail(Error error);
+    Error processLine(const char* data, size_t begin, size_t end);
+    Error parseHeader(const char* data, size_t begin, size_t end);
+    Error parseChunkSize(std::string_view line);
+
+protected:
+    uint8_t m_version;
+    bool m_close;                   // 处理完后关闭连接
+    bool m_chunked;                 // Transfer-Encoding的最后一个编码是chunked
+    bool m_hasTransferEncoding;
+    bool m_hasContentLength;
+    bool m_expectContinue;
+    uint64_t m_contentLength;
+
+private:
+    State m_state;
+    Error m_error;
+    bool m_closeToken;              // Connection: close
+    bool m_keepAliveToken;          // Connection: keep-alive
+    size_t m_pos;                   // 下一个要处理的字节
+    size_t m_searchFrom;            // 查找行尾的起点，不完整的行不重复扫描
+    size_t m_bodyStart;
+    size_t m_bodyEnd;               // 分块编码时是已解码数据的末尾
+    uint64_t m_chunkSize;           // 当前块的大小
+    std::vector<std::pair<Span, Span>> m_headerSpans;
+};
+
+class HttpRequestParser : public HttpParser{
+public:
+    typedef std::shared_ptr<HttpRequestParser> ptr;
+
+    void reset() override;
+    // execute返回值>0后有效，直到缓冲区被改写
+    const HttpRequest& getData() const{ return m_data; };
+
+protected:
+    Error parseStartLine(const char* data, size_t begin, size_t end) override;
+    Error onHeaderComplete() override;
+    void onMessageComplete(const char* data) override;
+
+private:
+    HttpMethod m_method = HttpMethod::INVALID_METHOD;
+    Span m_uri;
+    Span m_path;
+    Span m_query;
+    Span m_fragment;
+    HttpRequest m_data;
+};
+
+class HttpResponseParser : public HttpParser{
+public:
+    typedef std::shared_ptr<HttpResponseParser> ptr;
+
+    void reset() override;
+    // 对HEAD请求的响应没有body，在execute之前设置
+    void setHeadRequest(bool v){ m_headRequest = v; };
+    /*
+        连接关闭时调用，没有Content-Length也不是分块编码的响应以关闭为结束
+        @return 同execute，关闭时消息还不完整返回-1
+    */
+    int64_t finish(char* data, size_t len);
+    const HttpResponseView& getData() const{ return m_data; };
+
+protected:
+    Error parseStartLine(const char* data, size_t begin, size_t end) override;
+    Error onHeaderComplete() override;
+    void onMessageComplete(const char* data) override;
+
+private:
+    bool m_headRequest = false;
+    uint32_t m_status = 0;
+    Span m_reason;
+    HttpResponseView m_data;
+};
+
+}
+
+#endif
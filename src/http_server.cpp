@@ -0,0 +1,39 @@
+#include "http_server.h"
+#include "log.h"
+
+namespace caizi{
+
+static Logger::ptr g_logger = CAIZI_GET_LOGGER("system");
+
+HttpServer::HttpServer(bool keepalive, IOManager* worker, const std::string& name)
+    :TcpServer(worker, name)
+    ,m_isKeepalive(keepalive){
+    m_dispatch.reset(new ServletDispatch);
+    m_dispatch->setDefault(Servlet::ptr(new NotFoundServlet(name)));
+}
+
+void HttpServer::handleClient(Socket::ptr client){
+    LOG_FMT_DEBUG(g_logger, "handleClient %s\n", client->toString().c_str());
+    HttpSession::ptr session(new HttpSession(client, getName()));
+    // 同一连接上的响应重复使用，头部和body的内存在请求之间保留
+    HttpResponse rsp;
+    while(true){
+        const HttpRequest* req = session->recvRequest();
+        if(!req){
+            if(session->getError() != HttpParser::OK){
+                rsp.reset(0x11, true);
+                rsp.setStatus(HttpParser::ErrorToStatus(session->getError()));
+                session->sendResponse(rsp);
+            }
+            break;
+        }
+        rsp.reset(req->getVersion(), req->isClose() || !m_isKeepalive);
+        m_dispatch->handle(*req, rsp, session);
+        if(session->sendResponse(rsp, req->getMethod() != HttpMethod::HEAD) <= 0 || rsp.isClose()){
+            break;
+        }
+    }
+    session->close();
+}
+
+}
@@ -0,0 +1,42 @@
+/*
+    @file http_server.h
+    @brief HTTP服务器
+*/
+
+#ifndef __CAIZI_HTTP_SERVER_H__
+#define __CAIZI_HTTP_SERVER_H__
+
+#include "http_session.h"
+#include "servlet.h"
+#include "tcp_server.h"
+
+namespace caizi{
+
+/*
+    在TcpServer上处理HTTP/1.1，每个连接在接受它的工作线程上顺序处理请求：
+    解析、按路径分发给servlet、发送响应，keep-alive时继续处理同一连接上的下一个请求。
+    请求错误时回复对应的状态码并关闭连接。
+*/
+class HttpServer : public TcpServer{
+public:
+    typedef std::shared_ptr<HttpServer> ptr;
+
+    // @param keepalive 是否支持长连接，为false时每个响应后关闭连接
+    HttpServer(bool keepalive = false, IOManager* worker = IOManager::GetThis(),
+               const std::string& name = "caizi/1.0.0");
+
+    ServletDispatch::ptr getServletDispatch() const{ return m_dispatch; };
+    void setServletDispatch(ServletDispatch::ptr v){ m_dispatch = v; };
+    bool isKeepalive() const{ return m_isKeepalive; };
+
+protected:
+    void handleClient(Socket::ptr client) override;
+
+private:
+    bool m_isKeepalive;
+    ServletDispatch::ptr m_dispatch;
+};
+
+}
+
+#endif
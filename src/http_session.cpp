@@ -0,0 +1,112 @@
+#include "http_session.h"
+#include "config.h"
+#include "log.h"
+#include <atomic>
+#include <string.h>
+
+namespace caizi{
+
+static Logger::ptr g_logger = CAIZI_GET_LOGGER("system");
+
+static ConfigVar<uint64_t>::ptr g_http_session_buffer_size =
+    Config::Lookup<uint64_t>("http.session.buffer_size", 4 * 1024, "initial receive buffer size of http session");
+
+static std::atomic<uint64_t> s_http_session_buffer_size{g_http_session_buffer_size->getValue()};
+
+struct HttpSessionConfigIniter{
+    HttpSessionConfigIniter(){
+        g_http_session_buffer_size->addListener([](const uint64_t& old_value, const uint64_t& new_value){
+            s_http_session_buffer_size.store(new_value, std::memory_order_relaxed);
+        });
+    }
+};
+static HttpSessionConfigIniter __http_session_config_init;
+
+HttpSession::HttpSession(Socket::ptr sock, const std::string& server)
+    :m_socket(sock)
+    ,m_writer(server)
+    ,m_error(HttpParser::OK)
+    ,m_begin(0)
+    ,m_end(0)
+    ,m_consumed(0)
+    ,m_sentContinue(false){
+    m_buffer.resize(std::max<uint64_t>(s_http_session_buffer_size.load(std::memory_order_relaxed), 64));
+}
+
+HttpSession::~HttpSession(){
+}
+
+const HttpRequest* HttpSession::recvRequest(){
+    // 丢弃上一个请求
+    m_begin += m_consumed;
+    m_consumed = 0;
+    if(m_begin == m_end){
+        m_begin = m_end = 0;
+    }
+    m_parser.reset();
+    m_sentContinue = false;
+    while(true){
+        if(m_end > m_begin){
+            int64_t rt = m_parser.execute(&m_buffer[m_begin], m_end - m_begin);
+            if(rt > 0){
+                m_consumed = rt;
+                return &m_parser.getData();
+            }
+            if(rt < 0){
+                m_error = m_parser.getError();
+                LOG_FMT_DEBUG(g_logger, "http parse error=%d %s\n", (int)m_error,
+                              m_socket->toString().c_str());
+                return nullptr;
+            }
+            // 客户端等待100 Continue后才发送body
+            if(m_parser.isHeaderComplete() && m_parser.isExpectContinue() && !m_sentContinue){
+                static const char s_continue[] = "HTTP/1.1 100 Continue\r\n\r\n";
+                if(sendAll(s_continue, sizeof(s_continue) - 1) <= 0){
+                    return nullptr;
+                }
+                m_sentContinue = true;
+            }
+        }
+        if(m_end == m_buffer.size()){
+            if(m_begin > 0){
+                memmove(&m_buffer[0], &m_buffer[m_begin], m_end - m_begin);
+                m_end -= m_begin;
+                m_begin = 0;
+            }else{
+                uint64_t limit = HttpParser::GetMaxHeaderSize() + HttpParser::GetMaxBodySize();
+                if(m_buffer.size() >= limit){
+                    m_error = HttpParser::BODY_TOO_LARGE;
+                    return nullptr;
+                }
+                m_buffer.resize(std::min<uint64_t>(m_buffer.size() * 2, limit));
+            }
+        }
+        int n = m_socket->recv(&m_buffer[m_end], m_buffer.size() - m_end);
+        if(n <= 0){
+            return nullptr;
+        }
+        m_end += n;
+    }
+}
+
+int HttpSession::sendAll(const void* buf, size_t len){
+    size_t offset = 0;
+    while(offset < len){
+        int n = m_socket->send((const char*)buf + offset, len - offset);
+        if(n <= 0){
+            return n;
+        }
+        offset += n;
+    }
+    return len;
+}
+
+int64_t HttpSession::sendResponse(const HttpResponse& rsp, bool with_body){
+    return m_writer.send(m_socket, rsp, with_body);
+}
+
+void HttpSession::close(){
+    m_socket->close();
+}
+
+}
@@ -0,0 +1,63 @@
+/*
+    @file http_session.h
+    @brief 服务器端的HTTP连接
+*/
+
+#ifndef __CAIZI_HTTP_SESSION_H__
+#define __CAIZI_HTTP_SESSION_H__
+
+#include "http.h"
+#include "http_parser.h"
+#include "http_writer.h"
+#include "socket.h"
+#include <memory>
+#include <vector>
+
+namespace caizi{
+
+/*
+    一个连接上的请求接收和响应发送
+    接收缓冲区属于连接，请求就地解析；缓冲区中剩下的数据是后续的请求(pipelining)，
+    在下一次recvRequest时先解析它们，不完整时再接收。
+    缓冲区初始大小为http.session.buffer_size，放不下一个请求时先把未处理的数据搬到开头，
+    仍放不下再成倍扩大，最多到头部和body的上限之和。
+    响应由连接的HttpResponseWriter用writev发送，文件body用sendfile发送。
+*/
+class HttpSession{
+public:
+    typedef std::shared_ptr<HttpSession> ptr;
+
+    // @param server 响应的Server头部，为空时不发送
+    HttpSession(Socket::ptr sock, const std::string& server = "");
+    ~HttpSession();
+
+    /*
+        接收下一个请求，返回的请求在下次调用recvRequest之前有效
+        @return 连接关闭、超时或请求错误时返回nullptr，请求错误时getError不为OK
+    */
+    const HttpRequest* recvRequest();
+    HttpParser::Error getError() const{ return m_error; };
+
+    // 发送完整的响应，@return 成功返回发送的字节数，失败返回<=0
+    int64_t sendResponse(const HttpResponse& rsp, bool with_body = true);
+    // 发送全部数据，@return 成功返回len，失败返回<=0
+    int sendAll(const void* buf, size_t len);
+
+    Socket::ptr getSocket() const{ return m_socket; };
+    void close();
+
+private:
+    Socket::ptr m_socket;
+    HttpRequestParser m_parser;
+    HttpResponseWriter m_writer;
+    HttpParser::Error m_error;
+    std::vector<char> m_buffer;
+    size_t m_begin;             // 当前请求的开头
+    size_t m_end;               // 已接收数据的末尾
+    size_t m_consumed;          // 当前请求占用的字节数，下次recvRequest时丢弃
+    bool m_sentContinue;        // 已经回复了100 Continue
+};
+
+}
+
+#endif
@@ -0,0 +1,231 @@
+#include "http_writer.h"
+#include "clock.h"
+#include "log.h"
+#include <string.h>
+#include <time.h>
+
+namespace caizi{
+
+static Logger::ptr g_logger = CAIZI_GET_LOGGER("system");
+
+static const std::string_view s_connection_close = "connection: close\r\n";
+static const std::string_view s_connection_keepalive = "connection: keep-alive\r\n";
+
+// 状态码100~599在两个版本下的状态行
+struct StatusLineTable{
+    std::string lines[2][500];
+
+    StatusLineTable(){
+        for(int v = 0; v < 2; ++v){
+            for(int code = 100; code < 600; ++code){
+                lines[v][code - 100] = std::string("HTTP/1.") + (char)('0' + v) + " " + std::to_string(code)
+                                     + " " + HttpStatusToString((HttpStatus)code) + "\r\n";
+            }
+        }
+    }
+};
+
+// 扩展名、MIME类型和预先序列化的头部行
+struct MimeEntry{
+    const char* ext;
+    const char* mime;
+    std::string line;
+};
+
+struct MimeTable{
+    std::vector<MimeEntry> entries;
+
+    MimeTable(){
+        static const char* s_types[][2] = {
+            {"html", "text/html; charset=utf-8"},
+            {"htm", "text/html; charset=utf-8"},
+            {"txt", "text/plain; charset=utf-8"},
+            {"css", "text/css"},
+            {"js", "application/javascript"},
+            {"json", "application/json"},
+            {"xml", "application/xml"},
+            {"png", "image/png"},
+            {"jpg", "image/jpeg"},
+            {"jpeg", "image/jpeg"},
+            {"gif", "image/gif"},
+            {"svg", "image/svg+xml"},
+            {"ico", "image/x-icon"},
+            {"webp", "image/webp"},
+            {"woff2", "font/woff2"},
+            {"wasm", "application/wasm"},
+            {"pdf", "application/pdf"},
+            {"mp4", "video/mp4"},
+            {"", "application/octet-stream"},
+            // 没有扩展名对应的常见类型
+            {nullptr, "text/html"},
+            {nullptr, "text/plain"},
+        };
+        for(auto& t : s_types){
+            entries.push_back(MimeEntry{t[0], t[1], std::string("content-type: ") + t[1] + "\r\n"});
+        }
+    }
+};
+
+static const StatusLineTable& GetStatusLineTable(){
+    static StatusLineTable s_table;
+    return s_table;
+}
+
+static const MimeTable& GetMimeTable(){
+    static MimeTable s_table;
+    return s_table;
+}
+
+// 写入十进制数，@return 写入的字节数
+static size_t FormatUint(uint64_t v, char* out){
+    char tmp[24];
+    size_t n = 0;
+    do{
+        tmp[n++] = '0' + v % 10;
+        v /= 10;
+    }while(v);
+    for(size_t i = 0; i < n; ++i){
+        out[i] = tmp[n - 1 - i];
+    }
+    return n;
+}
+
+struct DateLineCache{
+    uint64_t second = ~0ull;
+    size_t len = 0;
+    char line[64];
+};
+static thread_local DateLineCache t_date_line;
+
+std::string_view HttpResponseWriter::DateLine(){
+    DateLineCache& cache = t_date_line;
+    uint64_t second = CoarseClock::NowMS() / 1000;
+    if(second != cache.second){
+        time_t t = second;
+        struct tm tm;
+        gmtime_r(&t, &tm);
+        cache.len = strftime(cache.line, sizeof(cache.line), "date: %a, %d %b %Y %H:%M:%S GMT\r\n", &tm);
+        cache.second = second;
+    }
+    return std::string_view(cache.line, cache.len);
+}
+
+std::string_view HttpResponseWriter::StatusLine(HttpStatus status, uint8_t version){
+    int code = (int)status;
+    if(code < 100 || code >= 600){
+        code = 500;
+    }
+    return GetStatusLineTable().lines[version == 0x10 ? 0 : 1][code - 100];
+}
+
+std::string_view HttpResponseWriter::ContentTypeLine(std::string_view mime){
+    for(auto& entry : GetMimeTable().entries){
+        if(mime == entry.mime){
+            return entry.line;
+        }
+    }
+    return std::string_view();
+}
+
+std::string_view HttpResponseWriter::MimeTypeByPath(std::string_view path){
+    size_t slash = path.rfind('/');
+    size_t dot = path.rfind('.');
+    std::string_view ext;
+    if(dot != std::string_view::npos && (slash == std::string_view::npos || dot > slash)){
+        ext = path.substr(dot + 1);
+    }
+    for(auto& entry : GetMimeTable().entries){
+        if(entry.ext && EqualsIgnoreCase(ext, entry.ext)){
+            return entry.mime;
+        }
+    }
+    return "application/octet-stream";
+}
+
+HttpResponseWriter::HttpResponseWriter(const std::string& server)
+    :m_count(0){
+    if(!server.empty()){
+        m_serverLine = "server: " + server + "\r\n";
+    }
+}
+
+void HttpResponseWriter::add(std::string_view data){
+    if(!data.empty()){
+        m_iov[m_count].iov_base = (void*)data.data();
+        m_iov[m_count].iov_len = data.size();
+        ++m_count;
+    }
+}
+
+size_t HttpResponseWriter::build(const HttpResponse& rsp, bool with_body){
+    m_count = 0;
+    if(rsp.getReason().empty()){
+        add(StatusLine(rsp.getStatus(), rsp.getVersion()));
+    }else{
+        int n = snprintf(m_statusLine, sizeof(m_statusLine), "HTTP/1.%d %d %s\r\n",
+                         rsp.getVersion() == 0x10 ? 0 : 1, (int)rsp.getStatus(), rsp.getReason().c_str());
+        // 描述太长时截断，保留行尾
+        if(n >= (int)sizeof(m_statusLine)){
+            n = sizeof(m_statusLine) - 1;
+            m_statusLine[n - 2] = '\r';
+            m_statusLine[n - 1] = '\n';
+        }
+        add(std::string_view(m_statusLine, n));
+    }
+    add(m_serverLine);
+    std::string_view date = DateLine();
+    memcpy(m_dateLine, date.data(), date.size());
+    add(std::string_view(m_dateLine, date.size()));
+    add(rsp.getContentTypeLine());
+    add(rsp.getHeaderBlock());
+    add(rsp.isClose() ? s_connection_close : s_connection_keepalive);
+
+    static const char s_length[] = "content-length: ";
+    size_t n = sizeof(s_length) - 1;
+    memcpy(m_lengthLine, s_length, n);
+    n += FormatUint(rsp.getContentLength(), m_lengthLine + n);
+    memcpy(m_lengthLine + n, "\r\n\r\n", 4);
+    add(std::string_view(m_lengthLine, n + 4));
+
+    if(with_body && !rsp.hasFile()){
+        add(rsp.getBody());
+    }
+    return m_count;
+}
+
+int64_t HttpResponseWriter::send(Socket::ptr sock, const HttpResponse& rsp, bool with_body){
+    build(rsp, with_body);
+    iovec* iov = m_iov;
+    size_t count = m_count;
+    int64_t total = 0;
+    while(count){
+        int n = sock->send(iov, count);
+        if(n <= 0){
+            return n;
+        }
+        total += n;
+        // 跳过已经发送的部分
+        size_t sent = n;
+        while(count && sent >= iov->iov_len){
+            sent -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if(count){
+            iov->iov_base = (char*)iov->iov_base + sent;
+            iov->iov_len -= sent;
+        }
+    }
+    if(with_body && rsp.hasFile() && rsp.getContentLength()){
+        int64_t n = sock->sendFile(rsp.getFileFd(), rsp.getFileOffset(), rsp.getContentLength());
+        if(n != (int64_t)rsp.getContentLength()){
+            LOG_FMT_DEBUG(g_logger, "sendFile fd=%d sent=%lld len=%zu\n", rsp.getFileFd(),
+                          (long long)n, rsp.getContentLength());
+            return -1;
+        }
+        total += n;
+    }
+    return total;
+}
+
+}
@@ -0,0 +1,73 @@
+/*
+    @file http_writer.h
+    @brief HTTP响应的序列化和发送
+*/
+
+#ifndef __CAIZI_HTTP_WRITER_H__
+#define __CAIZI_HTTP_WRITER_H__
+
+#include "http.h"
+#include "socket.h"
+#include <string>
+#include <string_view>
+#include <sys/uio.h>
+
+namespace caizi{
+
+/*
+    把HttpResponse整理成iovec，用一次writev发送头部和body，文件body再用sendfile发送。
+    iovec只引用预先序列化的片段和响应中的数据，不拼接、不分配内存：
+        状态行      所有状态码的"HTTP/1.x code reason\r\n"在第一次使用时生成
+        Server      构造时序列化
+        Date        每个线程缓存，每秒格式化一次
+        Content-Type 常见类型的头部行预先序列化
+        Connection、Content-Length 常量或写入对象内的小缓冲区
+    一个连接使用一个writer，不能在多个协程中同时使用。
+*/
+class HttpResponseWriter{
+public:
+    // @param server Server头部的值，为空时不发送Server
+    HttpResponseWriter(const std::string& server = "");
+
+    /*
+        整理响应的iovec，结果在下一次build之前有效
+        @param with_body 为false时不包括body(HEAD请求)
+        @return iovec的个数
+    */
+    size_t build(const HttpResponse& rsp, bool with_body = true);
+    const iovec* getIovecs() const{ return m_iov; };
+    size_t getIovecCount() const{ return m_count; };
+
+    /*
+        发送完整的响应，部分发送时继续发送剩余的部分
+        @return 成功返回发送的总字节数，失败返回<=0
+    */
+    int64_t send(Socket::ptr sock, const HttpResponse& rsp, bool with_body = true);
+
+    // "date: ...\r\n"，同一线程同一秒内返回同一个缓存的字符串
+    static std::string_view DateLine();
+    // 预先序列化的状态行，rsp没有自定义描述时使用
+    static std::string_view StatusLine(HttpStatus status, uint8_t version);
+    // 常见类型的"content-type: ...\r\n"，其它类型返回空
+    static std::string_view ContentTypeLine(std::string_view mime);
+    // 按扩展名取得MIME类型，不认识的返回application/octet-stream
+    static std::string_view MimeTypeByPath(std::string_view path);
+
+private:
+    // 最多：状态行、Server、Date、Content-Type、其它头部、Connection、Content-Length、body
+    static const size_t kMaxIovecs = 8;
+
+    void add(std::string_view data);
+
+private:
+    std::string m_serverLine;
+    iovec m_iov[kMaxIovecs];
+    size_t m_count;
+    char m_statusLine[128];         // 自定义描述的状态行
+    char m_dateLine[64];            // 从线程缓存拷贝，发送时让出协程也不会被其它响应改写
+    char m_lengthLine[48];          // "content-length: N\r\n\r\n"
+};
+
+}
+
+#endif
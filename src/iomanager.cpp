@@ -0,0 +1,816 @@
+#include "iomanager.h"
+#include "config.h"
+#include "hook.h"
+#include "log.h"
+#include "macro.h"
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdexcept>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+
+namespace caizi{
+
+static Logger::ptr g_logger = CAIZI_GET_LOGGER("system");
+
+static_assert((int)IOManager::READ == (int)EPOLLIN, "IOManager::READ must equal EPOLLIN");
+static_assert((int)IOManager::WRITE == (int)EPOLLOUT, "IOManager::WRITE must equal EPOLLOUT");
+
+static ConfigVar<std::string>::ptr g_iomanager_backend =
+    Config::Lookup<std::string>("iomanager.backend", "epoll", "io backend: epoll or io_uring");
+static ConfigVar<uint32_t>::ptr g_uring_entries =
+    Config::Lookup<uint32_t>("iomanager.uring_entries", 256, "io_uring submission queue entries per worker");
+/*
+    固定文件省去每个请求引用fd的开销，但ring持有文件的引用直到注销，
+    fd必须经过IOManager::closeFd(或hook的close)关闭，否则fd号复用后请求会发往旧文件
+*/
+static ConfigVar<bool>::ptr g_uring_fixed_files =
+    Config::Lookup<bool>("iomanager.uring_fixed_files", false, "register fds as io_uring fixed files");
+
+// ring上epfd的poll请求的user_data，track分配的user_data高32位不为0，不会冲突
+static const uint64_t EPOLL_USER_DATA = 1;
+// 不需要处理完成事件的请求(取消请求)
+static const uint64_t IGNORE_USER_DATA = 0;
+// 空闲时等待的最长时间，防止极端情况下错过唤醒
+static const int MAX_TIMEOUT = 3000;
+static const int MAX_EVENTS = 256;
+
+IOManager::FdContext::EventContext& IOManager::FdContext::getContext(Event event){
+    switch(event){
+        case READ:
+            return read;
+        case WRITE:
+            return write;
+        default:
+            CAIZI_ASSERT2(false, "getContext");
+    }
+    throw std::invalid_argument("getContext invalid event");
+}
+
+void IOManager::FdContext::resetContext(EventContext& ctx){
+    ctx.scheduler = nullptr;
+    ctx.fiber.reset();
+    ctx.cb = nullptr;
+    ctx.result = nullptr;
+}
+
+IOManager::IOManager(size_t threads, bool use_caller, const std::string& name):
+    Scheduler(threads, use_caller, name){
+    for(auto& chunk : m_fdChunks){
+        chunk.store(nullptr, std::memory_order_relaxed);
+    }
+    m_pollers.resize(getWorkerCount());
+    for(auto& poller : m_pollers){
+        poller.epfd = epoll_create1(EPOLL_CLOEXEC);
+        CAIZI_ASSERT2(poller.epfd >= 0, "epoll_create1 errno=" + std::to_string(errno));
+        poller.eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        CAIZI_ASSERT2(poller.eventfd >= 0, "eventfd errno=" + std::to_string(errno));
+        epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN | EPOLLET;
+        event.data.ptr = nullptr;           // data.ptr为空表示唤醒用的eventfd
+        int rt = epoll_ctl(poller.epfd, EPOLL_CTL_ADD, poller.eventfd, &event);
+        CAIZI_ASSERT2(!rt, "epoll_ctl eventfd errno=" + std::to_string(errno));
+    }
+    std::string backend = g_iomanager_backend->getValue();
+    if(backend == "io_uring"){
+        m_backend = IO_URING;
+        for(auto& poller : m_pollers){
+            poller.uring.reset(new Uring);
+            int rt = poller.uring->init(g_uring_entries->getValue());
+            if(rt){
+                LOG_FMT_WARN(g_logger, "IOManager %s io_uring不可用(%s)，使用epoll\n", m_name.c_str(), strerror(rt));
+                m_backend = EPOLL;
+                break;
+            }
+        }
+        if(m_backend == IO_URING && g_uring_fixed_files->getValue() && getWorkerCount() <= 64){
+            // 固定文件槽直接用fd作为下标
+            rlimit limit;
+            unsigned count = 65536;
+            if(!getrlimit(RLIMIT_NOFILE, &limit) && limit.rlim_cur < count){
+                count = limit.rlim_cur;
+            }
+            m_fixedFiles = true;
+            for(auto& poller : m_pollers){
+                if(poller.uring->registerFiles(count)){
+                    m_fixedFiles = false;
+                }
+            }
+        }
+        if(m_backend == EPOLL){
+            for(auto& poller : m_pollers){
+                poller.uring.reset();
+            }
+        }
+    }else if(backend != "epoll"){
+        LOG_FMT_WARN(g_logger, "未知的iomanager.backend: %s，使用epoll\n", backend.c_str());
+    }
+    start();
+}
+
+IOManager::~IOManager(){
+    stop();
+    for(auto& poller : m_pollers){
+        close(poller.epfd);
+        close(poller.eventfd);
+    }
+    for(auto& chunk : m_fdChunks){
+        delete[] chunk.load(std::memory_order_relaxed);
+    }
+}
+
+IOManager* IOManager::GetThis(){
+    return dynamic_cast<IOManager*>(Scheduler::GetThis());
+}
+
+IOManager::FdContext* IOManager::getFdContext(int fd, bool create){
+    if(fd < 0 || (size_t)fd >= FD_CHUNK_SIZE * FD_MAX_CHUNKS){
+        return nullptr;
+    }
+    std::atomic<FdContext*>& slot = m_fdChunks[fd >> FD_CHUNK_BITS];
+    FdContext* chunk = slot.load(std::memory_order_acquire);
+    if(!chunk){
+        if(!create){
+            return nullptr;
+        }
+        FdContext* fresh = new FdContext[FD_CHUNK_SIZE];
+        size_t base = (size_t)fd & ~(FD_CHUNK_SIZE - 1);
+        for(size_t i = 0; i < FD_CHUNK_SIZE; ++i){
+            fresh[i].fd = base + i;
+        }
+        // 多个线程同时分配同一块时只保留一个
+        if(slot.compare_exchange_strong(chunk, fresh, std::memory_order_acq_rel)){
+            chunk = fresh;
+        }else{
+            delete[] fresh;
+        }
+    }
+    return &chunk[fd & (FD_CHUNK_SIZE - 1)];
+}
+
+bool IOManager::updateEpoll(FdContext* ctx, int events){
+    CAIZI_ASSERT(ctx->worker >= 0);
+    int epfd = m_pollers[ctx->worker].epfd;
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLET | events;
+    event.data.ptr = ctx;
+    int op = events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
+    if(epoll_ctl(epfd, op, ctx->fd, &event)){
+        LOG_FMT_ERROR(g_logger, "epoll_ctl(%d, %d, %d, %u) errno=%d %s\n",
+                      epfd, op, ctx->fd, event.events, errno, strerror(errno));
+        if(op == EPOLL_CTL_MOD){
+            return false;
+        }
+    }
+    if(!events){
+        ctx->worker = -1;
+    }
+    return true;
+}
+
+int IOManager::addEvent(int fd, Event event, std::function<void()> cb){
+    return addEventInternal(fd, event, std::move(cb), nullptr);
+}
+
+int IOManager::addEventInternal(int fd, Event event, std::function<void()> cb, int* result, uint64_t* seq){
+    FdContext* ctx = getFdContext(fd, true);
+    if(!ctx){
+        LOG_FMT_ERROR(g_logger, "IOManager::addEvent fd=%d 超出范围\n", fd);
+        errno = EBADF;
+        return -1;
+    }
+    ScopeLock lock(&ctx->mutex);
+    if(ctx->events & event){
+        LOG_FMT_ERROR(g_logger, "IOManager::addEvent fd=%d event=%d 重复登记 events=%d\n",
+                      fd, (int)event, ctx->events);
+        errno = EEXIST;
+        return -1;
+    }
+    int op = EPOLL_CTL_MOD;
+    if(ctx->worker < 0){
+        // 在当前工作线程上登记，就绪后的协程留在本线程执行
+        int worker = Scheduler::GetThis() == this ? GetWorkerIndex() : -1;
+        ctx->worker = worker >= 0 ? worker : nextWorker();
+        op = EPOLL_CTL_ADD;
+    }
+    epoll_event epevent;
+    memset(&epevent, 0, sizeof(epevent));
+    epevent.events = EPOLLET | ctx->events | event;
+    epevent.data.ptr = ctx;
+    if(epoll_ctl(m_pollers[ctx->worker].epfd, op, fd, &epevent)){
+        LOG_FMT_ERROR(g_logger, "epoll_ctl(%d, %d, %d, %u) errno=%d %s\n",
+                      m_pollers[ctx->worker].epfd, op, fd, epevent.events, errno, strerror(errno));
+        if(op == EPOLL_CTL_ADD){
+            ctx->worker = -1;
+        }
+        return -1;
+    }
+    ++m_pendingEventCount;
+    ctx->events |= event;
+    FdContext::EventContext& event_ctx = ctx->getContext(event);
+    CAIZI_ASSERT(!event_ctx.scheduler && !event_ctx.fiber && !event_ctx.cb);
+    event_ctx.scheduler = Scheduler::GetThis() ? Scheduler::GetThis() : this;
+    event_ctx.result = result;
+    event_ctx.seq = ++ctx->seq;
+    if(seq){
+        *seq = event_ctx.seq;
+    }
+    if(cb){
+        event_ctx.cb.swap(cb);
+    }else{
+        event_ctx.fiber = Fiber::GetThis();
+        CAIZI_ASSERT2(event_ctx.fiber->getcurrentState() == Fiber::EXEC,
+                      "state=" + std::to_string(event_ctx.fiber->getcurrentState()));
+    }
+    return 0;
+}
+
+int IOManager::waitEvent(int fd, Event event, uint64_t timeout_ms){
+    int result = 0;
+    uint64_t seq = 0;
+    if(addEventInternal(fd, event, nullptr, &result, &seq)){
+        return -1;
+    }
+    /*
+        登记之后再加定时器，超时时以ETIMEDOUT取消事件；协程返回后条件失效，迟到的定时器不再生效。
+        条件检查和取消之间协程可能已经返回并在同一fd上重新等待，按序号取消不会误伤新的等待
+    */
+    Timer::ptr timer;
+    std::shared_ptr<int> cond;
+    if(timeout_ms != ~0ull){
+        cond = std::make_shared<int>(0);
+        timer = addConditionTimer(timeout_ms, [this, fd, event, seq](){
+            cancelWait(fd, event, seq, ETIMEDOUT);
+        }, cond);
+    }
+    Fiber::YieldToHole();
+    if(timer){
+        timer->cancel();
+    }
+    return result;
+}
+
+bool IOManager::delEvent(int fd, Event event){
+    FdContext* ctx = getFdContext(fd, false);
+    if(!ctx){
+        return false;
+    }
+    ScopeLock lock(&ctx->mutex);
+    if(!(ctx->events & event)){
+        return false;
+    }
+    if(!updateEpoll(ctx, ctx->events & ~event)){
+        return false;
+    }
+    --m_pendingEventCount;
+    ctx->events &= ~event;
+    ctx->resetContext(ctx->getContext(event));
+    return true;
+}
+
+bool IOManager::cancelEvent(int fd, Event event, int error){
+    FdContext* ctx = getFdContext(fd, false);
+    if(!ctx){
+        return false;
+    }
+    ScopeLock lock(&ctx->mutex);
+    bool cancelled = cancelUring(ctx, event, error);
+    if(!(ctx->events & event)){
+        return cancelled;
+    }
+    if(!updateEpoll(ctx, ctx->events & ~event)){
+        return false;
+    }
+    triggerEvent(ctx, event, error);
+    return true;
+}
+
+bool IOManager::cancelWait(int fd, Event event, uint64_t seq, int error){
+    FdContext* ctx = getFdContext(fd, false);
+    if(!ctx){
+        return false;
+    }
+    ScopeLock lock(&ctx->mutex);
+    if(!(ctx->events & event) || ctx->getContext(event).seq != seq){
+        return false;
+    }
+    if(!updateEpoll(ctx, ctx->events & ~event)){
+        return false;
+    }
+    triggerEvent(ctx, event, error);
+    return true;
+}
+
+bool IOManager::cancelAll(int fd, int error){
+    FdContext* ctx = getFdContext(fd, false);
+    if(!ctx){
+        return false;
+    }
+    ScopeLock lock(&ctx->mutex);
+    bool cancelled = cancelUring(ctx, READ, error);
+    cancelled = cancelUring(ctx, WRITE, error) || cancelled;
+    if(!ctx->events){
+        return cancelled;
+    }
+    if(!updateEpoll(ctx, NONE)){
+        return false;
+    }
+    if(ctx->events & READ){
+        triggerEvent(ctx, READ, error);
+    }
+    if(ctx->events & WRITE){
+        triggerEvent(ctx, WRITE, error);
+    }
+    CAIZI_ASSERT(ctx->events == NONE);
+    return true;
+}
+
+void IOManager::triggerEvent(FdContext* ctx, Event event, int result){
+    CAIZI_ASSERT(ctx->events & event);
+    ctx->events &= ~event;
+    FdContext::EventContext& event_ctx = ctx->getContext(event);
+    // 等待的协程还没有恢复，它栈上的result仍然有效
+    if(event_ctx.result){
+        *event_ctx.result = result;
+    }
+    if(event_ctx.cb){
+        event_ctx.scheduler->schedule(std::move(event_ctx.cb));
+    }else{
+        event_ctx.scheduler->schedule(std::move(event_ctx.fiber));
+    }
+    ctx->resetContext(event_ctx);
+    --m_pendingEventCount;
+}
+
+void IOManager::tickle(size_t worker){
+    uint64_t one = 1;
+    ssize_t rt = write_f(m_pollers[worker].eventfd, &one, sizeof(one));
+    if(rt != sizeof(one) && errno != EAGAIN){
+        LOG_FMT_ERROR(g_logger, "IOManager::tickle write eventfd errno=%d\n", errno);
+    }
+}
+
+bool IOManager::stopping(){
+    return m_pendingEventCount == 0 && !hasTimer() && Scheduler::stopping();
+}
+
+void IOManager::onTimerInsertedAtFront(){
+    // 空闲线程按旧的超时等待，唤醒一个重新计算
+    tickleIdle();
+}
+
+void IOManager::processTimers(){
+    std::vector<std::function<void()>> cbs;
+    listExpiredCb(cbs);
+    if(!cbs.empty()){
+        schedule(cbs.begin(), cbs.end());
+    }
+}
+
+void IOManager::processEvents(Poller& poller, epoll_event* events, int count){
+    for(int i = 0; i < count; ++i){
+        epoll_event& event = events[i];
+        if(!event.data.ptr){
+            uint64_t value;
+            while(read_f(poller.eventfd, &value, sizeof(value)) > 0){
+            }
+            continue;
+        }
+        FdContext* ctx = (FdContext*)event.data.ptr;
+        ScopeLock lock(&ctx->mutex);
+        // 出错或挂断时唤醒所有等待者，由它们在读写时得到具体的错误
+        if(event.events & (EPOLLERR | EPOLLHUP)){
+            event.events |= (EPOLLIN | EPOLLOUT) & ctx->events;
+        }
+        int real_events = event.events & (READ | WRITE) & ctx->events;
+        if(real_events == NONE){
+            continue;
+        }
+        if(!updateEpoll(ctx, ctx->events & ~real_events)){
+            continue;
+        }
+        if(real_events & READ){
+            triggerEvent(ctx, READ, 0);
+        }
+        if(real_events & WRITE){
+            triggerEvent(ctx, WRITE, 0);
+        }
+    }
+}
+
+void IOManager::idle(){
+    Poller& poller = m_pollers[GetWorkerIndex()];
+    std::unique_ptr<epoll_event[]> events(new epoll_event[MAX_EVENTS]);
+    while(!stopping()){
+        int timeout = (int)std::min(getNextTimer(), (uint64_t)MAX_TIMEOUT);
+        if(poller.uring){
+            // epfd可读时ring上的poll请求完成，一次io_uring_enter同时提交请求并等待
+            if(!poller.epoll_armed){
+                io_uring_sqe* sqe = poller.uring->getSqe();
+                if(sqe){
+                    sqe->opcode = IORING_OP_POLL_ADD;
+                    sqe->fd = poller.epfd;
+                    sqe->poll32_events = POLLIN;
+                    sqe->user_data = EPOLL_USER_DATA;
+                    poller.epoll_armed = true;
+                }
+            }
+            poller.uring->enter(1, timeout);
+            reapUring(poller);
+        }else{
+            int rt = 0;
+            do{
+                rt = epoll_wait(poller.epfd, events.get(), MAX_EVENTS, timeout);
+            }while(rt < 0 && errno == EINTR);
+            processEvents(poller, events.get(), rt);
+        }
+        processTimers();
+        // 回到调度循环执行就绪的协程
+        Fiber::YieldToHole();
+    }
+}
+
+void IOManager::flush(){
+    // 繁忙时不进入idle，在这里处理到期的定时器
+    if(hasExpiredTimer()){
+        processTimers();
+    }
+    int index = GetWorkerIndex();
+    if(index < 0 || !m_pollers[index].uring){
+        return;
+    }
+    Poller& poller = m_pollers[index];
+    if(poller.uring->pending()){
+        poller.uring->enter(0);
+    }
+    reapUring(poller);
+}
+
+void IOManager::reapUring(Poller& poller){
+    bool epoll_ready = false;
+    poller.uring->reap([&](io_uring_cqe& cqe){
+        if(cqe.user_data == EPOLL_USER_DATA){
+            poller.epoll_armed = false;
+            epoll_ready = true;
+            return;
+        }
+        if(cqe.user_data == IGNORE_USER_DATA){
+            return;
+        }
+        UringRequest* req = (UringRequest*)poller.uring->complete(cqe.user_data);
+        if(!req){
+            return;
+        }
+        req->result = cqe.res;
+        // 调度之后协程可能立即在其他线程恢复并销毁req，先取出协程
+        Fiber::ptr fiber = std::move(req->fiber);
+        --m_pendingEventCount;
+        schedule(std::move(fiber));
+    });
+    if(epoll_ready){
+        epoll_event events[MAX_EVENTS];
+        int rt = epoll_wait(poller.epfd, events, MAX_EVENTS, 0);
+        processEvents(poller, events, rt);
+    }
+}
+
+bool IOManager::inTaskFiber() const{
+    if(Scheduler::GetThis() != this || GetWorkerIndex() < 0){
+        return false;
+    }
+    Fiber* main_fiber = Scheduler::GetMainFiber();
+    return main_fiber && Fiber::GetFiberID() != main_fiber->getId();
+}
+
+int IOManager::uringIO(int fd, Event event, uint8_t opcode, uint64_t addr, uint32_t len, uint64_t off, uint32_t flags,
+                       uint64_t timeout_ms){
+    size_t worker = GetWorkerIndex();
+    Uring* uring = m_pollers[worker].uring.get();
+    FdContext* ctx = getFdContext(fd, true);
+    if(!ctx){
+        errno = EBADF;
+        return -1;
+    }
+    bool has_timeout = timeout_ms != ~0ull;
+    // 请求和它的超时必须在同一次提交中：先腾出两个位置，之后的getSqe不会在中间提交
+    if(has_timeout && uring->space() < 2){
+        uring->enter(0);
+        if(uring->space() < 2){
+            // 内核没有取走提交项，宁可失败也不发出没有超时的请求
+            errno = EBUSY;
+            return -1;
+        }
+    }
+    io_uring_sqe* sqe = uring->getSqe();
+    if(!sqe){
+        errno = EBUSY;
+        return -1;
+    }
+    UringRequest req;
+    req.fiber = Fiber::GetThis();
+    req.worker = worker;
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = addr;
+    sqe->len = len;
+    sqe->off = off;
+    sqe->rw_flags = flags;
+    if(m_fixedFiles && (unsigned)fd < uring->getFixedFileCount()){
+        uint64_t bit = 1ull << worker;
+        if(!(ctx->fixed_files.load(std::memory_order_acquire) & bit)
+                && !uring->updateFile(fd, fd)){
+            ctx->fixed_files.fetch_or(bit, std::memory_order_acq_rel);
+        }
+        if(ctx->fixed_files.load(std::memory_order_relaxed) & bit){
+            // 固定文件槽的下标就是fd
+            sqe->flags |= IOSQE_FIXED_FILE;
+        }
+    }
+    req.user_data = sqe->user_data = uring->track(&req);
+    if(has_timeout){
+        io_uring_sqe* timeout_sqe = uring->getSqe();
+        CAIZI_ASSERT(timeout_sqe);
+        sqe->flags |= IOSQE_IO_LINK;
+        // 内核在提交时复制超时时间，提交发生在本协程恢复之前
+        req.timeout.tv_sec = timeout_ms / 1000;
+        req.timeout.tv_nsec = (timeout_ms % 1000) * 1000000LL;
+        timeout_sqe->opcode = IORING_OP_LINK_TIMEOUT;
+        timeout_sqe->fd = -1;
+        timeout_sqe->addr = (uint64_t)&req.timeout;
+        timeout_sqe->len = 1;
+        timeout_sqe->user_data = IGNORE_USER_DATA;
+    }
+    UringRequest*& slot = event == READ ? ctx->read_req : ctx->write_req;
+    {
+        ScopeLock lock(&ctx->mutex);
+        // 同一方向只记录第一个请求用于取消
+        if(!slot){
+            slot = &req;
+        }
+    }
+    ++m_pendingEventCount;
+    Fiber::YieldToHole();
+    int cancel_error;
+    {
+        ScopeLock lock(&ctx->mutex);
+        if(slot == &req){
+            slot = nullptr;
+        }
+        cancel_error = req.cancel_error;
+    }
+    if(req.result < 0){
+        errno = -req.result;
+        if(req.result == -ECANCELED){
+            // 没有被cancelEvent取消，就是被链接的超时取消
+            if(cancel_error){
+                errno = cancel_error;
+            }else if(has_timeout){
+                errno = ETIMEDOUT;
+            }
+        }
+        return -1;
+    }
+    return req.result;
+}
+
+bool IOManager::cancelUring(FdContext* ctx, Event event, int error){
+    UringRequest* req = event == READ ? ctx->read_req : ctx->write_req;
+    if(!req){
+        return false;
+    }
+    if(req->cancel_error){
+        return true;
+    }
+    req->cancel_error = error;
+    size_t worker = req->worker;
+    uint64_t user_data = req->user_data;
+    if(Scheduler::GetThis() == this && GetWorkerIndex() == (int)worker){
+        submitCancel(worker, user_data);
+    }else{
+        // ring只能由所属的工作线程提交，取消请求交给那个线程
+        schedule([this, worker, user_data](){
+            submitCancel(worker, user_data);
+        }, getWorkerThreadId(worker));
+    }
+    return true;
+}
+
+void IOManager::submitCancel(size_t worker, uint64_t user_data){
+    io_uring_sqe* sqe = m_pollers[worker].uring->getSqe();
+    if(!sqe){
+        LOG_FMT_ERROR(g_logger, "IOManager %s 提交取消请求失败\n", m_name.c_str());
+        return;
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = user_data;
+    sqe->user_data = IGNORE_USER_DATA;
+}
+
+void IOManager::closeFd(int fd){
+    cancelAll(fd, EBADF);
+    FdContext* ctx = getFdContext(fd, false);
+    if(!ctx){
+        return;
+    }
+    uint64_t files = ctx->fixed_files.exchange(0, std::memory_order_acq_rel);
+    for(size_t i = 0; files; ++i, files >>= 1){
+        if(files & 1){
+            m_pollers[i].uring->updateFile(fd, -1);
+        }
+    }
+}
+
+// 不在协程中时阻塞等待fd就绪，超时返回false并设置errno为ETIMEDOUT
+static bool WaitReady(int fd, short events, uint64_t timeout_ms){
+    pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
+    int timeout = timeout_ms == ~0ull ? -1 : (int)std::min(timeout_ms, (uint64_t)INT_MAX);
+    int rt;
+    do{
+        rt = poll(&pfd, 1, timeout);
+    }while(rt < 0 && errno == EINTR);
+    if(rt == 0){
+        errno = ETIMEDOUT;
+    }
+    return rt > 0;
+}
+
+// 等待fd上的事件，失败返回false并设置errno
+static bool WaitFd(IOManager* iom, bool in_fiber, int fd, IOManager::Event event, uint64_t timeout_ms){
+    if(in_fiber){
+        int rt = iom->waitEvent(fd, event, timeout_ms);
+        if(rt){
+            errno = rt > 0 ? rt : errno;
+            return false;
+        }
+        return true;
+    }
+    return WaitReady(fd, event == IOManager::READ ? POLLIN : POLLOUT, timeout_ms);
+}
+
+/*
+    被hook的系统调用(recv/send/connect等)用hook.h中的原函数 名字_f，hook的函数会调用这里的
+    Recv/Send等，直接调用会递归；accept4/recvmsg/sendmsg/sendfile/splice没有被hook，直接调用libc
+    epoll后端的通用流程：执行非阻塞的系统调用，EAGAIN时等待fd就绪再重试
+    @param func 执行一次系统调用，失败返回-1并设置errno
+*/
+template<class Func>
+static ssize_t DoIO(IOManager* iom, bool in_fiber, int fd, IOManager::Event event, uint64_t timeout_ms, Func func){
+    while(true){
+        ssize_t n = func();
+        if(n >= 0){
+            return n;
+        }
+        if(errno == EINTR){
+            continue;
+        }
+        if(errno != EAGAIN && errno != EWOULDBLOCK){
+            return -1;
+        }
+        if(!WaitFd(iom, in_fiber, fd, event, timeout_ms)){
+            return -1;
+        }
+    }
+}
+
+ssize_t IOManager::Recv(int fd, void* buf, size_t len, int flags, uint64_t timeout_ms){
+    IOManager* iom = GetThis();
+    bool in_fiber = iom && iom->inTaskFiber();
+    if(in_fiber && iom->m_backend == IO_URING){
+        return iom->uringIO(fd, READ, IORING_OP_RECV, (uint64_t)buf, len, 0, flags, timeout_ms);
+    }
+    return DoIO(iom, in_fiber, fd, READ, timeout_ms, [&](){ return recv_f(fd, buf, len, flags); });
+}
+
+ssize_t IOManager::Send(int fd, const void* buf, size_t len, int flags, uint64_t timeout_ms){
+    IOManager* iom = GetThis();
+    bool in_fiber = iom && iom->inTaskFiber();
+    flags |= MSG_NOSIGNAL;
+    if(in_fiber && iom->m_backend == IO_URING){
+        return iom->uringIO(fd, WRITE, IORING_OP_SEND, (uint64_t)buf, len, 0, flags, timeout_ms);
+    }
+    return DoIO(iom, in_fiber, fd, WRITE, timeout_ms, [&](){ return send_f(fd, buf, len, flags); });
+}
+
+int IOManager::Accept(int fd, sockaddr* addr, socklen_t* addrlen, int flags, uint64_t timeout_ms){
+    IOManager* iom = GetThis();
+    bool in_fiber = iom && iom->inTaskFiber();
+    if(in_fiber && iom->m_backend == IO_URING){
+        return iom->uringIO(fd, READ, IORING_OP_ACCEPT, (uint64_t)addr, 0, (uint64_t)addrlen, flags, timeout_ms);
+    }
+    return DoIO(iom, in_fiber, fd, READ, timeout_ms, [&](){ return ::accept4(fd, addr, addrlen, flags); });
+}
+
+int IOManager::Connect(int fd, const sockaddr* addr, socklen_t addrlen, uint64_t timeout_ms){
+    IOManager* iom = GetThis();
+    bool in_fiber = iom && iom->inTaskFiber();
+    if(in_fiber && iom->m_backend == IO_URING){
+        return iom->uringIO(fd, WRITE, IORING_OP_CONNECT, (uint64_t)addr, 0, addrlen, 0, timeout_ms);
+    }
+    int rt = connect_f(fd, addr, addrlen);
+    if(rt == 0 || errno != EINPROGRESS){
+        return rt;
+    }
+    // 非阻塞连接等待可写后取SO_ERROR
+    if(in_fiber){
+        int wait = iom->waitEvent(fd, WRITE, timeout_ms);
+        if(wait){
+            errno = wait > 0 ? wait : errno;
+            return -1;
+        }
+    }else if(!WaitReady(fd, POLLOUT, timeout_ms)){
+        return -1;
+    }
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if(getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) == -1){
+        return -1;
+    }
+    if(error){
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
+
+ssize_t IOManager::RecvMsg(int fd, msghdr* msg, int flags, uint64_t timeout_ms){
+    IOManager* iom = GetThis();
+    bool in_fiber = iom && iom->inTaskFiber();
+    if(in_fiber && iom->m_backend == IO_URING && !(flags & MSG_ERRQUEUE)){
+        return iom->uringIO(fd, READ, IORING_OP_RECVMSG, (uint64_t)msg, 1, 0, flags, timeout_ms);
+    }
+    return DoIO(iom, in_fiber, fd, READ, timeout_ms, [&](){ return ::recvmsg(fd, msg, flags); });
+}
+
+ssize_t IOManager::SendMsg(int fd, const msghdr* msg, int flags, uint64_t timeout_ms){
+    IOManager* iom = GetThis();
+    bool in_fiber = iom && iom->inTaskFiber();
+    flags |= MSG_NOSIGNAL;
+    if(in_fiber && iom->m_backend == IO_URING && !(flags & MSG_ZEROCOPY)){
+        return iom->uringIO(fd, WRITE, IORING_OP_SENDMSG, (uint64_t)msg, 1, 0, flags, timeout_ms);
+    }
+    return DoIO(iom, in_fiber, fd, WRITE, timeout_ms, [&](){ return ::sendmsg(fd, msg, flags); });
+}
+
+ssize_t IOManager::SendFile(int out_fd, int in_fd, off_t* offset, size_t count, uint64_t timeout_ms){
+    IOManager* iom = GetThis();
+    bool in_fiber = iom && iom->inTaskFiber();
+    return DoIO(iom, in_fiber, out_fd, WRITE, timeout_ms, [&](){ return ::sendfile(out_fd, in_fd, offset, count); });
+}
+
+ssize_t IOManager::Splice(int in_fd, int out_fd, size_t len, uint64_t timeout_ms){
+    IOManager* iom = GetThis();
+    bool in_fiber = iom && iom->inTaskFiber();
+    while(true){
+        ssize_t n = ::splice(in_fd, nullptr, out_fd, nullptr, len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if(n >= 0){
+            return n;
+        }
+        if(errno == EINTR){
+            continue;
+        }
+        if(errno != EAGAIN){
+            return -1;
+        }
+        // EAGAIN可能来自任一端：管道没有数据时等它可读，否则等out_fd可写
+        pollfd pfd;
+        pfd.fd = in_fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        bool in_ready = poll(&pfd, 1, 0) > 0;
+        if(!WaitFd(iom, in_fiber, in_ready ? out_fd : in_fd, in_ready ? WRITE : READ, timeout_ms)){
+            return -1;
+        }
+    }
+}
+
+void IOManager::Sleep(uint64_t ms){
+    IOManager* iom = GetThis();
+    if(!iom || !iom->inTaskFiber()){
+        struct timespec ts;
+        ts.tv_sec = ms / 1000;
+        ts.tv_nsec = (ms % 1000) * 1000000;
+        while(nanosleep_f(&ts, &ts) == -1 && errno == EINTR){
+        }
+        return;
+    }
+    Fiber::ptr fiber = Fiber::GetThis();
+    iom->addTimer(ms, [iom, fiber](){
+        iom->schedule(fiber);
+    });
+    Fiber::YieldToHole();
+}
+
+}
@@ -0,0 +1,189 @@
+/*
+    @file iomanager.h
+    @brief 基于epoll的协程IO调度器
+*/
+
+#ifndef __CAIZI_IOMANAGER_H__
+#define __CAIZI_IOMANAGER_H__
+
+#include <atomic>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <functional>
+#include <memory>
+#include <sys/socket.h>
+#include <vector>
+
+#include "scheduler.h"
+#include "thread.h"
+#include "timer.h"
+#include "uring.h"
+
+namespace caizi{
+
+/*
+    每个工作线程有自己的epoll(边缘触发)和用于唤醒的eventfd，空闲时在epoll_wait中等待。
+    fd第一次登记事件时绑定到当前工作线程的epoll，事件就绪后在该线程上恢复等待的协程；
+    fd上的事件全部取消后解除绑定。
+    fd上下文表按fd直接索引，分块按需分配，查找不加锁。
+    定时器放在分层时间轮中，空闲线程等待的超时取下一个定时器的时间，繁忙时每执行一批任务检查一次到期。
+    IO后端由配置项iomanager.backend在构造时选择：
+        epoll       先执行非阻塞的系统调用，EAGAIN时等待就绪后重试
+        io_uring    协程直接把recv/send/accept/connect提交到本工作线程的ring后挂起，完成后恢复，
+                    请求在调度循环每执行一批任务或空闲时一次系统调用批量提交；
+                    epoll的fd作为一个poll请求挂在ring上，waitEvent等接口不受影响。
+                    内核不支持io_uring时退回epoll。
+*/
+class IOManager : public Scheduler, public TimerManager{
+public:
+    typedef std::shared_ptr<IOManager> ptr;
+
+    enum Event{
+        NONE    = 0x0,
+        READ    = 0x1,      // EPOLLIN
+        WRITE   = 0x4       // EPOLLOUT
+    };
+
+    enum Backend{
+        EPOLL,
+        IO_URING
+    };
+
+    IOManager(size_t threads = 1, bool use_caller = true, const std::string& name = "");
+    ~IOManager();
+
+    // 登记fd上的事件，就绪时执行cb，cb为空时恢复当前协程，成功返回0，失败返回-1
+    int addEvent(int fd, Event event, std::function<void()> cb = nullptr);
+    // 删除事件，不触发
+    bool delEvent(int fd, Event event);
+    // 取消事件并立即触发，等待的协程从waitEvent返回error
+    bool cancelEvent(int fd, Event event, int error = ECANCELED);
+    // 取消fd上的所有事件
+    bool cancelAll(int fd, int error = ECANCELED);
+
+    /*
+        当前协程等待fd上的事件
+        @param timeout_ms 超时时间，~0ull表示一直等待
+        @return 0表示事件就绪，被取消时返回cancelEvent的error，超时返回ETIMEDOUT，登记失败返回-1
+    */
+    int waitEvent(int fd, Event event, uint64_t timeout_ms = ~0ull);
+
+    // 关闭fd之前调用：以EBADF取消fd上所有等待的事件和请求，并从io_uring的固定文件表中移除
+    void closeFd(int fd);
+
+    Backend getBackend() const{ return m_backend; };
+
+    static IOManager* GetThis();
+
+    /*
+        在当前协程中执行IO，参数和返回值与同名系统调用相同(失败返回-1并设置errno)
+        fd需要是非阻塞的；不在IOManager的协程中调用时阻塞等待fd就绪
+        timeout_ms为每次等待的超时时间，超时失败时errno为ETIMEDOUT，~0ull表示一直等待
+    */
+    static ssize_t Recv(int fd, void* buf, size_t len, int flags, uint64_t timeout_ms = ~0ull);
+    static ssize_t Send(int fd, const void* buf, size_t len, int flags, uint64_t timeout_ms = ~0ull);
+    static int Accept(int fd, sockaddr* addr, socklen_t* addrlen, int flags, uint64_t timeout_ms = ~0ull);
+    static int Connect(int fd, const sockaddr* addr, socklen_t addrlen, uint64_t timeout_ms = ~0ull);
+    // flags带MSG_ERRQUEUE/MSG_ZEROCOPY时不走io_uring，错误队列的就绪以EPOLLERR通知读等待者
+    static ssize_t RecvMsg(int fd, msghdr* msg, int flags, uint64_t timeout_ms = ~0ull);
+    static ssize_t SendMsg(int fd, const msghdr* msg, int flags, uint64_t timeout_ms = ~0ull);
+    // 同sendfile，in_fd需要支持mmap(普通文件)
+    static ssize_t SendFile(int out_fd, int in_fd, off_t* offset, size_t count, uint64_t timeout_ms = ~0ull);
+    // 从管道in_fd搬运最多len字节到out_fd，同不带偏移的splice；管道为空时等待可读，out_fd满时等待可写
+    static ssize_t Splice(int in_fd, int out_fd, size_t len, uint64_t timeout_ms = ~0ull);
+    // 当前协程挂起ms毫秒；不在IOManager的协程中时阻塞线程
+    static void Sleep(uint64_t ms);
+
+protected:
+    void tickle(size_t worker) override;
+    bool stopping() override;
+    void idle() override;
+    void flush() override;
+    void onTimerInsertedAtFront() override;
+
+private:
+    // 提交到io_uring的请求，位于等待它的协程栈上
+    struct UringRequest{
+        Fiber::ptr fiber;
+        int result = 0;
+        int cancel_error = 0;           // 被cancelEvent取消时的错误码
+        size_t worker = 0;
+        uint64_t user_data = 0;
+        __kernel_timespec timeout;      // 链接在请求后的超时
+    };
+
+    struct FdContext{
+        struct EventContext{
+            Scheduler* scheduler = nullptr;     // 事件就绪后在哪个调度器上执行
+            Fiber::ptr fiber;                   // 等待事件的协程
+            std::function<void()> cb;           // 事件回调
+            int* result = nullptr;              // waitEvent的返回值
+            uint64_t seq = 0;                   // 登记的序号，区分同一fd同一事件上先后的等待
+        };
+
+        EventContext& getContext(Event event);
+        void resetContext(EventContext& ctx);
+
+        Mutex mutex;
+        EventContext read;
+        EventContext write;
+        int fd = -1;
+        int events = NONE;                      // 已登记的事件
+        uint64_t seq = 0;                       // 最近一次登记的序号
+        int worker = -1;                        // 登记在哪个工作线程的epoll上
+        UringRequest* read_req = nullptr;       // 正在io_uring中执行的读请求(recv/accept)
+        UringRequest* write_req = nullptr;      // 正在io_uring中执行的写请求(send/connect)
+        std::atomic<uint64_t> fixed_files{0};   // 在哪些工作线程的ring中注册为固定文件
+    };
+
+    struct Poller{
+        int epfd = -1;
+        int eventfd = -1;
+        std::unique_ptr<Uring> uring;
+        bool epoll_armed = false;               // epfd的poll请求是否已挂在ring上
+    };
+
+    // 取得fd的上下文，create为false且不存在时返回nullptr
+    FdContext* getFdContext(int fd, bool create);
+    // @param seq 不为空时返回这次登记的序号
+    int addEventInternal(int fd, Event event, std::function<void()> cb, int* result, uint64_t* seq = nullptr);
+    // 只有登记的序号仍是seq时才取消，迟到的超时不会取消之后新的等待
+    bool cancelWait(int fd, Event event, uint64_t seq, int error);
+    // 修改epoll中登记的事件，没有剩余事件时从epoll删除
+    bool updateEpoll(FdContext* ctx, int events);
+    // 触发事件，调用时持有ctx的锁
+    void triggerEvent(FdContext* ctx, Event event, int result);
+    // 处理epoll_wait返回的事件
+    void processEvents(Poller& poller, epoll_event* events, int count);
+    // 取消正在io_uring中执行的请求，调用时持有ctx的锁
+    bool cancelUring(FdContext* ctx, Event event, int error);
+    void submitCancel(size_t worker, uint64_t user_data);
+    // 收割本线程ring上完成的请求
+    void reapUring(Poller& poller);
+    // 调度到期定时器的回调
+    void processTimers();
+    // 当前是否在本调度器的任务协程中(可以挂起等待IO)
+    bool inTaskFiber() const;
+    /*
+        提交一个io_uring请求并挂起当前协程，event为请求的方向，用于cancelEvent
+        @param timeout_ms 不为~0ull时在请求后链接一个超时，超时后请求被内核取消
+        @return 请求的结果，失败返回-1并设置errno
+    */
+    int uringIO(int fd, Event event, uint8_t opcode, uint64_t addr, uint32_t len, uint64_t off, uint32_t flags,
+                uint64_t timeout_ms);
+
+private:
+    static const size_t FD_CHUNK_BITS = 10;
+    static const size_t FD_CHUNK_SIZE = 1 << FD_CHUNK_BITS;
+    static const size_t FD_MAX_CHUNKS = 1024;           // 最多支持 1024 * 1024 个fd
+
+    Backend m_backend = EPOLL;
+    bool m_fixedFiles = false;
+    std::vector<Poller> m_pollers;
+    std::atomic<FdContext*> m_fdChunks[FD_MAX_CHUNKS];
+    std::atomic<size_t> m_pendingEventCount{0};
+};
+
+}
+
+#endif
@@ -1,6 +1,19 @@
 #include "log.h"
 #include <functional>
+#include <algorithm>
 #include <map>
+#include <sched.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <errno.h>
+#include <time.h>
+#include "util.h"
+#include "config.h"
+#include "fiber.h"
+#include "log_binary.h"
+#include "log_json.h"
 
 namespace caizi{
 
@@ -27,10 +40,32 @@ std::string LogLevel::levelToString(LogLevel::Level level){
         case FATAL:
             res = "FATAL";
             break;
+        case OFF:
+            res = "OFF";
+            break;
     }
     return res;
 }
 
+const char* LogLevel::ToString(LogLevel::Level level){
+    switch (level){
+        case DEBUG:
+            return "DEBUG";
+        case INFO:
+            return "INFO";
+        case WARN:
+            return "WARN";
+        case ERROR:
+            return "ERROR";
+        case FATAL:
+            return "FATAL";
+        case OFF:
+            return "OFF";
+        default:
+            return "UNKONW";
+    }
+}
+
 LogLevel::Level LogLevel::stringToLevel(const std::string& str){
     #define XX(level, v) {if(str == #v){return LogLevel::level;}}
     XX(DEBUG, debug);
@@ -38,173 +73,801 @@ LogLevel::Level LogLevel::stringToLevel(const std::string& str){
     XX(WARN, warn);
     XX(ERROR, error);
     XX(FATAL, fatal);
+    XX(OFF, off);
 
     XX(DEBUG, DEBUG);
     XX(INFO, INFO);
     XX(WARN, WARN);
     XX(ERROR, ERROR);
     XX(FATAL, FATAL);
+    XX(OFF, OFF);
     return Level::UNKNOW;
     #undef XX
 }
 
-LogEvent::LogEvent(const std::string& filename,
-            uint32_t line,
-            uint32_t threadID,
-            uint32_t fiberID,
-            time_t time,
-            const std::string& content,
-            const std::string& division,
-            LogLevel::Level level):
-        m_filename(filename),
-        m_line(line),
-        m_threadID(threadID),
-        m_fiberID(fiberID),
-        m_time(time),    
-        m_content(content),
-        m_division(division),
-        m_level(level){};
+LogEvent& LogEvent::operator=(const LogEvent& other){
+    if(this == &other){
+        return *this;
+    }
+    m_level = other.m_level;
+    m_filename = other.m_filename;
+    m_line = other.m_line;
+    m_elapse = other.m_elapse;
+    m_threadID = other.m_threadID;
+    m_fiberID = other.m_fiberID;
+    m_time = other.m_time;
+    m_division = other.m_division;
+    m_site = other.m_site;
+    m_rendered = other.m_rendered;
+    m_format_args = other.m_format_args;
+    m_content_size = other.m_content_size;
+    m_args_size = other.m_args_size;
+    m_fields_size = other.m_fields_size;
+    memcpy(m_threadName, other.m_threadName, sizeof(m_threadName));
+    memcpy(m_content, other.m_content, m_content_size);
+    memcpy(m_args, other.m_args, m_args_size);
+    memcpy(m_fields, other.m_fields, m_fields_size);
+    return *this;
+}
+
+void LogEvent::init(LogLevel::Level level, const char* filename, uint32_t line){
+    m_level = level;
+    m_filename = filename;
+    m_line = line;
+    m_time = CoarseClock::NowMS();
+    m_elapse = m_time - CoarseClock::StartMS();
+    m_threadID = Thread::GetThisId();
+    m_fiberID = Fiber::GetFiberID();
+    m_division = " ";
+    m_site = nullptr;
+    m_rendered = true;
+    m_format_args = false;
+    m_content_size = 0;
+    m_args_size = 0;
+    m_fields_size = 0;
+    setThreadName(Thread::GetThisThreadName());
+}
+
+void LogEvent::setThreadName(std::string_view name){
+    size_t len = std::min(name.size(), sizeof(m_threadName) - 1);
+    memcpy(m_threadName, name.data(), len);
+    m_threadName[len] = '\0';
+}
+
+std::string_view LogEvent::getContent() const{
+    if(!m_rendered){
+        m_content_size = LogArgs::Render(m_content, sizeof(m_content),
+                                         m_site->format, m_args, m_args_size);
+        m_rendered = true;
+    }
+    return std::string_view(m_content, m_content_size);
+}
+
+char* LogEvent::GetOverflowArgsBuffer(){
+    // 只在参数超出事件内空间时使用，第一次使用时分配
+    static thread_local std::unique_ptr<char[]> s_buffer;
+    if(!s_buffer){
+        s_buffer.reset(new char[s_overflow_args_size]);
+    }
+    return s_buffer.get();
+}
+
+void LogEvent::renderArgs(const LogArgs& args){
+    m_content_size = LogArgs::Render(m_content, sizeof(m_content),
+                                     m_site->format, args.data(), args.size());
+    m_rendered = true;
+    m_format_args = false;
+    m_args_size = 0;
+}
+
+void LogEvent::setContent(std::string_view content){
+    m_content_size = 0;
+    m_rendered = true;
+    m_format_args = false;
+    appendContent(content);
+}
+
+void LogEvent::appendContent(std::string_view content){
+    getContent();
+    size_t len = std::min(content.size(), sizeof(m_content) - m_content_size);
+    memcpy(m_content + m_content_size, content.data(), len);
+    m_content_size += len;
+}
+
+void LogEvent::printf(const char* format, ...){
+    va_list ap;
+    va_start(ap, format);
+    vprintf(format, ap);
+    va_end(ap);
+}
+
+void LogEvent::vprintf(const char* format, va_list ap){
+    getContent();
+    size_t avail = sizeof(m_content) - m_content_size;
+    int len = vsnprintf(m_content + m_content_size, avail, format, ap);
+    if(len > 0){
+        // vsnprintf会为结尾的'\0'预留一个字节
+        m_content_size += std::min((size_t)len, avail ? avail - 1 : 0);
+    }
+}
+
+/*
+    LogSite 日志调用点
+*/
+static std::atomic<uint32_t> s_log_site_id{1};
+
+// 格式串中对应%p的参数序号，与LogArgs::Render取参数的顺序一致('*'宽度和精度也占一个参数)
+static uint64_t PointerArgMask(const char* format){
+    uint64_t mask = 0;
+    uint32_t index = 0;
+    const char* p = format;
+    while(p && (p = strchr(p, '%'))){
+        ++p;
+        if(*p == '%'){
+            ++p;
+            continue;
+        }
+        while(*p && strchr("-+ #0", *p)){
+            ++p;
+        }
+        for(int part = 0; part < 2; ++part){
+            if(part == 1){
+                if(*p != '.'){
+                    break;
+                }
+                ++p;
+            }
+            if(*p == '*'){
+                ++index;
+                ++p;
+            }else{
+                while(isdigit(*p)){
+                    ++p;
+                }
+            }
+        }
+        while(*p && strchr("hlLqjzt", *p)){
+            ++p;
+        }
+        if(!*p){
+            break;
+        }
+        if(*p == 'p' && index < 64){
+            mask |= (uint64_t)1 << index;
+        }
+        if(*p != 'n'){
+            ++index;
+        }
+        ++p;
+    }
+    return mask;
+}
+
+LogSite::LogSite(const char* file, uint32_t line, const char* format):
+    file(file), line(line), format(format), id(s_log_site_id.fetch_add(1, std::memory_order_relaxed)),
+    pointer_args(PointerArgMask(format)){
+}
+
+void LogSuppressed(Logger& logger, LogLevel::Level level, const char* file, uint32_t line, uint64_t count){
+    LogEventGuard ev(level, file, line);
+    ev->printf("suppressed %llu messages\n", (unsigned long long)count);
+    logger.log(level, *ev);
+}
+
+/*
+    登记过的(限流调用点, 日志器)，由LogTicker定期报告窗口结束后仍未报告的丢弃条数
+    调用点是静态对象，表也一直存在到进程退出，不在退出时析构。
+    日志器释放后删除它的登记并丢弃未报告的条数，同一地址的新日志器再次被丢弃时重新登记
+*/
+class RateLimitWatcher{
+public:
+    struct Entry{
+        LogRateLimit* limit;
+        LogRateLimit::Suppressed* node;
+        std::weak_ptr<Logger> logger;
+        LogLevel::Level level;
+    };
+
+    static RateLimitWatcher* GetInstance(){
+        static RateLimitWatcher* s_watcher = new RateLimitWatcher;
+        return s_watcher;
+    }
+
+    void add(LogRateLimit* limit, LogRateLimit::Suppressed* node, std::weak_ptr<Logger> logger, LogLevel::Level level){
+        bool start = false;
+        {
+            ScopeLock lock(&m_mutex);
+            m_entries.push_back(Entry{limit, node, std::move(logger), level});
+            start = !m_started;
+            m_started = true;
+        }
+        if(start){
+            LogTicker::getInstance()->addTask(std::bind(&RateLimitWatcher::report, this, std::placeholders::_1));
+        }
+    }
+
+private:
+    void report(uint64_t now_ms){
+        {
+            ScopeLock lock(&m_mutex);
+            m_snapshot = m_entries;
+        }
+        for(auto& entry : m_snapshot){
+            if(entry.logger.expired()){
+                remove(entry.node);
+                continue;
+            }
+            uint64_t count = entry.limit->takeExpired(*entry.node, now_ms);
+            if(!count){
+                continue;
+            }
+            Logger::ptr logger = entry.logger.lock();
+            if(logger){
+                LogSuppressed(*logger, entry.level, entry.limit->getFile(), entry.limit->getLine(), count);
+            }
+        }
+        m_snapshot.clear();
+    }
+
+    // 先删除登记再清除标记，之后同一地址的新日志器登记的是新的一项
+    void remove(LogRateLimit::Suppressed* node){
+        {
+            ScopeLock lock(&m_mutex);
+            for(auto it = m_entries.begin(); it != m_entries.end(); ++it){
+                if(it->node == node){
+                    m_entries.erase(it);
+                    break;
+                }
+            }
+        }
+        node->count.store(0, std::memory_order_relaxed);
+        node->watched.store(false, std::memory_order_relaxed);
+    }
+
+    Mutex m_mutex;
+    std::vector<Entry> m_entries;
+    std::vector<Entry> m_snapshot;      // 只在LogTicker线程上使用
+    bool m_started = false;
+};
+
+/*
+    RCU回收域中还在宽限期内的旧快照(被替换的输出地列表、日志器表)由LogTicker定期回收，
+    写日志的线程离开读临界区时不加锁回收。全部回收后删除周期任务，不让LogTicker空转
+*/
+class RcuReclaimer{
+public:
+    static RcuReclaimer* GetInstance(){
+        static RcuReclaimer* s_reclaimer = new RcuReclaimer;
+        return s_reclaimer;
+    }
+
+    void schedule(){
+        ScopeLock lock(&m_mutex);
+        if(m_scheduled){
+            return;
+        }
+        __LogTicker::ptr ticker = LogTicker::getInstance();
+        m_ticker = ticker.get();
+        m_task = ticker->addTask(std::bind(&RcuReclaimer::run, this, std::placeholders::_1));
+        m_scheduled = true;
+    }
+
+private:
+    void run(uint64_t now_ms){
+        RcuDomain::Get().reclaim();
+        ScopeLock lock(&m_mutex);
+        // retire先增加计数再调用schedule，计数为0时删除任务不会漏掉新退休的快照
+        if(m_scheduled && !RcuDomain::Get().getRetiredCount()){
+            // 在LogTicker线程上执行，不能再取单例：进程退出时单例可能正在析构
+            m_ticker->delTask(m_task);
+            m_scheduled = false;
+        }
+    }
+
+    Mutex m_mutex;
+    __LogTicker* m_ticker = nullptr;
+    uint64_t m_task = 0;
+    bool m_scheduled = false;
+};
+
+struct RcuReclaimIniter{
+    RcuReclaimIniter(){
+        RcuDomain::Get().setPendingCallback([](){
+            RcuReclaimer::GetInstance()->schedule();
+        });
+    }
+};
+
+static RcuReclaimIniter __rcu_reclaim_init;
+
+uint64_t LogRateLimit::getSuppressed(const Logger* logger) const{
+    uint64_t count = 0;
+    for(Suppressed* node = m_head.load(std::memory_order_acquire); node; node = node->next){
+        if(!logger || node->logger == logger){
+            count += node->count.load(std::memory_order_relaxed);
+        }
+    }
+    return count;
+}
+
+LogRateLimit::Suppressed* LogRateLimit::add(Logger& logger){
+    Suppressed* node = new Suppressed;
+    node->logger = &logger;
+    Suppressed* head = m_head.load(std::memory_order_acquire);
+    while(true){
+        // 只需要检查上次查找之后新加入的节点
+        for(Suppressed* it = head; it && it != node->next; it = it->next){
+            if(it->logger == &logger){
+                delete node;
+                return it;
+            }
+        }
+        node->next = head;
+        if(m_head.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_acquire)){
+            return node;
+        }
+    }
+}
+
+void LogRateLimit::startWatch(Suppressed& node, Logger& logger, LogLevel::Level level){
+    if(node.watched.exchange(true, std::memory_order_relaxed)){
+        return;
+    }
+    // 不由shared_ptr管理的日志器没有weak_ptr，只在它下一条放行的日志前报告
+    std::weak_ptr<Logger> weak = logger.weak_from_this();
+    if(weak.expired()){
+        return;
+    }
+    RateLimitWatcher::GetInstance()->add(this, &node, std::move(weak), level);
+}
+
+/*
+    LogArgs 格式化参数的解码与渲染
+*/
+bool LogArgReader::next(LogArgValue& val){
+    if(m_pos >= m_size){
+        return false;
+    }
+    val.type = m_args[m_pos++];
+    if(val.type == LogArgs::STRING){
+        if(m_pos + 2 > m_size){
+            return false;
+        }
+        memcpy(&val.len, m_args + m_pos, 2);
+        val.str = m_args + m_pos + 2;
+        m_pos += 2 + val.len;
+        return m_pos <= m_size;
+    }
+    if(m_pos + 8 > m_size){
+        return false;
+    }
+    switch(val.type){
+        case LogArgs::INT:
+            memcpy(&val.i, m_args + m_pos, 8);
+            val.u = val.i;
+            val.d = val.i;
+            break;
+        case LogArgs::UINT:
+        case LogArgs::POINTER:
+        case LogArgs::BOOL:
+            memcpy(&val.u, m_args + m_pos, 8);
+            val.i = val.u;
+            val.d = val.u;
+            break;
+        case LogArgs::DOUBLE:
+            memcpy(&val.d, m_args + m_pos, 8);
+            val.i = val.d;
+            val.u = val.d;
+            break;
+        default:
+            return false;
+    }
+    m_pos += 8;
+    return true;
+}
+
+void AppendLogFields(LogBuffer& out, std::string_view fields){
+    LogArgReader reader(fields);
+    LogArgValue key;
+    LogArgValue val;
+    bool first = true;
+    while(reader.next(key) && reader.next(val)){
+        if(!first){
+            out.append(' ');
+        }
+        first = false;
+        out.append(key.str, key.len);
+        out.append('=');
+        switch(val.type){
+            case LogArgs::INT:
+                out.appendInt(val.i);
+                break;
+            case LogArgs::UINT:
+                out.appendUInt(val.u);
+                break;
+            case LogArgs::BOOL:
+                out.append(val.u ? "true" : "false");
+                break;
+            case LogArgs::DOUBLE:{
+                char tmp[32];
+                int n = snprintf(tmp, sizeof(tmp), "%g", val.d);
+                out.append(tmp, n > 0 ? n : 0);
+                break;
+            }
+            case LogArgs::POINTER:{
+                char tmp[32];
+                int n = snprintf(tmp, sizeof(tmp), "%p", (void*)(uintptr_t)val.u);
+                out.append(tmp, n > 0 ? n : 0);
+                break;
+            }
+            default:
+                out.append(val.str, val.len);
+                break;
+        }
+    }
+}
+
+size_t LogArgs::Render(char* out, size_t capacity, const char* format,
+                       const char* args, size_t args_size){
+    size_t len = 0;
+    auto put = [&](const char* str, size_t n){
+        n = std::min(n, capacity - len);
+        memcpy(out + len, str, n);
+        len += n;
+    };
+    if(!format){
+        format = "%s";
+    }
+
+    LogArgReader reader(args, args_size);
+    char spec[32];
+    char tmp[CAIZI_LOG_CONTENT_SIZE];
+    char str[CAIZI_LOG_CONTENT_SIZE];
+    const char* p = format;
+    while(*p && len < capacity){
+        if(*p != '%'){
+            const char* q = strchr(p, '%');
+            if(!q){
+                q = p + strlen(p);
+            }
+            put(p, q - p);
+            p = q;
+            continue;
+        }
+        if(p[1] == '%'){
+            put("%", 1);
+            p += 2;
+            continue;
+        }
+
+        // 解析转换说明：标志、宽度、精度，长度修饰符按参数实际类型重新生成
+        // spec最多保留20个字符，末尾留给类型后缀
+        const char* start = p;
+        size_t n = 0;
+        const char* q = p + 1;
+        spec[n++] = '%';
+        while(*q && strchr("-+ #0", *q)){
+            if(n < 20){
+                spec[n++] = *q;
+            }
+            ++q;
+        }
+        LogArgValue val;
+        for(int part = 0; part < 2; ++part){
+            if(part == 1){
+                if(*q != '.'){
+                    break;
+                }
+                if(n < 20){
+                    spec[n++] = '.';
+                }
+                ++q;
+            }
+            if(*q == '*'){
+                ++q;
+                int v = reader.next(val) ? (int)val.i : 0;
+                int w = snprintf(spec + n, 21 - n, "%d", v);
+                n = std::min(n + (w > 0 ? w : 0), (size_t)20);
+            }else{
+                while(isdigit(*q)){
+                    if(n < 20){
+                        spec[n++] = *q;
+                    }
+                    ++q;
+                }
+            }
+        }
+        while(*q && strchr("hlLqjzt", *q)){
+            ++q;
+        }
+        char conv = *q;
+        if(!conv){
+            break;
+        }
+        p = q + 1;
+        if(conv == 'n'){
+            continue;
+        }
+        if(!reader.next(val)){
+            put("<?>", 3);
+            continue;
+        }
+
+        int w = 0;
+        switch(conv){
+            case 'd':
+            case 'i':
+                memcpy(spec + n, "lld", 4);
+                w = snprintf(tmp, sizeof(tmp), spec, (long long)val.i);
+                break;
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'o':
+                spec[n] = 'l';
+                spec[n + 1] = 'l';
+                spec[n + 2] = conv;
+                spec[n + 3] = '\0';
+                w = snprintf(tmp, sizeof(tmp), spec, (unsigned long long)val.u);
+                break;
+            case 'c':
+                memcpy(spec + n, "c", 2);
+                w = snprintf(tmp, sizeof(tmp), spec, (int)val.i);
+                break;
+            case 'e':
+            case 'E':
+            case 'f':
+            case 'F':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+                spec[n] = conv;
+                spec[n + 1] = '\0';
+                w = snprintf(tmp, sizeof(tmp), spec, val.d);
+                break;
+            case 'p':
+                memcpy(spec + n, "p", 2);
+                w = snprintf(tmp, sizeof(tmp), spec, (void*)(uintptr_t)val.u);
+                break;
+            case 's':
+                if(val.type == LogArgs::STRING){
+                    size_t l = std::min((size_t)val.len, sizeof(str) - 1);
+                    memcpy(str, val.str, l);
+                    str[l] = '\0';
+                }else if(val.type == LogArgs::DOUBLE){
+                    snprintf(str, sizeof(str), "%g", val.d);
+                }else if(val.type == LogArgs::INT){
+                    snprintf(str, sizeof(str), "%lld", (long long)val.i);
+                }else{
+                    snprintf(str, sizeof(str), "%llu", (unsigned long long)val.u);
+                }
+                memcpy(spec + n, "s", 2);
+                w = snprintf(tmp, sizeof(tmp), spec, str);
+                break;
+            default:
+                // 不认识的转换说明原样输出
+                put(start, p - start);
+                continue;
+        }
+        if(w > 0){
+            put(tmp, std::min((size_t)w, sizeof(tmp) - 1));
+        }
+    }
+    return len;
+}
+
+/*
+    LogEventGuard 线程局部的事件池
+*/
+static const int s_event_pool_size = 4;
+static thread_local LogEvent t_event_pool[s_event_pool_size];
+static thread_local int t_event_depth = 0;
+
+LogEventGuard::LogEventGuard(LogLevel::Level level, const char* filename, uint32_t line){
+    m_pooled = t_event_depth < s_event_pool_size;
+    if(m_pooled){
+        m_event = &t_event_pool[t_event_depth++];
+    }else{
+        m_event = new LogEvent();
+    }
+    m_event->init(level, filename, line);
+}
+
+LogEventGuard::~LogEventGuard(){
+    if(m_pooled){
+        --t_event_depth;
+    }else{
+        delete m_event;
+    }
+}
 
+// 格式化时复用的线程局部行缓冲区
+static thread_local LogBuffer t_line_buffer;
 
 class MessageFormatItem: public LogFormatter::FormatItem{
     public:
     MessageFormatItem(const std::string $str){};
-    void format(std::ostream& out, LogLevel::Level level, LogEvent::ptr ev) override{
-        out << ev->getContent();
+    void format(LogBuffer& out, LogLevel::Level level, const LogEvent& ev) override{
+        out.append(ev.getContent());
     }
 };
 
 class LevelFormatItem: public LogFormatter::FormatItem{
     public:
     LevelFormatItem(const std::string $str){};
-    void format(std::ostream& out, LogLevel::Level level, LogEvent::ptr ev) override{
-        out << LogLevel::levelToString(level);
+    void format(LogBuffer& out, LogLevel::Level level, const LogEvent& ev) override{
+        out.append(LogLevel::ToString(level));
     }    
 };
 
 class ThreadIDFormatItem: public LogFormatter::FormatItem{
     public:
     ThreadIDFormatItem(const std::string $str){};
-    void format(std::ostream& out, LogLevel::Level level, LogEvent::ptr ev) override{
-        out << ev->getThreadId();
+    void format(LogBuffer& out, LogLevel::Level level, const LogEvent& ev) override{
+        out.appendUInt(ev.getThreadId());
     }    
 };
 
 class DivisionFormatItem: public LogFormatter::FormatItem{
     public:
     DivisionFormatItem(const std::string $str){};        
-    void format(std::ostream& out, LogLevel::Level level, LogEvent::ptr ev) override{
-        out << ev->getDivision();
+    void format(LogBuffer& out, LogLevel::Level level, const LogEvent& ev) override{
+        out.append(ev.getDivision());
     }        
 };
 
 class FiberIDFormatItem: public LogFormatter::FormatItem{
     public:
     FiberIDFormatItem(const std::string $str){};        
-    void format(std::ostream& out, LogLevel::Level level, LogEvent::ptr ev) override{
-        out << ev->getFiberId();
+    void format(LogBuffer& out, LogLevel::Level level, const LogEvent& ev) override{
+        out.appendUInt(ev.getFiberId());
     }    
 };
 class FilenameFormatItem: public LogFormatter::FormatItem{
     public:
     FilenameFormatItem(const std::string $str){};     
-    void format(std::ostream& out, LogLevel::Level level, LogEvent::ptr ev) override{
-        auto p = ev->getFilename();
-        out << ev->getFilename();
+    void format(LogBuffer& out, LogLevel::Level level, const LogEvent& ev) override{
+        out.append(ev.getFilename());
     }    
 };
 
 class LineFormatItem: public LogFormatter::FormatItem{
     public:
     LineFormatItem(const std::string $str){};   
-    void format(std::ostream& out, LogLevel::Level level, LogEvent::ptr ev) override{
-        out << ev->getLine();
+    void format(LogBuffer& out, LogLevel::Level level, const LogEvent& ev) override{
+        out.appendUInt(ev.getLine());
     }    
 };
 
 class DateTimeFormatItem: public LogFormatter::FormatItem{
     public:
     DateTimeFormatItem(const std::string $str){};   
-    void format(std::ostream& out, LogLevel::Level level, LogEvent::ptr ev) override{
-        out << ev->getTime();
+    void format(LogBuffer& out, LogLevel::Level level, const LogEvent& ev) override{
+        if(out.avail() >= CoarseClock::DATETIME_SIZE){
+            out.add(CoarseClock::FormatDateTime(ev.getTime(), out.current()));
+        }
+    }    
+};
+
+class ElapseFormatItem: public LogFormatter::FormatItem{
+    public:
+    ElapseFormatItem(const std::string $str){};   
+    void format(LogBuffer& out, LogLevel::Level level, const LogEvent& ev) override{
+        out.appendUInt(ev.getElapse());
+    }    
+};
+
+class FieldsFormatItem: public LogFormatter::FormatItem{
+    public:
+    FieldsFormatItem(const std::string $str){};   
+    void format(LogBuffer& out, LogLevel::Level level, const LogEvent& ev) override{
+        AppendLogFields(out, ev.getFields());
     }    
 };
 
 class ThreadNameFormatItem: public LogFormatter::FormatItem{
     public:
     ThreadNameFormatItem(const std::string $str){};   
-    void format(std::ostream& out, LogLevel::Level level, LogEvent::ptr ev) override{
-        out << ev->getThreadName();
+    void format(LogBuffer& out, LogLevel::Level level, const LogEvent& ev) override{
+        out.append(ev.getThreadName());
     }    
 };
 
+// 格式串中原样输出的文本
+class StringFormatItem: public LogFormatter::FormatItem{
+    public:
+    StringFormatItem(const std::string& str):m_string(str){};
+    void format(LogBuffer& out, LogLevel::Level level, const LogEvent& ev) override{
+        out.append(m_string);
+    }
+    private:
+    std::string m_string;
+};
+
 LogFormatter::LogFormatter(const std::string& pattern):m_format_pattern(pattern){
     init();
 }
 
-std::string LogFormatter::format(LogLevel::Level level, LogEvent::ptr event){
-    std::stringstream ss;
+void LogFormatter::format(LogBuffer& out, LogLevel::Level level, const LogEvent& event){
     for(auto &p:m_format_item_list){
-        p->format(ss,level,event);
+        p->format(out, level, event);
     }
-    return ss.str();
 }
 
+std::string LogFormatter::format(LogLevel::Level level, const LogEvent& event){
+    t_line_buffer.reset();
+    format(t_line_buffer, level, event);
+    return std::string(t_line_buffer.data(), t_line_buffer.size());
+}
 
-void LogFormatter::init(){
-    std::vector<std::string> vec;
-    enum PARSE_STATUS{
-        SCAN_STATUS,
-        CREATE_STATUS,
-    };
 
-    PARSE_STATUS status = SCAN_STATUS;
-    size_t str_start, str_end;
-    // 解析格式
-    for(size_t str_start = 0; str_start < m_format_pattern.size(); str_start++){
-        if(m_format_pattern[str_start] == '%'){
-            str_end = str_start + 1;
-            for(str_end = str_start + 1; str_end < m_format_pattern.size(); str_end++){
-                if(m_format_pattern[str_end] == '%'){
-                    vec.push_back(m_format_pattern.substr(str_start + 1,str_end - str_start - 1));
-                    str_start = str_end;
-                    str_start --;
-                    break;
-                }else if(str_end == m_format_pattern.size() - 1){
-                    vec.push_back(m_format_pattern.substr(str_start + 1,str_end - str_start));
-                }
-            }
+void LogFormatter::init(){
+    // 解析格式：%加一个字符为格式项，%%输出百分号，其余字符原样输出
+    // first为格式项的字符或原样输出的文本，second表示是否为格式项
+    std::vector<std::pair<std::string, bool>> vec;
+    std::string literal;
+    for(size_t i = 0; i < m_format_pattern.size(); i++){
+        char c = m_format_pattern[i];
+        if(c != '%' || i + 1 == m_format_pattern.size()){
+            literal.push_back(c);
+            continue;
+        }
+        char next = m_format_pattern[++i];
+        if(next == '%'){
+            literal.push_back('%');
+            continue;
         }
+        if(!literal.empty()){
+            vec.push_back(std::make_pair(literal, false));
+            literal.clear();
+        }
+        vec.push_back(std::make_pair(std::string(1, next), true));
+    }
+    if(!literal.empty()){
+        vec.push_back(std::make_pair(literal, false));
     }
 
     static std::map<std::string, std::function<FormatItem::ptr(const std::string& s)>> s_format_items = {
     #define XX(str,C) {#str, [](const std::string& fc) {return std::make_shared<C>(fc);}}
         XX(m, MessageFormatItem),           //m:消息 
         XX(p, LevelFormatItem),             //p:日志级别
-        // XX(r, ElapseFormatItem),            //r:累计毫秒数
+        XX(r, ElapseFormatItem),            //r:累计毫秒数
         // XX(c, NameFormatItem),              //c:日志名称
         XX(t, ThreadIDFormatItem),          //t:线程id
         // XX(n, NewLineFormatItem),           //n:换行
         XX(f, FilenameFormatItem),          //f:文件名
         XX(l, LineFormatItem),              //l:行号
         // XX(T, TabFormatItem),               //T:Tab
-        // XX(F, FiberIdFormatItem),           //F:协程id
+        XX(F, FiberIDFormatItem),           //F:协程id
         XX(n, ThreadNameFormatItem),        //n:线程名称
-        XX(d, DivisionFormatItem), //分割符
+        XX(d, DateTimeFormatItem),          //d:日期时间
+        XX(s, DivisionFormatItem),          //s:分割符
+        XX(k, FieldsFormatItem),            //k:结构化字段
     #undef XX
     };
 
     for(auto &p:vec){
-        m_format_item_list.push_back(s_format_items[p](""));
+        if(!p.second){
+            m_format_item_list.push_back(std::make_shared<StringFormatItem>(p.first));
+            continue;
+        }
+        auto iter = s_format_items.find(p.first);
+        if(iter == s_format_items.end()){
+            m_error = true;
+            m_format_item_list.push_back(std::make_shared<StringFormatItem>("<<error_format %" + p.first + ">>"));
+        }else{
+            m_format_item_list.push_back(iter->second(""));
+        }
     }
 }
 
-Logger::Logger():m_name("default"),m_level(LogLevel::DEBUG), m_format_pattern("%p%d%n%d%t%d%f%d%l%d%m")
+Logger::Logger():m_name("default"),m_level(LogLevel::DEBUG), m_format_pattern(CAIZI_LOG_DEFAULT_PATTERN)
 {
     m_formatter.reset(new LogFormatter(m_format_pattern));
 }
 
-Logger::Logger(const std::string& name): m_name(name),m_level(LogLevel::DEBUG), m_format_pattern("%p%d%n%d%t%d%f%d%l%d%m"){
+Logger::Logger(const std::string& name): m_name(name),m_level(LogLevel::DEBUG), m_format_pattern(CAIZI_LOG_DEFAULT_PATTERN){
     m_formatter.reset(new LogFormatter(m_format_pattern));
 }
 
@@ -212,16 +875,26 @@ Logger::Logger(const std::string& name,  LogLevel::Level level, const std::strin
     m_formatter.reset(new LogFormatter(pattern));
 }
 
-// 遍历输出器，输出日志
-void Logger::log(LogLevel::Level level, LogEvent::ptr event){
-    if(level >= m_level){
-        ScopeLock lock(&m_mutex);
-        if(!(m_appenders.empty())){
-            for(auto& p: m_appenders){
-                p->log(level, event);
-            }
+void Logger::log(LogLevel::Level level, const LogEvent& event){
+    if(!isEnabled(level)){
+        return;
+    }
+    if(isAsync()){
+        // 不由shared_ptr管理的日志器(如栈上对象)无法排队，直接同步输出
+        Logger::ptr self = weak_from_this().lock();
+        if(self && AsyncLogWorker::getInstance()->push(std::move(self), level, event)){
+            return;
         }
     }
+    writeToAppenders(level, event);
+}
+
+// 遍历输出器，输出日志
+void Logger::writeToAppenders(LogLevel::Level level, const LogEvent& event){
+    RcuPtr<AppenderList>::ReadGuard appenders(m_appenders);
+    for(auto& p : *appenders){
+        p->log(level, event);
+    }
 }
 
 void Logger::addAppender(LogAppender::ptr appender){
@@ -229,39 +902,74 @@ void Logger::addAppender(LogAppender::ptr appender){
     if(!appender->getFormatter()){
         appender->setFormatter(m_formatter);
     }
-    m_appenders.push_back(appender);
+    m_appenders.update([&appender](AppenderList& list){
+        list.push_back(appender);
+    });
 }
 
 void Logger::delAppender(LogAppender::ptr appender){
     ScopeLock lock(&m_mutex);
-    for(auto it = m_appenders.begin(); it != m_appenders.end(); it++){
-        if(*it == appender){
-            m_appenders.erase(it);
-            break;
+    m_appenders.update([&appender](AppenderList& list){
+        for(auto it = list.begin(); it != list.end(); it++){
+            if(*it == appender){
+                list.erase(it);
+                break;
+            }
         }
-    }
+    });
 }
 
 void Logger::clearAppedners(){
     ScopeLock lock(&m_mutex);
-    m_appenders.clear();
+    m_appenders.store(std::make_shared<const AppenderList>());
+}
+
+void Logger::setAppenders(const std::vector<LogAppender::ptr>& appenders){
+    ScopeLock lock(&m_mutex);
+    for(auto& p : appenders){
+        ScopeLock appender_lock(&p->m_mutex);
+        if(!p->m_formatter){
+            p->m_formatter = m_formatter;
+            p->m_hasFormatter = false;
+        }
+    }
+    m_appenders.store(std::make_shared<const AppenderList>(appenders));
+}
+
+std::vector<LogAppender::ptr> Logger::getAppenders() const{
+    return *m_appenders.load();
+}
+
+void Logger::flush(){
+    RcuPtr<AppenderList>::ReadGuard appenders(m_appenders);
+    for(auto& p : *appenders){
+        p->flush();
+    }
 }
 
 void Logger::setFormatter(LogFormatter::ptr val){
     ScopeLock lock(&m_mutex);
     m_formatter = val;
-    for(auto &p:m_appenders){
+    auto appenders = m_appenders.load();
+    for(auto &p : *appenders){
+        ScopeLock appender_lock(&p->m_mutex);
         if(!p->m_hasFormatter){
             p->m_formatter = m_formatter;
         }
     }
 }
 
-void Logger::setFormatter(const std::string& val){
+bool Logger::setFormatter(const std::string& val){
     LogFormatter::ptr new_val(new LogFormatter(val));
+    if(new_val->isError()){
+        std::cerr << "Logger::setFormatter name=" << m_name << " 格式串有误: " << val << std::endl;
+        return false;
+    }
+    setFormatter(new_val);
+    return true;
 }
 
-LogAppender::LogAppender(LogLevel::Level level){
+LogAppender::LogAppender(LogLevel::Level level):m_level(level){
 
 }
 
@@ -280,35 +988,215 @@ LogFormatter::ptr LogAppender::getFormatter(){
     return m_formatter;
 }
 
-StdoutLogAppender::StdoutLogAppender(LogLevel::Level level){
+StdoutLogAppender::StdoutLogAppender(LogLevel::Level level):LogAppender(level){
 
 }
 
-void StdoutLogAppender::log(LogLevel::Level level, LogEvent::ptr event){
+void StdoutLogAppender::log(LogLevel::Level level, const LogEvent& event){
     if(level < m_level) return;
     ScopeLock lock(&m_mutex);
-    std::cout << m_formatter->format(level, event);
+    t_line_buffer.reset();
+    m_formatter->format(t_line_buffer, level, event);
+    std::cout.write(t_line_buffer.data(), t_line_buffer.size());
     std::cout.flush();
 }
 
-FileLogAppender::FileLogAppender(const std::string &filename,  LogLevel::Level level):
-    LogAppender(level), m_filename(filename){
+FileLogAppender::FileLogAppender(const std::string &filename,  LogLevel::Level level, size_t buffer_size):
+    LogAppender(level), m_filename(filename), m_buffer(buffer_size), m_spare(buffer_size){
     reopen();
+    m_ticker = LogTicker::getInstance();
+    m_ticker_task = m_ticker->addTask(std::bind(&FileLogAppender::flushIfDue, this, std::placeholders::_1));
+}
+
+FileLogAppender::~FileLogAppender(){
+    m_ticker->delTask(m_ticker_task);
+    ScopeLock lock(&m_mutex);
+    ScopeLock io_lock(&m_io_mutex);
+    writeFile(m_buffer.data(), m_buffer_used, nullptr, 0);
+    m_buffer_used = 0;
+    if(m_fd >= 0){
+        ::close(m_fd);
+    }
 }
 
-void FileLogAppender::log(LogLevel::Level level, LogEvent::ptr ev) {
+void FileLogAppender::log(LogLevel::Level level, const LogEvent& ev) {
     if(level < m_level) return;
     ScopeLock lock(&m_mutex);
-    m_file_stream <<  m_formatter->format(level,ev); 
-    m_file_stream.flush();
+    t_line_buffer.reset();
+    m_formatter->format(t_line_buffer, level, ev);
+    const char* line = t_line_buffer.data();
+    size_t len = t_line_buffer.size();
+
+    uint64_t now = CoarseClock::NowMS();
+    if((m_rotate_size && m_file_size.load(std::memory_order_relaxed) + m_buffer_used + len > m_rotate_size)
+            || (m_next_rotate_ms && now >= m_next_rotate_ms)){
+        rotate(now);
+    }
+
+    bool fits = m_buffer_used + len <= m_buffer.size();
+    if(fits){
+        memcpy(&m_buffer[m_buffer_used], line, len);
+        m_buffer_used += len;
+    }
+    // 错误日志连同缓冲区一次写出，缓冲区放不下时把这一行接在缓冲区后面写出
+    if(!fits){
+        writeOut(lock, line, len);
+    }else if(level >= LogLevel::ERROR || now >= m_last_flush_ms + m_flush_interval_ms){
+        writeOut(lock);
+    }
+}
+
+void FileLogAppender::flush(){
+    ScopeLock lock(&m_mutex);
+    writeOut(lock);
 }
-// 
+
+void FileLogAppender::flushIfDue(uint64_t now_ms){
+    ScopeLock lock(&m_mutex);
+    if(m_buffer_used && now_ms >= m_last_flush_ms + m_flush_interval_ms){
+        writeOut(lock);
+    }
+}
+
 bool FileLogAppender::reopen(){
-    if(!m_file_stream){
-        m_file_stream.close();
+    ScopeLock lock(&m_mutex);
+    ScopeLock io_lock(&m_io_mutex);
+    writeFile(m_buffer.data(), m_buffer_used, nullptr, 0);
+    m_buffer_used = 0;
+    m_last_flush_ms = CoarseClock::NowMS();
+    return openFile();
+}
+
+void FileLogAppender::setFlushInterval(uint64_t ms){
+    ScopeLock lock(&m_mutex);
+    m_flush_interval_ms = ms;
+}
+
+void FileLogAppender::setRotateSize(uint64_t bytes){
+    ScopeLock lock(&m_mutex);
+    m_rotate_size = bytes;
+}
+
+void FileLogAppender::setRotateInterval(uint64_t seconds){
+    ScopeLock lock(&m_mutex);
+    m_rotate_interval = seconds;
+    updateNextRotateTime(CoarseClock::NowMS());
+}
+
+bool FileLogAppender::openFile(){
+    if(m_fd >= 0){
+        ::close(m_fd);
+    }
+    m_fd = ::open(m_filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if(m_fd < 0){
+        std::cerr << "FileLogAppender 打开日志文件失败: " << m_filename
+                  << " errno=" << errno << " " << strerror(errno) << std::endl;
+        m_file_size.store(0, std::memory_order_relaxed);
+        return false;
+    }
+    struct stat st;
+    m_file_size.store(fstat(m_fd, &st) == 0 ? st.st_size : 0, std::memory_order_relaxed);
+    return true;
+}
+
+void FileLogAppender::writeOut(ScopeLock& lock, const char* extra, size_t extra_len){
+    m_last_flush_ms = CoarseClock::NowMS();
+    if(!m_buffer_used && !extra_len){
+        lock.unlock();
+        return;
+    }
+    // 等待上一次写出完成，保证写入顺序
+    ScopeLock io_lock(&m_io_mutex);
+    size_t used = m_buffer_used;
+    m_buffer.swap(m_spare);
+    m_buffer_used = 0;
+    lock.unlock();
+    writeFile(m_spare.data(), used, extra, extra_len);
+}
+
+void FileLogAppender::writeFile(const char* data, size_t len, const char* extra, size_t extra_len){
+    struct iovec iov[2];
+    int cnt = 0;
+    if(len){
+        iov[cnt].iov_base = (void*)data;
+        iov[cnt].iov_len = len;
+        ++cnt;
+    }
+    if(extra_len){
+        iov[cnt].iov_base = (void*)extra;
+        iov[cnt].iov_len = extra_len;
+        ++cnt;
+    }
+    if(!cnt || m_fd < 0){
+        return;
+    }
+
+    struct iovec* cur = iov;
+    while(cnt){
+        ssize_t n = ::writev(m_fd, cur, cnt);
+        if(n < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            // 写失败时丢弃本次数据，避免缓冲区无限堆积
+            std::cerr << "FileLogAppender 写日志文件失败: " << m_filename
+                      << " errno=" << errno << " " << strerror(errno) << std::endl;
+            return;
+        }
+        m_file_size.fetch_add(n, std::memory_order_relaxed);
+        // 处理部分写入
+        while(cnt && (size_t)n >= cur->iov_len){
+            n -= cur->iov_len;
+            ++cur;
+            --cnt;
+        }
+        if(cnt){
+            cur->iov_base = (char*)cur->iov_base + n;
+            cur->iov_len -= n;
+        }
     }
-    m_file_stream.open(m_filename, std::ios_base::out | std::ios_base::app);
-    return !!m_file_stream;
+}
+
+// 滚动只是一次rename和open，不拷贝文件内容，写日志的线程只需等待这两个系统调用
+void FileLogAppender::rotate(uint64_t now_ms){
+    ScopeLock io_lock(&m_io_mutex);
+    writeFile(m_buffer.data(), m_buffer_used, nullptr, 0);
+    m_buffer_used = 0;
+    updateNextRotateTime(now_ms);
+    if(m_file_size.load(std::memory_order_relaxed) == 0){
+        return;
+    }
+
+    time_t now = now_ms / 1000;
+    struct tm tm;
+    localtime_r(&now, &tm);
+    char suffix[32];
+    strftime(suffix, sizeof(suffix), ".%Y%m%d-%H%M%S", &tm);
+    std::string target = m_filename + suffix;
+    struct stat st;
+    for(int i = 1; ::stat(target.c_str(), &st) == 0; ++i){
+        target = m_filename + suffix + "." + std::to_string(i);
+    }
+    if(::rename(m_filename.c_str(), target.c_str())){
+        std::cerr << "FileLogAppender 滚动日志文件失败: " << m_filename
+                  << " errno=" << errno << " " << strerror(errno) << std::endl;
+        return;
+    }
+    openFile();
+}
+
+void FileLogAppender::updateNextRotateTime(uint64_t now_ms){
+    if(!m_rotate_interval){
+        m_next_rotate_ms = 0;
+        return;
+    }
+    // 按本地时间对齐滚动点
+    time_t now = now_ms / 1000;
+    struct tm tm;
+    localtime_r(&now, &tm);
+    int64_t local = now + tm.tm_gmtoff;
+    int64_t next = (local / m_rotate_interval + 1) * m_rotate_interval - tm.tm_gmtoff;
+    m_next_rotate_ms = next * 1000;
 }
 
 __LoggerManager::__LoggerManager(){
@@ -316,54 +1204,632 @@ __LoggerManager::__LoggerManager(){
 }
 
 Logger::ptr __LoggerManager::getLogger(const std::string &name){
+    {
+        RcuPtr<LoggerMap>::ReadGuard loggers(m_loggers);
+        auto iter = loggers->find(name);
+        if(iter != loggers->end()){
+            return iter->second;
+        }
+    }
+
     ScopeLock lock(&m_mutex);
-    auto iter = m_logger_map.find(name);
-    if(iter != m_logger_map.end()){
+    // 加锁后再查一次，其他线程可能已经创建了同名日志器
+    auto current = m_loggers.load();
+    auto iter = current->find(name);
+    if(iter != current->end()){
         return iter->second;
     }
-
-    Logger::ptr logger = std::make_shared<Logger>("name");
+    Logger::ptr logger = std::make_shared<Logger>(name);
     LogAppender::ptr appender = std::make_shared<StdoutLogAppender>(LogLevel::DEBUG);
     logger->addAppender(appender);
-    m_logger_map[name] = logger;
+    m_loggers.update([&](LoggerMap& loggers){
+        loggers[name] = logger;
+    });
     std::cout << "成功创建日志器: " << name << std::endl;
     return logger;
-
 }
 
 Logger::ptr __LoggerManager::getGlobalLogger(){
-    return getLogger("Global");
+    return getLogger("global");
 }
 
 void __LoggerManager::init(){
     ScopeLock lock(&m_mutex);
-    m_logger_map.erase("global");
-    Logger::ptr logger = std::make_shared<Logger>("global",LogLevel::DEBUG,"%p%d%n%d%t%d%f%d%l%d%m");
-    LogAppender::ptr appender = std::make_shared<StdoutLogAppender>(LogLevel::DEBUG);
-    logger->addAppender(appender);
-    // std::cout << "成功创建日志器: " << "global" << std::endl;
-    m_logger_map.insert(std::make_pair("global",std::move(logger)));
-    ensureGlobalLoggerExists();
+    m_loggers.update([this](LoggerMap& loggers){
+        loggers.erase("global");
+        Logger::ptr logger = std::make_shared<Logger>("global",LogLevel::DEBUG,CAIZI_LOG_DEFAULT_PATTERN);
+        LogAppender::ptr appender = std::make_shared<StdoutLogAppender>(LogLevel::DEBUG);
+        logger->addAppender(appender);
+        // std::cout << "成功创建日志器: " << "global" << std::endl;
+        loggers.insert(std::make_pair("global",std::move(logger)));
+        ensureGlobalLoggerExists(loggers);
+    });
 }
 
 // 确保只保留一个全局日志器
-void __LoggerManager::ensureGlobalLoggerExists(){
-    auto iter = m_logger_map.find("global");
-    if(iter == m_logger_map.end()){
+void __LoggerManager::ensureGlobalLoggerExists(LoggerMap& loggers){
+    auto iter = loggers.find("global");
+    if(iter == loggers.end()){
         // 如果不存在全局日志器，则重新构造一个默认的
-        Logger::ptr logger = std::make_shared<Logger>("global",LogLevel::DEBUG,"%p%d%n%d%t%d%f%d%l%d%m");
+        Logger::ptr logger = std::make_shared<Logger>("global",LogLevel::DEBUG,CAIZI_LOG_DEFAULT_PATTERN);
         LogAppender::ptr appender = std::make_shared<StdoutLogAppender>(LogLevel::DEBUG);
         logger->addAppender(appender);
-        m_logger_map.insert(std::make_pair("global",std::move(logger)));
+        loggers.insert(std::make_pair("global",std::move(logger)));
     }else if(!iter->second){
         // 如果键存在，但日志器不存在，也重新构造一个
-        iter->second = std::make_shared<Logger>("global",LogLevel::DEBUG,"%p%d%n%d%t%d%f%d%l%d%m");
+        iter->second = std::make_shared<Logger>("global",LogLevel::DEBUG,CAIZI_LOG_DEFAULT_PATTERN);
         LogAppender::ptr appender = std::make_shared<StdoutLogAppender>(LogLevel::DEBUG);
         iter->second->addAppender(appender);
     }
 }
 
 
+/*
+    __AsyncLogWorker 异步日志
+*/
+
+// 单个生产者线程的日志队列
+class __AsyncLogWorker::ThreadQueue{
+public:
+    explicit ThreadQueue(size_t capacity): m_ring(capacity){}
+
+    SPSCRingBuffer<Record> m_ring;
+    std::atomic<bool> m_closed{false};      // 所属线程已退出
+};
+
+// 线程退出时标记队列关闭，剩余日志由后台线程写完后回收
+struct ThreadQueueHolder{
+    std::shared_ptr<__AsyncLogWorker::ThreadQueue> queue;
+    bool destroyed = false;
+    ~ThreadQueueHolder(){
+        destroyed = true;
+        if(queue){
+            queue->m_closed.store(true, std::memory_order_release);
+        }
+    }
+};
+
+static thread_local ThreadQueueHolder t_log_queue;
+static thread_local bool t_is_log_worker = false;
+
+__AsyncLogWorker::__AsyncLogWorker(){
+    m_thread.reset(new Thread(std::bind(&__AsyncLogWorker::run, this), "async_log"));
+}
+
+__AsyncLogWorker::~__AsyncLogWorker(){
+    stop();
+}
+
+std::shared_ptr<__AsyncLogWorker::ThreadQueue> __AsyncLogWorker::getThreadQueue(){
+    if(t_log_queue.destroyed){
+        return nullptr;
+    }
+    if(!t_log_queue.queue){
+        t_log_queue.queue = std::make_shared<ThreadQueue>(getQueueCapacity());
+        ScopeLock lock(&m_mutex);
+        m_queues.push_back(t_log_queue.queue);
+        m_queues_version.fetch_add(1, std::memory_order_release);
+    }
+    return t_log_queue.queue;
+}
+
+bool __AsyncLogWorker::push(Logger::ptr logger, LogLevel::Level level, const LogEvent& event){
+    // 后台线程自身产生的日志以及停止后的日志，交给调用方同步输出
+    if(t_is_log_worker || m_stopped.load(std::memory_order_acquire)){
+        return false;
+    }
+    // 线程退出阶段队列已被标记关闭，同样交给调用方同步输出
+    std::shared_ptr<ThreadQueue> queue = getThreadQueue();
+    if(!queue){
+        return false;
+    }
+
+    LogOverflowPolicy policy = getOverflowPolicy();
+    if(policy == LogOverflowPolicy::DROP_DEBUG_FIRST && level <= LogLevel::DEBUG
+            && queue->m_ring.size() >= queue->m_ring.capacity() / 4 * 3){
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    Record* slot = queue->m_ring.prepare();
+    if(!slot){
+        if(policy != LogOverflowPolicy::BLOCK){
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        // 先让出CPU，后台线程仍未腾出空间时短暂休眠
+        for(int spin = 0; !(slot = queue->m_ring.prepare()); ++spin){
+            if(m_stopped.load(std::memory_order_acquire)){
+                return false;
+            }
+            if(spin < 64){
+                sched_yield();
+            }else{
+                usleep(100);
+            }
+        }
+    }
+    slot->logger = std::move(logger);
+    slot->level = level;
+    slot->event = event;
+    queue->m_ring.commit();
+    return true;
+}
+
+size_t __AsyncLogWorker::drainOnce(size_t batch){
+    // 队列列表只在有线程加入或退出时才重新拷贝
+    if(m_queues_version.load(std::memory_order_acquire) != m_snapshot_version){
+        ScopeLock lock(&m_mutex);
+        m_snapshot = m_queues;
+        m_snapshot_version = m_queues_version.load(std::memory_order_relaxed);
+    }
+
+    size_t total = 0;
+    bool has_closed = false;
+    for(auto& queue : m_snapshot){
+        bool closed = queue->m_closed.load(std::memory_order_acquire);
+        for(size_t i = 0; i < batch; ++i){
+            Record* record = queue->m_ring.front();
+            if(!record){
+                break;
+            }
+            // 直接在槽位上写出，写完再归还槽位
+            record->logger->writeToAppenders(record->level, record->event);
+            if(m_touched.empty() || m_touched.back() != record->logger){
+                if(std::find(m_touched.begin(), m_touched.end(), record->logger) == m_touched.end()){
+                    m_touched.push_back(record->logger);
+                }
+            }
+            record->logger.reset();
+            queue->m_ring.pop();
+            ++total;
+        }
+        if(closed && !queue->m_ring.front()){
+            has_closed = true;
+        }
+    }
+
+    // 回收所属线程已退出且已写空的队列
+    if(has_closed){
+        ScopeLock lock(&m_mutex);
+        for(auto it = m_queues.begin(); it != m_queues.end();){
+            if((*it)->m_closed.load(std::memory_order_acquire) && !(*it)->m_ring.front()){
+                it = m_queues.erase(it);
+            }else{
+                ++it;
+            }
+        }
+        m_queues_version.fetch_add(1, std::memory_order_release);
+    }
+    return total;
+}
+
+void __AsyncLogWorker::flushTouched(){
+    for(auto& logger : m_touched){
+        logger->flush();
+    }
+    m_touched.clear();
+}
+
+void __AsyncLogWorker::run(){
+    t_is_log_worker = true;
+    int idle = 0;
+    while(true){
+        bool stopping = m_stopping.load(std::memory_order_acquire);
+        uint64_t request = m_flush_request.load(std::memory_order_acquire);
+        size_t n = drainOnce(getBatchSize());
+        if(n){
+            idle = 0;
+            continue;
+        }
+        // 队列已空：写出输出地的缓冲，并应答flush()
+        flushTouched();
+        m_flush_done.store(request, std::memory_order_release);
+        if(stopping){
+            break;
+        }
+        // 空闲时逐步退避，最长休眠1ms
+        if(++idle < 16){
+            sched_yield();
+        }else{
+            usleep(idle < 64 ? 50 : 1000);
+        }
+    }
+}
+
+void __AsyncLogWorker::flush(){
+    if(t_is_log_worker || m_stopped.load(std::memory_order_acquire)){
+        return;
+    }
+    std::vector<std::pair<std::shared_ptr<ThreadQueue>, size_t>> targets;
+    {
+        ScopeLock lock(&m_mutex);
+        for(auto& queue : m_queues){
+            targets.push_back(std::make_pair(queue, queue->m_ring.pushedCount()));
+        }
+    }
+    for(auto& target : targets){
+        while(target.first->m_ring.poppedCount() < target.second){
+            if(m_stopped.load(std::memory_order_acquire)){
+                return;
+            }
+            usleep(100);
+        }
+    }
+    // 等后台线程把输出地的缓冲写出
+    uint64_t request = m_flush_request.fetch_add(1, std::memory_order_acq_rel) + 1;
+    while(m_flush_done.load(std::memory_order_acquire) < request){
+        if(m_stopped.load(std::memory_order_acquire)){
+            return;
+        }
+        usleep(100);
+    }
+}
+
+void __AsyncLogWorker::stop(){
+    if(m_stopping.exchange(true)){
+        return;
+    }
+    // 先让新日志改为同步输出，再等待后台线程写空队列
+    m_stopped.store(true, std::memory_order_release);
+    if(m_thread){
+        m_thread->join();
+        m_thread.reset();
+    }
+    while(drainOnce(getBatchSize()));
+    flushTouched();
+}
+
+/*
+    日志配置
+    logs:
+        - name: global
+          level: info                   # debug/info/warn/error/fatal/off
+          formatter: "%d%s%p%s%m"       # 可选，默认CAIZI_LOG_DEFAULT_PATTERN
+          async: false
+          queue_capacity: 1024          # 可选，异步队列每个线程的容量
+          overflow_policy: block        # 可选，block/drop_newest/drop_debug_first
+          appenders:
+            - type: StdoutLogAppender
+            - type: FileLogAppender     # FileLogAppender/JsonLogAppender/BinaryLogAppender
+              file: /tmp/global.log
+              level: debug
+              formatter: "%m"
+              buffer_size: 262144
+              flush_interval: 1000      # 毫秒
+              rotate_size: 0            # 字节
+              rotate_interval: 0        # 秒
+              segment_size: 67108864    # 仅BinaryLogAppender
+    queue_capacity和overflow_policy作用于所有异步日志器共用的后台线程，
+    多个日志器都配置时以最后应用的为准，queue_capacity只影响之后新建的线程队列。
+    配置有误(缺少name、未知的级别/类型/格式项/溢出策略)时整份配置被拒绝，日志器保持原样。
+*/
+struct LogAppenderDefine{
+    int type = 0;       // 1 Stdout, 2 File, 3 Json, 4 Binary
+    LogLevel::Level level = LogLevel::DEBUG;
+    std::string formatter;
+    std::string file;
+    uint64_t buffer_size = 256 * 1024;
+    uint64_t flush_interval = 1000;
+    uint64_t rotate_size = 0;
+    uint64_t rotate_interval = 0;
+    uint64_t segment_size = 64 * 1024 * 1024;
+
+    bool operator==(const LogAppenderDefine& oth) const{
+        return type == oth.type && level == oth.level && formatter == oth.formatter
+            && file == oth.file && buffer_size == oth.buffer_size
+            && flush_interval == oth.flush_interval && rotate_size == oth.rotate_size
+            && rotate_interval == oth.rotate_interval && segment_size == oth.segment_size;
+    }
+    bool operator!=(const LogAppenderDefine& oth) const{ return !(*this == oth); }
+};
+
+struct LogDefine{
+    std::string name;
+    LogLevel::Level level = LogLevel::DEBUG;
+    std::string formatter;
+    bool async = false;
+    uint64_t queue_capacity = 0;        // 0表示不修改
+    int overflow_policy = -1;           // LogOverflowPolicy，-1表示不修改
+    std::vector<LogAppenderDefine> appenders;
+
+    bool operator==(const LogDefine& oth) const{
+        return name == oth.name && level == oth.level && formatter == oth.formatter
+            && async == oth.async && queue_capacity == oth.queue_capacity
+            && overflow_policy == oth.overflow_policy && appenders == oth.appenders;
+    }
+    // 日志器按名字去重
+    bool operator<(const LogDefine& oth) const{ return name < oth.name; }
+};
+
+static const char* s_appender_types[] = {"", "StdoutLogAppender", "FileLogAppender", "JsonLogAppender", "BinaryLogAppender"};
+
+static const char* s_overflow_policies[] = {"block", "drop_newest", "drop_debug_first"};
+
+static int ParseOverflowPolicy(const YAML::Node& node, const std::string& where){
+    if(!node.IsDefined()){
+        return -1;
+    }
+    std::string policy = node.as<std::string>();
+    for(int i = 0; i < (int)(sizeof(s_overflow_policies) / sizeof(s_overflow_policies[0])); ++i){
+        if(policy == s_overflow_policies[i]){
+            return i;
+        }
+    }
+    throw std::logic_error(where + " 未知的溢出策略: " + policy);
+}
+
+static LogLevel::Level ParseLevel(const YAML::Node& node, const std::string& where){
+    if(!node.IsDefined()){
+        return LogLevel::DEBUG;
+    }
+    LogLevel::Level level = LogLevel::stringToLevel(node.as<std::string>());
+    if(level == LogLevel::UNKNOW){
+        throw std::logic_error(where + " 未知的日志级别: " + node.as<std::string>());
+    }
+    return level;
 }
 
+static std::string ParseFormatter(const YAML::Node& node, const std::string& where){
+    if(!node.IsDefined()){
+        return "";
+    }
+    std::string pattern = node.as<std::string>();
+    if(LogFormatter(pattern).isError()){
+        throw std::logic_error(where + " 格式串有误: " + pattern);
+    }
+    return pattern;
+}
 
+template<>
+class LexicalCast<std::string, LogDefine>{
+public:
+    LogDefine operator()(const std::string& source){
+        YAML::Node node = YAML::Load(source);
+        LogDefine ld;
+        if(!node["name"].IsDefined()){
+            throw std::logic_error("log config error: name is null, " + source);
+        }
+        ld.name = node["name"].as<std::string>();
+        std::string where = "logger " + ld.name;
+        ld.level = ParseLevel(node["level"], where);
+        ld.formatter = ParseFormatter(node["formatter"], where);
+        ld.async = node["async"].IsDefined() && node["async"].as<bool>();
+        if(node["queue_capacity"].IsDefined()){
+            ld.queue_capacity = node["queue_capacity"].as<uint64_t>();
+        }
+        ld.overflow_policy = ParseOverflowPolicy(node["overflow_policy"], where);
+        if(node["appenders"].IsDefined()){
+            for(size_t i = 0; i < node["appenders"].size(); ++i){
+                YAML::Node a = node["appenders"][i];
+                LogAppenderDefine lad;
+                std::string type = a["type"].IsDefined() ? a["type"].as<std::string>() : "";
+                for(int t = 1; t < (int)(sizeof(s_appender_types) / sizeof(s_appender_types[0])); ++t){
+                    if(type == s_appender_types[t]){
+                        lad.type = t;
+                    }
+                }
+                if(!lad.type){
+                    throw std::logic_error(where + " 未知的输出地类型: " + type);
+                }
+                if(lad.type != 1){
+                    if(!a["file"].IsDefined()){
+                        throw std::logic_error(where + " " + type + " 缺少file");
+                    }
+                    lad.file = a["file"].as<std::string>();
+                }
+                lad.level = ParseLevel(a["level"], where);
+                lad.formatter = ParseFormatter(a["formatter"], where);
+                #define XX(field) if(a[#field].IsDefined()){ lad.field = a[#field].as<uint64_t>(); }
+                XX(buffer_size);
+                XX(flush_interval);
+                XX(rotate_size);
+                XX(rotate_interval);
+                XX(segment_size);
+                #undef XX
+                ld.appenders.push_back(lad);
+            }
+        }
+        return ld;
+    }
+};
+
+template<>
+class LexicalCast<LogDefine, std::string>{
+public:
+    std::string operator()(const LogDefine& ld){
+        YAML::Node node;
+        node["name"] = ld.name;
+        node["level"] = LogLevel::levelToString(ld.level);
+        if(!ld.formatter.empty()){
+            node["formatter"] = ld.formatter;
+        }
+        node["async"] = ld.async;
+        if(ld.queue_capacity){
+            node["queue_capacity"] = ld.queue_capacity;
+        }
+        if(ld.overflow_policy >= 0){
+            node["overflow_policy"] = s_overflow_policies[ld.overflow_policy];
+        }
+        for(auto& a : ld.appenders){
+            YAML::Node na;
+            na["type"] = s_appender_types[a.type];
+            if(!a.file.empty()){
+                na["file"] = a.file;
+            }
+            na["level"] = LogLevel::levelToString(a.level);
+            if(!a.formatter.empty()){
+                na["formatter"] = a.formatter;
+            }
+            na["buffer_size"] = a.buffer_size;
+            na["flush_interval"] = a.flush_interval;
+            na["rotate_size"] = a.rotate_size;
+            na["rotate_interval"] = a.rotate_interval;
+            na["segment_size"] = a.segment_size;
+            node["appenders"].push_back(na);
+        }
+        std::stringstream ss;
+        ss << node;
+        return ss.str();
+    }
+};
+
+static LogAppender::ptr CreateAppender(const LogAppenderDefine& a){
+    LogAppender::ptr appender;
+    switch(a.type){
+        case 1:
+            appender = std::make_shared<StdoutLogAppender>(a.level);
+            break;
+        case 2:
+        case 3:{
+            FileLogAppender::ptr file = a.type == 2
+                ? std::make_shared<FileLogAppender>(a.file, a.level, a.buffer_size)
+                : std::make_shared<JsonLogAppender>(a.file, a.level, a.buffer_size);
+            file->setFlushInterval(a.flush_interval);
+            file->setRotateSize(a.rotate_size);
+            file->setRotateInterval(a.rotate_interval);
+            appender = file;
+            break;
+        }
+        case 4:
+            appender = std::make_shared<BinaryLogAppender>(a.file, a.level, a.segment_size);
+            break;
+    }
+    if(appender && !a.formatter.empty()){
+        appender->setFormatter(std::make_shared<LogFormatter>(a.formatter));
+    }
+    return appender;
+}
+
+static ConfigVar<std::set<LogDefine>>::ptr g_log_defines =
+    Config::Lookup("logs", std::set<LogDefine>(), "logs config");
+
+/*
+    配置变化时逐个更新日志器，日志器对象本身不替换，各模块缓存的Logger::ptr继续有效。
+    输出地的配置不变时保留原来的输出地(文件不重新打开)，有变化时先构造好全部新输出地，
+    再一次替换整个列表，替换前后的日志都不会丢失；等到宽限期结束(替换前开始的写日志调用
+    全部返回)后才写出并释放被替换的输出地，不会有日志在写出之后再写入旧输出地。
+    从配置中删除的日志器恢复为默认的终端输出。
+*/
+static void ReplaceAppenders(Logger::ptr logger, const std::vector<LogAppender::ptr>& appenders){
+    std::vector<LogAppender::ptr> previous = logger->getAppenders();
+    logger->setAppenders(appenders);
+    RcuDomain::Get().synchronize();
+    for(auto& p : previous){
+        p->flush();
+    }
+}
+
+struct LogIniter{
+    LogIniter(){
+        g_log_defines->addListener([](const std::set<LogDefine>& old_value, const std::set<LogDefine>& new_value){
+            static Mutex s_mutex;
+            ScopeLock lock(&s_mutex);
+            auto manager = LoggerManager::getInstance();
+            for(auto& ld : new_value){
+                auto old = old_value.find(ld);
+                if(old != old_value.end() && *old == ld){
+                    continue;
+                }
+                Logger::ptr logger = manager->getLogger(ld.name);
+                std::string pattern = ld.formatter.empty() ? CAIZI_LOG_DEFAULT_PATTERN : ld.formatter;
+                if(old == old_value.end() || old->formatter != ld.formatter){
+                    logger->setFormatter(pattern);
+                }
+                if(old == old_value.end() || old->appenders != ld.appenders){
+                    std::vector<LogAppender::ptr> appenders;
+                    for(auto& a : ld.appenders){
+                        LogAppender::ptr appender = CreateAppender(a);
+                        if(appender){
+                            appenders.push_back(appender);
+                        }
+                    }
+                    ReplaceAppenders(logger, appenders);
+                }
+                if(ld.queue_capacity){
+                    AsyncLogWorker::getInstance()->setQueueCapacity(ld.queue_capacity);
+                }
+                if(ld.overflow_policy >= 0){
+                    AsyncLogWorker::getInstance()->setOverflowPolicy((LogOverflowPolicy)ld.overflow_policy);
+                }
+                logger->setLevel(ld.level);
+                logger->setAsync(ld.async);
+            }
+            for(auto& ld : old_value){
+                if(new_value.count(ld)){
+                    continue;
+                }
+                Logger::ptr logger = manager->getLogger(ld.name);
+                logger->setFormatter(CAIZI_LOG_DEFAULT_PATTERN);
+                ReplaceAppenders(logger, {std::make_shared<StdoutLogAppender>(LogLevel::DEBUG)});
+                logger->setLevel(LogLevel::DEBUG);
+                logger->setAsync(false);
+            }
+        });
+    }
+};
+
+static LogIniter __log_init;
+
+/*
+    __LogTicker 日志的周期任务
+*/
+static thread_local bool t_is_log_ticker = false;
+
+__LogTicker::__LogTicker(){
+}
+
+__LogTicker::~__LogTicker(){
+    m_stopping.store(true, std::memory_order_release);
+    if(m_thread){
+        m_thread->join();
+    }
+}
+
+uint64_t __LogTicker::addTask(Task task){
+    ScopeLock lock(&m_mutex);
+    uint64_t id = m_next_id++;
+    m_tasks[id] = std::move(task);
+    if(!m_thread){
+        m_thread.reset(new Thread(std::bind(&__LogTicker::run, this), "log_ticker"));
+    }
+    return id;
+}
+
+void __LogTicker::delTask(uint64_t id){
+    {
+        ScopeLock lock(&m_mutex);
+        m_tasks.erase(id);
+    }
+    if(!t_is_log_ticker){
+        // 等待正在执行的一轮结束
+        ScopeLock run_lock(&m_run_mutex);
+    }
+}
+
+void __LogTicker::run(){
+    t_is_log_ticker = true;
+    std::vector<std::pair<uint64_t, Task>> tasks;
+    while(!m_stopping.load(std::memory_order_acquire)){
+        usleep(TICK_MS * 1000);
+        ScopeLock run_lock(&m_run_mutex);
+        {
+            ScopeLock lock(&m_mutex);
+            tasks.assign(m_tasks.begin(), m_tasks.end());
+        }
+        uint64_t now = CoarseClock::NowMS();
+        for(auto& task : tasks){
+            {
+                // 本轮中被删除的任务不再调用
+                ScopeLock lock(&m_mutex);
+                if(!m_tasks.count(task.first)){
+                    continue;
+                }
+            }
+            task.second(now);
+        }
+        tasks.clear();
+    }
+}
+
+}
@@ -9,15 +9,41 @@
 #include <list>
 #include <sstream>
 #include <map>
+#include <atomic>
+#include <string_view>
+#include <cstdarg>
+#include <cstring>
+#include <type_traits>
+#include <functional>
+#include "clock.h"
+#include "rcu.h"
 #include "thread.h"
 #include "singleton.h"
+#include "ringbuffer.h"
 
-// 日志输出
-#define MAKE_LOG_EVENT(level, message) \
-    std::make_shared<caizi::LogEvent>(__FILE__, __LINE__, 0, 0, ::time(nullptr), message, " ", level)
+// 编译期的最低日志级别(取值同LogLevel::Level)，低于该级别的日志调用整体被编译器消除
+// 例如Release构建定义CAIZI_LOG_MIN_LEVEL=2即可去掉所有DEBUG日志
+#ifndef CAIZI_LOG_MIN_LEVEL
+#define CAIZI_LOG_MIN_LEVEL 1
+#endif
 
-#define LOG_LEVEL(logger, level, message) \
-    logger->log(level, MAKE_LOG_EVENT(level, message));
+#define CAIZI_LOG_LEVEL_COMPILED(level) ((level) >= CAIZI_LOG_MIN_LEVEL)
+
+// 先检查日志级别，未启用时不会对message求值，也不会构造日志事件
+// 日志事件取自线程局部的事件池，稳态下一次日志调用不分配堆内存
+#define LOG_LEVEL(logger, level, message)                                   \
+do{                                                                         \
+    if(CAIZI_LOG_LEVEL_COMPILED(level)){                                    \
+        auto&& __caizi_logger = (logger);                                   \
+        if(__caizi_logger->isEnabled(level)){                               \
+            static caizi::LogSite __caizi_site(__FILE__, __LINE__, nullptr);\
+            caizi::LogEventGuard __caizi_ev(level, __FILE__, __LINE__);     \
+            __caizi_ev->setSite(&__caizi_site);                             \
+            __caizi_ev->setContent(message);                                \
+            __caizi_logger->log(level, *__caizi_ev);                        \
+        }                                                                   \
+    }                                                                       \
+}while(0)
 
 #define LOG_DEBUG(logger, message) LOG_LEVEL(logger, caizi::LogLevel::DEBUG, message)
 #define LOG_INFO(logger, message) LOG_LEVEL(logger, caizi::LogLevel::INFO, message)
@@ -25,25 +51,182 @@
 #define LOG_ERROR(logger, message) LOG_LEVEL(logger, caizi::LogLevel::ERROR, message)
 #define LOG_FATAL(logger, message) LOG_LEVEL(logger, caizi::LogLevel::FATAL, message)
 
-// 格式化的日志输出
-#define LOG_FMT_LEVEL(logger, level, format, argv...)   \
-{                                                       \
-    char* b = nullptr;                                  \
-    int l = asprintf(&b, format, argv);                 \
-    if(l != -1){                                        \
-        LOG_LEVEL(logger, level, std::string(b,l));      \
-        free(b);                                        \
-    }                                                   \
-}                                                       
-
-#define LOG_FMT_DEBUG(logger, format, argv...) LOG_FMT_LEVEL(logger, caizi::LogLevel::DEBUG, format, argv)
-#define LOG_FMT_INFO(logger, format, argv...) LOG_FMT_LEVEL(logger, caizi::LogLevel::INFO, format, argv)
-#define LOG_FMT_WARN(logger, format, argv...) LOG_FMT_LEVEL(logger, caizi::LogLevel::WARN, format, argv)
-#define LOG_FMT_ERROR(logger, format, argv...) LOG_FMT_LEVEL(logger, caizi::LogLevel::ERROR, format, argv)
-#define LOG_FMT_FATAL(logger, format, argv...) LOG_FMT_LEVEL(logger, caizi::LogLevel::FATAL, format, argv)
+// 格式化的日志输出，级别未启用时不会对参数求值
+// format是字符串字面量时，调用时只记录调用点和类型化的参数，文本在输出地格式化时才生成
+// (异步模式下在后台线程)，二进制输出地直接写入原始参数；
+// 其它格式串(变量、缓冲区)在调用线程上立即格式化
+#define LOG_FMT_LEVEL(logger, level, format, argv...)                       \
+do{                                                                         \
+    if(CAIZI_LOG_LEVEL_COMPILED(level)){                                    \
+        auto&& __caizi_logger = (logger);                                   \
+        if(__caizi_logger->isEnabled(level)){                               \
+            if(false){                                                      \
+                caizi::CheckLogFormat(format, ##argv);                      \
+            }                                                               \
+            typedef caizi::LogFormatLiteral<decltype(format)> __caizi_literal;\
+            static caizi::LogSite __caizi_site(__FILE__, __LINE__,          \
+                    __caizi_literal::value ? (const char*)(format) : nullptr);\
+            caizi::LogEventGuard __caizi_ev(level, __FILE__, __LINE__);     \
+            if(__caizi_literal::value){                                     \
+                __caizi_ev->setFormatArgs(&__caizi_site, ##argv);           \
+            }else{                                                          \
+                __caizi_ev->setSite(&__caizi_site);                         \
+                __caizi_ev->printf(format, ##argv);                         \
+            }                                                               \
+            __caizi_logger->log(level, *__caizi_ev);                        \
+        }                                                                   \
+    }                                                                       \
+}while(0)
+
+#define LOG_FMT_DEBUG(logger, format, argv...) LOG_FMT_LEVEL(logger, caizi::LogLevel::DEBUG, format, ##argv)
+#define LOG_FMT_INFO(logger, format, argv...) LOG_FMT_LEVEL(logger, caizi::LogLevel::INFO, format, ##argv)
+#define LOG_FMT_WARN(logger, format, argv...) LOG_FMT_LEVEL(logger, caizi::LogLevel::WARN, format, ##argv)
+#define LOG_FMT_ERROR(logger, format, argv...) LOG_FMT_LEVEL(logger, caizi::LogLevel::ERROR, format, ##argv)
+#define LOG_FMT_FATAL(logger, format, argv...) LOG_FMT_LEVEL(logger, caizi::LogLevel::FATAL, format, ##argv)
+
+// 结构化日志：message之后依次为键和值，键为字符串，值为整数、布尔、浮点、字符串或指针
+// 字段按类型编码存入事件，不先格式化成文本，例如
+//     LOG_KV_INFO(logger, "request done", "path", path, "status", 200, "cost_ms", 1.5);
+#define LOG_KV_LEVEL(logger, level, message, kvs...)                        \
+do{                                                                         \
+    if(CAIZI_LOG_LEVEL_COMPILED(level)){                                    \
+        auto&& __caizi_logger = (logger);                                   \
+        if(__caizi_logger->isEnabled(level)){                               \
+            static caizi::LogSite __caizi_site(__FILE__, __LINE__, nullptr);\
+            caizi::LogEventGuard __caizi_ev(level, __FILE__, __LINE__);     \
+            __caizi_ev->setSite(&__caizi_site);                             \
+            __caizi_ev->setContent(message);                                \
+            __caizi_ev->setFields(kvs);                                     \
+            __caizi_logger->log(level, *__caizi_ev);                        \
+        }                                                                   \
+    }                                                                       \
+}while(0)
+
+#define LOG_KV_DEBUG(logger, message, kvs...) LOG_KV_LEVEL(logger, caizi::LogLevel::DEBUG, message, ##kvs)
+#define LOG_KV_INFO(logger, message, kvs...) LOG_KV_LEVEL(logger, caizi::LogLevel::INFO, message, ##kvs)
+#define LOG_KV_WARN(logger, message, kvs...) LOG_KV_LEVEL(logger, caizi::LogLevel::WARN, message, ##kvs)
+#define LOG_KV_ERROR(logger, message, kvs...) LOG_KV_LEVEL(logger, caizi::LogLevel::ERROR, message, ##kvs)
+#define LOG_KV_FATAL(logger, message, kvs...) LOG_KV_LEVEL(logger, caizi::LogLevel::FATAL, message, ##kvs)
+
+// 限流的日志：每个调用点每秒最多输出per_second条，多出的被丢弃并按日志器计数。
+// 被丢弃的条数在窗口结束后由LogTicker的后台线程向对应的日志器报告，窗口内再有日志放行时先在它前面报告。
+// 判断只是几次原子操作，被丢弃时不会对参数求值
+#define LOG_RATE_LEVEL(logger, level, per_second, message)                  \
+do{                                                                         \
+    if(CAIZI_LOG_LEVEL_COMPILED(level)){                                    \
+        auto&& __caizi_rl_logger = (logger);                                \
+        if(__caizi_rl_logger->isEnabled(level)){                            \
+            static caizi::LogRateLimit __caizi_limit(__FILE__, __LINE__);   \
+            uint64_t __caizi_suppressed = 0;                                \
+            if(__caizi_limit.allow(*__caizi_rl_logger, per_second, __caizi_suppressed)){\
+                if(__caizi_suppressed){                                     \
+                    caizi::LogSuppressed(*__caizi_rl_logger, level, __FILE__, __LINE__, __caizi_suppressed);\
+                }                                                           \
+                LOG_LEVEL(__caizi_rl_logger, level, message);               \
+            }else{                                                          \
+                __caizi_limit.suppress(*__caizi_rl_logger, level);          \
+            }                                                               \
+        }                                                                   \
+    }                                                                       \
+}while(0)
+
+#define LOG_FMT_RATE_LEVEL(logger, level, per_second, format, argv...)      \
+do{                                                                         \
+    if(CAIZI_LOG_LEVEL_COMPILED(level)){                                    \
+        auto&& __caizi_rl_logger = (logger);                                \
+        if(__caizi_rl_logger->isEnabled(level)){                            \
+            static caizi::LogRateLimit __caizi_limit(__FILE__, __LINE__);   \
+            uint64_t __caizi_suppressed = 0;                                \
+            if(__caizi_limit.allow(*__caizi_rl_logger, per_second, __caizi_suppressed)){\
+                if(__caizi_suppressed){                                     \
+                    caizi::LogSuppressed(*__caizi_rl_logger, level, __FILE__, __LINE__, __caizi_suppressed);\
+                }                                                           \
+                LOG_FMT_LEVEL(__caizi_rl_logger, level, format, ##argv);    \
+            }else{                                                          \
+                __caizi_limit.suppress(*__caizi_rl_logger, level);          \
+            }                                                               \
+        }                                                                   \
+    }                                                                       \
+}while(0)
+
+// 采样的日志：每个调用点每k次调用输出第一次，其余不求值直接跳过
+#define LOG_SAMPLE_LEVEL(logger, level, k, message)                         \
+do{                                                                         \
+    if(CAIZI_LOG_LEVEL_COMPILED(level)){                                    \
+        auto&& __caizi_rl_logger = (logger);                                \
+        if(__caizi_rl_logger->isEnabled(level)){                            \
+            static caizi::LogSampler __caizi_sampler;                       \
+            if(__caizi_sampler.allow(k)){                                   \
+                LOG_LEVEL(__caizi_rl_logger, level, message);               \
+            }                                                               \
+        }                                                                   \
+    }                                                                       \
+}while(0)
+
+#define LOG_FMT_SAMPLE_LEVEL(logger, level, k, format, argv...)             \
+do{                                                                         \
+    if(CAIZI_LOG_LEVEL_COMPILED(level)){                                    \
+        auto&& __caizi_rl_logger = (logger);                                \
+        if(__caizi_rl_logger->isEnabled(level)){                            \
+            static caizi::LogSampler __caizi_sampler;                       \
+            if(__caizi_sampler.allow(k)){                                   \
+                LOG_FMT_LEVEL(__caizi_rl_logger, level, format, ##argv);    \
+            }                                                               \
+        }                                                                   \
+    }                                                                       \
+}while(0)
+
+#define LOG_RATE_DEBUG(logger, per_second, message) LOG_RATE_LEVEL(logger, caizi::LogLevel::DEBUG, per_second, message)
+#define LOG_RATE_INFO(logger, per_second, message) LOG_RATE_LEVEL(logger, caizi::LogLevel::INFO, per_second, message)
+#define LOG_RATE_WARN(logger, per_second, message) LOG_RATE_LEVEL(logger, caizi::LogLevel::WARN, per_second, message)
+#define LOG_RATE_ERROR(logger, per_second, message) LOG_RATE_LEVEL(logger, caizi::LogLevel::ERROR, per_second, message)
+#define LOG_RATE_FATAL(logger, per_second, message) LOG_RATE_LEVEL(logger, caizi::LogLevel::FATAL, per_second, message)
+
+#define LOG_FMT_RATE_DEBUG(logger, per_second, format, argv...) LOG_FMT_RATE_LEVEL(logger, caizi::LogLevel::DEBUG, per_second, format, ##argv)
+#define LOG_FMT_RATE_INFO(logger, per_second, format, argv...) LOG_FMT_RATE_LEVEL(logger, caizi::LogLevel::INFO, per_second, format, ##argv)
+#define LOG_FMT_RATE_WARN(logger, per_second, format, argv...) LOG_FMT_RATE_LEVEL(logger, caizi::LogLevel::WARN, per_second, format, ##argv)
+#define LOG_FMT_RATE_ERROR(logger, per_second, format, argv...) LOG_FMT_RATE_LEVEL(logger, caizi::LogLevel::ERROR, per_second, format, ##argv)
+#define LOG_FMT_RATE_FATAL(logger, per_second, format, argv...) LOG_FMT_RATE_LEVEL(logger, caizi::LogLevel::FATAL, per_second, format, ##argv)
+
+#define LOG_SAMPLE_DEBUG(logger, k, message) LOG_SAMPLE_LEVEL(logger, caizi::LogLevel::DEBUG, k, message)
+#define LOG_SAMPLE_INFO(logger, k, message) LOG_SAMPLE_LEVEL(logger, caizi::LogLevel::INFO, k, message)
+#define LOG_SAMPLE_WARN(logger, k, message) LOG_SAMPLE_LEVEL(logger, caizi::LogLevel::WARN, k, message)
+#define LOG_SAMPLE_ERROR(logger, k, message) LOG_SAMPLE_LEVEL(logger, caizi::LogLevel::ERROR, k, message)
+#define LOG_SAMPLE_FATAL(logger, k, message) LOG_SAMPLE_LEVEL(logger, caizi::LogLevel::FATAL, k, message)
+
+#define LOG_FMT_SAMPLE_DEBUG(logger, k, format, argv...) LOG_FMT_SAMPLE_LEVEL(logger, caizi::LogLevel::DEBUG, k, format, ##argv)
+#define LOG_FMT_SAMPLE_INFO(logger, k, format, argv...) LOG_FMT_SAMPLE_LEVEL(logger, caizi::LogLevel::INFO, k, format, ##argv)
+#define LOG_FMT_SAMPLE_WARN(logger, k, format, argv...) LOG_FMT_SAMPLE_LEVEL(logger, caizi::LogLevel::WARN, k, format, ##argv)
+#define LOG_FMT_SAMPLE_ERROR(logger, k, format, argv...) LOG_FMT_SAMPLE_LEVEL(logger, caizi::LogLevel::ERROR, k, format, ##argv)
+#define LOG_FMT_SAMPLE_FATAL(logger, k, format, argv...) LOG_FMT_SAMPLE_LEVEL(logger, caizi::LogLevel::FATAL, k, format, ##argv)
+
+// 单条日志内容的最大长度，超出部分被截断
+#ifndef CAIZI_LOG_CONTENT_SIZE
+#define CAIZI_LOG_CONTENT_SIZE 512
+#endif
+
+// 事件内编码格式化参数的空间，至少能放下一条日志内容长的字符串参数
+// 放不下时在调用线程上立即格式化，字符串参数不会被截断
+#ifndef CAIZI_LOG_ARGS_SIZE
+#define CAIZI_LOG_ARGS_SIZE (CAIZI_LOG_CONTENT_SIZE + 128)
+#endif
+
+// 结构化字段编码后的最大总长度，超出的字段被丢弃
+#ifndef CAIZI_LOG_FIELDS_SIZE
+#define CAIZI_LOG_FIELDS_SIZE 256
+#endif
+
+// 格式化后单行日志的最大长度
+#ifndef CAIZI_LOG_LINE_SIZE
+#define CAIZI_LOG_LINE_SIZE 4096
+#endif
+
+// 日志器的默认格式：日期时间 级别 线程名 线程id 文件名 行号 消息
+#define CAIZI_LOG_DEFAULT_PATTERN "%d%s%p%s%n%s%t%s%f%s%l%s%m"
 
 #define CAIZI_GET_ROOT_LOGGER() caizi::LoggerManager::getInstance()->getGlobalLogger()
 #define CAIZI_GET_LOGGER(name) caizi::LoggerManager::getInstance()->getLogger(name)
+#define GET_ROOT_LOGGER() CAIZI_GET_ROOT_LOGGER()
 
 namespace caizi{
 
@@ -64,55 +247,472 @@ public:
         WARN = 3,
         ERROR = 4,
         FATAL = 5,
+        // 只用作日志器和输出地的级别，关闭全部输出
+        OFF = 6,
     };
 
     static std::string levelToString(LogLevel::Level level);
+    // 返回静态字符串，格式化日志时使用，不分配内存
+    static const char* ToString(LogLevel::Level level);
     static LogLevel::Level stringToLevel(const std::string& str);
 };
 
-// 日志事件
+/*
+    定长缓冲区，写满后截断，不分配堆内存
+    日志内容和格式化后的整行日志都写入这种缓冲区
+*/
+template<size_t SIZE>
+class FixedBuffer{
+public:
+    void append(const char* str, size_t len){
+        if(len > avail()){
+            len = avail();
+        }
+        memcpy(m_data + m_size, str, len);
+        m_size += len;
+    }
+    void append(std::string_view str) { append(str.data(), str.size()); }
+    void append(char c){
+        if(m_size < SIZE){
+            m_data[m_size++] = c;
+        }
+    }
+    void appendUInt(uint64_t value){
+        char tmp[20];
+        size_t n = 0;
+        do{
+            tmp[n++] = '0' + value % 10;
+            value /= 10;
+        }while(value);
+        if(n > avail()){
+            return;
+        }
+        while(n){
+            m_data[m_size++] = tmp[--n];
+        }
+    }
+    void appendInt(int64_t value){
+        if(value < 0){
+            append('-');
+            appendUInt(0 - (uint64_t)value);
+        }else{
+            appendUInt(value);
+        }
+    }
+
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    size_t avail() const { return SIZE - m_size; }
+    static constexpr size_t capacity() { return SIZE; }
+    std::string_view view() const { return std::string_view(m_data, m_size); }
+    void reset() { m_size = 0; }
+    // 丢弃size之后的内容
+    void truncate(size_t size) { if(size < m_size) m_size = size; }
+    // 直接写入缓冲区尾部，写完后用add()提交长度
+    char* current() { return m_data + m_size; }
+    void add(size_t len) { m_size += len; }
+
+private:
+    char m_data[SIZE];
+    size_t m_size = 0;
+};
+
+typedef FixedBuffer<CAIZI_LOG_LINE_SIZE> LogBuffer;
+
+// 把编码后的结构化字段以 key=value 的形式追加到out，字段之间用空格分隔
+void AppendLogFields(LogBuffer& out, std::string_view fields);
+
+// LOG_FMT_*的format是否为字符串字面量，只有字面量的地址在程序运行期间一直有效，可以延迟格式化
+// 具名的字符数组(decltype为const char[N])按普通格式串处理
+template<class T>
+struct LogFormatLiteral : std::false_type{};
+template<size_t N>
+struct LogFormatLiteral<const char(&)[N]> : std::true_type{};
+
+// 只用于让编译器检查LOG_FMT_*的格式串与参数是否匹配，从不调用
+inline void CheckLogFormat(const char* format, ...) __attribute__((format(printf, 1, 2)));
+inline void CheckLogFormat(const char* /*format*/, ...) {}
+
+/*
+    日志调用点
+    每个LOG_*宏展开处有一个静态的LogSite，进程内id唯一。
+    二进制输出地只记录调用点id，文件名、行号和格式串在每个文件段中只写一次。
+*/
+struct LogSite{
+    LogSite(const char* file, uint32_t line, const char* format);
+
+    // 第index个参数对应%p转换
+    bool isPointerArg(uint32_t index) const { return index < 64 && (pointer_args >> index & 1); }
+
+    const char* file;
+    uint32_t line;
+    const char* format;     // 格式串，LOG_LEVEL和非字面量格式串的调用点为nullptr
+    uint32_t id;
+    uint64_t pointer_args;  // 构造时解析格式串得到，前64个参数中对应%p的位
+};
+
+/*
+    调用点的限流状态，每个LOG_*_RATE宏展开处有一个静态实例
+    按秒划分窗口，窗口内计数超过上限的日志被丢弃。同一个调用点可能传入不同的日志器，
+    被丢弃的条数按日志器分开记录，每个日志器第一次被丢弃时登记到全局表，
+    LogTicker的后台线程在窗口结束后向这个日志器报告并清零，之后不再有日志也能看到报告；
+    窗口内该日志器有日志放行时也会先取走它的计数报告，两处用exchange取数，不会重复报告。
+    切换窗口时不加锁，并发下每秒的条数只是近似上限
+*/
+class LogRateLimit{
+public:
+    // 一个日志器在该调用点被丢弃的条数，节点只增不删，日志器释放后由同一地址的新日志器复用
+    struct Suppressed{
+        Logger* logger;
+        std::atomic<uint64_t> count{0};
+        std::atomic<bool> watched{false};
+        Suppressed* next = nullptr;
+    };
+
+    LogRateLimit(const char* file, uint32_t line): m_file(file), m_line(line){}
+
+    // @param[out] suppressed 允许输出且该日志器之前有被丢弃的日志时，返回被丢弃的条数
+    bool allow(Logger& logger, uint32_t per_second, uint64_t& suppressed){
+        uint64_t second = CoarseClock::NowMS() / 1000;
+        uint64_t window = m_window.load(std::memory_order_relaxed);
+        if(window != second && m_window.compare_exchange_strong(window, second, std::memory_order_relaxed)){
+            // 只有切换窗口成功的线程重置计数
+            m_count.store(0, std::memory_order_relaxed);
+        }
+        if(m_count.fetch_add(1, std::memory_order_relaxed) < per_second){
+            Suppressed* node = find(logger);
+            if(node && node->count.load(std::memory_order_relaxed)){
+                suppressed = node->count.exchange(0, std::memory_order_relaxed);
+            }
+            return true;
+        }
+        return false;
+    }
+    // 日志被丢弃后调用，计入该日志器的条数，第一次丢弃时登记，之后只是查找和原子加
+    void suppress(Logger& logger, LogLevel::Level level){
+        Suppressed* node = find(logger);
+        if(!node){
+            node = add(logger);
+        }
+        node->count.fetch_add(1, std::memory_order_relaxed);
+        if(!node->watched.load(std::memory_order_relaxed)){
+            startWatch(*node, logger, level);
+        }
+    }
+    // 窗口已经结束时取走被丢弃的条数，窗口内返回0
+    uint64_t takeExpired(Suppressed& node, uint64_t now_ms){
+        if(m_window.load(std::memory_order_relaxed) == now_ms / 1000
+                || !node.count.load(std::memory_order_relaxed)){
+            return 0;
+        }
+        return node.count.exchange(0, std::memory_order_relaxed);
+    }
+    // 当前累计被丢弃的条数，logger为nullptr时返回所有日志器的总和
+    uint64_t getSuppressed(const Logger* logger = nullptr) const;
+    const char* getFile() const { return m_file; }
+    uint32_t getLine() const { return m_line; }
+
+private:
+    Suppressed* find(const Logger& logger) const{
+        for(Suppressed* node = m_head.load(std::memory_order_acquire); node; node = node->next){
+            if(node->logger == &logger){
+                return node;
+            }
+        }
+        return nullptr;
+    }
+    Suppressed* add(Logger& logger);
+    void startWatch(Suppressed& node, Logger& logger, LogLevel::Level level);
+
+    const char* m_file;
+    uint32_t m_line;
+    std::atomic<uint64_t> m_window{0};
+    std::atomic<uint32_t> m_count{0};
+    std::atomic<Suppressed*> m_head{nullptr};
+};
+
+// 调用点的采样状态，每k次调用放行一次
+class LogSampler{
+public:
+    bool allow(uint64_t k){
+        return k <= 1 || m_calls.fetch_add(1, std::memory_order_relaxed) % k == 0;
+    }
+
+private:
+    std::atomic<uint64_t> m_calls{0};
+};
+
+// 输出一行限流报告："suppressed N messages"，文件名和行号为被限流的调用点
+void LogSuppressed(Logger& logger, LogLevel::Level level, const char* file, uint32_t line, uint64_t count);
+
+/*
+    类型化的格式化参数
+    编码为 [1字节类型][值]，整数、布尔、浮点和指针为8字节，字符串为2字节长度加内容。
+    LogEvent和二进制日志文件使用同一种编码。
+*/
+class LogArgs{
+public:
+    enum Type : uint8_t{
+        INT = 1,
+        UINT = 2,
+        DOUBLE = 3,
+        STRING = 4,
+        POINTER = 5,
+        BOOL = 6,
+    };
+
+    // @param max_string 字符串参数的最大长度，超出部分截断
+    LogArgs(char* buffer, size_t capacity, size_t max_string = UINT16_MAX)
+        :m_buffer(buffer), m_capacity(capacity), m_max_string(std::min<size_t>(max_string, UINT16_MAX)){}
+
+    template<class T>
+    void write(const T& value){
+        typedef typename std::decay<T>::type U;
+        if constexpr (std::is_same<U, bool>::value){
+            writeFixed(BOOL, (uint64_t)value);
+        }else if constexpr (std::is_enum<U>::value){
+            writeFixed(INT, (int64_t)value);
+        }else if constexpr (std::is_integral<U>::value && std::is_signed<U>::value){
+            writeFixed(INT, (int64_t)value);
+        }else if constexpr (std::is_integral<U>::value){
+            writeFixed(UINT, (uint64_t)value);
+        }else if constexpr (std::is_floating_point<U>::value){
+            writeFixed(DOUBLE, (double)value);
+        }else if constexpr (std::is_same<U, char*>::value || std::is_same<U, const char*>::value){
+            if constexpr (std::is_array<T>::value){
+                // 字符数组(包括字符串字面量)不会是空指针，不做判断以免-Waddress
+                writeString(std::string_view(value));
+            }else{
+                writeString(value ? std::string_view(value) : std::string_view("(null)"));
+            }
+        }else if constexpr (std::is_same<U, std::string>::value || std::is_same<U, std::string_view>::value){
+            writeString(value);
+        }else if constexpr (std::is_pointer<U>::value || std::is_same<U, std::nullptr_t>::value){
+            writeFixed(POINTER, (uint64_t)(uintptr_t)value);
+        }else{
+            static_assert(std::is_pointer<U>::value, "LogArgs: unsupported argument type");
+        }
+    }
+
+    // 对应%p转换的字符串指针按指针编码，输出地址而不是内容
+    template<class T>
+    void writeArg(const LogSite* site, uint32_t index, const T& value){
+        typedef typename std::decay<T>::type U;
+        if constexpr (std::is_same<U, char*>::value || std::is_same<U, const char*>::value){
+            if(site->isPointerArg(index)){
+                writeFixed(POINTER, (uint64_t)(uintptr_t)value);
+                return;
+            }
+        }
+        write(value);
+    }
+
+    const char* data() const { return m_buffer; }
+    size_t size() const { return m_size; }
+    // 有参数因空间不足没有写入
+    bool overflow() const { return m_overflow; }
+
+    /*
+        按printf格式串把编码后的参数渲染成文本
+        每个转换说明取下一个参数，按参数的实际类型输出，格式串与参数不符时不会越界读取
+        @return 写入out的长度
+    */
+    static size_t Render(char* out, size_t capacity, const char* format,
+                         const char* args, size_t args_size);
+
+private:
+    template<class V>
+    void writeFixed(Type type, V value){
+        if(m_size + 1 + sizeof(V) > m_capacity){
+            m_overflow = true;
+            return;
+        }
+        m_buffer[m_size] = type;
+        memcpy(m_buffer + m_size + 1, &value, sizeof(V));
+        m_size += 1 + sizeof(V);
+    }
+    void writeString(std::string_view str){
+        uint16_t len = std::min(str.size(), m_max_string);
+        if(m_size + 3 + len > m_capacity){
+            m_overflow = true;
+            return;
+        }
+        m_buffer[m_size] = STRING;
+        memcpy(m_buffer + m_size + 1, &len, sizeof(len));
+        memcpy(m_buffer + m_size + 3, str.data(), len);
+        m_size += 3 + len;
+    }
+
+    char* m_buffer;
+    size_t m_capacity;
+    size_t m_max_string;
+    size_t m_size = 0;
+    bool m_overflow = false;
+};
+
+// 解码后的一个参数，整数和浮点值同时换算成另外两种类型
+struct LogArgValue{
+    uint8_t type = 0;
+    int64_t i = 0;
+    uint64_t u = 0;
+    double d = 0;
+    const char* str = nullptr;
+    uint16_t len = 0;
+};
+
+// 依次读取LogArgs编码的参数
+class LogArgReader{
+public:
+    LogArgReader(const char* args, size_t size): m_args(args), m_size(size){}
+    LogArgReader(std::string_view args): m_args(args.data()), m_size(args.size()){}
+
+    // 读取下一个参数，读完或数据不完整返回false
+    bool next(LogArgValue& val);
+private:
+    const char* m_args;
+    size_t m_size;
+    size_t m_pos = 0;
+};
+
+/*
+    日志事件
+    定长的值类型，所有字段都存放在对象内部：文件名指向__FILE__静态字符串，
+    线程名和日志内容拷贝到定长数组中。事件由LogEventGuard从线程局部的事件池取得，
+    异步模式下直接拷贝进环形队列的槽位，整个过程不分配堆内存。
+*/
 class LogEvent{
 public:
-    LogEvent(const std::string& filename,
-             uint32_t line,
-             uint32_t threadID,
-             uint32_t fiberID,
-             time_t time,
-             const std::string& content,
-             const std::string& division = " ",
-             LogLevel::Level level = LogLevel::DEBUG);
+    LogEvent() = default;
+    LogEvent(const LogEvent& other){ *this = other; }
+    // 只拷贝已使用的内容
+    LogEvent& operator=(const LogEvent& other);
 
-    // LogEvent(const std::string content);
-    typedef std::shared_ptr<LogEvent> ptr;
+    // 重置事件并填写事件头，线程号和线程名取自当前线程
+    void init(LogLevel::Level level, const char* filename, uint32_t line);
 
     LogLevel::Level getLevel() const { return m_level; }
-    const std::string& getFilename() const { return m_filename;}
+    const char* getFilename() const { return m_filename;}
     uint32_t getLine() const { return m_line; }
     uint32_t getElapse() const {return m_elapse;}
     uint64_t getTime() const { return m_time; }
-    const std::string& getThreadName() const {return m_threadName;}
+    std::string_view getThreadName() const {return std::string_view(m_threadName);}
     uint32_t getThreadId() const { return m_threadID; }
     uint32_t getFiberId() const { return m_fiberID; }
-    const std::string& getContent() const { return m_content; }
-    const std::string& getDivision() const { return m_division; }
+    // 格式化日志的文本在第一次取用时才生成
+    std::string_view getContent() const;
+    const char* getDivision() const { return m_division; }
+    const LogSite* getSite() const { return m_site; }
+    // 编码后的格式化参数，非格式化日志和已立即格式化的日志为空
+    std::string_view getArgs() const { return std::string_view(m_args, m_args_size); }
+    // 内容由调用点的格式串和getArgs()延迟生成
+    bool hasFormatArgs() const { return m_format_args; }
+    // 编码后的结构化字段，键和值依次排列，用LogArgReader读取
+    std::string_view getFields() const { return std::string_view(m_fields, m_fields_size); }
 
     void setLevel(LogLevel::Level level) { m_level = level; }
+    void setLine(uint32_t val) { m_line = val; }
+    void setThreadId(uint32_t val) { m_threadID = val; }
+    void setThreadName(std::string_view name);
+    void setFiberId(uint32_t val) { m_fiberID = val; }
+    void setTime(uint64_t val) { m_time = val; }
+    void setElapse(uint32_t val) { m_elapse = val; }
+    void setSite(const LogSite* site) { m_site = site; }
+    // 记录调用点和参数，不做格式化
+    template<class... Args>
+    void setFormatArgs(const LogSite* site, const Args&... args){
+        m_site = site;
+        m_content_size = 0;
+        m_rendered = false;
+        m_format_args = true;
+        LogArgs writer(m_args, sizeof(m_args));
+        uint32_t index = 0;
+        (writer.writeArg(site, index++, args), ...);
+        if(writer.overflow()){
+            // 参数放不下时编码到线程局部的大缓冲区并立即格式化
+            LogArgs large(GetOverflowArgsBuffer(), s_overflow_args_size, sizeof(m_content));
+            index = 0;
+            (large.writeArg(site, index++, args), ...);
+            renderArgs(large);
+            return;
+        }
+        (void)index;
+        m_args_size = writer.size();
+    }
+    // 设置结构化字段：依次为键和值
+    template<class... Args>
+    void setFields(const Args&... kvs){
+        static_assert(sizeof...(Args) % 2 == 0, "LogEvent::setFields: keys and values must be paired");
+        m_fields_size = 0;
+        addFields(kvs...);
+    }
+    // 追加一个字段，剩余空间放不下时丢弃整个字段
+    template<class T>
+    void addField(std::string_view key, const T& value){
+        char tmp[CAIZI_LOG_FIELDS_SIZE];
+        LogArgs writer(tmp, sizeof(tmp));
+        writer.write(key);
+        size_t key_size = writer.size();
+        writer.write(value);
+        if(writer.size() == key_size || m_fields_size + writer.size() > sizeof(m_fields)){
+            return;
+        }
+        memcpy(m_fields + m_fields_size, tmp, writer.size());
+        m_fields_size += writer.size();
+    }
+    void setContent(std::string_view content);
+    void appendContent(std::string_view content);
+    void printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+    void vprintf(const char* format, va_list ap);
+
+private:
+    static const size_t s_overflow_args_size = 64 * 1024;
+    static char* GetOverflowArgsBuffer();
+    // 立即把参数渲染成内容，不再保留参数
+    void renderArgs(const LogArgs& args);
+
+    void addFields(){}
+    template<class K, class V, class... Args>
+    void addFields(const K& key, const V& value, const Args&... kvs){
+        addField(key, value);
+        addFields(kvs...);
+    }
+
+    LogLevel::Level m_level = LogLevel::DEBUG;  //日志等级
+    const char* m_filename = "";                //文件名，指向静态字符串
+    int32_t m_line = 0;                         //行号
+    uint32_t m_elapse = 0;                      //程序启动流逝时间
+    uint32_t m_threadID = 0;                    //线程号
+    uint32_t m_fiberID = 0;                     //协程号
+    uint64_t m_time = 0;                        //时间戳
+    const char* m_division = " ";               //分隔符
+    const LogSite* m_site = nullptr;            //调用点
+    mutable bool m_rendered = true;             //格式化日志的内容是否已生成
+    bool m_format_args = false;                 //内容由格式串和m_args延迟生成
+    mutable uint32_t m_content_size = 0;        //日志内容长度
+    uint32_t m_args_size = 0;                   //格式化参数长度
+    uint32_t m_fields_size = 0;                 //结构化字段长度
+    char m_threadName[16] = {0};                //线程名称，与pthread线程名长度一致
+    mutable char m_content[CAIZI_LOG_CONTENT_SIZE]; //日志内容
+    char m_args[CAIZI_LOG_ARGS_SIZE];           //编码后的格式化参数
+    char m_fields[CAIZI_LOG_FIELDS_SIZE];       //编码后的结构化字段
+};
 
+// 从线程局部的事件池中借出一个LogEvent，离开作用域时归还
+// 日志嵌套过深、池中没有空闲事件时才会在堆上分配
+class LogEventGuard : public Noncopyable{
+public:
+    LogEventGuard(LogLevel::Level level, const char* filename, uint32_t line);
+    ~LogEventGuard();
+
+    LogEvent* operator->() { return m_event; }
+    LogEvent& operator*() { return *m_event; }
 private:
-    LogLevel::Level m_level;                  //日志等级
-    const std::string m_filename = nullptr;   //文件名
-    int32_t m_line = 0;                       //行号
-    uint32_t m_elapse = 0;                    //程序启动流逝时间
-    uint32_t m_threadID = 0;                  //线程号
-    uint32_t m_fiberID = 0;                   //协程号
-    uint64_t m_time = 0;                      //时间戳
-    std::string m_threadName;                 //线程名称
-    std::string m_content;                    //日志内容
-    std::string m_division;
+    LogEvent* m_event;
+    bool m_pooled;
 };
 
 // 日志格式
-// 通过format()传入LogEvent实例，返回格式化后的字符串
+// 通过format()传入LogEvent实例，把格式化后的文本追加到缓冲区
 class LogFormatter{
 public:
     typedef std::shared_ptr<LogFormatter> ptr;
@@ -120,15 +720,24 @@ public:
     class FormatItem{
     public:
         typedef std::shared_ptr<FormatItem> ptr;
-        virtual void format(std::ostream& out, LogLevel::Level level, LogEvent::ptr ev) = 0;
+        virtual ~FormatItem() = default;
+        virtual void format(LogBuffer& out, LogLevel::Level level, const LogEvent& ev) = 0;
     };
 
+    // 格式项：%m 消息 %p 级别 %t 线程id %n 线程名称 %f 文件名 %l 行号
+    //        %d 日期时间(YYYY-mm-dd HH:MM:SS.mmm) %r 启动至今毫秒数 %s 分隔符
+    //        %F 协程id %k 结构化字段(key=value，空格分隔) %% 百分号
+    // 其余字符原样输出
     explicit LogFormatter(const std::string& pattern);
+    virtual ~LogFormatter() = default;
 
+    // @brief 日志格式化 @param[out] out 追加格式化后的文本 @param[in] ev 日志事件
+    virtual void format(LogBuffer& out, LogLevel::Level level, const LogEvent& event);
     // @brief 日志格式化 @param[in] ev 日志事件 @return 格式化后的文本
-    // std::string format(std::ostream& os, LogLevel::Level leve, LogEvent::ptr ev);
-    std::string format(LogLevel::Level level, LogEvent::ptr event);
+    std::string format(LogLevel::Level level, const LogEvent& event);
     const std::string getPatern() const {return m_format_pattern;};
+    // 格式串中是否有无法识别的格式项
+    bool isError() const {return m_error;};
 private:
     // @brief 解析pattern
     void init();
@@ -137,6 +746,87 @@ private:
     bool m_error = false;
 };
 
+/*
+    编译期解析的日志格式
+    格式串在编译期展开成一串内联的追加操作，直接写入LogBuffer，
+    每条日志只有一次虚函数调用。格式串必须是静态存储期的constexpr字符数组：
+        static constexpr char kPattern[] = "%p %f:%l %m";
+        appender->setFormatter(std::make_shared<caizi::StaticLogFormatter<kPattern>>());
+    支持的格式项与LogFormatter相同，未知的格式项在编译期报错。
+    从配置文件读取的格式串仍使用运行时解析的LogFormatter。
+*/
+template<const char* PATTERN>
+class StaticLogFormatter : public LogFormatter{
+public:
+    typedef std::shared_ptr<StaticLogFormatter> ptr;
+
+    StaticLogFormatter(): LogFormatter(PATTERN){}
+
+    using LogFormatter::format;
+    void format(LogBuffer& out, LogLevel::Level level, const LogEvent& event) override{
+        formatFrom<0>(out, level, event);
+    }
+
+private:
+    // 从i开始的原样输出文本的结束位置
+    static constexpr size_t literalEnd(size_t i){
+        while(PATTERN[i] != '\0' && PATTERN[i] != '%'){
+            ++i;
+        }
+        return i;
+    }
+
+    template<char C>
+    static void formatItem(LogBuffer& out, LogLevel::Level level, const LogEvent& ev){
+        if constexpr (C == 'm'){
+            out.append(ev.getContent());
+        }else if constexpr (C == 'p'){
+            out.append(LogLevel::ToString(level));
+        }else if constexpr (C == 't'){
+            out.appendUInt(ev.getThreadId());
+        }else if constexpr (C == 'n'){
+            out.append(ev.getThreadName());
+        }else if constexpr (C == 'f'){
+            out.append(ev.getFilename());
+        }else if constexpr (C == 'l'){
+            out.appendUInt(ev.getLine());
+        }else if constexpr (C == 'd'){
+            if(out.avail() >= CoarseClock::DATETIME_SIZE){
+                out.add(CoarseClock::FormatDateTime(ev.getTime(), out.current()));
+            }
+        }else if constexpr (C == 'r'){
+            out.appendUInt(ev.getElapse());
+        }else if constexpr (C == 's'){
+            out.append(ev.getDivision());
+        }else if constexpr (C == 'F'){
+            out.appendUInt(ev.getFiberId());
+        }else if constexpr (C == 'k'){
+            AppendLogFields(out, ev.getFields());
+        }else{
+            static_assert(C == 'm', "StaticLogFormatter: unknown format item");
+        }
+    }
+
+    template<size_t I>
+    static void formatFrom(LogBuffer& out, LogLevel::Level level, const LogEvent& ev){
+        if constexpr (PATTERN[I] == '\0'){
+            return;
+        }else if constexpr (PATTERN[I] == '%' && PATTERN[I + 1] == '\0'){
+            out.append('%');
+        }else if constexpr (PATTERN[I] == '%' && PATTERN[I + 1] == '%'){
+            out.append('%');
+            formatFrom<I + 2>(out, level, ev);
+        }else if constexpr (PATTERN[I] == '%'){
+            formatItem<PATTERN[I + 1]>(out, level, ev);
+            formatFrom<I + 2>(out, level, ev);
+        }else{
+            constexpr size_t end = literalEnd(I);
+            out.append(PATTERN + I, end - I);
+            formatFrom<end>(out, level, ev);
+        }
+    }
+};
+
 // 日志输出地 基类
 class LogAppender{
 friend class Logger;
@@ -145,7 +835,9 @@ public:
 
     explicit LogAppender(LogLevel::Level level = LogLevel::DEBUG);
     virtual ~LogAppender() = default;
-    virtual void log(LogLevel::Level level, LogEvent::ptr ev) = 0;
+    virtual void log(LogLevel::Level level, const LogEvent& ev) = 0;
+    // 把缓冲中的日志写出，默认无缓冲
+    virtual void flush() {}
 
     void setFormatter(LogFormatter::ptr val);
     LogFormatter::ptr getFormatter();
@@ -165,23 +857,55 @@ public:
     Logger();
     Logger(const std::string& name);
     Logger(const std::string& name, LogLevel::Level, const std::string &pattern);
-    void log(LogLevel::Level level, LogEvent::ptr event);    
+    // 同步模式下直接写入输出地；异步模式下投递到后台线程
+    void log(LogLevel::Level level, const LogEvent& event);    
     void addAppender(LogAppender::ptr appender);
     void delAppender(LogAppender::ptr appender);
     void clearAppedners();
-    LogLevel::Level getLevel(){return m_level;};
-    void setLevel(LogLevel::Level level){m_level = level;};
+    // 一次性替换全部输出地，写日志的线程看到的要么是旧列表要么是新列表
+    void setAppenders(const std::vector<LogAppender::ptr>& appenders);
+    std::vector<LogAppender::ptr> getAppenders() const;
+    // 写出所有输出地缓冲中的日志
+    void flush();
+    LogLevel::Level getLevel() const {return m_level.load(std::memory_order_relaxed);};
+    void setLevel(LogLevel::Level level){m_level.store(level, std::memory_order_relaxed);};
+    // 日志宏在构造日志事件之前调用，只是一次原子读
+    bool isEnabled(LogLevel::Level level) const {return level >= m_level.load(std::memory_order_relaxed);};
     const std::string& getName() const {return m_name;};
     void setFormatter(LogFormatter::ptr val);
-    void setFormatter(const std::string& val);
+    // 格式串有误时保留原来的格式并返回false
+    bool setFormatter(const std::string& val);
     LogFormatter::ptr getFormatter();
+    // 不经过日志宏的结构化日志，kvs依次为键和值，没有文件名和行号
+    template<class... Args>
+    void logFields(LogLevel::Level level, std::string_view message, const Args&... kvs){
+        if(!isEnabled(level)){
+            return;
+        }
+        LogEventGuard ev(level, "", 0);
+        ev->setContent(message);
+        ev->setFields(kvs...);
+        log(level, *ev);
+    }
+    // 开启后日志事件由AsyncLogWorker的后台线程批量写出
+    void setAsync(bool val){ m_async.store(val, std::memory_order_relaxed); };
+    bool isAsync() const { return m_async.load(std::memory_order_relaxed); };
 
 private:
+    friend class __AsyncLogWorker;
+    // 遍历输出器，在调用线程上输出日志
+    void writeToAppenders(LogLevel::Level level, const LogEvent& event);
+
+    typedef std::vector<LogAppender::ptr> AppenderList;
+
     std::string m_name;
-    LogLevel::Level m_level;
+    std::atomic<LogLevel::Level> m_level;
     LogFormatter::ptr m_formatter;
-    std::list<LogAppender::ptr> m_appenders;
+    // 输出地列表的不可变快照，写日志时不加锁遍历，增删输出地时整体替换
+    RcuPtr<AppenderList> m_appenders;
     std::string m_format_pattern;
+    std::atomic<bool> m_async{false};
+    // 串行化输出地和格式的修改，写日志时不使用
     Mutex m_mutex;
 };
 
@@ -191,20 +915,62 @@ public:
     typedef std::shared_ptr<StdoutLogAppender> ptr;
 
     explicit StdoutLogAppender(LogLevel::Level level = LogLevel::DEBUG);
-    void log(LogLevel::Level level, LogEvent::ptr ev) override;
+    void log(LogLevel::Level level, const LogEvent& ev) override;
 
 };
 
+class __LogTicker;
+
 // 日志输出地的派生类，输出到文件
+// 日志先写入用户态缓冲区，缓冲区写满、遇到ERROR/FATAL日志、或距上次写出超过flush_interval时
+// (由LogTicker的后台线程定期检查，没有新日志时也会写出)，才用一次writev写入文件。
+// 写出时在锁内交换前后两块缓冲区，writev在锁外进行，写日志的线程不等待磁盘IO
+// 支持按大小和按时间滚动：当前文件重命名为 filename.YYYYmmdd-HHMMSS 后重新打开
 class FileLogAppender: public LogAppender{
 public:
     typedef std::shared_ptr<FileLogAppender> ptr;
-    explicit FileLogAppender(const std::string &filename,  LogLevel::Level level = LogLevel::DEBUG);
-    void log(LogLevel::Level level, LogEvent::ptr ev) override;
+    explicit FileLogAppender(const std::string &filename,  LogLevel::Level level = LogLevel::DEBUG,
+                             size_t buffer_size = 256 * 1024);
+    ~FileLogAppender();
+    void log(LogLevel::Level level, const LogEvent& ev) override;
+    void flush() override;
+    // 重新打开日志文件，文件被外部移走后可调用
     bool reopen();
+
+    // 缓冲的日志最长保留多久(毫秒)，0表示每条都写出
+    void setFlushInterval(uint64_t ms);
+    // 文件超过该大小(字节)时滚动，0表示不按大小滚动
+    void setRotateSize(uint64_t bytes);
+    // 按本地时间对齐的滚动周期(秒)，如86400为每天零点滚动，0表示不按时间滚动
+    void setRotateInterval(uint64_t seconds);
+    const std::string& getFilename() const { return m_filename; }
+
 private:
+    // LogTicker定期调用，缓冲的日志超过flush_interval时写出
+    void flushIfDue(uint64_t now_ms);
+    // 调用时持有lock(m_mutex)，交换缓冲区后释放lock，再把旧缓冲区和extra一起用writev写出
+    void writeOut(ScopeLock& lock, const char* extra = nullptr, size_t extra_len = 0);
+    // 以下函数调用时需同时持有m_mutex和m_io_mutex
+    bool openFile();
+    void rotate(uint64_t now_ms);
+    // 以下函数调用时需持有m_io_mutex
+    void writeFile(const char* data, size_t len, const char* extra, size_t extra_len);
+    void updateNextRotateTime(uint64_t now_ms);
+
     std::string m_filename;
-    std::ofstream m_file_stream;
+    std::vector<char> m_buffer;             // 正在写入的缓冲区，由m_mutex保护
+    size_t m_buffer_used = 0;
+    std::vector<char> m_spare;              // 正在写出的缓冲区，由m_io_mutex保护
+    int m_fd = -1;                          // 由m_io_mutex保护
+    Mutex m_io_mutex;                       // 串行化文件写入，加锁顺序为先m_mutex后m_io_mutex
+    std::atomic<uint64_t> m_file_size{0};
+    std::shared_ptr<__LogTicker> m_ticker;
+    uint64_t m_ticker_task = 0;
+    uint64_t m_last_flush_ms = 0;
+    uint64_t m_flush_interval_ms = 1000;
+    uint64_t m_rotate_size = 0;
+    uint64_t m_rotate_interval = 0;
+    uint64_t m_next_rotate_ms = 0;
 };
 
 // @brief 日志的管理器
@@ -212,20 +978,131 @@ class __LoggerManager{
 public:
     typedef std::shared_ptr<__LoggerManager> ptr;
     __LoggerManager();
-    // 根据日志器的名字获取日志器，如果不存在，返回全局日志器
+    // 根据日志器的名字获取日志器，如果不存在，创建一个输出到终端的日志器
+    // 已存在的日志器查找不加锁
     Logger::ptr getLogger(const std::string &name);
     Logger::ptr getGlobalLogger();
 
 private:
+    typedef std::map<std::string, Logger::ptr> LoggerMap;
+
     friend struct LogIniter;
     void init();
-    void ensureGlobalLoggerExists();
-    std::map<std::string, Logger::ptr> m_logger_map;
+    void ensureGlobalLoggerExists(LoggerMap& loggers);
+    // 日志器表的不可变快照，只在创建日志器时复制替换
+    RcuPtr<LoggerMap> m_loggers;
+    // 串行化日志器的创建
     Mutex m_mutex;
 };
 
 typedef SingletonPtr<__LoggerManager> LoggerManager;
 
+// 异步日志队列满时的处理策略
+enum class LogOverflowPolicy{
+    BLOCK,              // 阻塞生产者，直到后台线程腾出空间
+    DROP_NEWEST,        // 丢弃当前这条日志
+    DROP_DEBUG_FIRST,   // 队列超过高水位后先丢弃DEBUG日志，队列满时丢弃当前日志
+};
+
+/*
+    @brief 异步日志的后台线程
+    每个生产者线程拥有一个独立的SPSC环形队列，写日志时只操作自己的队列，
+    生产者之间没有任何锁竞争。一个专门的caizi::Thread轮询所有队列，
+    每次从每个队列批量取出最多batch_size条日志写入对应日志器的输出地。
+*/
+class __AsyncLogWorker : public Noncopyable{
+public:
+    typedef std::shared_ptr<__AsyncLogWorker> ptr;
+
+    // 队列中的一条记录
+    struct Record{
+        Logger::ptr logger;
+        LogLevel::Level level = LogLevel::UNKNOW;
+        LogEvent event;
+    };
+    class ThreadQueue;
+
+    __AsyncLogWorker();
+    ~__AsyncLogWorker();
+
+    // 投递一条日志，已入队或按溢出策略丢弃时返回true，返回false表示调用方需要同步输出
+    bool push(Logger::ptr logger, LogLevel::Level level, const LogEvent& event);
+    // 阻塞直到调用前已投递的日志全部写出
+    void flush();
+    // 写出剩余日志并结束后台线程，之后的日志在调用线程上同步输出
+    void stop();
+
+    void setOverflowPolicy(LogOverflowPolicy val) { m_policy.store(val, std::memory_order_relaxed); };
+    LogOverflowPolicy getOverflowPolicy() const { return m_policy.load(std::memory_order_relaxed); };
+    // 只影响之后新创建的线程队列
+    void setQueueCapacity(size_t val) { m_queue_capacity.store(val, std::memory_order_relaxed); };
+    size_t getQueueCapacity() const { return m_queue_capacity.load(std::memory_order_relaxed); };
+    void setBatchSize(size_t val) { m_batch_size.store(val, std::memory_order_relaxed); };
+    size_t getBatchSize() const { return m_batch_size.load(std::memory_order_relaxed); };
+    // 因队列满而被丢弃的日志数量
+    uint64_t getDroppedCount() const { return m_dropped.load(std::memory_order_relaxed); };
+
+private:
+    void run();
+    // 把每个队列中最多batch条日志写出，返回写出的条数
+    size_t drainOnce(size_t batch);
+    // 写出本轮涉及的日志器的输出地缓冲
+    void flushTouched();
+    std::shared_ptr<ThreadQueue> getThreadQueue();
+
+    Thread::ptr m_thread;
+    Mutex m_mutex;                                      // 保护m_queues
+    std::vector<std::shared_ptr<ThreadQueue>> m_queues;
+    std::atomic<uint64_t> m_queues_version{0};
+    std::vector<std::shared_ptr<ThreadQueue>> m_snapshot;  // 后台线程持有的m_queues副本
+    uint64_t m_snapshot_version = -1;
+    std::vector<Logger::ptr> m_touched;                     // 上次flush之后写过的日志器
+    std::atomic<uint64_t> m_flush_request{0};
+    std::atomic<uint64_t> m_flush_done{0};
+    std::atomic<bool> m_stopping{false};
+    std::atomic<bool> m_stopped{false};
+    std::atomic<LogOverflowPolicy> m_policy{LogOverflowPolicy::BLOCK};
+    std::atomic<size_t> m_queue_capacity{1024};
+    std::atomic<size_t> m_batch_size{256};
+    std::atomic<uint64_t> m_dropped{0};
+};
+
+typedef SingletonPtr<__AsyncLogWorker> AsyncLogWorker;
+
+/*
+    @brief 日志的周期任务
+    一个后台线程每隔TICK_MS调用一次注册的任务，例如写出FileLogAppender中超时的缓冲日志。
+    任务在锁外执行，可以写日志；第一次注册任务时才创建线程。
+*/
+class __LogTicker : public Noncopyable{
+public:
+    typedef std::shared_ptr<__LogTicker> ptr;
+    // @param now_ms 本次调用的CoarseClock::NowMS()
+    typedef std::function<void(uint64_t now_ms)> Task;
+
+    static const uint64_t TICK_MS = 20;
+
+    __LogTicker();
+    ~__LogTicker();
+
+    // @return 任务id，用于delTask
+    uint64_t addTask(Task task);
+    // 返回后任务不会再被调用(在任务中调用时不等待本轮结束)
+    void delTask(uint64_t id);
+
+private:
+    void run();
+
+    Mutex m_mutex;                          // 保护m_tasks和m_thread
+    Mutex m_run_mutex;                      // 执行一轮任务时持有
+    std::map<uint64_t, Task> m_tasks;
+    uint64_t m_next_id = 1;
+    Thread::ptr m_thread;
+    std::atomic<bool> m_stopping{false};
+};
+
+typedef SingletonPtr<__LogTicker> LogTicker;
+
 }
 
 #endif
\ No newline at end of file
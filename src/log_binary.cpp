@@ -0,0 +1,364 @@
+#include "log_binary.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace caizi{
+
+static const char s_binary_magic[8] = {'C', 'A', 'I', 'Z', 'I', 'L', 'O', 'G'};
+static const uint32_t s_binary_version = 1;
+// 记录头：类型、保留、负载长度
+static const size_t s_record_header_size = 8;
+
+template<class T>
+static void Put(char*& p, const T& value){
+    memcpy(p, &value, sizeof(T));
+    p += sizeof(T);
+}
+
+static void PutString(char*& p, std::string_view str){
+    uint16_t len = str.size();
+    Put(p, len);
+    memcpy(p, str.data(), len);
+    p += len;
+}
+
+template<class T>
+static bool Get(const char*& p, const char* end, T& value){
+    if(p + sizeof(T) > end){
+        return false;
+    }
+    memcpy(&value, p, sizeof(T));
+    p += sizeof(T);
+    return true;
+}
+
+static bool GetString(const char*& p, const char* end, std::string& str){
+    uint16_t len = 0;
+    if(!Get(p, end, len) || p + len > end){
+        return false;
+    }
+    str.assign(p, len);
+    p += len;
+    return true;
+}
+
+static char* PutRecordHeader(char* p, BinaryLogRecord type, uint32_t size){
+    Put(p, (uint16_t)type);
+    Put(p, (uint16_t)0);
+    Put(p, size);
+    return p;
+}
+
+/*
+    BinaryLogAppender
+*/
+BinaryLogAppender::BinaryLogAppender(const std::string& filename, LogLevel::Level level, size_t segment_size):
+    LogAppender(level), m_filename(filename), m_segment_size(segment_size){
+    if(m_segment_size < 4096){
+        m_segment_size = 4096;
+    }
+    // 从第一个不存在的序号开始，不覆盖之前的文件段
+    struct stat st;
+    while(::stat(getSegmentPath().c_str(), &st) == 0){
+        ++m_segment_index;
+    }
+}
+
+BinaryLogAppender::~BinaryLogAppender(){
+    ScopeLock lock(&m_mutex);
+    closeSegment();
+}
+
+std::string BinaryLogAppender::getSegmentPath() const{
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%06llu", (unsigned long long)m_segment_index);
+    return m_filename + suffix;
+}
+
+bool BinaryLogAppender::openSegment(){
+    std::string path = getSegmentPath();
+    m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(m_fd < 0){
+        std::cerr << "BinaryLogAppender 打开文件段失败: " << path
+                  << " errno=" << errno << " " << strerror(errno) << std::endl;
+        return false;
+    }
+    if(ftruncate(m_fd, m_segment_size)){
+        std::cerr << "BinaryLogAppender 预分配文件段失败: " << path
+                  << " errno=" << errno << " " << strerror(errno) << std::endl;
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    void* addr = mmap(nullptr, m_segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if(addr == MAP_FAILED){
+        std::cerr << "BinaryLogAppender mmap失败: " << path
+                  << " errno=" << errno << " " << strerror(errno) << std::endl;
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    m_base = (char*)addr;
+
+    BinaryLogHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, s_binary_magic, sizeof(header.magic));
+    header.version = s_binary_version;
+    header.header_size = sizeof(header);
+    header.segment_index = m_segment_index;
+    header.create_time = ::time(nullptr);
+    header.pid = getpid();
+    memcpy(m_base, &header, sizeof(header));
+    m_offset = sizeof(header);
+    return true;
+}
+
+// 关闭文件段，并把文件截断到实际写入的长度
+void BinaryLogAppender::closeSegment(){
+    if(!m_base){
+        return;
+    }
+    munmap(m_base, m_segment_size);
+    m_base = nullptr;
+    if(ftruncate(m_fd, m_offset)){
+        std::cerr << "BinaryLogAppender 截断文件段失败 errno=" << errno << std::endl;
+    }
+    ::close(m_fd);
+    m_fd = -1;
+    ++m_segment_index;
+    m_site_written.assign(m_site_written.size(), false);
+}
+
+char* BinaryLogAppender::reserve(size_t len){
+    if(m_base && m_offset + len > m_segment_size){
+        closeSegment();
+    }
+    if(!m_base && !openSegment()){
+        return nullptr;
+    }
+    if(m_offset + len > m_segment_size){
+        return nullptr;
+    }
+    char* p = m_base + m_offset;
+    m_offset += len;
+    return p;
+}
+
+void BinaryLogAppender::writeSite(const LogSite* site){
+    if(site->id < m_site_written.size() && m_site_written[site->id]){
+        return;
+    }
+    std::string_view file(site->file);
+    std::string_view format(site->format ? site->format : "");
+    file = file.substr(0, UINT16_MAX);
+    format = format.substr(0, UINT16_MAX);
+    uint32_t size = 4 + 4 + 2 + file.size() + 2 + format.size();
+    char* p = reserve(s_record_header_size + size);
+    if(!p){
+        return;
+    }
+    p = PutRecordHeader(p, BinaryLogRecord::SITE, size);
+    Put(p, site->id);
+    Put(p, site->line);
+    PutString(p, file);
+    PutString(p, format);
+
+    if(site->id >= m_site_written.size()){
+        m_site_written.resize(site->id + 1, false);
+    }
+    m_site_written[site->id] = true;
+}
+
+void BinaryLogAppender::log(LogLevel::Level level, const LogEvent& ev){
+    if(level < m_level) return;
+
+    // 非格式化日志把内容作为一个字符串参数写入
+    // 已经立即格式化的格式化日志不引用调用点，避免读取时再按格式串渲染
+    const LogSite* site = ev.getSite();
+    if(site && site->format && !ev.hasFormatArgs()){
+        site = nullptr;
+    }
+    std::string_view args;
+    char inline_args[CAIZI_LOG_CONTENT_SIZE + 256];
+    if(site && site->format){
+        args = ev.getArgs();
+    }else{
+        LogArgs writer(inline_args, sizeof(inline_args));
+        if(!site){
+            writer.write(std::string_view(ev.getFilename()).substr(0, 200));
+            writer.write(ev.getLine());
+        }
+        writer.write(ev.getContent());
+        args = std::string_view(inline_args, writer.size());
+    }
+    uint32_t size = 1 + 4 + 4 + 8 + 4 + 4 + 2 + args.size();
+
+    ScopeLock lock(&m_mutex);
+    // 保证调用点定义与事件在同一个文件段中
+    size_t site_size = site ? s_record_header_size + 12 + strlen(site->file)
+                              + (site->format ? strlen(site->format) : 0) : 0;
+    if(m_base && m_offset + site_size + s_record_header_size + size > m_segment_size){
+        closeSegment();
+    }
+    if(site){
+        writeSite(site);
+    }
+    char* p = reserve(s_record_header_size + size);
+    if(!p){
+        return;
+    }
+    p = PutRecordHeader(p, BinaryLogRecord::EVENT, size);
+    Put(p, (uint8_t)level);
+    Put(p, ev.getThreadId());
+    Put(p, ev.getFiberId());
+    Put(p, ev.getTime());
+    Put(p, ev.getElapse());
+    Put(p, site ? site->id : (uint32_t)0);
+    Put(p, (uint16_t)args.size());
+    memcpy(p, args.data(), args.size());
+}
+
+void BinaryLogAppender::flush(){
+    ScopeLock lock(&m_mutex);
+    if(m_base){
+        msync(m_base, m_offset, MS_ASYNC);
+    }
+}
+
+/*
+    BinaryLogReader
+*/
+BinaryLogReader::~BinaryLogReader(){
+    close();
+}
+
+bool BinaryLogReader::open(const std::string& path){
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) || (size_t)st.st_size < sizeof(BinaryLogHeader)){
+        ::close(fd);
+        return false;
+    }
+    void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(addr == MAP_FAILED){
+        return false;
+    }
+    m_base = (char*)addr;
+    m_size = st.st_size;
+    const BinaryLogHeader* header = getHeader();
+    if(memcmp(header->magic, s_binary_magic, sizeof(s_binary_magic))
+            || header->version != s_binary_version
+            || header->header_size > m_size){
+        close();
+        return false;
+    }
+    m_offset = header->header_size;
+    return true;
+}
+
+void BinaryLogReader::close(){
+    if(m_base){
+        munmap(m_base, m_size);
+    }
+    m_base = nullptr;
+    m_size = 0;
+    m_offset = 0;
+    m_sites.clear();
+}
+
+bool BinaryLogReader::next(LogEvent& ev){
+    while(m_base && m_offset + s_record_header_size <= m_size){
+        const char* p = m_base + m_offset;
+        uint16_t type = 0;
+        uint16_t reserved = 0;
+        uint32_t size = 0;
+        Get(p, p + s_record_header_size, type);
+        Get(p, p + 4, reserved);
+        Get(p, p + 4, size);
+        const char* end = p + size;
+        if(size == 0 || end > m_base + m_size){
+            return false;
+        }
+        m_offset = end - m_base;
+
+        if(type == (uint16_t)BinaryLogRecord::SITE){
+            uint32_t id = 0;
+            Site site;
+            if(Get(p, end, id) && Get(p, end, site.line)
+                    && GetString(p, end, site.file) && GetString(p, end, site.format)){
+                site.has_format = !site.format.empty();
+                m_sites[id] = std::move(site);
+            }
+            continue;
+        }
+        if(type != (uint16_t)BinaryLogRecord::EVENT){
+            continue;
+        }
+
+        uint8_t level = 0;
+        uint32_t tid = 0, fid = 0, elapse = 0, id = 0;
+        uint64_t time = 0;
+        uint16_t args_size = 0;
+        if(!Get(p, end, level) || !Get(p, end, tid) || !Get(p, end, fid) || !Get(p, end, time)
+                || !Get(p, end, elapse) || !Get(p, end, id) || !Get(p, end, args_size)
+                || p + args_size > end){
+            continue;
+        }
+
+        const char* file = "?";
+        uint32_t line = 0;
+        const char* format = "%s";
+        const char* args = p;
+        size_t args_len = args_size;
+        if(id == 0){
+            // 没有调用点的事件：参数依次为文件名、行号、内容
+            const char* args_end = p + args_size;
+            uint8_t arg_type = 0;
+            uint16_t file_len = 0;
+            uint64_t line_value = 0;
+            m_inline_file.clear();
+            if(Get(args, args_end, arg_type) && arg_type == LogArgs::STRING
+                    && Get(args, args_end, file_len) && args + file_len <= args_end){
+                m_inline_file.assign(args, file_len);
+                args += file_len;
+            }
+            if(Get(args, args_end, arg_type) && Get(args, args_end, line_value)){
+                line = line_value;
+            }
+            args_len = args_end - args;
+            file = m_inline_file.c_str();
+        }else{
+            auto it = m_sites.find(id);
+            if(it != m_sites.end()){
+                file = it->second.file.c_str();
+                line = it->second.line;
+                if(it->second.has_format){
+                    format = it->second.format.c_str();
+                }
+            }
+        }
+
+        ev.init((LogLevel::Level)level, file, line);
+        ev.setThreadId(tid);
+        ev.setFiberId(fid);
+        ev.setTime(time);
+        ev.setElapse(elapse);
+        ev.setThreadName("");
+
+        char content[CAIZI_LOG_CONTENT_SIZE];
+        size_t len = LogArgs::Render(content, sizeof(content), format, args, args_len);
+        ev.setContent(std::string_view(content, len));
+        return true;
+    }
+    return false;
+}
+
+}
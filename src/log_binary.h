@@ -0,0 +1,108 @@
+/*
+    @file log_binary.h
+    @brief 二进制日志：写入mmap文件段的输出地，以及离线读取文件段的解码器
+*/
+
+#ifndef __CAIZI_LOG_BINARY_H__
+#define __CAIZI_LOG_BINARY_H__
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "log.h"
+
+namespace caizi{
+
+/*
+    文件段格式(小端)：
+        文件头   BinaryLogHeader
+        记录     [uint16 类型][uint16 保留][uint32 负载长度][负载]，依次排列
+        剩余部分全为0，读到长度为0的记录即结束
+    记录类型：
+        SITE   调用点定义  uint32 id, uint32 行号, uint16 文件名长度, 文件名,
+                          uint16 格式串长度, 格式串 (LOG_LEVEL的调用点格式串为空)
+        EVENT  日志事件    uint8 级别, uint32 线程号, uint32 协程号, uint64 时间戳(毫秒),
+                          uint32 启动至今毫秒数, uint32 调用点id, uint16 参数长度, 参数(LogArgs编码)
+    每个调用点在一个文件段中第一次出现时先写SITE记录，因此每个文件段可以单独解码。
+    不经过日志宏构造的事件没有调用点，id写0，参数依次为文件名、行号和日志内容。
+    结构化字段(LOG_KV_*)不写入二进制日志。
+*/
+struct BinaryLogHeader{
+    char magic[8];              // "CAIZILOG"
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t segment_index;     // 文件段序号
+    uint64_t create_time;       // 创建时间，秒
+    uint32_t pid;
+    uint32_t reserved[7];
+};
+
+enum class BinaryLogRecord : uint16_t{
+    SITE = 1,
+    EVENT = 2,
+};
+
+// 二进制日志输出地，写满一个文件段后切换到下一个: filename.000000, filename.000001 ...
+class BinaryLogAppender : public LogAppender{
+public:
+    typedef std::shared_ptr<BinaryLogAppender> ptr;
+
+    explicit BinaryLogAppender(const std::string& filename, LogLevel::Level level = LogLevel::DEBUG,
+                               size_t segment_size = 64 * 1024 * 1024);
+    ~BinaryLogAppender();
+
+    void log(LogLevel::Level level, const LogEvent& ev) override;
+    // 通知内核异步回写已写入的页
+    void flush() override;
+    // 当前文件段的路径
+    std::string getSegmentPath() const;
+
+private:
+    // 以下函数调用时需持有m_mutex
+    bool openSegment();
+    void closeSegment();
+    // 预留len字节，当前文件段不够时切换文件段
+    char* reserve(size_t len);
+    void writeSite(const LogSite* site);
+
+    std::string m_filename;
+    size_t m_segment_size;
+    uint64_t m_segment_index = 0;
+    int m_fd = -1;
+    char* m_base = nullptr;
+    size_t m_offset = 0;
+    std::vector<bool> m_site_written;   // 按调用点id记录本文件段是否已写入SITE
+};
+
+// 二进制日志文件段的解码器
+class BinaryLogReader{
+public:
+    BinaryLogReader() = default;
+    ~BinaryLogReader();
+
+    bool open(const std::string& path);
+    void close();
+    // 读取下一条日志事件，文件段结束返回false
+    bool next(LogEvent& ev);
+    const BinaryLogHeader* getHeader() const { return (const BinaryLogHeader*)m_base; }
+
+private:
+    struct Site{
+        std::string file;
+        std::string format;
+        uint32_t line = 0;
+        bool has_format = false;
+    };
+
+    char* m_base = nullptr;
+    size_t m_size = 0;
+    size_t m_offset = 0;
+    std::map<uint32_t, Site> m_sites;
+    std::string m_inline_file;          // 没有调用点的事件的文件名
+};
+
+}
+
+#endif
@@ -0,0 +1,169 @@
+#include "log_json.h"
+#include <cmath>
+#include <cstdlib>
+
+namespace caizi{
+
+static const char s_hex_digits[] = "0123456789abcdef";
+
+JsonLogFormatter::JsonLogFormatter(): LogFormatter("%m"){
+}
+
+// 截断时行尾追加的内容
+static const char s_truncated_tail[] = ",\"truncated\":true}\n";
+static const size_t s_tail_size = sizeof(s_truncated_tail) - 1;
+// 数字、布尔和指针字段值的最大长度
+static const size_t s_max_scalar_size = 32;
+
+bool JsonLogFormatter::AppendString(LogBuffer& out, std::string_view str, size_t reserve){
+    // 两个引号和保留的空间，空间不足时至少写出""
+    if(out.avail() < 2){
+        return false;
+    }
+    size_t room = out.avail() >= reserve + 2 ? out.avail() - reserve - 2 : 0;
+    out.append('"');
+    size_t limit = out.size() + room;
+    const char* p = str.data();
+    const char* end = p + str.size();
+    bool complete = true;
+    while(p < end){
+        // 连续的普通字符一次写入
+        const char* q = p;
+        while(q < end && (unsigned char)*q >= 0x20 && *q != '"' && *q != '\\'){
+            ++q;
+        }
+        if((size_t)(q - p) > limit - out.size()){
+            out.append(p, limit - out.size());
+            complete = false;
+            break;
+        }
+        out.append(p, q - p);
+        if(q == end){
+            break;
+        }
+        unsigned char c = *q;
+        char esc[6] = {'\\', 'u', '0', '0', s_hex_digits[c >> 4], s_hex_digits[c & 0xf]};
+        size_t esc_len = 2;
+        switch(c){
+            case '"':  esc[1] = '"'; break;
+            case '\\': esc[1] = '\\'; break;
+            case '\n': esc[1] = 'n'; break;
+            case '\r': esc[1] = 'r'; break;
+            case '\t': esc[1] = 't'; break;
+            case '\b': esc[1] = 'b'; break;
+            case '\f': esc[1] = 'f'; break;
+            default: esc_len = sizeof(esc); break;
+        }
+        if(esc_len > limit - out.size()){
+            complete = false;
+            break;
+        }
+        out.append(esc, esc_len);
+        p = q + 1;
+    }
+    out.append('"');
+    return complete;
+}
+
+// 追加 ,"key":
+static bool AppendKey(LogBuffer& out, std::string_view key, size_t reserve){
+    out.append(',');
+    if(!JsonLogFormatter::AppendString(out, key, reserve + 1)){
+        return false;
+    }
+    out.append(':');
+    return true;
+}
+
+void JsonLogFormatter::format(LogBuffer& out, LogLevel::Level level, const LogEvent& ev){
+    out.append("{\"time\":\"", 9);
+    if(out.avail() >= CoarseClock::DATETIME_SIZE){
+        out.add(CoarseClock::FormatDateTime(ev.getTime(), out.current()));
+    }
+    out.append("\",\"level\":\"", 11);
+    out.append(LogLevel::ToString(level));
+    out.append("\",\"thread\":", 11);
+    out.appendUInt(ev.getThreadId());
+    out.append(",\"thread_name\":", 15);
+    AppendString(out, ev.getThreadName());
+    out.append(",\"fiber\":", 9);
+    out.appendUInt(ev.getFiberId());
+    out.append(",\"file\":", 8);
+    // 为行号、msg和行尾留出空间
+    bool complete = AppendString(out, ev.getFilename(), s_tail_size + s_max_scalar_size + 16);
+    out.append(",\"line\":", 8);
+    out.appendUInt(ev.getLine());
+    out.append(",\"msg\":", 7);
+    std::string_view msg = ev.getContent();
+    if(!msg.empty() && msg.back() == '\n'){
+        msg.remove_suffix(1);
+    }
+    complete = AppendString(out, msg, s_tail_size) && complete;
+
+    LogArgReader reader(ev.getFields());
+    LogArgValue key;
+    LogArgValue val;
+    while(complete && reader.next(key) && reader.next(val)){
+        // 放不下的字段整个丢弃
+        size_t mark = out.size();
+        if(out.avail() < s_tail_size + s_max_scalar_size + 4
+                || !AppendKey(out, std::string_view(key.str, key.len), s_tail_size + s_max_scalar_size)){
+            out.truncate(mark);
+            complete = false;
+            break;
+        }
+        switch(val.type){
+            case LogArgs::INT:
+                out.appendInt(val.i);
+                break;
+            case LogArgs::UINT:
+                out.appendUInt(val.u);
+                break;
+            case LogArgs::BOOL:
+                if(val.u){
+                    out.append("true", 4);
+                }else{
+                    out.append("false", 5);
+                }
+                break;
+            case LogArgs::DOUBLE:{
+                if(!std::isfinite(val.d)){
+                    out.append("null", 4);
+                    break;
+                }
+                // 优先用较短的15位有效数字，不能精确还原时才用17位
+                char tmp[32];
+                int n = snprintf(tmp, sizeof(tmp), "%.15g", val.d);
+                if(strtod(tmp, nullptr) != val.d){
+                    n = snprintf(tmp, sizeof(tmp), "%.17g", val.d);
+                }
+                out.append(tmp, n > 0 ? n : 0);
+                break;
+            }
+            case LogArgs::POINTER:{
+                char tmp[32];
+                int n = snprintf(tmp, sizeof(tmp), "\"%p\"", (void*)(uintptr_t)val.u);
+                out.append(tmp, n > 0 ? n : 0);
+                break;
+            }
+            default:
+                if(!AppendString(out, std::string_view(val.str, val.len), s_tail_size)){
+                    out.truncate(mark);
+                    complete = false;
+                }
+                break;
+        }
+    }
+    if(!complete){
+        out.append(s_truncated_tail, s_tail_size);
+    }else{
+        out.append("}\n", 2);
+    }
+}
+
+JsonLogAppender::JsonLogAppender(const std::string& filename, LogLevel::Level level, size_t buffer_size):
+    FileLogAppender(filename, level, buffer_size){
+    setFormatter(std::make_shared<JsonLogFormatter>());
+}
+
+}
@@ -0,0 +1,50 @@
+/*
+    @file log_json.h
+    @brief JSON行格式的日志：每条日志一行JSON对象，方便日志收集系统直接解析
+*/
+
+#ifndef __CAIZI_LOG_JSON_H__
+#define __CAIZI_LOG_JSON_H__
+
+#include "log.h"
+
+namespace caizi{
+
+/*
+    把日志事件编码为一行JSON：
+        {"time":"2026-01-01 12:00:00.123","level":"INFO","thread":1234,"thread_name":"main",
+         "fiber":0,"file":"main.cpp","line":10,"msg":"...", 结构化字段...}
+    结构化字段按原始类型输出：整数和浮点为数字(NaN和无穷为null)，布尔为true/false，字符串和指针为字符串。
+    手写编码直接写入LogBuffer，不经过stringstream，不分配堆内存。
+    消息末尾的一个换行符不写入msg。
+    整行超出LogBuffer时截断msg、丢弃放不下的字段并加上"truncated":true，每行总是以"}\n"结束。
+*/
+class JsonLogFormatter : public LogFormatter{
+public:
+    typedef std::shared_ptr<JsonLogFormatter> ptr;
+
+    JsonLogFormatter();
+
+    using LogFormatter::format;
+    void format(LogBuffer& out, LogLevel::Level level, const LogEvent& event) override;
+
+    /*
+        追加带引号的JSON字符串，转义引号、反斜杠和控制字符
+        @param reserve 写完后至少保留的空间，不够时截断字符串(不拆开转义序列)，仍以引号结束
+        @return 完整写入返回true
+    */
+    static bool AppendString(LogBuffer& out, std::string_view str, size_t reserve = 0);
+};
+
+// 输出JSON行的文件输出地，缓冲、刷新和滚动与FileLogAppender相同
+class JsonLogAppender : public FileLogAppender{
+public:
+    typedef std::shared_ptr<JsonLogAppender> ptr;
+
+    explicit JsonLogAppender(const std::string& filename, LogLevel::Level level = LogLevel::DEBUG,
+                             size_t buffer_size = 256 * 1024);
+};
+
+}
+
+#endif
@@ -5,6 +5,7 @@
 #include <assert.h>
 
 #include "log.h"
+#include "util.h"
 
 static caizi::Logger::ptr logger = CAIZI_GET_LOGGER("system");
 
@@ -18,11 +19,23 @@ static caizi::Logger::ptr logger = CAIZI_GET_LOGGER("system");
 #endif
 
 // 断言的封装，输出断言结果和调用函数的栈信息
-// #define CAIZI_ASSERT(x) \
-//     if(CAIZI_UNLIKELY(!(x))){ \
-//         // CAIZI_Lo \
-//                     \
-//     }
+#define CAIZI_ASSERT(x) \
+    do{ \
+        if(CAIZI_UNLIKELY(!(x))){ \
+            LOG_ERROR(CAIZI_GET_LOGGER("system"), "ASSERTION: " #x "\nbacktrace:\n" \
+                      + caizi::BacktraceToString(100, 2, "    ")); \
+            assert(x); \
+        } \
+    }while(0)
 
+// 断言的封装，额外输出说明信息w
+#define CAIZI_ASSERT2(x, w) \
+    do{ \
+        if(CAIZI_UNLIKELY(!(x))){ \
+            LOG_ERROR(CAIZI_GET_LOGGER("system"), "ASSERTION: " #x "\n" + std::string(w) \
+                      + "\nbacktrace:\n" + caizi::BacktraceToString(100, 2, "    ")); \
+            assert(x); \
+        } \
+    }while(0)
 
 #endif
\ No newline at end of file
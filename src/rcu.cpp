@@ -0,0 +1,100 @@
+#include "rcu.h"
+#include <algorithm>
+#include <assert.h>
+#include <sched.h>
+
+namespace caizi{
+
+void RcuDomain::addReader(Reader* reader){
+    ScopeLock lock(&m_mutex);
+    m_readers.push_back(reader);
+}
+
+void RcuDomain::delReader(Reader* reader){
+    ScopeLock lock(&m_mutex);
+    auto it = std::find(m_readers.begin(), m_readers.end(), reader);
+    if(it != m_readers.end()){
+        m_readers.erase(it);
+    }
+}
+
+uint64_t RcuDomain::minActiveEpoch() const {
+    uint64_t min_epoch = UINT64_MAX;
+    for(auto reader : m_readers){
+        uint64_t epoch = reader->epoch.load(std::memory_order_seq_cst);
+        if(epoch && epoch < min_epoch){
+            min_epoch = epoch;
+        }
+    }
+    return min_epoch;
+}
+
+void RcuDomain::retire(std::shared_ptr<const void> data){
+    if(!data){
+        return;
+    }
+    {
+        ScopeLock lock(&m_mutex);
+        // 退休时的纪元，之后进入的读取方一定能看到新快照
+        uint64_t epoch = m_epoch.fetch_add(1, std::memory_order_seq_cst);
+        m_retired.push_back(Retired{epoch, std::move(data)});
+        m_retired_count.store(m_retired.size(), std::memory_order_relaxed);
+    }
+    reclaim();
+    std::function<void()> cb;
+    {
+        ScopeLock lock(&m_mutex);
+        if(m_retired.empty()){
+            return;
+        }
+        cb = m_pending_cb;
+    }
+    if(cb){
+        cb();
+    }
+}
+
+void RcuDomain::setPendingCallback(std::function<void()> cb){
+    ScopeLock lock(&m_mutex);
+    m_pending_cb = std::move(cb);
+}
+
+void RcuDomain::reclaim(){
+    m_reclaim_count.fetch_add(1, std::memory_order_relaxed);
+    std::vector<std::shared_ptr<const void>> expired;
+    {
+        ScopeLock lock(&m_mutex);
+        if(m_retired.empty()){
+            return;
+        }
+        uint64_t min_epoch = minActiveEpoch();
+        auto it = std::stable_partition(m_retired.begin(), m_retired.end(), [min_epoch](const Retired& r){
+            return r.epoch >= min_epoch;
+        });
+        for(auto i = it; i != m_retired.end(); ++i){
+            expired.push_back(std::move(i->data));
+        }
+        m_retired.erase(it, m_retired.end());
+        m_retired_count.store(m_retired.size(), std::memory_order_relaxed);
+    }
+    // 在锁外释放，旧快照的析构(如关闭输出地)可能再次读取或写入
+    expired.clear();
+}
+
+void RcuDomain::synchronize(){
+    Reader* self = GetReader();
+    assert(!self || self->depth == 0);
+    uint64_t epoch = m_epoch.fetch_add(1, std::memory_order_seq_cst);
+    while(true){
+        {
+            ScopeLock lock(&m_mutex);
+            if(minActiveEpoch() > epoch){
+                break;
+            }
+        }
+        sched_yield();
+    }
+    reclaim();
+}
+
+}
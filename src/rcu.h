@@ -0,0 +1,232 @@
+/*
+    @file rcu.h
+    @brief 读多写少数据的快照发布(RCU风格)
+*/
+
+#ifndef __CAIZI_RCU_H__
+#define __CAIZI_RCU_H__
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "noncopyable.h"
+#include "thread.h"
+
+namespace caizi{
+
+/*
+    进程内唯一的RCU回收域(基于纪元的宽限期)。
+    每个线程有一条读者记录，进入最外层读临界区时登记当前的全局纪元，离开时清零。
+    写入方退休旧快照时推进全局纪元，旧快照由回收域持有，
+    等到所有在退休之前进入的读临界区都结束后才释放。
+    空闲线程(不在读临界区内)不持有任何快照，不会延长旧快照的生命周期。
+    读取方离开临界区时只清零自己的纪元，从不加锁回收；回收在retire/synchronize中进行，
+    退休时仍有读取方未结束的旧快照交给setPendingCallback登记的回调(如日志的LogTicker)定期回收。
+*/
+class RcuDomain : public Noncopyable{
+public:
+    static const size_t CACHE_SLOTS = 64;
+    // 按RcuPtr的id直接映射的缓存，只记录指针和版本号，不持有快照
+    struct Slot{
+        uint64_t id = 0;
+        uint64_t version = 0;
+        const void* data = nullptr;
+    };
+    struct Reader{
+        std::atomic<uint64_t> epoch{0};     // 0表示不在读临界区内
+        int depth = 0;                      // 当前线程嵌套的读临界区数量
+        Slot slots[CACHE_SLOTS];
+    };
+
+    // 有意不析构，线程退出阶段仍然可以使用
+    static RcuDomain& Get(){
+        static RcuDomain* s_domain = new RcuDomain;
+        return *s_domain;
+    }
+
+    // 当前线程的读者记录，线程退出阶段(记录已析构)返回nullptr
+    static Reader* GetReader(){
+        static thread_local ReaderHolder t_holder;
+        return t_holder.destroyed ? nullptr : &t_holder.reader;
+    }
+
+    // 进入读临界区，可以嵌套
+    void readLock(Reader* reader){
+        if(reader->depth++ == 0){
+            // 登记纪元之后才读取版本号和指针，写入方扫描时一定能看到这次登记
+            reader->epoch.store(m_epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+        }
+    }
+
+    // 离开读临界区
+    void readUnlock(Reader* reader){
+        if(--reader->depth == 0){
+            reader->epoch.store(0, std::memory_order_release);
+        }
+    }
+
+    // 退休旧快照，在此之前进入的读临界区全部结束后释放
+    void retire(std::shared_ptr<const void> data);
+
+    // 等待在此之前进入的读临界区全部结束，不能在读临界区内调用
+    void synchronize();
+
+    // 释放已经过了宽限期的旧快照
+    void reclaim();
+
+    // retire之后仍有旧快照等待宽限期时调用，由调用方安排之后的reclaim
+    void setPendingCallback(std::function<void()> cb);
+
+    // 等待释放的旧快照数量
+    size_t getRetiredCount() const { return m_retired_count.load(std::memory_order_relaxed); }
+    // reclaim被调用的次数，统计用
+    uint64_t getReclaimCount() const { return m_reclaim_count.load(std::memory_order_relaxed); }
+
+private:
+    struct ReaderHolder{
+        Reader reader;
+        bool destroyed = false;
+        ReaderHolder(){ RcuDomain::Get().addReader(&reader); }
+        ~ReaderHolder(){
+            RcuDomain::Get().delReader(&reader);
+            destroyed = true;
+        }
+    };
+    struct Retired{
+        uint64_t epoch;
+        std::shared_ptr<const void> data;
+    };
+
+    RcuDomain() = default;
+    void addReader(Reader* reader);
+    void delReader(Reader* reader);
+    // 正在读取的线程中最小的纪元，没有时返回UINT64_MAX，需要持有m_mutex
+    uint64_t minActiveEpoch() const;
+
+    std::atomic<uint64_t> m_epoch{1};
+    std::atomic<size_t> m_retired_count{0};
+    std::atomic<uint64_t> m_reclaim_count{0};
+    Mutex m_mutex;
+    std::function<void()> m_pending_cb;
+    std::vector<Reader*> m_readers;
+    std::vector<Retired> m_retired;
+};
+
+/*
+    数据以不可变快照的形式发布，写入方复制一份修改后整体替换，读取方永远不加锁。
+    每个线程缓存自己最近读到的快照指针和版本号，版本号不变时读取只是一次原子读，
+    不修改任何共享的缓存行(包括shared_ptr的引用计数)，因此读取随核数线性扩展。
+    读取：
+        RcuPtr<T>::ReadGuard data(rcu);
+        for(auto& v : *data) ...
+    生命周期：
+        ReadGuard存活期间快照不会被释放，即使期间有写入或嵌套读取其他对象。
+        被替换的旧快照交给RcuDomain，所有在替换之前创建的ReadGuard都析构后立即释放，
+        与其他线程之后是否再读取无关；线程缓存只保存裸指针，不持有快照。
+        需要在旧快照不再被任何读取方使用之后做事(如关闭旧的输出地)，调用synchronize()。
+*/
+template<class T>
+class RcuPtr : public Noncopyable{
+public:
+    typedef std::shared_ptr<const T> DataPtr;
+
+    class ReadGuard : public Noncopyable{
+    public:
+        explicit ReadGuard(const RcuPtr& rcu){
+            RcuDomain::Reader* reader = RcuDomain::GetReader();
+            if(!reader){
+                // 读者记录已析构(线程退出阶段)，退化为加锁复制
+                m_hold = rcu.load();
+                m_data = m_hold.get();
+                return;
+            }
+            m_reader = reader;
+            RcuDomain::Get().readLock(m_reader);
+            m_data = rcu.cached(m_reader);
+        }
+        ~ReadGuard(){
+            if(m_reader){
+                RcuDomain::Get().readUnlock(m_reader);
+            }
+        }
+        const T& operator*() const { return *m_data; }
+        const T* operator->() const { return m_data; }
+        const T* get() const { return m_data; }
+
+    private:
+        RcuDomain::Reader* m_reader = nullptr;
+        const T* m_data = nullptr;
+        DataPtr m_hold;
+    };
+
+    RcuPtr(): m_id(NextId()), m_data(std::make_shared<const T>()){}
+    explicit RcuPtr(DataPtr data): m_id(NextId()), m_data(std::move(data)){}
+
+    // 取得当前快照的引用，需要加锁，用于写入方或不在热点上的读取
+    DataPtr load() const {
+        ScopeLock lock(&m_mutex);
+        return m_data;
+    }
+
+    // 发布新的快照
+    void store(DataPtr data){
+        DataPtr old;
+        {
+            ScopeLock lock(&m_mutex);
+            old = std::move(m_data);
+            m_data = std::move(data);
+            m_version.fetch_add(1, std::memory_order_seq_cst);
+        }
+        RcuDomain::Get().retire(std::move(old));
+    }
+
+    // 复制当前快照，调用func(T&)修改后发布，多个写入方之间串行
+    template<class Func>
+    void update(Func func){
+        DataPtr old;
+        {
+            ScopeLock lock(&m_mutex);
+            std::shared_ptr<T> copy = std::make_shared<T>(*m_data);
+            func(*copy);
+            old = std::move(m_data);
+            m_data = std::move(copy);
+            m_version.fetch_add(1, std::memory_order_seq_cst);
+        }
+        RcuDomain::Get().retire(std::move(old));
+    }
+
+    // 等待之前发布的快照不再被任何ReadGuard使用
+    void synchronize() const { RcuDomain::Get().synchronize(); }
+
+private:
+    static uint64_t NextId(){
+        static std::atomic<uint64_t> s_id{0};
+        return s_id.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    // 读取方已经登记纪元，槽中的指针在版本号不变时仍是当前快照
+    const T* cached(RcuDomain::Reader* reader) const {
+        RcuDomain::Slot& slot = reader->slots[m_id % RcuDomain::CACHE_SLOTS];
+        uint64_t version = m_version.load(std::memory_order_seq_cst);
+        if(slot.id != m_id || slot.version != version){
+            ScopeLock lock(&m_mutex);
+            slot.id = m_id;
+            slot.version = m_version.load(std::memory_order_relaxed);
+            slot.data = m_data.get();
+        }
+        return static_cast<const T*>(slot.data);
+    }
+
+    const uint64_t m_id;
+    std::atomic<uint64_t> m_version{0};
+    DataPtr m_data;
+    mutable Mutex m_mutex;
+};
+
+}
+
+#endif
@@ -0,0 +1,91 @@
+/*
+    @file ringbuffer.h
+    @brief 单生产者单消费者(SPSC)的无锁有界环形队列
+*/
+
+#ifndef __CAIZI_RINGBUFFER_H__
+#define __CAIZI_RINGBUFFER_H__
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#include "noncopyable.h"
+
+namespace caizi{
+
+/*
+    只允许一个线程写入、一个线程读取，读写双方各自只修改自己的下标，
+    因此不需要任何锁。容量向上取整为2的幂，下标用掩码取模。
+    写入方：slot = prepare() 取得空槽，填好数据后 commit() 发布；
+    读取方：slot = front() 取得最早的元素，处理完后 pop() 归还。
+    元素在槽中原地构造和使用，不产生额外的拷贝。
+*/
+template<class T>
+class SPSCRingBuffer : public Noncopyable{
+public:
+    explicit SPSCRingBuffer(size_t capacity){
+        size_t cap = 2;
+        while(cap < capacity){
+            cap <<= 1;
+        }
+        m_buffer.resize(cap);
+        m_mask = cap - 1;
+    }
+
+    // 生产者：返回下一个可写的槽，队列已满返回nullptr
+    T* prepare(){
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if(tail - m_head_cache == m_buffer.size()){
+            m_head_cache = m_head.load(std::memory_order_acquire);
+            if(tail - m_head_cache == m_buffer.size()){
+                return nullptr;
+            }
+        }
+        return &m_buffer[tail & m_mask];
+    }
+
+    // 生产者：发布prepare()返回的槽
+    void commit(){
+        m_tail.store(m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // 消费者：返回最早的元素，队列为空返回nullptr
+    T* front(){
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if(head == m_tail_cache){
+            m_tail_cache = m_tail.load(std::memory_order_acquire);
+            if(head == m_tail_cache){
+                return nullptr;
+            }
+        }
+        return &m_buffer[head & m_mask];
+    }
+
+    // 消费者：归还front()返回的槽
+    void pop(){
+        m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // 以下接口任意线程可调用，结果只是一个瞬时的近似值
+    size_t size() const {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+    size_t capacity() const { return m_buffer.size(); }
+    // 已写入/已读取的累计数量，用于等待队列排空
+    size_t pushedCount() const { return m_tail.load(std::memory_order_acquire); }
+    size_t poppedCount() const { return m_head.load(std::memory_order_acquire); }
+
+private:
+    std::vector<T> m_buffer;
+    size_t m_mask = 0;
+    // 读写下标分别放在独立的缓存行，避免伪共享
+    alignas(64) std::atomic<size_t> m_head{0};      // 消费者下标
+    size_t m_tail_cache = 0;                        // 消费者看到的m_tail缓存
+    alignas(64) std::atomic<size_t> m_tail{0};      // 生产者下标
+    size_t m_head_cache = 0;                        // 生产者看到的m_head缓存
+};
+
+}
+
+#endif
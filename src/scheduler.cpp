@@ -0,0 +1,374 @@
+#include "scheduler.h"
+#include "hook.h"
+#include "log.h"
+#include "macro.h"
+
+namespace caizi{
+
+static Logger::ptr g_logger = CAIZI_GET_LOGGER("system");
+
+// 当前线程所属的调度器
+static thread_local Scheduler* t_scheduler = nullptr;
+// 当前线程的调度协程
+static thread_local Fiber* t_scheduler_fiber = nullptr;
+// 当前线程的工作线程序号
+static thread_local int t_worker = -1;
+
+Scheduler::Scheduler(size_t threads, bool use_caller, const std::string& name):
+    m_name(name){
+    CAIZI_ASSERT(threads > 0);
+    for(size_t i = 0; i < threads; ++i){
+        m_workers.emplace_back(new Worker);
+        m_workers.back()->seed = i * 2654435761u + 1;
+    }
+    if(use_caller){
+        Fiber::GetThis();
+        CAIZI_ASSERT(GetThis() == nullptr);
+        t_scheduler = this;
+        m_rootFiber = Fiber::Create(std::bind(&Scheduler::run, this), 0, true);
+        t_scheduler_fiber = m_rootFiber.get();
+        m_rootThread = Thread::GetThisId();
+        m_workers[0]->thread_id = m_rootThread;
+    }
+}
+
+Scheduler::~Scheduler(){
+    CAIZI_ASSERT(m_stopping);
+    if(GetThis() == this){
+        t_scheduler = nullptr;
+        t_worker = -1;
+    }
+    for(auto& worker : m_workers){
+        while(ScheduleTask* task = worker->queue.steal()){
+            delete task;
+        }
+        for(auto task : worker->inbox){
+            delete task;
+        }
+        for(auto task : worker->pinned){
+            delete task;
+        }
+    }
+}
+
+Scheduler* Scheduler::GetThis(){
+    return t_scheduler;
+}
+
+Fiber* Scheduler::GetMainFiber(){
+    return t_scheduler_fiber;
+}
+
+int Scheduler::GetWorkerIndex(){
+    return t_worker;
+}
+
+void Scheduler::setThis(){
+    t_scheduler = this;
+}
+
+void Scheduler::start(){
+    if(m_started){
+        return;
+    }
+    m_started = true;
+    m_stopping = false;
+    for(size_t i = m_rootFiber ? 1 : 0; i < m_workers.size(); ++i){
+        Worker* worker = m_workers[i].get();
+        worker->thread.reset(new Thread([this, i](){
+            t_worker = i;
+            run();
+        }, m_name + "_" + std::to_string(i)));
+        worker->thread_id = worker->thread->getId();
+    }
+}
+
+void Scheduler::stop(){
+    if(m_rootFiber){
+        CAIZI_ASSERT2(GetThis() == this, "use_caller的调度器必须由创建它的线程停止");
+    }
+    m_stopping = true;
+    for(size_t i = 0; i < m_workers.size(); ++i){
+        tickle(i);
+    }
+    if(m_rootFiber && m_rootFiber->getcurrentState() == Fiber::INIT){
+        m_rootFiber->call();
+    }
+    for(auto& worker : m_workers){
+        if(worker->thread){
+            worker->thread->join();
+            worker->thread.reset();
+        }
+    }
+}
+
+void Scheduler::switchTo(int thread){
+    CAIZI_ASSERT(Scheduler::GetThis() != nullptr);
+    if(Scheduler::GetThis() == this){
+        if(thread == -1 || thread == Thread::GetThisId()){
+            return;
+        }
+    }
+    schedule(Fiber::GetThis(), thread);
+    Fiber::YieldToHole();
+}
+
+void Scheduler::scheduleTask(ScheduleTask* task){
+    // 没有指定线程时沿用协程固定的线程：IO就绪、定时器、YieldToReady后重新调度都回到原来的线程
+    bool inherited = false;
+    if(task->thread == -1 && task->fiber && task->fiber->getPinnedThread() != -1){
+        task->thread = task->fiber->getPinnedThread();
+        inherited = true;
+    }
+    if(task->thread != -1){
+        for(size_t i = 0; i < m_workers.size(); ++i){
+            Worker* worker = m_workers[i].get();
+            if(worker->thread_id == task->thread){
+                if(task->fiber){
+                    task->fiber->setPinnedThread(task->thread);
+                }
+                {
+                    ScopeLock lock(&worker->mutex);
+                    worker->pinned.push_back(task);
+                    worker->pinned_size.fetch_add(1, std::memory_order_seq_cst);
+                }
+                tickleIdle(i);
+                return;
+            }
+        }
+        // 固定在其他调度器线程上的协程切换到本调度器后不再固定
+        if(!inherited){
+            LOG_FMT_WARN(g_logger, "Scheduler %s 没有线程%d，任务由任意线程执行\n", m_name.c_str(), task->thread);
+        }
+        task->thread = -1;
+        if(task->fiber){
+            task->fiber->setPinnedThread(-1);
+        }
+    }
+    if(t_scheduler == this && t_worker >= 0){
+        // 工作线程自己调度的任务直接放入自己的无锁队列
+        m_workers[t_worker]->queue.push(task);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        tickleIdle();
+        return;
+    }
+    // 外部线程轮转放入收件箱
+    size_t index = nextWorker();
+    Worker* worker = m_workers[index].get();
+    {
+        ScopeLock lock(&worker->mutex);
+        worker->inbox.push_back(task);
+        worker->inbox_size.fetch_add(1, std::memory_order_seq_cst);
+    }
+    tickleIdle(index);
+}
+
+size_t Scheduler::nextWorker(){
+    // use_caller的调用线程在stop之前不执行调度，跳过它
+    size_t first = m_rootFiber && m_workers.size() > 1 ? 1 : 0;
+    return first + m_nextInbox.fetch_add(1, std::memory_order_relaxed) % (m_workers.size() - first);
+}
+
+void Scheduler::tickleIdle(int index){
+    if(index >= 0){
+        Worker* worker = m_workers[index].get();
+        if(worker->idle.load() && !worker->tickled.exchange(true)){
+            tickle(index);
+            return;
+        }
+        // 目标线程正忙，由空闲的线程来窃取
+    }
+    if(m_idleWorkers.load() == 0){
+        return;
+    }
+    for(size_t i = 0; i < m_workers.size(); ++i){
+        Worker* worker = m_workers[i].get();
+        if(worker->idle.load() && !worker->tickled.exchange(true)){
+            tickle(i);
+            return;
+        }
+    }
+}
+
+Scheduler::ScheduleTask* Scheduler::nextTask(size_t index){
+    Worker* worker = m_workers[index].get();
+    if(worker->pinned_size.load(std::memory_order_relaxed)){
+        ScopeLock lock(&worker->mutex);
+        if(!worker->pinned.empty()){
+            ScheduleTask* task = worker->pinned.front();
+            worker->pinned.pop_front();
+            worker->pinned_size.fetch_sub(1, std::memory_order_relaxed);
+            return task;
+        }
+    }
+    if(worker->inbox_size.load(std::memory_order_relaxed)){
+        // 收件箱整体移入本地队列，之后其他线程可以无锁窃取
+        std::deque<ScheduleTask*> inbox;
+        {
+            ScopeLock lock(&worker->mutex);
+            inbox.swap(worker->inbox);
+            worker->inbox_size.store(0, std::memory_order_relaxed);
+        }
+        for(auto task : inbox){
+            worker->queue.push(task);
+        }
+    }
+    ScheduleTask* task = worker->queue.steal();
+    if(task){
+        return task;
+    }
+    return stealTask(index);
+}
+
+Scheduler::ScheduleTask* Scheduler::stealTask(size_t index){
+    size_t count = m_workers.size();
+    if(count == 1){
+        return nullptr;
+    }
+    Worker* self = m_workers[index].get();
+    // xorshift选择起始位置，避免所有空闲线程同时窃取同一个队列
+    uint32_t x = self->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    self->seed = x;
+    size_t start = x % count;
+    for(size_t i = 0; i < count; ++i){
+        size_t victim = (start + i) % count;
+        if(victim == index){
+            continue;
+        }
+        ScheduleTask* task = m_workers[victim]->queue.steal();
+        if(task){
+            return task;
+        }
+    }
+    // 其他线程的收件箱里还没有移入队列的任务
+    for(size_t i = 0; i < count; ++i){
+        size_t victim = (start + i) % count;
+        Worker* worker = m_workers[victim].get();
+        if(victim == index || !worker->inbox_size.load(std::memory_order_relaxed)){
+            continue;
+        }
+        ScopeLock lock(&worker->mutex);
+        if(!worker->inbox.empty()){
+            ScheduleTask* task = worker->inbox.front();
+            worker->inbox.pop_front();
+            worker->inbox_size.fetch_sub(1, std::memory_order_relaxed);
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+bool Scheduler::hasTask(size_t index){
+    if(m_workers[index]->pinned_size.load()){
+        return true;
+    }
+    for(auto& worker : m_workers){
+        if(!worker->queue.empty() || worker->inbox_size.load()){
+            return true;
+        }
+    }
+    return false;
+}
+
+void Scheduler::run(){
+    setThis();
+    // 任务中的阻塞调用转为挂起协程，退出时恢复调用线程原来的设置
+    bool hook_enable = IsHookEnable();
+    SetHookEnable(true);
+    bool is_root = Thread::GetThisId() == m_rootThread;
+    if(is_root){
+        t_worker = 0;
+    }else{
+        t_scheduler_fiber = Fiber::GetThis().get();
+    }
+    size_t index = t_worker;
+    Worker* worker = m_workers[index].get();
+    Fiber::ptr idle_fiber = Fiber::Create(std::bind(&Scheduler::idle, this));
+    worker->idle.store(false);
+    static const size_t FLUSH_BATCH = 16;
+    size_t batch = 0;
+    while(true){
+        ScheduleTask* task = nextTask(index);
+        if(task){
+            if(++batch == FLUSH_BATCH){
+                batch = 0;
+                flush();
+            }
+            if(task->fiber){
+                Fiber::ptr fiber = std::move(task->fiber);
+                delete task;
+                if(fiber->getcurrentState() != Fiber::TERM && fiber->getcurrentState() != Fiber::EXCEPT){
+                    fiber->swapIn();
+                    if(fiber->getcurrentState() == Fiber::READY){
+                        schedule(std::move(fiber));
+                    }
+                }
+            }else{
+                Fiber::ptr fiber = Fiber::Create(std::move(task->cb));
+                // 指定了线程的函数任务，协程在整个生命周期内都留在该线程
+                fiber->setPinnedThread(task->thread);
+                delete task;
+                fiber->swapIn();
+                if(fiber->getcurrentState() == Fiber::READY){
+                    schedule(std::move(fiber));
+                }
+            }
+            // HOLD的协程由让出前登记它的一方负责重新调度
+            continue;
+        }
+        if(idle_fiber->getcurrentState() == Fiber::TERM){
+            break;
+        }
+        // 先声明空闲再检查一次队列，与调度方的 放入任务 -> 检查空闲 顺序相对，不会丢失唤醒
+        worker->idle.store(true);
+        m_idleWorkers.fetch_add(1);
+        if(!hasTask(index)){
+            idle_fiber->swapIn();
+        }
+        m_idleWorkers.fetch_sub(1);
+        worker->idle.store(false);
+        worker->tickled.store(false);
+    }
+    worker->idle.store(true);
+    // 本线程退出可能使stopping()成立，唤醒还在等待的线程重新检查
+    for(size_t i = 0; i < m_workers.size(); ++i){
+        if(i != index){
+            tickle(i);
+        }
+    }
+    if(is_root){
+        t_worker = -1;
+    }
+    SetHookEnable(hook_enable);
+    LOG_FMT_DEBUG(g_logger, "Scheduler %s worker %zu exit\n", m_name.c_str(), index);
+}
+
+void Scheduler::tickle(size_t worker){
+    m_workers[worker]->semaphore.notify();
+}
+
+void Scheduler::idle(){
+    Worker* worker = m_workers[t_worker].get();
+    while(!stopping()){
+        worker->semaphore.wait();
+        Fiber::YieldToHole();
+    }
+}
+
+bool Scheduler::stopping(){
+    if(!m_stopping){
+        return false;
+    }
+    for(auto& worker : m_workers){
+        if(!worker->idle.load() || !worker->queue.empty() || worker->inbox_size.load()
+                || worker->pinned_size.load()){
+            return false;
+        }
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,145 @@
+/*
+    @file scheduler.h
+    @brief 协程调度器(M:N，工作窃取)
+*/
+
+#ifndef __CAIZI_SCHEDULER_H__
+#define __CAIZI_SCHEDULER_H__
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "fiber.h"
+#include "noncopyable.h"
+#include "thread.h"
+#include "work_stealing_queue.h"
+
+namespace caizi{
+
+/*
+    N个工作线程运行M个协程。
+    每个工作线程有自己的无锁队列，工作线程内调度的任务放入自己的队列，没有任务时从其他线程的队列窃取，
+    不存在所有线程竞争的全局锁。其他线程调度的任务按轮转放入某个工作线程的收件箱(有锁，只与该线程竞争)。
+    指定了线程的任务只放入该线程的收件箱，不会被窃取；执行它的协程固定在该线程上，
+    之后挂起再被唤醒(IO就绪、定时器、YieldToReady)时不指定线程的schedule也回到该线程。
+    use_caller为true时创建调度器的线程也作为一个工作线程，在stop()中开始执行调度。
+*/
+class Scheduler : public Noncopyable{
+public:
+    typedef std::shared_ptr<Scheduler> ptr;
+
+    // @param threads 工作线程数量(use_caller时包括调用线程)
+    Scheduler(size_t threads = 1, bool use_caller = true, const std::string& name = "");
+    virtual ~Scheduler();
+
+    const std::string& getName() const{ return m_name; };
+
+    // 当前线程所属的调度器
+    static Scheduler* GetThis();
+    // 当前线程的调度协程，协程swapIn/swapOut与它切换
+    static Fiber* GetMainFiber();
+    // 当前线程正在执行调度循环时返回工作线程序号，否则返回-1
+    static int GetWorkerIndex();
+
+    void start();
+    // 等待所有任务执行完后停止，use_caller时必须由创建调度器的线程调用
+    void stop();
+
+    // 调度协程或函数，thread为指定执行的线程id，-1表示任意线程
+    template<class FiberOrCb>
+    void schedule(FiberOrCb fc, int thread = -1){
+        ScheduleTask* task = new ScheduleTask(std::move(fc), thread);
+        if(task->fiber || task->cb){
+            scheduleTask(task);
+        }else{
+            delete task;
+        }
+    }
+
+    template<class InputIterator>
+    void schedule(InputIterator begin, InputIterator end){
+        while(begin != end){
+            schedule(*begin);
+            ++begin;
+        }
+    }
+
+    // 把当前协程切换到本调度器的thread线程上执行
+    void switchTo(int thread = -1);
+
+    size_t getWorkerCount() const{ return m_workers.size(); };
+    // 第index个工作线程的线程id
+    int getWorkerThreadId(size_t index) const{ return m_workers[index]->thread_id; };
+    // use_caller时调用线程的id(它在stop()中才开始调度)，否则为-1
+    int getRootThreadId() const{ return m_rootThread; };
+    bool hasIdleThreads() const{ return m_idleWorkers.load(std::memory_order_relaxed) > 0; };
+
+protected:
+    // 唤醒第worker个工作线程
+    virtual void tickle(size_t worker);
+    // 没有任务时在idle协程中执行，唤醒后YieldToHole让出
+    virtual void idle();
+    // 是否可以停止：已调用stop、所有队列为空且所有工作线程都空闲
+    virtual bool stopping();
+    // 调度循环每连续执行一批任务后调用，子类用来批量提交积累的请求
+    virtual void flush(){}
+    // 工作线程的调度循环
+    void run();
+    void setThis();
+    // 外部线程提交的工作轮转分配给哪个工作线程
+    size_t nextWorker();
+    // 唤醒一个空闲的工作线程，worker>=0时优先唤醒它
+    void tickleIdle(int worker = -1);
+
+private:
+    struct ScheduleTask{
+        Fiber::ptr fiber;
+        std::function<void()> cb;
+        int thread;
+
+        ScheduleTask(Fiber::ptr f, int thr): fiber(std::move(f)), thread(thr){}
+        ScheduleTask(std::function<void()> f, int thr): cb(std::move(f)), thread(thr){}
+    };
+
+    struct alignas(64) Worker{
+        WorkStealingQueue<ScheduleTask*> queue;     // 本线程调度的任务，其他线程可以窃取
+        Mutex mutex;
+        std::deque<ScheduleTask*> inbox;            // 其他线程调度过来的任务
+        std::deque<ScheduleTask*> pinned;           // 指定在本线程执行的任务
+        std::atomic<size_t> inbox_size{0};
+        std::atomic<size_t> pinned_size{0};
+        std::atomic<bool> idle{false};              // 正在idle协程中
+        std::atomic<bool> tickled{false};           // 已被唤醒，还没有离开idle
+        Semaphore semaphore;                        // 默认idle的等待对象
+        Thread::ptr thread;
+        int thread_id = -1;
+        uint32_t seed = 1;                          // 选择窃取对象的随机数种子
+    };
+
+    void scheduleTask(ScheduleTask* task);
+    // 按 指定任务 -> 收件箱 -> 本地队列 -> 窃取 的顺序取下一个任务
+    ScheduleTask* nextTask(size_t index);
+    ScheduleTask* stealTask(size_t index);
+    // 本线程能执行的任务是否存在
+    bool hasTask(size_t index);
+
+protected:
+    std::string m_name;
+    int m_rootThread = -1;                      // use_caller时调用线程的id
+    std::atomic<bool> m_stopping{false};
+
+private:
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    Fiber::ptr m_rootFiber;                     // use_caller时调用线程上执行run的协程
+    std::atomic<int> m_idleWorkers{0};
+    std::atomic<size_t> m_nextInbox{0};         // 外部调度轮转的下一个收件箱
+    bool m_started = false;
+};
+
+}
+
+#endif
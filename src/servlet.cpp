@@ -0,0 +1,206 @@
+#include "servlet.h"
+
+namespace caizi{
+
+FunctionServlet::FunctionServlet(callback cb)
+    :Servlet("FunctionServlet")
+    ,m_cb(cb){
+}
+
+int32_t FunctionServlet::handle(const HttpRequest& request, HttpResponse& response, HttpSession::ptr session){
+    return m_cb(request, response, session);
+}
+
+NotFoundServlet::NotFoundServlet(const std::string& name)
+    :Servlet("NotFoundServlet"){
+    m_content = "<html><head><title>404 Not Found</title></head><body><center><h1>404 Not Found</h1></center>"
+                "<hr><center>" + name + "</center></body></html>";
+}
+
+int32_t NotFoundServlet::handle(const HttpRequest& request, HttpResponse& response, HttpSession::ptr session){
+    response.setStatus(HttpStatus::NOT_FOUND);
+    response.setHeader("Content-Type", "text/html");
+    response.setBody(m_content);
+    return 0;
+}
+
+FileServlet::FileServlet(const std::string& root, const std::string& prefix)
+    :Servlet("FileServlet")
+    ,m_root(root)
+    ,m_prefix(prefix){
+    while(!m_root.empty() && m_root.back() == '/'){
+        m_root.pop_back();
+    }
+}
+
+int32_t FileServlet::handle(const HttpRequest& request, HttpResponse& response, HttpSession::ptr session){
+    if(request.getMethod() != HttpMethod::GET && request.getMethod() != HttpMethod::HEAD){
+        response.setStatus(HttpStatus::METHOD_NOT_ALLOWED);
+        response.setHeader("Allow", "GET, HEAD");
+        return 0;
+    }
+    std::string_view path = request.getPath();
+    if(path.compare(0, m_prefix.size(), m_prefix) == 0){
+        path.remove_prefix(m_prefix.size());
+    }
+    // 不允许访问root之外的文件
+    std::string_view rest = path;
+    while(!rest.empty()){
+        size_t slash = rest.find('/');
+        if(rest.substr(0, slash) == ".."){
+            response.setStatus(HttpStatus::FORBIDDEN);
+            return 0;
+        }
+        rest = slash == std::string_view::npos ? std::string_view() : rest.substr(slash + 1);
+    }
+    std::string file = m_root;
+    if(path.empty() || path[0] != '/'){
+        file.push_back('/');
+    }
+    file.append(path.data(), path.size());
+    if(!response.setFile(file)){
+        response.setStatus(HttpStatus::NOT_FOUND);
+    }
+    return 0;
+}
+
+/*
+    取出路径的下一段，开头的'/'在调用前去掉
+    "a/b" -> "a"，剩下"b"；"a/" -> "a"，剩下""(还有一个空段)；"a" -> "a"，没有剩下的段
+*/
+static std::string_view NextSegment(std::string_view& rest, bool& more){
+    size_t slash = rest.find('/');
+    std::string_view seg = rest.substr(0, slash);
+    more = slash != std::string_view::npos;
+    rest = more ? rest.substr(slash + 1) : std::string_view();
+    return seg;
+}
+
+static std::string_view StripLeadingSlash(std::string_view path){
+    if(!path.empty() && path[0] == '/'){
+        path.remove_prefix(1);
+    }
+    return path;
+}
+
+// 前缀结尾的'/'不影响匹配
+static std::string_view StripTrailingSlash(std::string_view path){
+    while(path.size() > 1 && path.back() == '/'){
+        path.remove_suffix(1);
+    }
+    return path;
+}
+
+ServletDispatch::ServletDispatch()
+    :Servlet("ServletDispatch"){
+    m_default.reset(new NotFoundServlet("caizi/1.0.0"));
+}
+
+int32_t ServletDispatch::handle(const HttpRequest& request, HttpResponse& response, HttpSession::ptr session){
+    Servlet::ptr slt = getMatchedServlet(request.getPath());
+    if(slt){
+        slt->handle(request, response, session);
+    }
+    return 0;
+}
+
+ServletDispatch::Node* ServletDispatch::findNode(std::string_view path, bool create){
+    Node* node = &m_root;
+    std::string_view rest = StripLeadingSlash(path);
+    bool more = !rest.empty();
+    while(more){
+        std::string_view seg = NextSegment(rest, more);
+        auto it = node->children.find(seg);
+        if(it == node->children.end()){
+            if(!create){
+                return nullptr;
+            }
+            it = node->children.emplace(std::string(seg), std::unique_ptr<Node>(new Node)).first;
+        }
+        node = it->second.get();
+    }
+    return node;
+}
+
+void ServletDispatch::addServlet(const std::string& uri, Servlet::ptr slt){
+    WriteScopeLock lock(&m_mutex);
+    findNode(uri, true)->exact = slt;
+}
+
+void ServletDispatch::addServlet(const std::string& uri, FunctionServlet::callback cb){
+    addServlet(uri, Servlet::ptr(new FunctionServlet(cb)));
+}
+
+void ServletDispatch::addPrefixServlet(const std::string& prefix, Servlet::ptr slt){
+    WriteScopeLock lock(&m_mutex);
+    findNode(StripTrailingSlash(prefix), true)->prefix = slt;
+}
+
+void ServletDispatch::addPrefixServlet(const std::string& prefix, FunctionServlet::callback cb){
+    addPrefixServlet(prefix, Servlet::ptr(new FunctionServlet(cb)));
+}
+
+// 节点保留，没有servlet的节点只影响查找时经过的路径
+void ServletDispatch::delServlet(const std::string& uri){
+    WriteScopeLock lock(&m_mutex);
+    Node* node = findNode(uri, false);
+    if(node){
+        node->exact.reset();
+    }
+}
+
+void ServletDispatch::delPrefixServlet(const std::string& prefix){
+    WriteScopeLock lock(&m_mutex);
+    Node* node = findNode(StripTrailingSlash(prefix), false);
+    if(node){
+        node->prefix.reset();
+    }
+}
+
+Servlet::ptr ServletDispatch::getDefault(){
+    ReadScopeLock lock(&m_mutex);
+    return m_default;
+}
+
+void ServletDispatch::setDefault(Servlet::ptr v){
+    WriteScopeLock lock(&m_mutex);
+    m_default = v;
+}
+
+Servlet::ptr ServletDispatch::getServlet(const std::string& uri){
+    ReadScopeLock lock(&m_mutex);
+    Node* node = findNode(uri, false);
+    return node ? node->exact : nullptr;
+}
+
+Servlet::ptr ServletDispatch::getPrefixServlet(const std::string& prefix){
+    ReadScopeLock lock(&m_mutex);
+    Node* node = findNode(StripTrailingSlash(prefix), false);
+    return node ? node->prefix : nullptr;
+}
+
+Servlet::ptr ServletDispatch::getMatchedServlet(std::string_view path){
+    ReadScopeLock lock(&m_mutex);
+    Node* node = &m_root;
+    Servlet::ptr* matched = &m_root.prefix;
+    std::string_view rest = StripLeadingSlash(path);
+    bool more = !rest.empty();
+    while(more){
+        std::string_view seg = NextSegment(rest, more);
+        auto it = node->children.find(seg);
+        if(it == node->children.end()){
+            node = nullptr;
+            break;
+        }
+        node = it->second.get();
+        if(node->prefix){
+            matched = &node->prefix;
+        }
+    }
+    if(node && node->exact){
+        return node->exact;
+    }
+    return *matched ? *matched : m_default;
+}
+
+}
@@ -0,0 +1,129 @@
+/*
+    @file servlet.h
+    @brief HTTP请求的处理和分发
+*/
+
+#ifndef __CAIZI_SERVLET_H__
+#define __CAIZI_SERVLET_H__
+
+#include "http.h"
+#include "http_session.h"
+#include "thread.h"
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace caizi{
+
+class Servlet{
+public:
+    typedef std::shared_ptr<Servlet> ptr;
+
+    Servlet(const std::string& name): m_name(name){}
+    virtual ~Servlet(){}
+
+    // @return 0表示成功
+    virtual int32_t handle(const HttpRequest& request, HttpResponse& response, HttpSession::ptr session) = 0;
+
+    const std::string& getName() const{ return m_name; };
+
+protected:
+    std::string m_name;
+};
+
+class FunctionServlet : public Servlet{
+public:
+    typedef std::shared_ptr<FunctionServlet> ptr;
+    typedef std::function<int32_t(const HttpRequest& request, HttpResponse& response,
+                                  HttpSession::ptr session)> callback;
+
+    FunctionServlet(callback cb);
+    int32_t handle(const HttpRequest& request, HttpResponse& response, HttpSession::ptr session) override;
+
+private:
+    callback m_cb;
+};
+
+// 没有匹配的servlet时返回404
+class NotFoundServlet : public Servlet{
+public:
+    typedef std::shared_ptr<NotFoundServlet> ptr;
+
+    NotFoundServlet(const std::string& name);
+    int32_t handle(const HttpRequest& request, HttpResponse& response, HttpSession::ptr session) override;
+
+private:
+    std::string m_content;
+};
+
+/*
+    把prefix之后的路径映射到root目录下的文件，用sendfile发送
+    只支持GET和HEAD，含".."段的路径返回403，文件不存在或不是普通文件返回404
+*/
+class FileServlet : public Servlet{
+public:
+    typedef std::shared_ptr<FileServlet> ptr;
+
+    // @param prefix 注册时使用的路径前缀，请求路径去掉它之后拼接到root
+    FileServlet(const std::string& root, const std::string& prefix = "");
+    int32_t handle(const HttpRequest& request, HttpResponse& response, HttpSession::ptr session) override;
+
+private:
+    std::string m_root;
+    std::string m_prefix;
+};
+
+/*
+    按路径分发请求，路径按'/'分段存放在字典树中，查找只沿请求路径走一遍，与注册的数量无关
+        精确匹配    addServlet("/api/user")只匹配/api/user
+        前缀匹配    addPrefixServlet("/static")匹配/static以及/static/下的所有路径(按段匹配，不匹配/staticx)，
+                    结尾的'/'忽略，"/"匹配所有路径
+    同一路径上精确匹配优先，前缀匹配取最长的，都没有时交给默认servlet。
+    路径按原始字节比较，不做百分号解码和规范化。
+*/
+class ServletDispatch : public Servlet{
+public:
+    typedef std::shared_ptr<ServletDispatch> ptr;
+    typedef RWLock RWMutexType;
+
+    ServletDispatch();
+    int32_t handle(const HttpRequest& request, HttpResponse& response, HttpSession::ptr session) override;
+
+    void addServlet(const std::string& uri, Servlet::ptr slt);
+    void addServlet(const std::string& uri, FunctionServlet::callback cb);
+    void addPrefixServlet(const std::string& prefix, Servlet::ptr slt);
+    void addPrefixServlet(const std::string& prefix, FunctionServlet::callback cb);
+
+    void delServlet(const std::string& uri);
+    void delPrefixServlet(const std::string& prefix);
+
+    Servlet::ptr getDefault();
+    void setDefault(Servlet::ptr v);
+
+    Servlet::ptr getServlet(const std::string& uri);
+    Servlet::ptr getPrefixServlet(const std::string& prefix);
+    // 按精确、最长前缀、默认的顺序查找
+    Servlet::ptr getMatchedServlet(std::string_view path);
+
+private:
+    struct Node{
+        // std::less<>可以直接用string_view查找，不构造string
+        std::map<std::string, std::unique_ptr<Node>, std::less<>> children;
+        Servlet::ptr exact;
+        Servlet::ptr prefix;
+    };
+
+    // 找到(create为true时创建)路径对应的节点，不存在时返回nullptr
+    Node* findNode(std::string_view path, bool create);
+
+private:
+    RWMutexType m_mutex;
+    Node m_root;
+    Servlet::ptr m_default;
+};
+
+}
+
+#endif
@@ -0,0 +1,391 @@
+#include "simd_codec.h"
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CAIZI_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+namespace caizi{
+
+const char* SimdLevelToString(SimdLevel level){
+    switch(level){
+#define XX(name) \
+        case SimdLevel::name: \
+            return #name;
+        XX(SCALAR);
+        XX(SSSE3);
+        XX(AVX2);
+#undef XX
+        default:
+            return "UNKNOWN";
+    }
+}
+
+SimdLevel GetCpuSimdLevel(){
+    static SimdLevel s_level = [](){
+#ifdef CAIZI_SIMD_X86
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2")){
+            return SimdLevel::AVX2;
+        }
+        if(__builtin_cpu_supports("ssse3")){
+            return SimdLevel::SSSE3;
+        }
+#endif
+        return SimdLevel::SCALAR;
+    }();
+    return s_level;
+}
+
+// 放在函数里，其它编译单元静态初始化时调用也是已初始化的
+static std::atomic<int>& CurrentLevel(){
+    static std::atomic<int> s_current{(int)GetCpuSimdLevel()};
+    return s_current;
+}
+
+SimdLevel GetSimdLevel(){
+    return (SimdLevel)CurrentLevel().load(std::memory_order_relaxed);
+}
+
+SimdLevel SetSimdLevel(SimdLevel level){
+    if((int)level > (int)GetCpuSimdLevel()){
+        level = GetCpuSimdLevel();
+    }
+    CurrentLevel().store((int)level, std::memory_order_relaxed);
+    return level;
+}
+
+/*
+    标量实现
+*/
+template<class T>
+static void ByteswapScalar(T* dst, const T* src, size_t count){
+    for(size_t i = 0; i < count; ++i){
+        dst[i] = byteswap(src[i]);
+    }
+}
+
+static inline size_t EncodeVarint(uint64_t value, uint8_t* p){
+    size_t i = 0;
+    while(value >= 0x80){
+        p[i++] = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    p[i++] = value;
+    return i;
+}
+
+// @return 消耗的字节数，数据不足或超过max_len字节时返回0
+template<class T>
+static inline size_t DecodeVarint(const uint8_t* p, size_t avail, T& value, size_t max_len){
+    T result = 0;
+    for(size_t i = 0; i < avail && i < max_len; ++i){
+        result |= (T)(p[i] & 0x7f) << (7 * i);
+        if(!(p[i] & 0x80)){
+            value = result;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+template<class T>
+static size_t VarintEncodeScalar(const T* src, size_t count, uint8_t* dst){
+    size_t pos = 0;
+    for(size_t i = 0; i < count; ++i){
+        pos += EncodeVarint(src[i], dst + pos);
+    }
+    return pos;
+}
+
+template<class T>
+static int64_t VarintDecodeScalar(const uint8_t* src, size_t size, T* dst, size_t count, size_t max_len){
+    size_t pos = 0;
+    for(size_t i = 0; i < count; ++i){
+        size_t len = DecodeVarint(src + pos, size - pos, dst[i], max_len);
+        if(!len){
+            return -1;
+        }
+        pos += len;
+    }
+    return pos;
+}
+
+#ifdef CAIZI_SIMD_X86
+
+// pshufb的字节重排表，每个元素内部的字节倒序，32字节供AVX2使用
+alignas(32) static const uint8_t s_swap16_mask[32] = {
+    1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+    1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+};
+alignas(32) static const uint8_t s_swap32_mask[32] = {
+    3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+    3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+};
+alignas(32) static const uint8_t s_swap64_mask[32] = {
+    7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+    7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+};
+
+template<class T>
+__attribute__((target("ssse3")))
+static void ByteswapSSSE3(T* dst, const T* src, size_t count, const uint8_t* mask){
+    const __m128i shuffle = _mm_load_si128((const __m128i*)mask);
+    const size_t per = 16 / sizeof(T);
+    size_t i = 0;
+    for(; i + per <= count; i += per){
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_shuffle_epi8(v, shuffle));
+    }
+    ByteswapScalar(dst + i, src + i, count - i);
+}
+
+// vpshufb只在128位的两半内重排，元素不跨越两半，直接可用
+template<class T>
+__attribute__((target("avx2")))
+static void ByteswapAVX2(T* dst, const T* src, size_t count, const uint8_t* mask){
+    const __m256i shuffle = _mm256_load_si256((const __m256i*)mask);
+    const size_t per = 32 / sizeof(T);
+    size_t i = 0;
+    for(; i + 2 * per <= count; i += 2 * per){
+        __m256i v0 = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i v1 = _mm256_loadu_si256((const __m256i*)(src + i + per));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_shuffle_epi8(v0, shuffle));
+        _mm256_storeu_si256((__m256i*)(dst + i + per), _mm256_shuffle_epi8(v1, shuffle));
+    }
+    ByteswapSSSE3(dst + i, src + i, count - i, mask);
+}
+
+/*
+    varint编码：每次4个小于2^28的值(最多4字节)
+    每个值先在32位内展开成4个7位组并设置延续位，再按4个值的长度查表用pshufb把有效字节紧凑排列
+    表的下标是4个(长度-1)，每个占2位
+*/
+struct VarintEncodeEntry{
+    uint8_t shuffle[16];
+    uint8_t length;
+};
+
+/*
+    varint解码(Masked-VByte)：取16字节的最高位得到延续位掩码，用低12位查表，
+    表项给出开头最多4个不超过4字节的值的pshufb重排(每个值放到一个32位通道)、值的个数和消耗的字节数，
+    重排后去掉延续位并把7位组合并成整数。第一个值超过4字节或者不在12字节内结束时(个数为0)用标量解一个
+*/
+struct VarintDecodeEntry{
+    uint8_t shuffle[16];
+    uint8_t count;
+    uint8_t consumed;
+};
+
+struct VarintTables{
+    VarintEncodeEntry encode[256];
+    VarintDecodeEntry decode[1 << 12];
+
+    VarintTables(){
+        for(int key = 0; key < 256; ++key){
+            VarintEncodeEntry& entry = encode[key];
+            memset(entry.shuffle, 0x80, sizeof(entry.shuffle));
+            uint8_t pos = 0;
+            for(int lane = 0; lane < 4; ++lane){
+                int len = ((key >> (2 * lane)) & 3) + 1;
+                for(int j = 0; j < len; ++j){
+                    entry.shuffle[pos++] = lane * 4 + j;
+                }
+            }
+            entry.length = pos;
+        }
+        for(int mask = 0; mask < (1 << 12); ++mask){
+            VarintDecodeEntry& entry = decode[mask];
+            memset(entry.shuffle, 0x80, sizeof(entry.shuffle));
+            int pos = 0;
+            int count = 0;
+            while(count < 4){
+                int end = pos;
+                while(end < 12 && (mask & (1 << end))){
+                    ++end;
+                }
+                if(end >= 12 || end - pos + 1 > 4){
+                    break;
+                }
+                for(int j = pos; j <= end; ++j){
+                    entry.shuffle[count * 4 + j - pos] = j;
+                }
+                pos = end + 1;
+                ++count;
+            }
+            entry.count = count;
+            entry.consumed = pos;
+        }
+    }
+};
+
+static const VarintTables& GetVarintTables(){
+    static VarintTables s_tables;
+    return s_tables;
+}
+
+// 4个(0~3)组成的位掩码展开到每2位一个
+static inline uint32_t SpreadMask4(uint32_t m){
+    return (m & 1) | ((m & 2) << 1) | ((m & 4) << 2) | ((m & 8) << 3);
+}
+
+__attribute__((target("ssse3")))
+static size_t VarintEncodeSSSE3(const uint32_t* src, size_t count, uint8_t* dst){
+    const VarintEncodeEntry* table = GetVarintTables().encode;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i high4 = _mm_set1_epi32(0xf0000000);
+    const __m128i low7 = _mm_set1_epi32(0x7f);
+    size_t pos = 0;
+    size_t i = 0;
+    // 每次无条件写16字节，剩余的输出空间 5*(count-i) >= 20 保证不越界
+    while(i + 4 <= count){
+        if(i + 16 <= count){
+            // 16个值都小于128时直接压缩成16字节
+            __m128i v0 = _mm_loadu_si128((const __m128i*)(src + i));
+            __m128i v1 = _mm_loadu_si128((const __m128i*)(src + i + 4));
+            __m128i v2 = _mm_loadu_si128((const __m128i*)(src + i + 8));
+            __m128i v3 = _mm_loadu_si128((const __m128i*)(src + i + 12));
+            __m128i all = _mm_or_si128(_mm_or_si128(v0, v1), _mm_or_si128(v2, v3));
+            if(_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_andnot_si128(low7, all), zero)) == 0xffff){
+                __m128i out = _mm_packus_epi16(_mm_packs_epi32(v0, v1), _mm_packs_epi32(v2, v3));
+                _mm_storeu_si128((__m128i*)(dst + pos), out);
+                pos += 16;
+                i += 16;
+                continue;
+            }
+        }
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        i += 4;
+        if(_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(v, high4), zero)) != 0xffff){
+            pos += VarintEncodeScalar(src + i - 4, 4, dst + pos);
+            continue;
+        }
+        __m128i t = _mm_or_si128(
+                _mm_or_si128(_mm_and_si128(v, low7),
+                             _mm_and_si128(_mm_slli_epi32(v, 1), _mm_slli_epi32(low7, 8))),
+                _mm_or_si128(_mm_and_si128(_mm_slli_epi32(v, 2), _mm_slli_epi32(low7, 16)),
+                             _mm_and_si128(_mm_slli_epi32(v, 3), _mm_slli_epi32(low7, 24))));
+        // 值小于2^28，有符号比较也正确
+        __m128i c7 = _mm_cmpgt_epi32(v, _mm_set1_epi32((1 << 7) - 1));
+        __m128i c14 = _mm_cmpgt_epi32(v, _mm_set1_epi32((1 << 14) - 1));
+        __m128i c21 = _mm_cmpgt_epi32(v, _mm_set1_epi32((1 << 21) - 1));
+        __m128i cont = _mm_or_si128(_mm_and_si128(c7, _mm_set1_epi32(0x80)),
+                                    _mm_or_si128(_mm_and_si128(c14, _mm_set1_epi32(0x8000)),
+                                                 _mm_and_si128(c21, _mm_set1_epi32(0x800000))));
+        t = _mm_or_si128(t, cont);
+        uint32_t key = SpreadMask4(_mm_movemask_ps(_mm_castsi128_ps(c7)))
+                     + SpreadMask4(_mm_movemask_ps(_mm_castsi128_ps(c14)))
+                     + SpreadMask4(_mm_movemask_ps(_mm_castsi128_ps(c21)));
+        const VarintEncodeEntry& entry = table[key];
+        __m128i out = _mm_shuffle_epi8(t, _mm_loadu_si128((const __m128i*)entry.shuffle));
+        _mm_storeu_si128((__m128i*)(dst + pos), out);
+        pos += entry.length;
+    }
+    return pos + VarintEncodeScalar(src + i, count - i, dst + pos);
+}
+
+__attribute__((target("ssse3")))
+static int64_t VarintDecodeSSSE3(const uint8_t* src, size_t size, uint32_t* dst, size_t count){
+    const VarintDecodeEntry* table = GetVarintTables().decode;
+    const __m128i zero = _mm_setzero_si128();
+    size_t pos = 0;
+    size_t n = 0;
+    while(size - pos >= 16 && count - n >= 4){
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + pos));
+        uint32_t bits = _mm_movemask_epi8(v);
+        if(bits == 0 && count - n >= 16){
+            // 16个单字节的值，直接零扩展
+            __m128i lo = _mm_unpacklo_epi8(v, zero);
+            __m128i hi = _mm_unpackhi_epi8(v, zero);
+            _mm_storeu_si128((__m128i*)(dst + n), _mm_unpacklo_epi16(lo, zero));
+            _mm_storeu_si128((__m128i*)(dst + n + 4), _mm_unpackhi_epi16(lo, zero));
+            _mm_storeu_si128((__m128i*)(dst + n + 8), _mm_unpacklo_epi16(hi, zero));
+            _mm_storeu_si128((__m128i*)(dst + n + 12), _mm_unpackhi_epi16(hi, zero));
+            pos += 16;
+            n += 16;
+            continue;
+        }
+        const VarintDecodeEntry& entry = table[bits & 0xfff];
+        if(entry.count == 0){
+            size_t len = DecodeVarint(src + pos, size - pos, dst[n], kMaxVarint32Size);
+            if(!len){
+                return -1;
+            }
+            pos += len;
+            ++n;
+            continue;
+        }
+        // 每个32位通道是一个值的1~4字节(其余为0)，去掉延续位后把7位组拼起来
+        __m128i t = _mm_shuffle_epi8(v, _mm_loadu_si128((const __m128i*)entry.shuffle));
+        t = _mm_and_si128(t, _mm_set1_epi32(0x7f7f7f7f));
+        t = _mm_or_si128(_mm_and_si128(t, _mm_set1_epi32(0x007f007f)),
+                         _mm_srli_epi32(_mm_and_si128(t, _mm_set1_epi32(0x7f007f00)), 1));
+        t = _mm_or_si128(_mm_and_si128(t, _mm_set1_epi32(0x0000ffff)),
+                         _mm_srli_epi32(_mm_and_si128(t, _mm_set1_epi32(0xffff0000)), 2));
+        // 总是写4个通道，多出的会被后面的值覆盖
+        _mm_storeu_si128((__m128i*)(dst + n), t);
+        pos += entry.consumed;
+        n += entry.count;
+    }
+    int64_t rt = VarintDecodeScalar(src + pos, size - pos, dst + n, count - n, kMaxVarint32Size);
+    return rt < 0 ? -1 : (int64_t)pos + rt;
+}
+
+#endif
+
+#ifdef CAIZI_SIMD_X86
+#define CAIZI_BYTESWAP_ARRAY(type, mask) \
+    void ByteswapArray(type* dst, const type* src, size_t count){ \
+        switch(GetSimdLevel()){ \
+            case SimdLevel::AVX2: \
+                ByteswapAVX2(dst, src, count, mask); \
+                break; \
+            case SimdLevel::SSSE3: \
+                ByteswapSSSE3(dst, src, count, mask); \
+                break; \
+            default: \
+                ByteswapScalar(dst, src, count); \
+                break; \
+        } \
+    }
+#else
+#define CAIZI_BYTESWAP_ARRAY(type, mask) \
+    void ByteswapArray(type* dst, const type* src, size_t count){ \
+        ByteswapScalar(dst, src, count); \
+    }
+#endif
+
+CAIZI_BYTESWAP_ARRAY(uint16_t, s_swap16_mask);
+CAIZI_BYTESWAP_ARRAY(uint32_t, s_swap32_mask);
+CAIZI_BYTESWAP_ARRAY(uint64_t, s_swap64_mask);
+#undef CAIZI_BYTESWAP_ARRAY
+
+size_t VarintEncodeArray(const uint32_t* src, size_t count, uint8_t* dst){
+#ifdef CAIZI_SIMD_X86
+    if(GetSimdLevel() != SimdLevel::SCALAR){
+        return VarintEncodeSSSE3(src, count, dst);
+    }
+#endif
+    return VarintEncodeScalar(src, count, dst);
+}
+
+// 64位的值多数超过4字节，没有SIMD实现
+size_t VarintEncodeArray(const uint64_t* src, size_t count, uint8_t* dst){
+    return VarintEncodeScalar(src, count, dst);
+}
+
+int64_t VarintDecodeArray(const uint8_t* src, size_t size, uint32_t* dst, size_t count){
+#ifdef CAIZI_SIMD_X86
+    if(GetSimdLevel() != SimdLevel::SCALAR){
+        return VarintDecodeSSSE3(src, size, dst, count);
+    }
+#endif
+    return VarintDecodeScalar(src, size, dst, count, kMaxVarint32Size);
+}
+
+int64_t VarintDecodeArray(const uint8_t* src, size_t size, uint64_t* dst, size_t count){
+    return VarintDecodeScalar(src, size, dst, count, kMaxVarint64Size);
+}
+
+}
@@ -0,0 +1,79 @@
+/*
+    @file simd_codec.h
+    @brief 批量字节序转换和varint编解码(SIMD加速，运行时按CPU选择实现)
+*/
+
+#ifndef __CAIZI_SIMD_CODEC_H__
+#define __CAIZI_SIMD_CODEC_H__
+
+#include "endiant.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace caizi{
+
+/*
+    实现级别，启动时用cpuid检测CPU支持的最高级别
+        SCALAR  逐个元素处理，所有平台可用
+        SSSE3   pshufb，每次16字节
+        AVX2    vpshufb，每次32字节(varint编解码与SSSE3相同)
+    64位的varint只有标量实现
+*/
+enum class SimdLevel{
+    SCALAR = 0,
+    SSSE3 = 1,
+    AVX2 = 2,
+};
+
+const char* SimdLevelToString(SimdLevel level);
+// CPU支持的最高级别
+SimdLevel GetCpuSimdLevel();
+// 当前使用的级别
+SimdLevel GetSimdLevel();
+// 设置使用的级别，超过CPU支持的级别时使用CPU支持的最高级别，用于测试和基准测试对比
+// @return 实际使用的级别
+SimdLevel SetSimdLevel(SimdLevel level);
+
+/*
+    批量字节序转换，dst和src可以是同一块内存(原地转换)，其它情况不能重叠
+*/
+void ByteswapArray(uint16_t* dst, const uint16_t* src, size_t count);
+void ByteswapArray(uint32_t* dst, const uint32_t* src, size_t count);
+void ByteswapArray(uint64_t* dst, const uint64_t* src, size_t count);
+
+// 只在小端机器上转换字节序(主机序和网络序互转)
+template<class T>
+void ByteswapArrayOnLittleEndian(T* dst, const T* src, size_t count){
+#if CAIZI_BYTE_ORDER == CAIZI_BIG_ENDIAN
+    if(dst != src){
+        memcpy(dst, src, count * sizeof(T));
+    }
+#else
+    ByteswapArray(dst, src, count);
+#endif
+}
+
+// 每个值编码后的最大字节数，dst至少需要count倍
+static const size_t kMaxVarint32Size = 5;
+static const size_t kMaxVarint64Size = 10;
+
+/*
+    批量varint编码，格式与ByteArray::writeUint32/writeUint64相同(每字节7位，低位在前)
+    @param dst 至少 count * kMaxVarint32Size(kMaxVarint64Size) 字节
+    @return 写入的字节数
+*/
+size_t VarintEncodeArray(const uint32_t* src, size_t count, uint8_t* dst);
+size_t VarintEncodeArray(const uint64_t* src, size_t count, uint8_t* dst);
+
+/*
+    批量varint解码，从src中解出count个值
+    uint32的值超过5字节、uint64的值超过10字节视为数据错误，超出32/64位的高位丢弃
+    @return 消耗的字节数，数据不足或错误时返回-1
+*/
+int64_t VarintDecodeArray(const uint8_t* src, size_t size, uint32_t* dst, size_t count);
+int64_t VarintDecodeArray(const uint8_t* src, size_t size, uint64_t* dst, size_t count);
+
+}
+
+#endif
@@ -1,6 +1,22 @@
 #include "socket.h"
+#include "config.h"
+#include "fd_manager.h"
+#include "iomanager.h"
+#include "log.h"
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sstream>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace caizi{
+
+    static Logger::ptr g_logger = CAIZI_GET_LOGGER("system");
+
+    static ConfigVar<uint32_t>::ptr g_zerocopy_threshold =
+        Config::Lookup<uint32_t>("tcp.zerocopy.threshold", 16 * 1024, "min payload(bytes) sent with MSG_ZEROCOPY");
     
     Socket::Socket(int family, int type, int protocol):
                     m_sock(-1),m_family(family),m_type(type),m_protocol(protocol),m_isConnect(false){};
@@ -10,6 +26,7 @@ namespace caizi{
 
     Socket::ptr Socket::createTCP(caizi::Address::ptr address){
         Socket::ptr sock(new Socket(address->getFamily(), TCP, 0));
+        sock->newSock();
         return sock;
     }
     Socket::ptr Socket::createUDP(caizi::Address::ptr address){
@@ -19,37 +36,495 @@ namespace caizi{
         return sock;
     }
     // 创建IPV4套接字
-    Socket::ptr Socket::CreateTCPSocket(){}
-    Socket::ptr Socket::CreateUDPSocket(){}
+    Socket::ptr Socket::CreateTCPSocket(){
+        Socket::ptr sock(new Socket(IPv4, TCP, 0));
+        sock->newSock();
+        return sock;
+    }
+    Socket::ptr Socket::CreateUDPSocket(){
+        Socket::ptr sock(new Socket(IPv4, UDP, 0));
+        sock->newSock();
+        sock->m_isConnect = true;
+        return sock;
+    }
     // 创建IPV6套接字
-    Socket::ptr Socket::CreateTCPSocket6(){}
-    Socket::ptr Socket::CreateUDPSocket6(){}
+    Socket::ptr Socket::CreateTCPSocket6(){
+        Socket::ptr sock(new Socket(IPv6, TCP, 0));
+        sock->newSock();
+        return sock;
+    }
+    Socket::ptr Socket::CreateUDPSocket6(){
+        Socket::ptr sock(new Socket(IPv6, UDP, 0));
+        sock->newSock();
+        sock->m_isConnect = true;
+        return sock;
+    }
 
-    int64_t Socket::getSendTimeout(){}
-    void Socket::setSendTimeout(int64_t timeout){}
-    int64_t Socket::getRecvTimeout(){}
-    void Socket::setRecvTimeout(int64_t timeout){}
-    
-    bool Socket::getOption(int level, int option, void* result, socklen_t* length){}
-    bool Socket::setOption(int level, int option, void* result, socklen_t length){}
+    // 超时由hook的setsockopt记录到FdManager
+    static timeval ToTimeval(int64_t timeout){
+        timeval tv{0, 0};
+        if(timeout > 0){
+            tv.tv_sec = timeout / 1000;
+            tv.tv_usec = timeout % 1000 * 1000;
+        }
+        return tv;
+    }
 
-    Address::ptr Socket::getRemoteAddress(){}
-    Address::ptr Socket::getLocalAddress(){}
+    int64_t Socket::getSendTimeout(){
+        FdCtx* ctx = FdMgr::getInstance()->get(m_sock);
+        return ctx ? (int64_t)ctx->getTimeout(SO_SNDTIMEO) : -1;
+    }
+    void Socket::setSendTimeout(int64_t timeout){
+        setOption(SOL_SOCKET, SO_SNDTIMEO, ToTimeval(timeout));
+    }
+    int64_t Socket::getRecvTimeout(){
+        FdCtx* ctx = FdMgr::getInstance()->get(m_sock);
+        return ctx ? (int64_t)ctx->getTimeout(SO_RCVTIMEO) : -1;
+    }
+    void Socket::setRecvTimeout(int64_t timeout){
+        setOption(SOL_SOCKET, SO_RCVTIMEO, ToTimeval(timeout));
+    }
+
+    bool Socket::getOption(int level, int option, void* result, socklen_t* length){
+        if(getsockopt(m_sock, level, option, result, length)){
+            LOG_FMT_DEBUG(g_logger, "getOption sock=%d level=%d option=%d errno=%d %s\n",
+                          m_sock, level, option, errno, strerror(errno));
+            return false;
+        }
+        return true;
+    }
+    bool Socket::setOption(int level, int option, const void* result, socklen_t length){
+        if(setsockopt(m_sock, level, option, result, length)){
+            LOG_FMT_DEBUG(g_logger, "setOption sock=%d level=%d option=%d errno=%d %s\n",
+                          m_sock, level, option, errno, strerror(errno));
+            return false;
+        }
+        return true;
+    }
+
+    // 按协议簇创建用于getsockname/getpeername填充的空地址
+    static Address::ptr NewAddress(int family){
+        switch(family){
+            case AF_INET:
+                return Address::ptr(new IPv4Address());
+            case AF_INET6:
+                return Address::ptr(new IPv6Address());
+            case AF_UNIX:
+                return Address::ptr(new UnixAddress());
+            default:
+                return Address::ptr(new UnknownAddress(family));
+        }
+    }
+
+    Address::ptr Socket::getRemoteAddress(){
+        if(m_remoteAddress){
+            return m_remoteAddress;
+        }
+        Address::ptr result = NewAddress(m_family);
+        socklen_t addrlen = result->getAddrLen();
+        if(getpeername(m_sock, result->getAddr(), &addrlen)){
+            return Address::ptr(new UnknownAddress(m_family));
+        }
+        if(m_family == AF_UNIX){
+            std::static_pointer_cast<UnixAddress>(result)->setAddrLen(addrlen);
+        }
+        m_remoteAddress = result;
+        return m_remoteAddress;
+    }
+    Address::ptr Socket::getLocalAddress(){
+        if(m_localAddress){
+            return m_localAddress;
+        }
+        Address::ptr result = NewAddress(m_family);
+        socklen_t addrlen = result->getAddrLen();
+        if(getsockname(m_sock, result->getAddr(), &addrlen)){
+            LOG_FMT_ERROR(g_logger, "getsockname sock=%d errno=%d %s\n", m_sock, errno, strerror(errno));
+            return Address::ptr(new UnknownAddress(m_family));
+        }
+        if(m_family == AF_UNIX){
+            std::static_pointer_cast<UnixAddress>(result)->setAddrLen(addrlen);
+        }
+        m_localAddress = result;
+        return m_localAddress;
+    }
     int Socket::getSocket() const { return m_sock;}
     int Socket::getFamily() const {return m_family;};
     int Socket::getType() const {return m_type;};
     int Socket::getProtocol() const {return m_protocol;};
     bool Socket::isConnect() const {return m_isConnect;};
-    bool Socket::isValid() const{}
-    int Socket::getError(){}
+    bool Socket::isValid() const{ return m_sock != -1; }
+    int Socket::getError(){
+        int error = 0;
+        if(!getOption(SOL_SOCKET, SO_ERROR, error)){
+            error = errno;
+        }
+        return error;
+    }
+
+    // 取消当前IOManager上等待本套接字的协程，它们以ECANCELED返回
+    bool Socket::cancelRead() const{
+        IOManager* iom = IOManager::GetThis();
+        return iom && iom->cancelEvent(m_sock, IOManager::READ);
+    }
+    bool Socket::cancelWrite() const{
+        IOManager* iom = IOManager::GetThis();
+        return iom && iom->cancelEvent(m_sock, IOManager::WRITE);
+    }
+    bool Socket::cancelAccept() const{
+        IOManager* iom = IOManager::GetThis();
+        return iom && iom->cancelEvent(m_sock, IOManager::READ);
+    }
+    bool Socket::cancelAll() const{
+        IOManager* iom = IOManager::GetThis();
+        return iom && iom->cancelAll(m_sock);
+    }
+
+    // 读写都经过IOManager，由它在协程中等待或直接提交到io_uring
+    Socket::ptr Socket::accept(){
+        Socket::ptr sock(new Socket(m_family, m_type, m_protocol));
+        int newsock = IOManager::Accept(m_sock, nullptr, nullptr, SOCK_CLOEXEC, getRecvTimeout());
+        if(newsock == -1){
+            LOG_FMT_ERROR(g_logger, "accept(%d) errno=%d %s\n", m_sock, errno, strerror(errno));
+            return nullptr;
+        }
+        if(sock->init(newsock)){
+            return sock;
+        }
+        return nullptr;
+    }
+
+    bool Socket::bind(const Address::ptr addr){
+        if(!isValid()){
+            newSock();
+            if(!isValid()){
+                return false;
+            }
+        }
+        if(addr->getFamily() != m_family){
+            LOG_FMT_ERROR(g_logger, "bind sock.family(%d) addr.family(%d) not equal\n", m_family, addr->getFamily());
+            return false;
+        }
+        if(::bind(m_sock, addr->getAddr(), addr->getAddrLen())){
+            LOG_FMT_ERROR(g_logger, "bind(%s) errno=%d %s\n", addr->toString().c_str(), errno, strerror(errno));
+            return false;
+        }
+        m_localAddress.reset();
+        getLocalAddress();
+        return true;
+    }
+
+    bool Socket::connect(const Address::ptr addr, uint64_t timeout_ms){
+        if(!isValid()){
+            newSock();
+            if(!isValid()){
+                return false;
+            }
+        }
+        if(addr->getFamily() != m_family){
+            LOG_FMT_ERROR(g_logger, "connect sock.family(%d) addr.family(%d) not equal\n", m_family, addr->getFamily());
+            return false;
+        }
+        m_remoteAddress = addr;
+        if(IOManager::Connect(m_sock, addr->getAddr(), addr->getAddrLen(), timeout_ms)){
+            LOG_FMT_ERROR(g_logger, "connect(%s) timeout=%lu errno=%d %s\n",
+                          addr->toString().c_str(), timeout_ms, errno, strerror(errno));
+            close();
+            return false;
+        }
+        m_isConnect = true;
+        m_localAddress.reset();
+        getLocalAddress();
+        return true;
+    }
 
-    bool Socket::cancelRead() const{}
-    bool Socket::cancelWrite() const{}
-    bool Socket::cancelAccept() const{}
-    bool Socket::cancelAll() const{}
+    bool Socket::reconnect(uint64_t timeout_ms){
+        if(!m_remoteAddress){
+            LOG_ERROR(g_logger, "reconnect m_remoteAddress is null\n");
+            return false;
+        }
+        m_localAddress.reset();
+        return connect(m_remoteAddress, timeout_ms);
+    }
+
+    bool Socket::listen(int backlog){
+        if(!isValid()){
+            LOG_ERROR(g_logger, "listen error sock=-1\n");
+            return false;
+        }
+        if(::listen(m_sock, backlog)){
+            LOG_FMT_ERROR(g_logger, "listen errno=%d %s\n", errno, strerror(errno));
+            return false;
+        }
+        return true;
+    }
+
+    bool Socket::close(){
+        if(!m_isConnect && m_sock == -1){
+            return true;
+        }
+        m_isConnect = false;
+        if(m_sock != -1){
+            // hook的close取消等待本套接字的协程并清除FdManager中的状态
+            ::close(m_sock);
+            m_sock = -1;
+        }
+        return true;
+    }
+
+    int Socket::send(const void* buf, size_t size, int flags){
+        if(isConnect()){
+            return IOManager::Send(m_sock, buf, size, flags, getSendTimeout());
+        }
+        return -1;
+    }
+
+    // iovec版本的size是iovec的个数，都映射为sendmsg/recvmsg
+    int Socket::send(const iovec* buf, size_t size, int flags){
+        if(isConnect()){
+            msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = (iovec*)buf;
+            msg.msg_iovlen = size;
+            return IOManager::SendMsg(m_sock, &msg, flags, getSendTimeout());
+        }
+        return -1;
+    }
+
+    int Socket::sendTo(const void* buf, size_t size, const Address::ptr addr, int flags){
+        iovec iov;
+        iov.iov_base = (void*)buf;
+        iov.iov_len = size;
+        return sendTo(&iov, 1, addr, flags);
+    }
+
+    int Socket::sendTo(const iovec* buf, size_t size, const Address::ptr addr, int flags){
+        if(isConnect()){
+            msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = (iovec*)buf;
+            msg.msg_iovlen = size;
+            msg.msg_name = (void*)addr->getAddr();
+            msg.msg_namelen = addr->getAddrLen();
+            return IOManager::SendMsg(m_sock, &msg, flags, getSendTimeout());
+        }
+        return -1;
+    }
+
+    int Socket::recv(void* buf, size_t size, int flags){
+        if(isConnect()){
+            return IOManager::Recv(m_sock, buf, size, flags, getRecvTimeout());
+        }
+        return -1;
+    }
+
+    int Socket::recv(iovec* buf, size_t size, int flags){
+        if(isConnect()){
+            msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = buf;
+            msg.msg_iovlen = size;
+            return IOManager::RecvMsg(m_sock, &msg, flags, getRecvTimeout());
+        }
+        return -1;
+    }
+
+    int Socket::recvFrom(void* buf, size_t size, Address::ptr addr, int flags){
+        iovec iov;
+        iov.iov_base = buf;
+        iov.iov_len = size;
+        return recvFrom(&iov, 1, addr, flags);
+    }
+
+    // 对端地址写入addr，Unix地址同时更新长度
+    int Socket::recvFrom(iovec* buf, size_t size, Address::ptr addr, int flags){
+        if(isConnect()){
+            msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = buf;
+            msg.msg_iovlen = size;
+            msg.msg_name = addr->getAddr();
+            msg.msg_namelen = addr->getAddrLen();
+            int rt = IOManager::RecvMsg(m_sock, &msg, flags, getRecvTimeout());
+            if(rt >= 0 && addr->getFamily() == AF_UNIX){
+                std::static_pointer_cast<UnixAddress>(addr)->setAddrLen(msg.msg_namelen);
+            }
+            return rt;
+        }
+        return -1;
+    }
+
+    int64_t Socket::sendFile(int fd, off_t offset, size_t len){
+        if(!isConnect()){
+            return -1;
+        }
+        struct stat st;
+        if(fstat(fd, &st)){
+            return -1;
+        }
+        bool is_pipe = S_ISFIFO(st.st_mode);
+        int64_t total = 0;
+        while((size_t)total < len){
+            ssize_t n;
+            if(is_pipe){
+                n = IOManager::Splice(fd, m_sock, len - total, getSendTimeout());
+            }else{
+                n = IOManager::SendFile(m_sock, fd, &offset, len - total, getSendTimeout());
+            }
+            if(n < 0){
+                LOG_FMT_ERROR(g_logger, "sendFile sock=%d fd=%d errno=%d %s\n", m_sock, fd, errno, strerror(errno));
+                return total ? total : -1;
+            }
+            if(n == 0){
+                break;
+            }
+            total += n;
+        }
+        return total;
+    }
+
+    bool Socket::setZeroCopy(bool v){
+        int val = v ? 1 : 0;
+        if(!setOption(SOL_SOCKET, SO_ZEROCOPY, val)){
+            return false;
+        }
+        m_zeroCopy = v;
+        return true;
+    }
+
+    int Socket::sendZeroCopy(const void* buf, size_t size, uint32_t* seq, int flags){
+        if(!m_zeroCopy || size < g_zerocopy_threshold->getValue()){
+            *seq = m_zcIssued;
+            return send(buf, size, flags);
+        }
+        if(!isConnect()){
+            return -1;
+        }
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        iovec iov;
+        iov.iov_base = (void*)buf;
+        iov.iov_len = size;
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        int rt = IOManager::SendMsg(m_sock, &msg, flags | MSG_ZEROCOPY, getSendTimeout());
+        // 内核只给成功的调用分配序号
+        if(rt >= 0){
+            ++m_zcIssued;
+        }
+        *seq = m_zcIssued;
+        return rt;
+    }
+
+    void Socket::onZeroCopyNotify(msghdr* msg){
+        for(cmsghdr* cm = CMSG_FIRSTHDR(msg); cm; cm = CMSG_NXTHDR(msg, cm)){
+            if(!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+                    || (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))){
+                continue;
+            }
+            sock_extended_err* serr = (sock_extended_err*)CMSG_DATA(cm);
+            if(serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY){
+                continue;
+            }
+            // [ee_info, ee_data]是完成的序号区间
+            uint32_t count = serr->ee_data - serr->ee_info + 1;
+            m_zcCompleted += count;
+            if(serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED){
+                m_zcCopied += count;
+            }
+        }
+    }
+
+    uint32_t Socket::reapZeroCopy(){
+        while(true){
+            char control[128];
+            msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            if(::recvmsg(m_sock, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0){
+                break;
+            }
+            onZeroCopyNotify(&msg);
+        }
+        return m_zcCompleted;
+    }
+
+    bool Socket::waitZeroCopy(uint32_t seq, uint64_t timeout_ms){
+        // 序号会回绕，按差值比较
+        while((int32_t)(seq - reapZeroCopy()) > 0){
+            char control[128];
+            msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            if(IOManager::RecvMsg(m_sock, &msg, MSG_ERRQUEUE, timeout_ms) < 0){
+                LOG_FMT_ERROR(g_logger, "waitZeroCopy sock=%d seq=%u completed=%u errno=%d %s\n",
+                              m_sock, seq, m_zcCompleted, errno, strerror(errno));
+                return false;
+            }
+            onZeroCopyNotify(&msg);
+        }
+        return true;
+    }
+
+    std::ostream& Socket::dump(std::ostream& os) const{
+        os << "[Socket sock=" << m_sock
+           << " is_connected=" << m_isConnect
+           << " family=" << m_family
+           << " type=" << m_type
+           << " protocol=" << m_protocol;
+        if(m_localAddress){
+            os << " local_address=" << m_localAddress->toString();
+        }
+        if(m_remoteAddress){
+            os << " remote_address=" << m_remoteAddress->toString();
+        }
+        os << "]";
+        return os;
+    }
+
+    std::string Socket::toString() const{
+        std::stringstream ss;
+        dump(ss);
+        return ss.str();
+    }
+
+    std::ostream& operator<<(std::ostream& os, const Socket& sock){
+        return sock.dump(os);
+    }
+
+    bool Socket::init(int sock){
+        m_sock = sock;
+        initSock();
+        FdCtx* ctx = FdMgr::getInstance()->get(sock);
+        if(!ctx || !ctx->isSocket()){
+            // 由析构关闭
+            return false;
+        }
+        m_isConnect = true;
+        getLocalAddress();
+        getRemoteAddress();
+        return true;
+    }
+
+    void Socket::initSock(){
+        // 登记到FdManager，超时的设置和close的清理都依赖它
+        FdMgr::getInstance()->get(m_sock, true);
+        int val = 1;
+        setOption(SOL_SOCKET, SO_REUSEADDR, val);
+        if(m_type == SOCK_STREAM && m_family != AF_UNIX){
+            setOption(IPPROTO_TCP, TCP_NODELAY, val);
+        }
+    }
 
-    void Socket::initSock(){}
+    // 套接字在FdManager中由框架设为非阻塞，阻塞语义由IOManager在协程中等待实现
     void Socket::newSock(){
-        
+        m_sock = socket(m_family, m_type | SOCK_CLOEXEC, m_protocol);
+        if(m_sock != -1){
+            initSock();
+        }else{
+            LOG_FMT_ERROR(g_logger, "socket(%d, %d, %d) errno=%d %s\n",
+                          m_family, m_type, m_protocol, errno, strerror(errno));
+        }
     }
 }
\ No newline at end of file
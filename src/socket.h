@@ -2,8 +2,11 @@
 #define __CAIZI_SOCKET_H__
 
 #include <memory>
+#include <ostream>
+#include <string>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <openssl/err.h>
 #include <openssl/ssl.h>
 
@@ -41,6 +44,8 @@ public:
     static Socket::ptr CreateTCPSocket6();
     static Socket::ptr CreateUDPSocket6();
 
+    // 发送/接收(包括accept)每次等待的超时时间(毫秒)，-1表示一直等待，超时失败时errno为ETIMEDOUT
+    // 超时记录在FdManager中，与setsockopt(SO_SNDTIMEO/SO_RCVTIMEO)设置的相同
     int64_t getSendTimeout();
     void setSendTimeout(int64_t timeout);
     int64_t getRecvTimeout();
@@ -52,7 +57,7 @@ public:
         socklen_t length = sizeof(T);
         return getOption(level, option, &result, &length);
     }
-    bool setOption(int level, int option, void* result, socklen_t length);
+    bool setOption(int level, int option, const void* result, socklen_t length);
     template<typename T>
     bool setOption(int level, int option, const T& result){
         return setOption(level, option, &result, sizeof(T));
@@ -75,6 +80,32 @@ public:
     virtual int recvFrom(void* buf, size_t size, Address::ptr addr, int flags = 0);
     virtual int recvFrom(iovec* buf, size_t size, Address::ptr addr, int flags = 0);
 
+    /*
+        发送文件fd中从offset开始的len字节，数据不经过用户空间：
+        普通文件用sendfile，管道用splice(忽略offset)
+        @return 发送的字节数，fd提前结束时可能小于len，失败返回-1
+    */
+    virtual int64_t sendFile(int fd, off_t offset, size_t len);
+
+    /*
+        MSG_ZEROCOPY：大块数据直接从用户内存发送，内核在数据不再需要时通过错误队列通知完成。
+        每次成功的零拷贝发送得到一个递增的序号，完成前调用者不能修改或释放发送的内存。
+    */
+    // 开启或关闭SO_ZEROCOPY，内核不支持时返回false
+    bool setZeroCopy(bool v);
+    bool isZeroCopy() const{ return m_zeroCopy; };
+    /*
+        开启零拷贝且size不小于tcp.zerocopy.threshold时以MSG_ZEROCOPY发送，否则同send
+        @param seq 返回需要等待的序号，传给waitZeroCopy
+    */
+    int sendZeroCopy(const void* buf, size_t size, uint32_t* seq, int flags = 0);
+    // 不等待，读取错误队列中已有的完成通知，返回累计完成的零拷贝发送数
+    uint32_t reapZeroCopy();
+    // 等待序号不大于seq的零拷贝发送全部完成；等待时占用读方向，不要和recv同时调用
+    bool waitZeroCopy(uint32_t seq, uint64_t timeout_ms = ~0ull);
+    // 内核退回复制方式完成的发送数(例如回环地址)，一直增长说明零拷贝没有收益
+    uint32_t getZeroCopyCopied() const{ return m_zcCopied; };
+
     Address::ptr getRemoteAddress();
     Address::ptr getLocalAddress();
     int getSocket() const;
@@ -97,6 +128,8 @@ protected:
     void initSock();
     void newSock();
     virtual bool init(int sock);
+    // 处理一个错误队列消息中的零拷贝完成通知
+    void onZeroCopyNotify(msghdr* msg);
 
 protected:
     int m_sock;
@@ -106,8 +139,14 @@ protected:
     bool m_isConnect;
     Address::ptr m_localAddress;
     Address::ptr m_remoteAddress;
+    bool m_zeroCopy = false;
+    uint32_t m_zcIssued = 0;                // 已发出的零拷贝发送数
+    uint32_t m_zcCompleted = 0;             // 已完成的零拷贝发送数
+    uint32_t m_zcCopied = 0;                // 其中退回复制方式完成的
 };
 
+std::ostream& operator<<(std::ostream& os, const Socket& sock);
+
 
 // SSL套接字，待实现
 class SSLSocket : public Socket{
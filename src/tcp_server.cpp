@@ -0,0 +1,169 @@
+#include "tcp_server.h"
+#include "config.h"
+#include "log.h"
+#include <sstream>
+#include <string.h>
+
+namespace caizi{
+
+static Logger::ptr g_logger = CAIZI_GET_LOGGER("system");
+
+static ConfigVar<uint64_t>::ptr g_tcp_server_read_timeout =
+    Config::Lookup<uint64_t>("tcp_server.read_timeout", 60 * 1000 * 2, "tcp server read timeout(ms)");
+
+TcpServer::TcpServer(IOManager* worker, const std::string& name)
+    :m_worker(worker)
+    ,m_recvTimeout(g_tcp_server_read_timeout->getValue())
+    ,m_name(name){
+}
+
+TcpServer::~TcpServer(){
+    for(auto& acceptor : m_acceptors){
+        acceptor.sock->close();
+    }
+    m_acceptors.clear();
+}
+
+Socket::ptr TcpServer::listenOn(Address::ptr addr, bool reuse_port){
+    Socket::ptr sock = Socket::createTCP(addr);
+    int val = 1;
+    // 同一端口的所有套接字都要在bind之前设置
+    if(reuse_port && !sock->setOption(SOL_SOCKET, SO_REUSEPORT, val)){
+        return nullptr;
+    }
+    if(!sock->bind(addr) || !sock->listen()){
+        return nullptr;
+    }
+    return sock;
+}
+
+bool TcpServer::bind(Address::ptr addr){
+    std::vector<Address::ptr> addrs;
+    std::vector<Address::ptr> fails;
+    addrs.push_back(addr);
+    return bind(addrs, fails);
+}
+
+bool TcpServer::bind(const std::vector<Address::ptr>& addrs, std::vector<Address::ptr>& fails){
+    for(auto& addr : addrs){
+        bool is_ip = addr->getFamily() == AF_INET || addr->getFamily() == AF_INET6;
+        std::vector<int> threads;
+        if(is_ip){
+            // use_caller的调用线程在stop之前不调度，分到它的连接会一直等待，不在它上面监听
+            for(size_t i = 0; i < m_worker->getWorkerCount(); ++i){
+                int thread = m_worker->getWorkerThreadId(i);
+                if(thread != m_worker->getRootThreadId() || m_worker->getWorkerCount() == 1){
+                    threads.push_back(thread);
+                }
+            }
+        }else{
+            threads.push_back(-1);
+        }
+        std::vector<Acceptor> acceptors;
+        Address::ptr bound = addr;
+        for(int thread : threads){
+            Socket::ptr sock = listenOn(bound, is_ip);
+            if(!sock){
+                LOG_FMT_ERROR(g_logger, "TcpServer %s bind/listen %s failed errno=%d %s\n",
+                              m_name.c_str(), bound->toString().c_str(), errno, strerror(errno));
+                acceptors.clear();
+                break;
+            }
+            // 端口为0时后面的套接字绑定第一个得到的端口，才能共享同一个端口
+            bound = sock->getLocalAddress();
+            Acceptor acceptor;
+            acceptor.sock = sock;
+            acceptor.thread = thread;
+            acceptors.push_back(acceptor);
+        }
+        if(acceptors.empty()){
+            fails.push_back(addr);
+            continue;
+        }
+        m_addresses.push_back(bound);
+        m_acceptors.insert(m_acceptors.end(), acceptors.begin(), acceptors.end());
+    }
+    if(!fails.empty()){
+        for(auto& acceptor : m_acceptors){
+            acceptor.sock->close();
+        }
+        m_acceptors.clear();
+        m_addresses.clear();
+        return false;
+    }
+    for(auto& acceptor : m_acceptors){
+        LOG_FMT_INFO(g_logger, "TcpServer %s bind %s thread=%d\n", m_name.c_str(),
+                     acceptor.sock->toString().c_str(), acceptor.thread);
+    }
+    return true;
+}
+
+void TcpServer::startAccept(Socket::ptr sock){
+    // 本协程固定在一个工作线程上，接受的连接也在这个线程上处理
+    int thread = Scheduler::GetWorkerIndex() >= 0 ? Thread::GetThisId() : -1;
+    while(!m_isStop){
+        Socket::ptr client = sock->accept();
+        if(client){
+            client->setRecvTimeout(m_recvTimeout);
+            m_worker->schedule(std::bind(&TcpServer::handleClient, shared_from_this(), client), thread);
+            continue;
+        }
+        if(m_isStop || errno == EBADF || errno == ECANCELED){
+            break;
+        }
+        if(errno == EMFILE || errno == ENFILE){
+            // fd用完时稍后再试，避免空转
+            IOManager::Sleep(10);
+        }
+    }
+}
+
+bool TcpServer::start(){
+    if(!m_isStop){
+        return true;
+    }
+    m_isStop = false;
+    for(auto& acceptor : m_acceptors){
+        m_worker->schedule(std::bind(&TcpServer::startAccept, shared_from_this(), acceptor.sock), acceptor.thread);
+    }
+    return true;
+}
+
+void TcpServer::stop(){
+    m_isStop = true;
+    auto self = shared_from_this();
+    for(auto& acceptor : m_acceptors){
+        Socket::ptr sock = acceptor.sock;
+        // 在工作线程上关闭，hook的close唤醒阻塞在accept中的协程
+        m_worker->schedule([self, sock](){
+            sock->close();
+        }, acceptor.thread);
+    }
+    m_acceptors.clear();
+}
+
+void TcpServer::handleClient(Socket::ptr client){
+    LOG_FMT_INFO(g_logger, "handleClient: %s\n", client->toString().c_str());
+}
+
+std::vector<Socket::ptr> TcpServer::getSocks() const{
+    std::vector<Socket::ptr> socks;
+    for(auto& acceptor : m_acceptors){
+        socks.push_back(acceptor.sock);
+    }
+    return socks;
+}
+
+std::string TcpServer::toString(const std::string& prefix){
+    std::stringstream ss;
+    ss << prefix << "[type=tcp name=" << m_name
+       << " workers=" << m_worker->getWorkerCount()
+       << " recv_timeout=" << m_recvTimeout << "]" << std::endl;
+    std::string pfx = prefix.empty() ? "    " : prefix;
+    for(auto& acceptor : m_acceptors){
+        ss << pfx << pfx << *acceptor.sock << " thread=" << acceptor.thread << std::endl;
+    }
+    return ss.str();
+}
+
+}
@@ -0,0 +1,84 @@
+/*
+    @file tcp_server.h
+    @brief 多Reactor的TCP服务器
+*/
+
+#ifndef __CAIZI_TCP_SERVER_H__
+#define __CAIZI_TCP_SERVER_H__
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "address.h"
+#include "iomanager.h"
+#include "noncopyable.h"
+#include "socket.h"
+
+namespace caizi{
+
+/*
+    每个IP地址在IOManager的每个工作线程上各有一个SO_REUSEPORT的监听套接字，
+    由内核把新连接分散到各个监听套接字，每个工作线程上的accept协程只接受自己的连接。
+    接受的连接固定在同一个工作线程上处理(处理协程每次挂起后都在该线程恢复，见Scheduler)，
+    fd登记在该线程的epoll/io_uring中，不经过其他线程转交。
+    Unix域地址不支持SO_REUSEPORT的负载均衡，只有一个监听套接字，连接由任意线程处理。
+*/
+class TcpServer : public std::enable_shared_from_this<TcpServer>, Noncopyable{
+public:
+    typedef std::shared_ptr<TcpServer> ptr;
+
+    // @param worker 处理连接的IOManager，监听和连接的协程都在其中执行
+    TcpServer(IOManager* worker = IOManager::GetThis(), const std::string& name = "caizi/1.0.0");
+    virtual ~TcpServer();
+
+    // 绑定地址，端口为0时所有工作线程的监听套接字共用第一次绑定得到的端口
+    virtual bool bind(Address::ptr addr);
+    // 绑定多个地址，失败的地址放入fails，全部成功时返回true
+    virtual bool bind(const std::vector<Address::ptr>& addrs, std::vector<Address::ptr>& fails);
+    // 在每个监听套接字所属的工作线程上开始accept
+    virtual bool start();
+    // 停止accept并关闭监听套接字，已经建立的连接不受影响
+    virtual void stop();
+
+    uint64_t getRecvTimeout() const{ return m_recvTimeout; };
+    void setRecvTimeout(uint64_t v){ m_recvTimeout = v; };
+    const std::string& getName() const{ return m_name; };
+    void setName(const std::string& v){ m_name = v; };
+    bool isStop() const{ return m_isStop; };
+    // 所有监听套接字，同一个地址在每个工作线程上各有一个
+    std::vector<Socket::ptr> getSocks() const;
+    // 绑定成功的地址(端口为0时是实际端口)
+    const std::vector<Address::ptr>& getAddresses() const{ return m_addresses; };
+
+    virtual std::string toString(const std::string& prefix = "");
+
+protected:
+    // 处理一个连接，在接受它的工作线程上执行，子类重写
+    virtual void handleClient(Socket::ptr client);
+    // 循环accept直到stop
+    virtual void startAccept(Socket::ptr sock);
+
+private:
+    struct Acceptor{
+        Socket::ptr sock;
+        int thread = -1;            // 所属工作线程的id，-1表示任意线程
+    };
+
+    // 创建、绑定并监听一个套接字
+    Socket::ptr listenOn(Address::ptr addr, bool reuse_port);
+
+private:
+    IOManager* m_worker;
+    std::vector<Acceptor> m_acceptors;
+    std::vector<Address::ptr> m_addresses;
+    uint64_t m_recvTimeout;
+    std::string m_name;
+    std::atomic<bool> m_isStop{true};
+};
+
+}
+
+#endif
@@ -1,6 +1,7 @@
 #include "thread.h"
 #include "log.h"
 #include <cassert>
+#include <errno.h>
 #include "util.h"
 
 namespace caizi{
@@ -27,7 +28,11 @@ Semaphore::~Semaphore(){
 }
 
 void Semaphore::wait(){
-    if(sem_wait(&m_semaphore)){
+    int rt;
+    // 被信号中断时继续等待
+    while((rt = sem_wait(&m_semaphore)) && errno == EINTR){
+    }
+    if(rt){
         LOG_FATAL(system_logger,"Semaphore::wait() 等待信号量失败！");
         throw std::system_error();
     }
@@ -50,6 +55,10 @@ Thread* Thread::GetThis(){
 }
 
 pid_t Thread::GetThisId(){
+    // 主线程等非caizi::Thread创建的线程第一次调用时再获取
+    if(!t_tid){
+        t_tid = GetThreadId();
+    }
     return t_tid;
 }
 
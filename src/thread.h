@@ -5,6 +5,7 @@
 #include <pthread.h>
 #include <functional>
 #include <memory>
+#include <string>
 #include <semaphore.h>
 #include "noncopyable.h"
 
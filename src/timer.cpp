@@ -0,0 +1,313 @@
+#include "timer.h"
+#include <algorithm>
+#include <string.h>
+#include <time.h>
+
+namespace caizi{
+
+Timer::Timer(uint64_t ms, std::function<void()> cb, bool recurring, TimerManager* manager):
+    m_ms(ms), m_cb(std::move(cb)), m_recurring(recurring), m_manager(manager){
+}
+
+bool Timer::cancel(){
+    // 最后一个引用可能是m_self，解锁之后再释放
+    Timer::ptr self;
+    ScopeLock lock(&m_manager->m_mutex);
+    if(m_level < 0){
+        return false;
+    }
+    m_manager->unlink(this);
+    m_cb = nullptr;
+    self.swap(m_self);
+    return true;
+}
+
+bool Timer::refresh(){
+    ScopeLock lock(&m_manager->m_mutex);
+    if(m_level < 0){
+        return false;
+    }
+    // 只会推迟，不需要通知
+    m_manager->unlink(this);
+    m_expire = TimerManager::NowMS() + m_ms;
+    m_manager->link(this);
+    return true;
+}
+
+bool Timer::reset(uint64_t ms, bool from_now){
+    if(ms == m_ms && !from_now){
+        return true;
+    }
+    bool at_front = false;
+    {
+        ScopeLock lock(&m_manager->m_mutex);
+        if(m_level < 0){
+            return false;
+        }
+        m_manager->unlink(this);
+        uint64_t start = from_now ? TimerManager::NowMS() : m_expire - m_ms;
+        m_ms = ms;
+        m_expire = start + ms;
+        at_front = m_manager->insert(this);
+    }
+    if(at_front){
+        m_manager->onTimerInsertedAtFront();
+    }
+    return true;
+}
+
+TimerManager::TimerManager(){
+    m_current = NowMS();
+    memset(m_root, 0, sizeof(m_root));
+    memset(m_levels, 0, sizeof(m_levels));
+    memset(m_rootBits, 0, sizeof(m_rootBits));
+    memset(m_levelBits, 0, sizeof(m_levelBits));
+}
+
+TimerManager::~TimerManager(){
+    // 解锁之后再释放定时器
+    std::vector<Timer::ptr> timers;
+    ScopeLock lock(&m_mutex);
+    for(size_t level = 0; level < LEVELS; ++level){
+        size_t size = level ? LEVEL_SIZE : ROOT_SIZE;
+        for(size_t slot = 0; slot < size; ++slot){
+            Timer* timer = slotHead(level, slot);
+            while(timer){
+                Timer* next = timer->m_next;
+                timer->m_prev = timer->m_next = nullptr;
+                timer->m_level = -1;
+                timer->m_cb = nullptr;
+                timers.push_back(std::move(timer->m_self));
+                timer = next;
+            }
+        }
+    }
+}
+
+uint64_t TimerManager::NowMS(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000ul + ts.tv_nsec / 1000000;
+}
+
+Timer::ptr TimerManager::addTimer(uint64_t ms, std::function<void()> cb, bool recurring){
+    Timer::ptr timer(new Timer(ms, std::move(cb), recurring, this));
+    bool at_front = false;
+    {
+        ScopeLock lock(&m_mutex);
+        timer->m_expire = NowMS() + ms;
+        timer->m_self = timer;
+        at_front = insert(timer.get());
+    }
+    if(at_front){
+        onTimerInsertedAtFront();
+    }
+    return timer;
+}
+
+static void OnTimer(std::weak_ptr<void> weak_cond, const std::function<void()>& cb){
+    std::shared_ptr<void> tmp = weak_cond.lock();
+    if(tmp){
+        cb();
+    }
+}
+
+Timer::ptr TimerManager::addConditionTimer(uint64_t ms, std::function<void()> cb, std::weak_ptr<void> cond, bool recurring){
+    return addTimer(ms, std::bind(&OnTimer, std::move(cond), std::move(cb)), recurring);
+}
+
+uint64_t TimerManager::getNextTimer(){
+    ScopeLock lock(&m_mutex);
+    uint64_t next = nextTick();
+    m_nextExpire.store(next, std::memory_order_relaxed);
+    if(next == ~0ull){
+        return ~0ull;
+    }
+    uint64_t now = NowMS();
+    return next > now ? next - now : 0;
+}
+
+bool TimerManager::hasExpiredTimer() const{
+    return NowMS() >= m_nextExpire.load(std::memory_order_relaxed);
+}
+
+void TimerManager::listExpiredCb(std::vector<std::function<void()>>& cbs){
+    if(!hasExpiredTimer()){
+        return;
+    }
+    uint64_t now = NowMS();
+    // 非循环定时器的最后一个引用可能在这里，解锁之后再释放
+    std::vector<Timer::ptr> expired;
+    ScopeLock lock(&m_mutex);
+    advance(now, expired);
+    for(auto& timer : expired){
+        if(timer->m_recurring){
+            cbs.push_back(timer->m_cb);
+            timer->m_expire = now + timer->m_ms;
+            timer->m_self = timer;
+            link(timer.get());
+        }else{
+            cbs.push_back(std::move(timer->m_cb));
+            timer->m_cb = nullptr;
+        }
+    }
+    m_nextExpire.store(nextTick(), std::memory_order_relaxed);
+}
+
+bool TimerManager::hasTimer(){
+    ScopeLock lock(&m_mutex);
+    return m_count > 0;
+}
+
+bool TimerManager::insert(Timer* timer){
+    link(timer);
+    if(timer->m_expire < m_nextExpire.load(std::memory_order_relaxed)){
+        m_nextExpire.store(timer->m_expire, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+Timer*& TimerManager::slotHead(int level, size_t slot){
+    return level ? m_levels[level - 1][slot] : m_root[slot];
+}
+
+void TimerManager::link(Timer* timer){
+    uint64_t expire = std::max(timer->m_expire, m_current);
+    uint64_t delta = expire - m_current;
+    if(delta > MAX_DELTA){
+        expire = m_current + MAX_DELTA;
+        delta = MAX_DELTA;
+    }
+    int level = 0;
+    size_t slot = expire & (ROOT_SIZE - 1);
+    if(delta >= ROOT_SIZE){
+        for(level = 1; level < (int)LEVELS - 1; ++level){
+            if(delta < (1ull << (ROOT_BITS + LEVEL_BITS * level))){
+                break;
+            }
+        }
+        slot = (expire >> (ROOT_BITS + LEVEL_BITS * (level - 1))) & (LEVEL_SIZE - 1);
+        m_levelBits[level - 1] |= 1ull << slot;
+    }else{
+        m_rootBits[slot >> 6] |= 1ull << (slot & 63);
+    }
+    Timer*& head = slotHead(level, slot);
+    timer->m_prev = nullptr;
+    timer->m_next = head;
+    if(head){
+        head->m_prev = timer;
+    }
+    head = timer;
+    timer->m_level = level;
+    timer->m_slot = slot;
+    ++m_count;
+}
+
+void TimerManager::unlink(Timer* timer){
+    Timer*& head = slotHead(timer->m_level, timer->m_slot);
+    if(timer->m_prev){
+        timer->m_prev->m_next = timer->m_next;
+    }else{
+        head = timer->m_next;
+    }
+    if(timer->m_next){
+        timer->m_next->m_prev = timer->m_prev;
+    }
+    if(!head){
+        if(timer->m_level){
+            m_levelBits[timer->m_level - 1] &= ~(1ull << timer->m_slot);
+        }else{
+            m_rootBits[timer->m_slot >> 6] &= ~(1ull << (timer->m_slot & 63));
+        }
+    }
+    timer->m_prev = timer->m_next = nullptr;
+    timer->m_level = -1;
+    --m_count;
+}
+
+void TimerManager::cascade(int level, size_t slot){
+    Timer*& head = slotHead(level, slot);
+    Timer* timer = head;
+    head = nullptr;
+    m_levelBits[level - 1] &= ~(1ull << slot);
+    while(timer){
+        Timer* next = timer->m_next;
+        --m_count;
+        link(timer);
+        timer = next;
+    }
+}
+
+uint64_t TimerManager::nextTick() const{
+    if(!m_count){
+        return ~0ull;
+    }
+    uint64_t next = ~0ull;
+    // 第0层：从当前槽开始找第一个非空的槽，槽的位置就是到期时刻
+    size_t index = m_current & (ROOT_SIZE - 1);
+    for(size_t i = 0; i < ROOT_SIZE;){
+        size_t slot = (index + i) & (ROOT_SIZE - 1);
+        uint64_t word = m_rootBits[slot >> 6] >> (slot & 63);
+        if(word){
+            next = m_current + i + __builtin_ctzll(word);
+            break;
+        }
+        i += 64 - (slot & 63);
+    }
+    // 上层：第一个非空的槽的级联时刻
+    for(size_t level = 1; level < LEVELS; ++level){
+        uint64_t bits = m_levelBits[level - 1];
+        if(!bits){
+            continue;
+        }
+        size_t shift = ROOT_BITS + LEVEL_BITS * (level - 1);
+        uint64_t base = m_current >> shift;
+        size_t index = base & (LEVEL_SIZE - 1);
+        uint64_t rotated = index ? (bits >> index) | (bits << (LEVEL_SIZE - index)) : bits;
+        uint64_t tick = (base + __builtin_ctzll(rotated)) << shift;
+        if(tick < m_current){
+            // 当前槽这一圈的级联点已经过去，槽里的定时器属于下一圈
+            rotated &= rotated - 1;
+            tick = (base + (rotated ? __builtin_ctzll(rotated) : LEVEL_SIZE)) << shift;
+        }
+        next = std::min(next, tick);
+    }
+    return next;
+}
+
+void TimerManager::advance(uint64_t now, std::vector<Timer::ptr>& expired){
+    while(m_current <= now){
+        // 直接跳到下一个需要处理的时刻，中间的空槽不需要逐个走过
+        uint64_t next = nextTick();
+        if(next > now){
+            m_current = now + 1;
+            break;
+        }
+        m_current = next;
+        size_t index = m_current & (ROOT_SIZE - 1);
+        if(index == 0){
+            for(size_t level = 1; level < LEVELS; ++level){
+                size_t slot = (m_current >> (ROOT_BITS + LEVEL_BITS * (level - 1))) & (LEVEL_SIZE - 1);
+                cascade(level, slot);
+                if(slot){
+                    break;
+                }
+            }
+        }
+        Timer* timer = m_root[index];
+        m_root[index] = nullptr;
+        m_rootBits[index >> 6] &= ~(1ull << (index & 63));
+        while(timer){
+            Timer* next_timer = timer->m_next;
+            timer->m_prev = timer->m_next = nullptr;
+            timer->m_level = -1;
+            --m_count;
+            expired.push_back(std::move(timer->m_self));
+            timer = next_timer;
+        }
+        ++m_current;
+    }
+}
+
+}
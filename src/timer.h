@@ -0,0 +1,122 @@
+/*
+    @file timer.h
+    @brief 分层时间轮定时器
+*/
+
+#ifndef __CAIZI_TIMER_H__
+#define __CAIZI_TIMER_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "noncopyable.h"
+#include "thread.h"
+
+namespace caizi{
+
+class TimerManager;
+
+class Timer : public std::enable_shared_from_this<Timer>, Noncopyable{
+friend class TimerManager;
+public:
+    typedef std::shared_ptr<Timer> ptr;
+
+    // 取消定时器，已经触发(非循环)或已经取消时返回false
+    bool cancel();
+    // 从现在起重新计时
+    bool refresh();
+    // 修改超时时间，from_now为false时仍从原来的起点计时
+    bool reset(uint64_t ms, bool from_now);
+
+    uint64_t getTimeout() const{ return m_ms; };
+
+private:
+    Timer(uint64_t ms, std::function<void()> cb, bool recurring, TimerManager* manager);
+
+private:
+    Timer* m_prev = nullptr;            // 所在槽的双向链表
+    Timer* m_next = nullptr;
+    int m_level = -1;                   // 所在的层，-1表示不在时间轮中
+    size_t m_slot = 0;
+    uint64_t m_ms;                      // 超时时间
+    uint64_t m_expire = 0;              // 到期时刻(单调时钟毫秒)
+    std::function<void()> m_cb;
+    bool m_recurring;
+    TimerManager* m_manager;
+    Timer::ptr m_self;                  // 在时间轮中时持有自己，触发或取消后释放
+};
+
+/*
+    分层时间轮，精度1毫秒，添加、取消、刷新都是O(1)。
+    第0层256个槽，每槽1毫秒；第1~4层各64个槽，每槽是下一层一整圈的时长，共覆盖2^32毫秒(约49天)，更长的按49天算。
+    时间轮走到上层某个槽的起点时，把槽里的定时器按剩余时间重新放入下层(级联)。
+    每层用位图记录非空的槽，推进时直接跳到下一个非空的槽或级联点，空闲时不会逐毫秒空转。
+*/
+class TimerManager : public Noncopyable{
+friend class Timer;
+public:
+    TimerManager();
+    virtual ~TimerManager();
+
+    /*
+        添加定时器
+        @param ms 多少毫秒后触发
+        @param recurring 是否每隔ms循环触发
+    */
+    Timer::ptr addTimer(uint64_t ms, std::function<void()> cb, bool recurring = false);
+    // 条件定时器，触发时cond指向的对象已经销毁则跳过回调
+    Timer::ptr addConditionTimer(uint64_t ms, std::function<void()> cb, std::weak_ptr<void> cond, bool recurring = false);
+
+    // 距离下一次需要推进时间轮还有多少毫秒，没有定时器返回~0ull
+    uint64_t getNextTimer();
+    // 推进时间轮，取出所有到期定时器的回调
+    void listExpiredCb(std::vector<std::function<void()>>& cbs);
+    // 当前可能有到期的定时器(不加锁，用于在繁忙时决定是否调用listExpiredCb)
+    bool hasExpiredTimer() const;
+    bool hasTimer();
+
+    // 定时器使用的单调时钟(毫秒)
+    static uint64_t NowMS();
+
+protected:
+    // 新定时器比等待中的超时更早到期，子类唤醒等待的线程重新计算超时
+    virtual void onTimerInsertedAtFront() = 0;
+
+private:
+    static const size_t ROOT_BITS = 8;
+    static const size_t ROOT_SIZE = 1 << ROOT_BITS;
+    static const size_t LEVEL_BITS = 6;
+    static const size_t LEVEL_SIZE = 1 << LEVEL_BITS;
+    static const size_t LEVELS = 5;                     // 包括第0层
+    static const uint64_t MAX_DELTA = 0xffffffffull;
+
+    // 把定时器放入时间轮，返回是否需要通知onTimerInsertedAtFront，调用时持有锁
+    bool insert(Timer* timer);
+    void link(Timer* timer);
+    void unlink(Timer* timer);
+    Timer*& slotHead(int level, size_t slot);
+    // 把第level层的slot槽重新放入下层
+    void cascade(int level, size_t slot);
+    // 下一个需要处理的时刻(到期或级联)，没有定时器返回~0ull
+    uint64_t nextTick() const;
+    // 推进到now(包括now)，到期的定时器放入expired
+    void advance(uint64_t now, std::vector<Timer::ptr>& expired);
+
+private:
+    Mutex m_mutex;
+    uint64_t m_current;                                 // 下一个要处理的时刻
+    size_t m_count = 0;
+    std::atomic<uint64_t> m_nextExpire{~0ull};          // 不晚于下一个需要处理的时刻
+    Timer* m_root[ROOT_SIZE];
+    Timer* m_levels[LEVELS - 1][LEVEL_SIZE];
+    uint64_t m_rootBits[ROOT_SIZE / 64];
+    uint64_t m_levelBits[LEVELS - 1];
+};
+
+}
+
+#endif
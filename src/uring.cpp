@@ -0,0 +1,239 @@
+#include "uring.h"
+#include "log.h"
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace caizi{
+
+static Logger::ptr g_logger = CAIZI_GET_LOGGER("system");
+
+static int SysSetup(unsigned entries, io_uring_params* params){
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int SysEnter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, void* arg, size_t argsz){
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static int SysRegister(int fd, unsigned opcode, const void* arg, unsigned nr_args){
+    return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+Uring::~Uring(){
+    if(m_sqes){
+        munmap(m_sqes, m_sqes_size);
+    }
+    if(m_cq_ring && m_cq_ring != m_sq_ring){
+        munmap(m_cq_ring, m_cq_ring_size);
+    }
+    if(m_sq_ring){
+        munmap(m_sq_ring, m_sq_ring_size);
+    }
+    if(m_fd >= 0){
+        close(m_fd);
+    }
+}
+
+int Uring::init(unsigned entries){
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    // 新内核上减少完成事件的处理开销，旧内核不认识这些标志时去掉重试
+    params.flags = IORING_SETUP_CLAMP | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+    int fd = SysSetup(entries, &params);
+    if(fd < 0 && errno == EINVAL){
+        memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CLAMP;
+        fd = SysSetup(entries, &params);
+    }
+    if(fd < 0){
+        return errno;
+    }
+    m_fd = fd;
+    m_features = params.features;
+    // 空闲等待需要带超时的io_uring_enter(5.11)
+    if(!(m_features & IORING_FEAT_EXT_ARG)){
+        return ENOTSUP;
+    }
+
+    m_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if(m_features & IORING_FEAT_SINGLE_MMAP){
+        m_sq_ring_size = m_cq_ring_size = std::max(m_sq_ring_size, m_cq_ring_size);
+    }
+    m_sq_ring = mmap(nullptr, m_sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     m_fd, IORING_OFF_SQ_RING);
+    if(m_sq_ring == MAP_FAILED){
+        m_sq_ring = nullptr;
+        return errno;
+    }
+    if(m_features & IORING_FEAT_SINGLE_MMAP){
+        m_cq_ring = m_sq_ring;
+    }else{
+        m_cq_ring = mmap(nullptr, m_cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         m_fd, IORING_OFF_CQ_RING);
+        if(m_cq_ring == MAP_FAILED){
+            m_cq_ring = nullptr;
+            return errno;
+        }
+    }
+    m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    m_sqes = (io_uring_sqe*)mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                 m_fd, IORING_OFF_SQES);
+    if(m_sqes == MAP_FAILED){
+        m_sqes = nullptr;
+        return errno;
+    }
+
+    char* sq = (char*)m_sq_ring;
+    m_sq_head = (unsigned*)(sq + params.sq_off.head);
+    m_sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    m_sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    m_sq_array = (unsigned*)(sq + params.sq_off.array);
+    m_sq_entries = params.sq_entries;
+    m_sqe_head = m_sqe_tail = *m_sq_tail;
+
+    char* cq = (char*)m_cq_ring;
+    m_cq_head = (unsigned*)(cq + params.cq_off.head);
+    m_cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    m_cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    m_cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    // 检查用到的操作是否都支持
+    size_t probe_size = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+    std::vector<char> probe_buf(probe_size, 0);
+    io_uring_probe* probe = (io_uring_probe*)probe_buf.data();
+    if(SysRegister(m_fd, IORING_REGISTER_PROBE, probe, 256) < 0){
+        return errno;
+    }
+    const int ops[] = {IORING_OP_RECV, IORING_OP_SEND, IORING_OP_ACCEPT, IORING_OP_CONNECT,
+                       IORING_OP_POLL_ADD, IORING_OP_ASYNC_CANCEL, IORING_OP_LINK_TIMEOUT,
+                       IORING_OP_RECVMSG, IORING_OP_SENDMSG};
+    for(int op : ops){
+        if(op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)){
+            LOG_FMT_WARN(g_logger, "io_uring不支持操作%d\n", op);
+            return ENOTSUP;
+        }
+    }
+    return 0;
+}
+
+io_uring_sqe* Uring::getSqe(){
+    unsigned head = __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+    if(m_sqe_tail - head >= m_sq_entries){
+        enter(0);
+        head = __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+        if(m_sqe_tail - head >= m_sq_entries){
+            return nullptr;
+        }
+    }
+    io_uring_sqe* sqe = &m_sqes[m_sqe_tail & *m_sq_mask];
+    ++m_sqe_tail;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+unsigned Uring::pending() const{
+    return m_sqe_tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+}
+
+int Uring::enter(unsigned wait_nr, int timeout_ms){
+    // 把getSqe分配的请求放入提交队列
+    unsigned tail = *m_sq_tail;
+    unsigned mask = *m_sq_mask;
+    while(m_sqe_head != m_sqe_tail){
+        m_sq_array[tail & mask] = m_sqe_head & mask;
+        ++tail;
+        ++m_sqe_head;
+    }
+    __atomic_store_n(m_sq_tail, tail, __ATOMIC_RELEASE);
+    unsigned to_submit = tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+    if(!to_submit && !wait_nr){
+        return 0;
+    }
+
+    unsigned flags = wait_nr ? IORING_ENTER_GETEVENTS : 0;
+    io_uring_getevents_arg arg;
+    __kernel_timespec ts;
+    void* argp = nullptr;
+    size_t argsz = 0;
+    if(wait_nr && timeout_ms >= 0){
+        memset(&arg, 0, sizeof(arg));
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (timeout_ms % 1000) * 1000000LL;
+        arg.ts = (uint64_t)&ts;
+        argp = &arg;
+        argsz = sizeof(arg);
+        flags |= IORING_ENTER_EXT_ARG;
+    }
+    int rt = SysEnter(m_fd, to_submit, wait_nr, flags, argp, argsz);
+    if(rt < 0){
+        if(errno == ETIME || errno == EINTR){
+            return 0;
+        }
+        LOG_FMT_ERROR(g_logger, "io_uring_enter(%d, %u, %u) errno=%d %s\n",
+                      m_fd, to_submit, wait_nr, errno, strerror(errno));
+        return -errno;
+    }
+    return rt;
+}
+
+uint64_t Uring::track(void* request){
+    uint32_t index;
+    if(!m_free_slots.empty()){
+        index = m_free_slots.back();
+        m_free_slots.pop_back();
+    }else{
+        index = m_slots.size();
+        m_slots.emplace_back();
+    }
+    Slot& slot = m_slots[index];
+    slot.request = request;
+    // 代数从1开始，user_data永远不为0，0留给不需要处理完成事件的请求
+    if(++slot.generation == 0){
+        slot.generation = 1;
+    }
+    return ((uint64_t)slot.generation << 32) | index;
+}
+
+void* Uring::complete(uint64_t user_data){
+    uint32_t index = (uint32_t)user_data;
+    uint32_t generation = (uint32_t)(user_data >> 32);
+    if(index >= m_slots.size()){
+        return nullptr;
+    }
+    Slot& slot = m_slots[index];
+    if(slot.generation != generation || !slot.request){
+        return nullptr;
+    }
+    void* request = slot.request;
+    slot.request = nullptr;
+    m_free_slots.push_back(index);
+    return request;
+}
+
+int Uring::registerFiles(unsigned count){
+    std::vector<int> fds(count, -1);
+    if(SysRegister(m_fd, IORING_REGISTER_FILES, fds.data(), count) < 0){
+        return errno;
+    }
+    m_fixed_files = count;
+    return 0;
+}
+
+int Uring::updateFile(unsigned slot, int fd){
+    io_uring_files_update update;
+    memset(&update, 0, sizeof(update));
+    update.offset = slot;
+    update.fds = (uint64_t)&fd;
+    if(SysRegister(m_fd, IORING_REGISTER_FILES_UPDATE, &update, 1) < 0){
+        return errno;
+    }
+    return 0;
+}
+
+}
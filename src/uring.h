@@ -0,0 +1,110 @@
+/*
+    @file uring.h
+    @brief io_uring的最小封装(直接使用系统调用，不依赖liburing)
+*/
+
+#ifndef __CAIZI_URING_H__
+#define __CAIZI_URING_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <vector>
+
+#include "noncopyable.h"
+
+namespace caizi{
+
+/*
+    一个io_uring实例，只能由一个线程提交请求和收割完成事件(io_uring_register可以在任意线程调用)。
+    getSqe()取得的请求先累积在提交队列里，enter()时一次系统调用批量提交。
+    请求的user_data由track()分配：低32位是请求表的下标，高32位是代数，
+    下标复用后旧的user_data不会再匹配，取消一个已经完成的请求不会误伤新的请求。
+*/
+class Uring : public Noncopyable{
+public:
+    Uring() = default;
+    ~Uring();
+
+    // 创建ring并检查需要的操作是否支持，成功返回0，失败返回errno
+    int init(unsigned entries);
+    bool isValid() const{ return m_fd >= 0; }
+    int getFd() const{ return m_fd; }
+
+    // 取得一个清零的提交项，提交队列已满时先提交再取
+    io_uring_sqe* getSqe();
+    // 已填写还没有提交给内核的请求数
+    unsigned pending() const;
+    // 提交队列剩余的位置
+    unsigned space() const{ return m_sq_entries - pending(); };
+    /*
+        提交所有请求，wait_nr>0时等待至少wait_nr个完成事件
+        @param timeout_ms 等待的超时时间，-1表示一直等待
+        @return 成功返回提交的数量，失败返回-errno(超时和被信号中断返回0)
+    */
+    int enter(unsigned wait_nr, int timeout_ms = -1);
+
+    // 依次处理已完成的事件，返回处理的数量
+    template<class Func>
+    unsigned reap(Func func){
+        unsigned head = *m_cq_head;
+        unsigned tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+        unsigned count = 0;
+        while(head != tail){
+            func(m_cqes[head & *m_cq_mask]);
+            ++head;
+            ++count;
+        }
+        __atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+        return count;
+    }
+
+    // 为请求分配user_data，完成时用complete()取回
+    uint64_t track(void* request);
+    // 取回user_data对应的请求并释放下标，不是track分配的或已经取回过返回nullptr
+    void* complete(uint64_t user_data);
+
+    // 注册count个空的固定文件槽
+    int registerFiles(unsigned count);
+    // 把fd放入固定文件槽slot，fd为-1时清空
+    int updateFile(unsigned slot, int fd);
+    unsigned getFixedFileCount() const{ return m_fixed_files; }
+
+private:
+    struct Slot{
+        void* request = nullptr;
+        uint32_t generation = 0;
+    };
+
+    int m_fd = -1;
+    uint32_t m_features = 0;
+
+    void* m_sq_ring = nullptr;
+    size_t m_sq_ring_size = 0;
+    void* m_cq_ring = nullptr;
+    size_t m_cq_ring_size = 0;
+    io_uring_sqe* m_sqes = nullptr;
+    size_t m_sqes_size = 0;
+
+    unsigned* m_sq_head = nullptr;
+    unsigned* m_sq_tail = nullptr;
+    unsigned* m_sq_mask = nullptr;
+    unsigned* m_sq_array = nullptr;
+    unsigned m_sq_entries = 0;
+    unsigned m_sqe_head = 0;            // 已放入提交队列的位置
+    unsigned m_sqe_tail = 0;            // 已由getSqe分配的位置
+
+    unsigned* m_cq_head = nullptr;
+    unsigned* m_cq_tail = nullptr;
+    unsigned* m_cq_mask = nullptr;
+    io_uring_cqe* m_cqes = nullptr;
+
+    std::vector<Slot> m_slots;
+    std::vector<uint32_t> m_free_slots;
+    unsigned m_fixed_files = 0;
+};
+
+}
+
+#endif
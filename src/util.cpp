@@ -4,6 +4,7 @@
 #include <unistd.h>
 #include <execinfo.h>
 #include <sstream>
+#include <time.h>
 
 static caizi::Logger::ptr g_logger = CAIZI_GET_LOGGER("system");
 namespace caizi{
@@ -12,6 +13,18 @@ long GetThreadId(){
     return ::syscall(SYS_gettid);
 }
 
+uint64_t GetCurrentMS(){
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec * 1000ul + ts.tv_nsec / 1000000;
+}
+
+uint64_t GetCurrentUS(){
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec * 1000000ul + ts.tv_nsec / 1000;
+}
+
 // 获取栈信息
 void __GetBacktrace(std::vector<std::string>&bt, int size, int skip){
     void** buf = (void**) malloc(sizeof(void*) * size);
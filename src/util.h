@@ -3,11 +3,16 @@
 
 #include <vector>
 #include <string>
+#include <cstdint>
 
 namespace caizi{
 
 long GetThreadId();
 
+// 获取当前时间(自1970年起)，毫秒/微秒
+uint64_t GetCurrentMS();
+uint64_t GetCurrentUS();
+
 void __GetBacktrace(std::vector<std::string>&bt, int size, int skip = 0);
 std::string BacktraceToString(int size, int skip = 2, const std::string& prefix = "  ");
 
@@ -0,0 +1,115 @@
+/*
+    @file work_stealing_queue.h
+    @brief 单生产者多消费者的无锁工作窃取队列(Chase-Lev)
+*/
+
+#ifndef __CAIZI_WORK_STEALING_QUEUE_H__
+#define __CAIZI_WORK_STEALING_QUEUE_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "noncopyable.h"
+
+namespace caizi{
+
+/*
+    只有队列的所有者线程可以push，所有线程(包括所有者)都可以从队头steal。
+    所有者也从队头取，因此队列是FIFO的，先入队的任务先执行，YieldToReady的协程不会饿死其他任务。
+    T必须是指针类型，nullptr表示队列为空。
+    队列满时所有者把数组扩大一倍，旧数组可能仍被窃取方读取，保留到队列析构时才释放。
+*/
+template<class T>
+class WorkStealingQueue : public Noncopyable{
+public:
+    explicit WorkStealingQueue(size_t capacity = 256){
+        size_t cap = 2;
+        while(cap < capacity){
+            cap <<= 1;
+        }
+        m_array.store(new Array(cap), std::memory_order_relaxed);
+    }
+
+    ~WorkStealingQueue(){
+        delete m_array.load(std::memory_order_relaxed);
+        for(auto array : m_garbage){
+            delete array;
+        }
+    }
+
+    // 所有者：放入队尾
+    void push(T value){
+        int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+        int64_t top = m_top.load(std::memory_order_acquire);
+        Array* array = m_array.load(std::memory_order_relaxed);
+        if(bottom - top >= (int64_t)array->capacity){
+            Array* bigger = array->grow(top, bottom);
+            m_garbage.push_back(array);
+            array = bigger;
+            m_array.store(array, std::memory_order_release);
+        }
+        array->put(bottom, value);
+        m_bottom.store(bottom + 1, std::memory_order_release);
+    }
+
+    // 任意线程：从队头取出一个元素，队列为空返回nullptr
+    T steal(){
+        while(true){
+            int64_t top = m_top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t bottom = m_bottom.load(std::memory_order_acquire);
+            if(top >= bottom){
+                return nullptr;
+            }
+            Array* array = m_array.load(std::memory_order_acquire);
+            T value = array->get(top);
+            // 与其他取出方竞争同一个位置，失败说明被别人取走了，重试
+            if(m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                             std::memory_order_relaxed)){
+                return value;
+            }
+        }
+    }
+
+    // 近似的元素个数
+    size_t size() const{
+        int64_t bottom = m_bottom.load(std::memory_order_acquire);
+        int64_t top = m_top.load(std::memory_order_acquire);
+        return bottom > top ? bottom - top : 0;
+    }
+
+    bool empty() const{ return size() == 0; }
+
+private:
+    struct Array{
+        size_t capacity;
+        size_t mask;
+        std::atomic<T>* slots;
+
+        explicit Array(size_t cap): capacity(cap), mask(cap - 1), slots(new std::atomic<T>[cap]){}
+        ~Array(){ delete[] slots; }
+
+        T get(int64_t i) const{ return slots[i & mask].load(std::memory_order_relaxed); }
+        void put(int64_t i, T value){ slots[i & mask].store(value, std::memory_order_relaxed); }
+
+        Array* grow(int64_t top, int64_t bottom) const{
+            Array* array = new Array(capacity * 2);
+            for(int64_t i = top; i < bottom; ++i){
+                array->put(i, get(i));
+            }
+            return array;
+        }
+    };
+
+    // 队头和队尾分别被窃取方和所有者频繁修改，放在不同的缓存行
+    alignas(64) std::atomic<int64_t> m_top{0};
+    alignas(64) std::atomic<int64_t> m_bottom{0};
+    std::atomic<Array*> m_array{nullptr};
+    std::vector<Array*> m_garbage;
+};
+
+}
+
+#endif
@@ -0,0 +1,33 @@
+/*
+    @file random_values.h
+    @brief 测试用的随机整数生成，test_bytearray和test_simd_codec共用
+*/
+
+#ifndef __CAIZI_TEST_RANDOM_VALUES_H__
+#define __CAIZI_TEST_RANDOM_VALUES_H__
+
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace caizi{
+
+// 随机值，先放边界值(0、最小值、最大值、-1)，数量不超过count
+template<class T>
+std::vector<T> RandomValues(std::mt19937_64& rng, size_t count){
+    std::vector<T> values = {0, std::numeric_limits<T>::min(),
+                             std::numeric_limits<T>::max(), (T)-1};
+    if(values.size() > count){
+        values.resize(count);
+    }
+    for(size_t i = values.size(); i < count; ++i){
+        // 不同数量级的值，覆盖varint的各种长度
+        T v = (T)(rng() >> (rng() % (64 - 1)));
+        values.push_back(v);
+    }
+    return values;
+}
+
+}
+
+#endif
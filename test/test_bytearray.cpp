@@ -0,0 +1,207 @@
+#include "bytearray.h"
+#include "log.h"
+#include "random_values.h"
+#include <assert.h>
+#include <random>
+#include <stdexcept>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+static caizi::Logger::ptr g_logger = CAIZI_GET_ROOT_LOGGER();
+
+static std::mt19937_64 s_rng(42);
+
+// 写入后从头读出，再用同一个块大小验证读越界
+#define XX(type, write_fun, read_fun, base_size) \
+    { \
+        std::vector<type> values = caizi::RandomValues<type>(s_rng, 1000); \
+        caizi::ByteArray::ptr ba(new caizi::ByteArray(base_size)); \
+        ba->setIsLittleEndian(little); \
+        for(auto v : values){ \
+            ba->write_fun(v); \
+        } \
+        ba->setPosition(0); \
+        for(auto v : values){ \
+            type r = ba->read_fun(); \
+            assert(r == v); \
+        } \
+        assert(ba->getReadSize() == 0); \
+        bool thrown = false; \
+        try{ \
+            ba->read_fun(); \
+        }catch(std::out_of_range&){ \
+            thrown = true; \
+        } \
+        assert(thrown); \
+    }
+
+void test_integers(bool little, size_t base_size){
+    XX(int8_t, writeFint8, readFint8, base_size);
+    XX(uint8_t, writeFuint8, readFuint8, base_size);
+    XX(int16_t, writeFint16, readFint16, base_size);
+    XX(uint16_t, writeFuint16, readFuint16, base_size);
+    XX(int32_t, writeFint32, readFint32, base_size);
+    XX(uint32_t, writeFuint32, readFuint32, base_size);
+    XX(int64_t, writeFint64, readFint64, base_size);
+    XX(uint64_t, writeFuint64, readFuint64, base_size);
+    XX(int16_t, writeInt16, readInt16, base_size);
+    XX(uint16_t, writeUint16, readUint16, base_size);
+    XX(int32_t, writeInt32, readInt32, base_size);
+    XX(uint32_t, writeUint32, readUint32, base_size);
+    XX(int64_t, writeInt64, readInt64, base_size);
+    XX(uint64_t, writeUint64, readUint64, base_size);
+}
+#undef XX
+
+// 编码格式：定长按字节序，varint小端7位一组，zigzag
+void test_encoding(){
+    caizi::ByteArray ba(16);
+    ba.writeFuint32(0x01020304);
+    ba.setIsLittleEndian(true);
+    ba.writeFuint32(0x01020304);
+    ba.writeUint32(300);
+    ba.writeInt32(-1);
+    ba.writeInt32(1);
+    ba.writeInt64(-64);
+    ba.setPosition(0);
+    unsigned char expect[] = {1, 2, 3, 4, 4, 3, 2, 1, 0xac, 0x02, 0x01, 0x02, 0x7f};
+    assert(ba.getReadSize() == sizeof(expect));
+    assert(ba.toString() == std::string((char*)expect, sizeof(expect)));
+    assert(ba.toHexString().substr(0, 12) == "01 02 03 04 ");
+}
+
+void test_float_string(size_t base_size){
+    caizi::ByteArray ba(base_size);
+    std::string longstr(1000, 'x');
+    ba.writeFloat(3.25f);
+    ba.writeDouble(-1.0 / 3);
+    ba.writeStringF16("f16");
+    ba.writeStringF32("");
+    ba.writeStringF64(longstr);
+    ba.writeStringVint("vint");
+    ba.writeStringWithoutLength("raw");
+    ba.setPosition(0);
+    assert(ba.readFloat() == 3.25f);
+    assert(ba.readDouble() == -1.0 / 3);
+    assert(ba.readStringF16() == "f16");
+    assert(ba.readStringF32() == "");
+    assert(ba.readStringF64() == longstr);
+    assert(ba.readStringVint() == "vint");
+    char raw[3];
+    ba.read(raw, 3);
+    assert(std::string(raw, 3) == "raw");
+
+    // 长度字段超过剩余数据时抛出异常而不是分配巨大的字符串
+    caizi::ByteArray bad(base_size);
+    bad.writeFuint64(1ull << 40);
+    bad.setPosition(0);
+    bool thrown = false;
+    try{
+        bad.readStringF64();
+    }catch(std::out_of_range&){
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+// 位置、按位置读、清空
+void test_position(){
+    caizi::ByteArray ba(7);
+    std::string data;
+    for(int i = 0; i < 100; ++i){
+        data.push_back('a' + i % 26);
+    }
+    ba.write(data.data(), data.size());
+    assert(ba.getSize() == 100 && ba.getPosition() == 100);
+    char buf[10];
+    ba.read(buf, 10, 35);
+    assert(std::string(buf, 10) == data.substr(35, 10));
+    assert(ba.getPosition() == 100);
+    ba.setPosition(14);
+    assert(ba.toString() == data.substr(14));
+    ba.read(buf, 10);
+    assert(std::string(buf, 10) == data.substr(14, 10));
+    // 恰好在块边界
+    ba.setPosition(21);
+    ba.write("XYZ", 3);
+    ba.setPosition(20);
+    ba.read(buf, 5);
+    assert(std::string(buf, 5) == data.substr(20, 1) + "XYZ" + data.substr(24, 1));
+    ba.clear();
+    assert(ba.getSize() == 0 && ba.getPosition() == 0 && ba.toString().empty());
+    ba.writeStringF16("again");
+    ba.setPosition(0);
+    assert(ba.readStringF16() == "again");
+}
+
+// getWriteBuffers/getReadBuffers配合readv/writev，数据不经过中间缓冲区
+void test_iovec(){
+    int fds[2];
+    assert(!pipe(fds));
+    std::string data;
+    for(int i = 0; i < 5000; ++i){
+        data.push_back('0' + i % 10);
+    }
+    caizi::ByteArray src(100);
+    src.write(data.data(), data.size());
+    src.setPosition(123);
+    std::vector<iovec> iovs;
+    assert(src.getReadBuffers(iovs) == data.size() - 123);
+    assert(iovs.size() == 49);
+    assert(iovs[0].iov_len == 77);
+    assert(writev(fds[1], iovs.data(), iovs.size()) == (ssize_t)(data.size() - 123));
+    assert(src.getPosition() == 123);
+
+    caizi::ByteArray dst(64);
+    dst.writeStringWithoutLength("head");
+    size_t total = 0;
+    while(total < data.size() - 123){
+        iovs.clear();
+        dst.getWriteBuffers(iovs, 1000);
+        ssize_t n = readv(fds[0], iovs.data(), iovs.size());
+        assert(n > 0);
+        dst.setPosition(dst.getPosition() + n);
+        total += n;
+    }
+    dst.setPosition(0);
+    assert(dst.toString() == "head" + data.substr(123));
+
+    iovs.clear();
+    assert(dst.getReadBuffers(iovs, 10, 60) == 10);
+    assert(iovs.size() == 2 && iovs[0].iov_len == 4 && iovs[1].iov_len == 6);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+void test_file(){
+    caizi::ByteArray ba(13);
+    for(int i = 0; i < 1000; ++i){
+        ba.writeInt32(i * 7919 - 500000);
+    }
+    ba.setPosition(0);
+    std::string path = "/tmp/caizi_test_bytearray_" + std::to_string(getpid());
+    assert(ba.writeToFile(path));
+    caizi::ByteArray other(4096);
+    assert(other.readFromFile(path));
+    unlink(path.c_str());
+    other.setPosition(0);
+    assert(other.toString() == ba.toString());
+    for(int i = 0; i < 1000; ++i){
+        assert(other.readInt32() == i * 7919 - 500000);
+    }
+}
+
+int main(){
+    for(size_t base_size : {1, 3, 7, 128, 0}){
+        test_integers(false, base_size);
+        test_integers(true, base_size);
+        test_float_string(base_size);
+    }
+    test_encoding();
+    test_position();
+    test_iovec();
+    test_file();
+    LOG_INFO(g_logger, "test_bytearray ok\n");
+    return 0;
+}
@@ -1,7 +1,9 @@
 #include "config.h"
 #include "log.h"
 #include "yaml-cpp/yaml.h"
+#include <cassert>
 #include <cstdint>
+#include <fstream>
 #include <iostream>
 #include <list>
 #include <map>
@@ -17,9 +19,124 @@ void test_yaml(){
     // std::cout << config["name"].as<std::string>() << std::endl;
 }
 
+static size_t count_lines(const std::string& path){
+    std::ifstream in(path);
+    std::string line;
+    size_t lines = 0;
+    while(std::getline(in, line)){
+        ++lines;
+    }
+    return lines;
+}
+
+static void load(const std::string& yaml){
+    caizi::Config::LoadFromYAML(YAML::Load(yaml));
+}
+
+// 日志器由配置驱动，配置变化后已缓存的Logger::ptr立即生效
+void test_log_config(){
+    const char* path = "/tmp/caizi_test_config.log";
+    remove(path);
+    caizi::Logger::ptr logger = CAIZI_GET_LOGGER("config_test");
+    std::string yaml = std::string() +
+        "logs:\n"
+        "  - name: config_test\n"
+        "    level: warn\n"
+        "    appenders:\n"
+        "      - type: FileLogAppender\n"
+        "        file: " + path + "\n"
+        "        formatter: \"%p %m\"\n"
+        "        flush_interval: 0\n";
+    load(yaml);
+    assert(logger->getLevel() == caizi::LogLevel::WARN);
+    auto appenders = logger->getAppenders();
+    assert(appenders.size() == 1);
+    LOG_INFO(logger, "filtered\n");
+    LOG_WARN(logger, "written\n");
+    logger->flush();
+    assert(count_lines(path) == 1);
+    std::cout << caizi::Config::Lookup("logs")->toString() << std::endl;
+
+    // 只改级别时保留原来的输出地
+    std::string debug_yaml = yaml;
+    debug_yaml.replace(debug_yaml.find("level: warn"), 11, "level: debug");
+    load(debug_yaml);
+    assert(logger->getLevel() == caizi::LogLevel::DEBUG);
+    assert(logger->getAppenders() == appenders);
+
+    // 异步队列的容量和溢出策略
+    auto worker = caizi::AsyncLogWorker::getInstance();
+    std::string async_yaml = debug_yaml;
+    async_yaml.replace(async_yaml.find("    appenders:"), 0,
+        "    queue_capacity: 4096\n    overflow_policy: drop_debug_first\n");
+    load(async_yaml);
+    assert(worker->getQueueCapacity() == 4096);
+    assert(worker->getOverflowPolicy() == caizi::LogOverflowPolicy::DROP_DEBUG_FIRST);
+    assert(logger->getAppenders() == appenders);
+    assert(caizi::Config::Lookup("logs")->toString().find("overflow_policy: drop_debug_first") != std::string::npos);
+
+    // 有误的配置整体被拒绝
+    std::string bad_yaml = yaml;
+    bad_yaml.replace(bad_yaml.find("level: warn"), 11, "level: loud");
+    load(bad_yaml);
+    assert(logger->getLevel() == caizi::LogLevel::DEBUG);
+    bad_yaml = async_yaml;
+    bad_yaml.replace(bad_yaml.find("drop_debug_first"), 16, "drop_all");
+    load(bad_yaml);
+    assert(worker->getOverflowPolicy() == caizi::LogOverflowPolicy::DROP_DEBUG_FIRST);
+    worker->setOverflowPolicy(caizi::LogOverflowPolicy::BLOCK);
+    worker->setQueueCapacity(1024);
+
+    // 从配置中删除后恢复为默认的终端输出
+    load("logs: []");
+    assert(logger->getLevel() == caizi::LogLevel::DEBUG);
+    assert(logger->getAppenders().size() == 1);
+    assert(logger->getAppenders()[0] != appenders[0]);
+}
+
+// 写日志的同时反复切换输出地，切换前后的日志一条不丢
+void test_log_reload(){
+    std::string paths[2] = {"/tmp/caizi_test_reload_a.log", "/tmp/caizi_test_reload_b.log"};
+    remove(paths[0].c_str());
+    remove(paths[1].c_str());
+    caizi::Logger::ptr logger = CAIZI_GET_LOGGER("reload_test");
+    auto yaml = [](const std::string& file, bool async){
+        return "logs:\n"
+               "  - name: reload_test\n"
+               "    async: " + std::string(async ? "true" : "false") + "\n"
+               "    appenders:\n"
+               "      - type: FileLogAppender\n"
+               "        file: " + file + "\n";
+    };
+    load(yaml(paths[0], false));
+
+    std::atomic<bool> stop{false};
+    std::vector<caizi::Thread::ptr> threads;
+    for(int i = 0; i < 4; ++i){
+        threads.push_back(std::make_shared<caizi::Thread>([logger](){
+            for(int j = 0; j < 20000; ++j){
+                LOG_FMT_INFO(logger, "reload %d\n", j);
+            }
+        }, "reload_" + std::to_string(i)));
+    }
+    for(int i = 0; i < 50; ++i){
+        load(yaml(paths[(i + 1) % 2], i % 3 == 0));
+    }
+    for(auto& t : threads){
+        t->join();
+    }
+    caizi::AsyncLogWorker::getInstance()->flush();
+    load("logs: []");
+    size_t lines = count_lines(paths[0]) + count_lines(paths[1]);
+    std::cout << "reload lines = " << lines << std::endl;
+    assert(lines == 80000);
+}
 
 int main(){
 
+    test_log_config();
+    test_log_reload();
+
     LOG_DEBUG(GET_ROOT_LOGGER(),std::to_string(int_port->getValue())); 
     std::cout << std::endl;
 
@@ -0,0 +1,135 @@
+#include "fiber.h"
+#include "config.h"
+#include "log.h"
+#include <assert.h>
+#include <signal.h>
+#include <stdexcept>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+static caizi::Logger::ptr g_logger = CAIZI_GET_ROOT_LOGGER();
+
+// 子协程与主协程交替执行
+void test_swap(){
+    std::vector<int> order;
+    caizi::Fiber::GetThis();
+    caizi::Fiber::ptr fiber = caizi::Fiber::Create([&order](){
+        order.push_back(1);
+        caizi::Fiber::YieldToHole();
+        order.push_back(3);
+        caizi::Fiber::YieldToReady();
+        order.push_back(5);
+    });
+    fiber->swapIn();
+    order.push_back(2);
+    assert(fiber->getcurrentState() == caizi::Fiber::HOLD);
+    fiber->swapIn();
+    order.push_back(4);
+    assert(fiber->getcurrentState() == caizi::Fiber::READY);
+    fiber->swapIn();
+    assert(fiber->getcurrentState() == caizi::Fiber::TERM);
+    assert((order == std::vector<int>{1, 2, 3, 4, 5}));
+    assert(caizi::Fiber::GetFiberID() == caizi::Fiber::GetThis()->getId());
+}
+
+// 结束的协程回到空闲链表，下一次Create复用同一个对象和栈
+void test_recycle(){
+    int count = 0;
+    caizi::Fiber::ptr fiber = caizi::Fiber::Create([&count](){ ++count; });
+    caizi::Fiber* raw = fiber.get();
+    uint64_t id = fiber->getId();
+    fiber->swapIn();
+    fiber.reset();
+
+    fiber = caizi::Fiber::Create([&count](){ ++count; });
+    assert(fiber.get() == raw);
+    assert(fiber->getId() != id);
+    assert(fiber->getcurrentState() == caizi::Fiber::INIT);
+    fiber->swapIn();
+    assert(count == 2);
+
+}
+
+// 协程执行中丢掉外部唯一的引用，切换回来之后才被释放；挂起的协程由入口函数持有，恢复执行完后释放
+void test_lifetime(){
+    uint64_t before = caizi::Fiber::GetTotalFiberCount();
+    caizi::Fiber::ptr holder(new caizi::Fiber([&holder](){ holder.reset(); }));
+    caizi::Fiber* raw = holder.get();
+    raw->swapIn();
+    assert(!holder);
+    assert(caizi::Fiber::GetTotalFiberCount() == before);
+
+    caizi::Fiber::ptr held(new caizi::Fiber([](){
+        caizi::Fiber::YieldToHole();
+    }));
+    std::weak_ptr<caizi::Fiber> weak = held;
+    raw = held.get();
+    held->swapIn();
+    assert(held->getcurrentState() == caizi::Fiber::HOLD);
+    held.reset();
+    assert(!weak.expired());
+    raw->swapIn();
+    assert(weak.expired());
+    assert(caizi::Fiber::GetTotalFiberCount() == before);
+}
+
+// 协程里抛出的异常被捕获，协程进入EXCEPT状态并可以复用
+void test_exception(){
+    caizi::Fiber::ptr fiber = caizi::Fiber::Create([](){
+        throw std::runtime_error("test_fiber exception");
+    });
+    fiber->swapIn();
+    assert(fiber->getcurrentState() == caizi::Fiber::EXCEPT);
+    double value = 0;
+    fiber->reset([&value](){ value = 1.5 * 2; });
+    fiber->swapIn();
+    assert(fiber->getcurrentState() == caizi::Fiber::TERM);
+    assert(value == 3.0);
+}
+
+// 栈大小由配置项fiber.stack_size决定，按页对齐
+void test_stack_size(){
+    auto var = caizi::Config::Lookup<uint32_t>("fiber.stack_size");
+    assert(var);
+    uint32_t old = var->getValue();
+    var->setValue(64 * 1024 + 1);
+    caizi::Fiber::ptr fiber = caizi::Fiber::Create([](){});
+    assert(fiber->getStackSize() == 64 * 1024 + sysconf(_SC_PAGESIZE));
+    fiber->swapIn();
+    var->setValue(old);
+    fiber = caizi::Fiber::Create([](){});
+    assert(fiber->getStackSize() == old);
+    fiber->swapIn();
+}
+
+static int overflow(int depth){
+    volatile char buf[1024];
+    buf[0] = depth;
+    return overflow(depth + 1) + buf[0];
+}
+
+// 栈溢出访问保护页，进程收到SIGSEGV
+void test_guard_page(){
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if(pid == 0){
+        caizi::Fiber::ptr fiber = caizi::Fiber::Create([](){ overflow(0); }, 16 * 1024);
+        fiber->swapIn();
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    assert(WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV);
+}
+
+int main(){
+    test_swap();
+    test_recycle();
+    test_lifetime();
+    test_exception();
+    test_stack_size();
+    test_guard_page();
+    LOG_INFO(g_logger, "test_fiber ok, total fibers " + std::to_string(caizi::Fiber::GetTotalFiberCount()) + "\n");
+    return 0;
+}
@@ -0,0 +1,210 @@
+#include "hook.h"
+#include "fd_manager.h"
+#include "iomanager.h"
+#include "log.h"
+#include "thread.h"
+#include <assert.h>
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static caizi::Logger::ptr g_logger = CAIZI_GET_ROOT_LOGGER();
+
+// 监听回环地址的随机端口，返回监听fd并写出地址
+static int Listen(sockaddr_in& addr){
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    assert(fd != -1);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert(!bind(fd, (sockaddr*)&addr, sizeof(addr)));
+    assert(!listen(fd, 16));
+    socklen_t len = sizeof(addr);
+    assert(!getsockname(fd, (sockaddr*)&addr, &len));
+    return fd;
+}
+
+// 在协程中建立一对相连的阻塞套接字
+static void ConnectPair(int& client, int& server){
+    sockaddr_in addr;
+    int listen_fd = Listen(addr);
+    client = socket(AF_INET, SOCK_STREAM, 0);
+    assert(!connect(client, (sockaddr*)&addr, sizeof(addr)));
+    server = accept(listen_fd, nullptr, nullptr);
+    assert(server != -1);
+    close(listen_fd);
+}
+
+// 一个线程上的多个协程同时sleep，总耗时接近一次sleep
+void test_sleep(){
+    std::atomic<int> done{0};
+    uint64_t start = caizi::TimerManager::NowMS();
+    {
+        caizi::IOManager iom(1, false, "sleep");
+        iom.schedule([&](){
+            assert(caizi::IsHookEnable());
+            usleep(100 * 1000);
+            ++done;
+        });
+        iom.schedule([&](){
+            usleep(100 * 1000);
+            ++done;
+        });
+        iom.schedule([&](){
+            timespec req{0, 100 * 1000 * 1000};
+            assert(!nanosleep(&req, nullptr));
+            ++done;
+        });
+    }
+    uint64_t used = caizi::TimerManager::NowMS() - start;
+    assert(done == 3);
+    assert(used >= 100 && used < 250);
+}
+
+// 不了解协程的阻塞式代码：同一个线程上的服务端和客户端互相等待也不会死锁
+void test_blocking_echo(){
+    std::atomic<bool> echoed{false};
+    {
+        caizi::IOManager iom(1, false, "echo");
+        iom.schedule([&](){
+            sockaddr_in addr;
+            int listen_fd = Listen(addr);
+            caizi::IOManager::GetThis()->schedule([addr, &echoed](){
+                int fd = socket(AF_INET, SOCK_STREAM, 0);
+                assert(!connect(fd, (sockaddr*)&addr, sizeof(addr)));
+                assert(write(fd, "hello", 5) == 5);
+                char buf[16] = {0};
+                assert(read(fd, buf, sizeof(buf)) == 5);
+                assert(std::string(buf) == "hello");
+                close(fd);
+                echoed = true;
+            });
+            int fd = accept(listen_fd, nullptr, nullptr);
+            assert(fd != -1);
+            char buf[16];
+            ssize_t n = recv(fd, buf, sizeof(buf), 0);
+            assert(n == 5);
+            assert(send(fd, buf, n, 0) == n);
+            // 对端关闭后读到0
+            assert(read(fd, buf, sizeof(buf)) == 0);
+            close(fd);
+            close(listen_fd);
+        });
+    }
+    assert(echoed);
+}
+
+// 框架设置的O_NONBLOCK对用户不可见，用户自己设置后不再hook
+void test_fcntl(){
+    std::atomic<bool> finished{false};
+    {
+        caizi::IOManager iom(1, false, "fcntl");
+        iom.schedule([&](){
+            int client, server;
+            ConnectPair(client, server);
+            assert(!(fcntl(server, F_GETFL) & O_NONBLOCK));
+            assert(fcntl_f(server, F_GETFL) & O_NONBLOCK);
+
+            int flags = fcntl(server, F_GETFL);
+            assert(!fcntl(server, F_SETFL, flags | O_NONBLOCK));
+            assert(fcntl(server, F_GETFL) & O_NONBLOCK);
+            char buf[16];
+            assert(recv(server, buf, sizeof(buf), 0) == -1 && errno == EAGAIN);
+
+            // 取消用户的非阻塞后内核中仍保持非阻塞
+            assert(!fcntl(server, F_SETFL, flags));
+            assert(!(fcntl(server, F_GETFL) & O_NONBLOCK));
+            assert(fcntl_f(server, F_GETFL) & O_NONBLOCK);
+
+            int on = 1;
+            assert(!ioctl(client, FIONBIO, &on));
+            assert(caizi::FdMgr::getInstance()->get(client)->getUserNonblock());
+            assert(recv(client, buf, sizeof(buf), 0) == -1 && errno == EAGAIN);
+            close(client);
+            close(server);
+            finished = true;
+        });
+    }
+    assert(finished);
+}
+
+// SO_RCVTIMEO超时后阻塞的recv返回EAGAIN
+void test_recv_timeout(){
+    std::atomic<bool> finished{false};
+    {
+        caizi::IOManager iom(1, false, "timeout");
+        iom.schedule([&](){
+            int client, server;
+            ConnectPair(client, server);
+            timeval tv{0, 100 * 1000};
+            assert(!setsockopt(server, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)));
+            assert(caizi::FdMgr::getInstance()->get(server)->getTimeout(SO_RCVTIMEO) == 100);
+            char buf[16];
+            uint64_t start = caizi::TimerManager::NowMS();
+            assert(recv(server, buf, sizeof(buf), 0) == -1 && errno == EAGAIN);
+            uint64_t used = caizi::TimerManager::NowMS() - start;
+            assert(used >= 90 && used < 1000);
+            close(client);
+            close(server);
+            finished = true;
+        });
+    }
+    assert(finished);
+}
+
+// 另一个协程close时，阻塞在这个fd上的协程以EBADF返回，fd的状态被清除
+void test_close_wakes(){
+    std::atomic<int> error{0};
+    {
+        caizi::IOManager iom(1, false, "close");
+        iom.schedule([&](){
+            int client, server;
+            ConnectPair(client, server);
+            caizi::IOManager::GetThis()->schedule([server](){
+                usleep(10 * 1000);
+                close(server);
+                assert(!caizi::FdMgr::getInstance()->get(server));
+            });
+            char buf[16];
+            assert(read(server, buf, sizeof(buf)) == -1);
+            error = errno;
+            close(client);
+        });
+    }
+    assert(error == EBADF);
+}
+
+// 没有开启hook的线程照常阻塞
+void test_not_hooked(){
+    assert(!caizi::IsHookEnable());
+    std::atomic<bool> finished{false};
+    caizi::Thread thread([&](){
+        assert(!caizi::IsHookEnable());
+        uint64_t start = caizi::TimerManager::NowMS();
+        usleep(20 * 1000);
+        assert(caizi::TimerManager::NowMS() - start >= 20);
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        assert(fd != -1);
+        assert(!caizi::FdMgr::getInstance()->get(fd));
+        assert(!(fcntl(fd, F_GETFL) & O_NONBLOCK));
+        close(fd);
+        finished = true;
+    }, "plain");
+    thread.join();
+    assert(finished);
+}
+
+int main(){
+    test_sleep();
+    test_blocking_echo();
+    test_fcntl();
+    test_recv_timeout();
+    test_close_wakes();
+    test_not_hooked();
+    LOG_INFO(g_logger, "test_hook ok\n");
+    return 0;
+}
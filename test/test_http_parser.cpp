@@ -0,0 +1,288 @@
+#include "http_parser.h"
+#include "config.h"
+#include "log.h"
+#include <assert.h>
+#include <string.h>
+#include <vector>
+
+static caizi::Logger::ptr g_logger = CAIZI_GET_ROOT_LOGGER();
+
+/*
+    每次多给step个字节并把数据搬到新的缓冲区，模拟增量接收和缓冲区扩容
+    @param buffer 最后一次调用使用的缓冲区，结果指向它
+*/
+template<class Parser>
+static int64_t FeedIncremental(Parser& parser, const std::string& msg, size_t step, std::vector<char>& buffer){
+    buffer.clear();
+    for(size_t len = std::min(step, msg.size()); ; len = std::min(len + step, msg.size())){
+        // 已经解析过的部分(包括原地解码的分块数据)从旧缓冲区搬过来
+        std::vector<char> next(buffer);
+        next.insert(next.end(), msg.begin() + buffer.size(), msg.begin() + len);
+        buffer.swap(next);
+        int64_t rt = parser.execute(buffer.data(), buffer.size());
+        if(rt != 0 || len == msg.size()){
+            return rt;
+        }
+    }
+}
+
+static int64_t Parse(caizi::HttpParser& parser, std::string& msg){
+    parser.reset();
+    return parser.execute(&msg[0], msg.size());
+}
+
+void test_request(){
+    std::string msg = "GET /index.html?a=1&b=&c#frag HTTP/1.1\r\n"
+                      "Host: www.example.com\r\n"
+                      "User-Agent:curl/8.0\r\n"
+                      "X-Empty:\r\n"
+                      "Accept:   */*  \r\n"
+                      "\r\n";
+    for(size_t step : {msg.size(), (size_t)1, (size_t)7}){
+        caizi::HttpRequestParser parser;
+        std::vector<char> buffer;
+        assert(FeedIncremental(parser, msg, step, buffer) == (int64_t)msg.size());
+        assert(parser.isFinished());
+        const caizi::HttpRequest& req = parser.getData();
+        assert(req.getMethod() == caizi::HttpMethod::GET);
+        assert(req.getVersion() == 0x11);
+        assert(req.getUri() == "/index.html?a=1&b=&c#frag");
+        assert(req.getPath() == "/index.html");
+        assert(req.getQuery() == "a=1&b=&c");
+        assert(req.getFragment() == "frag");
+        assert(req.getHeaders().size() == 4);
+        assert(req.getHeader("host") == "www.example.com");
+        assert(req.getHeader("USER-AGENT") == "curl/8.0");
+        assert(req.getHeader("accept") == "*/*");
+        std::string_view v;
+        assert(req.hasHeader("x-empty", &v) && v.empty());
+        assert(!req.hasHeader("cookie"));
+        assert(req.getParam("a", v) && v == "1");
+        assert(req.getParam("b", v) && v.empty());
+        assert(req.getParam("c", v) && v.empty());
+        assert(!req.getParam("d", v));
+        assert(req.getBody().empty());
+        assert(!req.isClose());
+        // 结果指向缓冲区，不是拷贝
+        assert(req.getPath().data() >= buffer.data() && req.getPath().data() < buffer.data() + buffer.size());
+    }
+}
+
+// 多个请求连续到达，每次解析一个，剩下的数据留给下一次
+void test_pipelining(){
+    std::string msg = "POST /a HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello"
+                      "\r\n"    // 请求之间多余的空行
+                      "GET /b HTTP/1.1\r\n\r\n"
+                      "PUT /c HTTP/1.1\r\nContent-Length: 3\r\n\r\nab";
+    caizi::HttpRequestParser parser;
+    char* data = &msg[0];
+    size_t len = msg.size();
+    int64_t rt = parser.execute(data, len);
+    assert(rt > 0);
+    assert(parser.getData().getPath() == "/a" && parser.getData().getBody() == "hello");
+    data += rt;
+    len -= rt;
+    parser.reset();
+    rt = parser.execute(data, len);
+    assert(rt > 0);
+    assert(parser.getData().getPath() == "/b" && parser.getData().getBody().empty());
+    data += rt;
+    len -= rt;
+    parser.reset();
+    // 最后一个请求的body还差一个字节
+    assert(parser.execute(data, len) == 0);
+    assert(parser.isHeaderComplete());
+    std::string rest(data, len);
+    rest.push_back('c');
+    assert(parser.execute(&rest[0], rest.size()) == (int64_t)rest.size());
+    assert(parser.getData().getMethod() == caizi::HttpMethod::PUT);
+    assert(parser.getData().getBody() == "abc");
+}
+
+// 分块编码的数据原地拼接成连续的body
+void test_chunked(){
+    std::string msg = "POST /upload HTTP/1.1\r\n"
+                      "Transfer-Encoding: gzip, chunked\r\n"
+                      "\r\n"
+                      "5;name=value\r\nhello\r\n"
+                      "1\r\n \r\n"
+                      "A\r\n0123456789\r\n"
+                      "0\r\n"
+                      "Trailer: x\r\n"
+                      "\r\n"
+                      "GET /next HTTP/1.1\r\n\r\n";
+    size_t first = msg.find("GET /next");
+    for(size_t step : {msg.size(), (size_t)1, (size_t)3}){
+        caizi::HttpRequestParser parser;
+        std::vector<char> buffer;
+        assert(FeedIncremental(parser, msg, step, buffer) == (int64_t)first);
+        const caizi::HttpRequest& req = parser.getData();
+        assert(req.isChunked());
+        assert(req.getBody() == "hello 0123456789");
+        // trailer不算头部
+        assert(req.getHeaders().size() == 1);
+        // 后面的请求没有被改写
+        assert(std::string(buffer.data() + first, buffer.size() - first).find("GET /next") == 0
+               || buffer.size() < msg.size());
+    }
+
+    // LF结尾也接受
+    std::string lf = "POST / HTTP/1.1\nTransfer-Encoding: chunked\n\n3\nabc\n0\n\n";
+    caizi::HttpRequestParser parser;
+    assert(Parse(parser, lf) == (int64_t)lf.size());
+    assert(parser.getData().getBody() == "abc");
+}
+
+void test_keepalive(){
+    struct Case{
+        const char* msg;
+        bool close;
+    };
+    Case cases[] = {
+        {"GET / HTTP/1.1\r\n\r\n", false},
+        {"GET / HTTP/1.1\r\nConnection: close\r\n\r\n", true},
+        {"GET / HTTP/1.1\r\nConnection: Upgrade, Close\r\n\r\n", true},
+        {"GET / HTTP/1.0\r\n\r\n", true},
+        {"GET / HTTP/1.0\r\nConnection: keep-alive\r\n\r\n", false},
+    };
+    caizi::HttpRequestParser parser;
+    for(auto& c : cases){
+        std::string msg = c.msg;
+        assert(Parse(parser, msg) == (int64_t)msg.size());
+        assert(parser.getData().isClose() == c.close);
+    }
+
+    std::string msg = "PUT /x HTTP/1.1\r\nExpect: 100-continue\r\nContent-Length: 10\r\n\r\n";
+    assert(Parse(parser, msg) == 0);
+    assert(parser.isHeaderComplete() && parser.isExpectContinue());
+}
+
+void test_errors(){
+    struct Case{
+        const char* msg;
+        caizi::HttpParser::Error error;
+    };
+    Case cases[] = {
+        {"BREW /pot HTTP/1.1\r\n\r\n", caizi::HttpParser::UNSUPPORTED_METHOD},
+        {"GET / HTTP/2.0\r\n\r\n", caizi::HttpParser::UNSUPPORTED_VERSION},
+        {"GET / HTP/1.1\r\n\r\n", caizi::HttpParser::INVALID_MESSAGE},
+        {"GET  / HTTP/1.1\r\n\r\n", caizi::HttpParser::INVALID_MESSAGE},
+        {"GET /\x01 HTTP/1.1\r\n\r\n", caizi::HttpParser::INVALID_MESSAGE},
+        {"GET / HTTP/1.1\r\nHost : a\r\n\r\n", caizi::HttpParser::INVALID_MESSAGE},
+        {"GET / HTTP/1.1\r\nNoColon\r\n\r\n", caizi::HttpParser::INVALID_MESSAGE},
+        {"GET / HTTP/1.1\r\nA: b\r\n  folded\r\n\r\n", caizi::HttpParser::INVALID_MESSAGE},
+        {"POST / HTTP/1.1\r\nContent-Length: 1x\r\n\r\n", caizi::HttpParser::INVALID_MESSAGE},
+        {"POST / HTTP/1.1\r\nContent-Length: 1\r\nContent-Length: 2\r\n\r\n", caizi::HttpParser::INVALID_MESSAGE},
+        {"POST / HTTP/1.1\r\nContent-Length: 3\r\nTransfer-Encoding: chunked\r\n\r\n", caizi::HttpParser::INVALID_MESSAGE},
+        {"POST / HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\n", caizi::HttpParser::INVALID_MESSAGE},
+        {"POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n", caizi::HttpParser::INVALID_MESSAGE},
+        {"POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabcd\r\n", caizi::HttpParser::INVALID_MESSAGE},
+        {"POST / HTTP/1.1\r\nContent-Length: 99999999999999999999\r\n\r\n", caizi::HttpParser::BODY_TOO_LARGE},
+    };
+    caizi::HttpRequestParser parser;
+    for(auto& c : cases){
+        std::string msg = c.msg;
+        assert(Parse(parser, msg) == -1);
+        assert(parser.hasError() && parser.getError() == c.error);
+        // 出错后不再继续解析
+        assert(parser.execute(&msg[0], msg.size()) == -1);
+    }
+    assert(caizi::HttpParser::ErrorToStatus(caizi::HttpParser::UNSUPPORTED_METHOD) == caizi::HttpStatus::NOT_IMPLEMENTED);
+
+    // 大小限制来自配置
+    auto max_header = caizi::Config::Lookup<uint64_t>("http.parser.max_header_size");
+    auto max_body = caizi::Config::Lookup<uint64_t>("http.parser.max_body_size");
+    max_header->setValue(64);
+    max_body->setValue(16);
+    std::string msg = "GET / HTTP/1.1\r\nCookie: " + std::string(100, 'c');
+    assert(Parse(parser, msg) == -1 && parser.getError() == caizi::HttpParser::HEADER_TOO_LARGE);
+    msg = "POST / HTTP/1.1\r\nContent-Length: 17\r\n\r\n";
+    assert(Parse(parser, msg) == -1 && parser.getError() == caizi::HttpParser::BODY_TOO_LARGE);
+    msg = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n8\r\n12345678\r\n9\r\n";
+    assert(Parse(parser, msg) == -1 && parser.getError() == caizi::HttpParser::BODY_TOO_LARGE);
+    msg = "POST / HTTP/1.1\r\nContent-Length: 16\r\n\r\n0123456789abcdef";
+    assert(Parse(parser, msg) == (int64_t)msg.size());
+    max_header->setValue(8 * 1024);
+    max_body->setValue(64 * 1024 * 1024);
+}
+
+void test_response(){
+    caizi::HttpResponseParser parser;
+    std::string msg = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\nServer: x\r\n\r\nhiHTTP/1.1 404 Not Found\r\n";
+    assert(Parse(parser, msg) == (int64_t)msg.find("HTTP/1.1 404"));
+    assert(parser.getData().getStatus() == caizi::HttpStatus::OK);
+    assert(parser.getData().getReason() == "OK");
+    assert(parser.getData().getBody() == "hi");
+    assert(parser.getData().getHeader("server") == "x");
+
+    msg = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n2\r\nab\r\n0\r\n\r\n";
+    for(size_t step : {(size_t)1, msg.size()}){
+        std::vector<char> buffer;
+        parser.reset();
+        assert(FeedIncremental(parser, msg, step, buffer) == (int64_t)msg.size());
+        assert(parser.getData().getBody() == "ab");
+    }
+
+    // 没有长度时以关闭为结束
+    msg = "HTTP/1.0 200\r\n\r\nuntil close";
+    assert(Parse(parser, msg) == 0);
+    assert(parser.finish(&msg[0], msg.size()) == (int64_t)msg.size());
+    assert(parser.getData().getBody() == "until close");
+    assert(parser.getData().getReason().empty());
+    assert(parser.getData().isClose());
+
+    // HEAD、204和1xx没有body
+    msg = "HTTP/1.1 200 OK\r\nContent-Length: 100\r\n\r\n";
+    parser.reset();
+    parser.setHeadRequest(true);
+    assert(parser.execute(&msg[0], msg.size()) == (int64_t)msg.size());
+    parser.setHeadRequest(false);
+    msg = "HTTP/1.1 204 No Content\r\n\r\n";
+    assert(Parse(parser, msg) == (int64_t)msg.size());
+    msg = "HTTP/1.1 100 Continue\r\n\r\n";
+    assert(Parse(parser, msg) == (int64_t)msg.size());
+    assert(parser.getData().getStatus() == caizi::HttpStatus::CONTINUE);
+
+    // 关闭时还不完整
+    msg = "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nabc";
+    assert(Parse(parser, msg) == 0);
+    assert(parser.finish(&msg[0], msg.size()) == -1);
+}
+
+void test_response_dump(){
+    caizi::HttpResponse rsp(0x11, false);
+    rsp.setStatus(caizi::HttpStatus::NOT_FOUND);
+    rsp.setHeader("Content-Type", "text/plain");
+    rsp.setHeader("content-length", "999");
+    rsp.setBody("missing");
+    std::string str = rsp.toString();
+    caizi::HttpResponseParser parser;
+    assert(Parse(parser, str) == (int64_t)str.size());
+    const caizi::HttpResponseView& view = parser.getData();
+    assert(view.getStatus() == caizi::HttpStatus::NOT_FOUND);
+    assert(view.getReason() == "Not Found");
+    assert(view.getHeader("content-type") == "text/plain");
+    assert(view.getHeader("content-length") == "7");
+    assert(view.getBody() == "missing");
+    assert(!view.isClose());
+    // HEAD：Content-Length仍是body的长度，但不输出body
+    std::string head = rsp.toString(false);
+    assert(head.size() < str.size());
+    parser.reset();
+    parser.setHeadRequest(true);
+    assert(Parse(parser, head) == (int64_t)head.size());
+    assert(parser.getData().getHeader("content-length") == "7");
+    assert(parser.getData().getBody().empty());
+}
+
+int main(){
+    test_request();
+    test_pipelining();
+    test_chunked();
+    test_keepalive();
+    test_errors();
+    test_response();
+    test_response_dump();
+    LOG_INFO(g_logger, "test_http_parser ok\n");
+    return 0;
+}
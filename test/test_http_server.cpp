@@ -0,0 +1,241 @@
+#include "http_server.h"
+#include "log.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static caizi::Logger::ptr g_logger = CAIZI_GET_ROOT_LOGGER();
+static std::string s_root;          // FileServlet的目录
+static std::string s_file_content;
+
+// 不在IOManager中的阻塞客户端
+class Client{
+public:
+    Client(caizi::Address::ptr addr){
+        m_fd = socket(AF_INET, SOCK_STREAM, 0);
+        assert(m_fd != -1);
+        assert(!connect(m_fd, addr->getAddr(), addr->getAddrLen()));
+    }
+    ~Client(){
+        close(m_fd);
+    }
+
+    void send(const std::string& data){
+        assert(write(m_fd, data.data(), data.size()) == (ssize_t)data.size());
+    }
+
+    // 读出下一个响应，连接关闭时返回false
+    bool recv(caizi::HttpResponseView& rsp, bool head = false){
+        m_buffer.erase(0, m_consumed);
+        m_consumed = 0;
+        m_parser.reset();
+        m_parser.setHeadRequest(head);
+        while(true){
+            int64_t rt = m_buffer.empty() ? 0 : m_parser.execute(&m_buffer[0], m_buffer.size());
+            assert(rt >= 0);
+            if(rt > 0){
+                m_consumed = rt;
+                rsp = m_parser.getData();
+                return true;
+            }
+            char buf[4096];
+            ssize_t n = read(m_fd, buf, sizeof(buf));
+            if(n <= 0){
+                return false;
+            }
+            m_buffer.append(buf, n);
+        }
+    }
+
+    // 服务器已经关闭连接
+    bool isClosed(){
+        char c;
+        return read(m_fd, &c, 1) <= 0;
+    }
+
+private:
+    int m_fd;
+    std::string m_buffer;
+    size_t m_consumed = 0;
+    caizi::HttpResponseParser m_parser;
+};
+
+static caizi::HttpServer::ptr StartServer(caizi::IOManager* iom, bool keepalive){
+    caizi::HttpServer::ptr server(new caizi::HttpServer(keepalive, iom, "test/1.0"));
+    auto dispatch = server->getServletDispatch();
+    dispatch->addServlet("/hello", [](const caizi::HttpRequest& req, caizi::HttpResponse& rsp,
+                                      caizi::HttpSession::ptr session){
+        rsp.setHeader("Content-Type", "text/plain");
+        rsp.setBody("hello " + std::string(req.getQuery()));
+        return 0;
+    });
+    dispatch->addServlet("/echo", [](const caizi::HttpRequest& req, caizi::HttpResponse& rsp,
+                                     caizi::HttpSession::ptr session){
+        rsp.setBody(std::string(req.getBody()));
+        return 0;
+    });
+    dispatch->addPrefixServlet("/static/", [](const caizi::HttpRequest& req, caizi::HttpResponse& rsp,
+                                              caizi::HttpSession::ptr session){
+        rsp.setBody("static:" + std::string(req.getPath()));
+        return 0;
+    });
+    dispatch->addPrefixServlet("/static/img", [](const caizi::HttpRequest& req, caizi::HttpResponse& rsp,
+                                                 caizi::HttpSession::ptr session){
+        rsp.setBody("img:" + std::string(req.getPath()));
+        return 0;
+    });
+    dispatch->addServlet("/const", [](const caizi::HttpRequest& req, caizi::HttpResponse& rsp,
+                                      caizi::HttpSession::ptr session){
+        rsp.setBodyRef("constant body");
+        return 0;
+    });
+    dispatch->addPrefixServlet("/files", caizi::Servlet::ptr(new caizi::FileServlet(s_root, "/files")));
+    assert(server->bind(caizi::Address::ptr(new caizi::IPv4Address(INADDR_LOOPBACK, 0))));
+    assert(server->start());
+    return server;
+}
+
+// 字典树分发：精确优先、最长前缀、按段匹配
+void test_dispatch(){
+    caizi::ServletDispatch dispatch;
+    caizi::Servlet::ptr exact(new caizi::FunctionServlet(nullptr));
+    caizi::Servlet::ptr api(new caizi::FunctionServlet(nullptr));
+    caizi::Servlet::ptr api_v2(new caizi::FunctionServlet(nullptr));
+    caizi::Servlet::ptr root(new caizi::FunctionServlet(nullptr));
+    dispatch.addServlet("/api/user", exact);
+    dispatch.addPrefixServlet("/api", api);
+    dispatch.addPrefixServlet("/api/v2/", api_v2);
+    assert(dispatch.getMatchedServlet("/api/user") == exact);
+    assert(dispatch.getMatchedServlet("/api/user/1") == api);
+    assert(dispatch.getMatchedServlet("/api") == api);
+    assert(dispatch.getMatchedServlet("/api/") == api);
+    assert(dispatch.getMatchedServlet("/api/v2") == api_v2);
+    assert(dispatch.getMatchedServlet("/api/v2/x/y") == api_v2);
+    assert(dispatch.getMatchedServlet("/apix") == dispatch.getDefault());
+    assert(dispatch.getMatchedServlet("/") == dispatch.getDefault());
+    assert(dispatch.getServlet("/api/user") == exact);
+    assert(dispatch.getPrefixServlet("/api/v2") == api_v2);
+    dispatch.addPrefixServlet("/", root);
+    assert(dispatch.getMatchedServlet("/apix") == root);
+    assert(dispatch.getMatchedServlet("/") == root);
+    dispatch.delServlet("/api/user");
+    assert(dispatch.getMatchedServlet("/api/user") == api);
+    dispatch.delPrefixServlet("/api");
+    assert(dispatch.getMatchedServlet("/api/user") == root);
+    assert(dispatch.getMatchedServlet("/api/v2/z") == api_v2);
+}
+
+void test_keepalive_server(){
+    caizi::IOManager iom(2, false, "http");
+    caizi::HttpServer::ptr server = StartServer(&iom, true);
+    caizi::Address::ptr addr = server->getAddresses()[0];
+    {
+        Client client(addr);
+        caizi::HttpResponseView rsp;
+        client.send("GET /hello?x=1 HTTP/1.1\r\nHost: a\r\n\r\n");
+        assert(client.recv(rsp));
+        assert(rsp.getStatus() == caizi::HttpStatus::OK);
+        assert(rsp.getBody() == "hello x=1");
+        assert(rsp.getHeader("server") == "test/1.0");
+        assert(rsp.getHeader("content-type") == "text/plain");
+        assert(!rsp.isClose());
+
+        // 一次发送多个请求，按顺序得到响应
+        client.send("GET /static/css/a.css HTTP/1.1\r\n\r\n"
+                    "GET /static/img/b.png HTTP/1.1\r\n\r\n"
+                    "POST /echo HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n4\r\ndefg\r\n0\r\n\r\n"
+                    "GET /staticx HTTP/1.1\r\n\r\n"
+                    "HEAD /hello HTTP/1.1\r\n\r\n");
+        assert(client.recv(rsp) && rsp.getBody() == "static:/static/css/a.css");
+        assert(client.recv(rsp) && rsp.getBody() == "img:/static/img/b.png");
+        assert(client.recv(rsp) && rsp.getBody() == "abcdefg");
+        assert(client.recv(rsp) && rsp.getStatus() == caizi::HttpStatus::NOT_FOUND);
+        assert(rsp.getBody().find("test/1.0") != std::string_view::npos);
+        assert(client.recv(rsp, true) && rsp.getBody().empty());
+        assert(rsp.getHeader("content-length") == "6");
+        assert(!rsp.getHeader("date").empty());
+
+        // 文件用sendfile发送，接在writev发送的头部之后
+        client.send("GET /files/a.html HTTP/1.1\r\n\r\n"
+                    "HEAD /files/a.html HTTP/1.1\r\n\r\n"
+                    "GET /const HTTP/1.1\r\n\r\n"
+                    "GET /files/missing.txt HTTP/1.1\r\n\r\n"
+                    "GET /files/../test_http_server.cpp HTTP/1.1\r\n\r\n"
+                    "POST /files/a.html HTTP/1.1\r\n\r\n");
+        assert(client.recv(rsp) && rsp.getBody() == s_file_content);
+        assert(rsp.getHeader("content-type") == "text/html; charset=utf-8");
+        assert(client.recv(rsp, true) && rsp.getBody().empty());
+        assert(rsp.getHeader("content-length") == std::to_string(s_file_content.size()));
+        assert(client.recv(rsp) && rsp.getBody() == "constant body");
+        assert(client.recv(rsp) && rsp.getStatus() == caizi::HttpStatus::NOT_FOUND);
+        assert(client.recv(rsp) && rsp.getStatus() == caizi::HttpStatus::FORBIDDEN);
+        assert(client.recv(rsp) && rsp.getStatus() == caizi::HttpStatus::METHOD_NOT_ALLOWED);
+
+        // 大于初始缓冲区的请求，分两次发送
+        std::string body(20000, 'x');
+        client.send("POST /echo HTTP/1.1\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n"
+                    + body.substr(0, 5000));
+        usleep(10 * 1000);
+        client.send(body.substr(5000));
+        assert(client.recv(rsp) && rsp.getBody() == body);
+
+        // 客户端要求关闭
+        client.send("GET /hello HTTP/1.1\r\nConnection: close\r\n\r\n");
+        assert(client.recv(rsp) && rsp.isClose());
+        assert(client.isClosed());
+    }
+    {
+        // 100-continue：收到100后再发送body
+        Client client(addr);
+        caizi::HttpResponseView rsp;
+        client.send("PUT /echo HTTP/1.1\r\nExpect: 100-continue\r\nContent-Length: 4\r\n\r\n");
+        assert(client.recv(rsp) && rsp.getStatus() == caizi::HttpStatus::CONTINUE);
+        client.send("data");
+        assert(client.recv(rsp) && rsp.getStatus() == caizi::HttpStatus::OK && rsp.getBody() == "data");
+    }
+    {
+        // 错误的请求回复对应的状态码并关闭连接
+        Client client(addr);
+        caizi::HttpResponseView rsp;
+        client.send("GET / HTTP/3.0\r\n\r\n");
+        assert(client.recv(rsp) && rsp.getStatus() == caizi::HttpStatus::HTTP_VERSION_NOT_SUPPORTED);
+        assert(rsp.isClose());
+        assert(client.isClosed());
+    }
+    server->stop();
+}
+
+// 不支持长连接时每个响应后关闭
+void test_close_server(){
+    caizi::IOManager iom(1, false, "http_close");
+    caizi::HttpServer::ptr server = StartServer(&iom, false);
+    Client client(server->getAddresses()[0]);
+    caizi::HttpResponseView rsp;
+    client.send("GET /hello HTTP/1.1\r\n\r\nGET /hello HTTP/1.1\r\n\r\n");
+    assert(client.recv(rsp) && rsp.getBody() == "hello " && rsp.isClose());
+    assert(client.isClosed());
+    server->stop();
+}
+
+int main(){
+    char dir[] = "/tmp/test_http_server_XXXXXX";
+    assert(mkdtemp(dir));
+    s_root = dir;
+    std::string path = s_root + "/a.html";
+    for(int i = 0; i < 10000; ++i){
+        s_file_content += "<p>" + std::to_string(i) + "</p>";
+    }
+    FILE* fp = fopen(path.c_str(), "w");
+    assert(fp && fwrite(s_file_content.data(), 1, s_file_content.size(), fp) == s_file_content.size());
+    fclose(fp);
+
+    test_dispatch();
+    test_keepalive_server();
+    test_close_server();
+    unlink(path.c_str());
+    rmdir(dir);
+    LOG_INFO(g_logger, "test_http_server ok\n");
+    return 0;
+}
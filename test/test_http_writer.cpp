@@ -0,0 +1,154 @@
+#include "http_writer.h"
+#include "http_parser.h"
+#include "log.h"
+#include <assert.h>
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static caizi::Logger::ptr g_logger = CAIZI_GET_ROOT_LOGGER();
+
+// 统计内存分配次数
+static std::atomic<uint64_t> s_alloc_count{0};
+
+void* operator new(size_t size){
+    ++s_alloc_count;
+    void* p = malloc(size ? size : 1);
+    if(!p){
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept{
+    free(p);
+}
+
+static std::string Join(const caizi::HttpResponseWriter& writer){
+    std::string str;
+    for(size_t i = 0; i < writer.getIovecCount(); ++i){
+        const iovec& iov = writer.getIovecs()[i];
+        str.append((const char*)iov.iov_base, iov.iov_len);
+    }
+    return str;
+}
+
+static const caizi::HttpResponseView& Parse(caizi::HttpResponseParser& parser, std::string& msg, bool head = false){
+    parser.reset();
+    parser.setHeadRequest(head);
+    assert(parser.execute(&msg[0], msg.size()) == (int64_t)msg.size());
+    return parser.getData();
+}
+
+void test_header_block(){
+    caizi::HttpResponse rsp;
+    rsp.setHeader("X-A", "1");
+    rsp.setHeader("X-B", "2");
+    rsp.setHeader("x-a", "3");
+    assert(rsp.getHeader("X-A") == "3");
+    assert(rsp.getHeader("x-b") == "2");
+    assert(rsp.getHeaderBlock() == "X-B: 2\r\nx-a: 3\r\n");
+    rsp.delHeader("X-B");
+    assert(rsp.getHeader("X-B", "none") == "none");
+    // 由writer生成的头部被忽略
+    rsp.setHeader("Content-Length", "5");
+    rsp.setHeader("Connection", "close");
+    assert(rsp.getHeaderBlock() == "x-a: 3\r\n");
+
+    // 常见类型使用缓存的头部行，其它类型放在头部块中
+    rsp.setHeader("Content-Type", "text/plain");
+    assert(rsp.getContentTypeLine() == "content-type: text/plain\r\n");
+    assert(rsp.getHeader("content-type") == "text/plain");
+    rsp.setContentType("application/x-custom");
+    assert(rsp.getContentTypeLine().empty());
+    assert(rsp.getHeader("content-type") == "application/x-custom");
+    rsp.setContentType("application/json");
+    assert(rsp.getHeader("content-type") == "application/json");
+    assert(rsp.getHeaderBlock() == "x-a: 3\r\n");
+
+    rsp.reset(0x10, false);
+    assert(rsp.getHeaderBlock().empty() && rsp.getContentTypeLine().empty());
+    assert(rsp.getVersion() == 0x10 && !rsp.isClose());
+
+    assert(caizi::HttpResponseWriter::MimeTypeByPath("/a/b.HTML") == "text/html; charset=utf-8");
+    assert(caizi::HttpResponseWriter::MimeTypeByPath("x.png") == "image/png");
+    assert(caizi::HttpResponseWriter::MimeTypeByPath("a.d/noext") == "application/octet-stream");
+}
+
+void test_build(){
+    caizi::HttpResponseWriter writer("test/1.0");
+    caizi::HttpResponseParser parser;
+    caizi::HttpResponse rsp(0x11, false);
+    rsp.setStatus(caizi::HttpStatus::CREATED);
+    rsp.setContentType("text/plain");
+    rsp.setHeader("X-Id", "42");
+    rsp.setBodyRef("created");
+    // 状态行、Server、Date、Content-Type、头部块、Connection、Content-Length、body
+    assert(writer.build(rsp) == 8);
+    std::string str = Join(writer);
+    assert(str.compare(0, 22, "HTTP/1.1 201 Created\r\n") == 0);
+    const caizi::HttpResponseView& view = Parse(parser, str);
+    assert(view.getStatus() == caizi::HttpStatus::CREATED);
+    assert(view.getHeader("server") == "test/1.0");
+    assert(view.getHeader("x-id") == "42");
+    assert(view.getHeader("content-type") == "text/plain");
+    assert(view.getHeader("date").size() == strlen("Thu, 01 Jan 1970 00:00:00 GMT"));
+    assert(view.getBody() == "created" && !view.isClose());
+
+    // HEAD不带body，Content-Length不变
+    assert(writer.build(rsp, false) == 7);
+    str = Join(writer);
+    assert(Parse(parser, str, true).getHeader("content-length") == "7");
+
+    // 自定义描述、HTTP/1.0、没有Server
+    caizi::HttpResponseWriter anonymous;
+    rsp.reset(0x10, true);
+    rsp.setStatus(caizi::HttpStatus::OK);
+    rsp.setReason("Fine");
+    anonymous.build(rsp);
+    str = Join(anonymous);
+    assert(str.compare(0, 17, "HTTP/1.0 200 Fine") == 0);
+    assert(Parse(parser, str).getHeader("server", "none") == "none");
+    assert(parser.getData().isClose() && parser.getData().getHeader("content-length") == "0");
+
+    // 同一秒内Date行来自同一个缓存
+    assert(caizi::HttpResponseWriter::DateLine().data() == caizi::HttpResponseWriter::DateLine().data());
+}
+
+// 预热之后，重复使用的响应对象构造和序列化小响应不分配内存
+void test_no_alloc(){
+    caizi::HttpResponseWriter writer("test/1.0");
+    caizi::HttpResponse rsp;
+    std::string body(100, 'x');
+    for(int i = 0; i < 3; ++i){
+        rsp.reset(0x11, false);
+        rsp.setContentType("application/json");
+        rsp.setHeader("X-Request-Id", "abcdef");
+        rsp.setBody(body);
+        writer.build(rsp);
+    }
+    uint64_t before = s_alloc_count.load();
+    for(int i = 0; i < 1000; ++i){
+        rsp.reset(0x11, false);
+        rsp.setStatus(i % 2 ? caizi::HttpStatus::OK : caizi::HttpStatus::NOT_FOUND);
+        rsp.setContentType("application/json");
+        rsp.setHeader("X-Request-Id", "abcdef");
+        rsp.setBody(body);
+        writer.build(rsp);
+    }
+    assert(s_alloc_count.load() == before);
+}
+
+int main(){
+    test_header_block();
+    test_build();
+    test_no_alloc();
+    LOG_INFO(g_logger, "test_http_writer ok\n");
+    return 0;
+}
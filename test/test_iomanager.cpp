@@ -0,0 +1,252 @@
+#include "iomanager.h"
+#include "config.h"
+#include "log.h"
+#include <assert.h>
+#include <atomic>
+#include <fcntl.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static caizi::Logger::ptr g_logger = CAIZI_GET_ROOT_LOGGER();
+
+// 协程等待管道可读，另一个任务写入后恢复
+void test_wait_read(){
+    int fds[2];
+    assert(!pipe2(fds, O_NONBLOCK));
+    std::atomic<int> result{-2};
+    std::atomic<bool> waiting{false};
+    char buf[16] = {0};
+    {
+        caizi::IOManager iom(2, false, "read");
+        iom.schedule([&](){
+            waiting = true;
+            int rt = caizi::IOManager::GetThis()->waitEvent(fds[0], caizi::IOManager::READ);
+            assert(read(fds[0], buf, sizeof(buf)) == 5);
+            result = rt;
+        });
+        while(!waiting){
+            usleep(100);
+        }
+        usleep(1000);
+        assert(result == -2);
+        assert(write(fds[1], "hello", 5) == 5);
+    }
+    assert(result == 0);
+    assert(std::string(buf) == "hello");
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// 取消等待中的事件，协程以ECANCELED返回
+void test_cancel(){
+    int fds[2];
+    assert(!pipe2(fds, O_NONBLOCK));
+    std::atomic<int> result{-2};
+    std::atomic<bool> waiting{false};
+    {
+        caizi::IOManager iom(2, false, "cancel");
+        iom.schedule([&](){
+            waiting = true;
+            result = caizi::IOManager::GetThis()->waitEvent(fds[0], caizi::IOManager::READ);
+        });
+        while(!waiting){
+            usleep(100);
+        }
+        usleep(1000);
+        // 没有登记的事件不能取消
+        assert(!iom.cancelEvent(fds[0], caizi::IOManager::WRITE));
+        assert(iom.cancelEvent(fds[0], caizi::IOManager::READ));
+    }
+    assert(result == ECANCELED);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// 带超时的等待刚好和数据同时到达时，迟到的超时不能取消紧接着的不带超时的等待
+void test_timeout_race(){
+    int fds[2];
+    assert(!pipe2(fds, O_NONBLOCK));
+    std::atomic<bool> stop{false};
+    std::atomic<int> stale{0};
+    {
+        caizi::IOManager iom(2, false, "timeout_race");
+        iom.schedule([&](){
+            char buf[64];
+            for(int i = 0; i < 300; ++i){
+                caizi::IOManager::GetThis()->waitEvent(fds[0], caizi::IOManager::READ, 1);
+                while(read(fds[0], buf, sizeof(buf)) > 0){
+                }
+                if(caizi::IOManager::GetThis()->waitEvent(fds[0], caizi::IOManager::READ) == ETIMEDOUT){
+                    ++stale;
+                }
+                while(read(fds[0], buf, sizeof(buf)) > 0){
+                }
+            }
+            stop = true;
+        });
+        while(!stop){
+            assert(write(fds[1], "x", 1) == 1);
+            usleep(1000);
+        }
+    }
+    assert(stale == 0);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// 回调方式的事件，读写同时登记，use_caller
+void test_callback(){
+    int fds[2];
+    assert(!pipe2(fds, O_NONBLOCK));
+    std::atomic<int> readable{0};
+    std::atomic<int> writable{0};
+    {
+        caizi::IOManager iom(2, true, "callback");
+        assert(!iom.addEvent(fds[1], caizi::IOManager::WRITE, [&](){ ++writable; }));
+        assert(!iom.addEvent(fds[0], caizi::IOManager::READ, [&](){ ++readable; }));
+        // 重复登记失败
+        assert(iom.addEvent(fds[0], caizi::IOManager::READ, [&](){ ++readable; }) == -1);
+        assert(write(fds[1], "x", 1) == 1);
+    }
+    assert(readable == 1);
+    assert(writable == 1);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// 大量fd分布在多个块上
+void test_many_fds(){
+    const int count = 300;
+    std::vector<int> fds(count * 2);
+    for(int i = 0; i < count; ++i){
+        assert(!pipe2(&fds[i * 2], O_NONBLOCK));
+    }
+    std::atomic<int> done{0};
+    {
+        caizi::IOManager iom(3, false, "many");
+        for(int i = 0; i < count; ++i){
+            int rfd = fds[i * 2];
+            iom.schedule([&, rfd](){
+                int rt = caizi::IOManager::GetThis()->waitEvent(rfd, caizi::IOManager::READ);
+                char c;
+                if(rt == 0 && read(rfd, &c, 1) == 1){
+                    ++done;
+                }
+            });
+        }
+        usleep(10000);
+        for(int i = 0; i < count; ++i){
+            assert(write(fds[i * 2 + 1], "x", 1) == 1);
+        }
+    }
+    assert(done == count);
+    for(int fd : fds){
+        close(fd);
+    }
+}
+
+// 通过IOManager::Accept/Connect/Recv/Send在回环地址上收发，服务端和客户端都在协程中
+void test_echo(const std::string& backend, bool fixed_files){
+    caizi::Config::Lookup<std::string>("iomanager.backend")->setValue(backend);
+    caizi::Config::Lookup<bool>("iomanager.uring_fixed_files")->setValue(fixed_files);
+    const int clients = 20;
+    std::atomic<int> echoed{0};
+
+    int listenfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    assert(listenfd >= 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert(!bind(listenfd, (sockaddr*)&addr, sizeof(addr)));
+    assert(!listen(listenfd, SOMAXCONN));
+    socklen_t len = sizeof(addr);
+    assert(!getsockname(listenfd, (sockaddr*)&addr, &len));
+    {
+        caizi::IOManager iom(2, false, "echo");
+        if(backend == "io_uring" && iom.getBackend() != caizi::IOManager::IO_URING){
+            // 内核或沙箱不支持io_uring时IOManager退回epoll，只跳过io_uring部分
+            LOG_INFO(g_logger, "io_uring unavailable, test_echo runs on epoll\n");
+        }
+        iom.schedule([listenfd, clients](){
+            for(int i = 0; i < clients; ++i){
+                int conn = caizi::IOManager::Accept(listenfd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                assert(conn >= 0);
+                caizi::IOManager::GetThis()->schedule([conn](){
+                    char buf[64];
+                    ssize_t n = caizi::IOManager::Recv(conn, buf, sizeof(buf), 0);
+                    assert(n > 0);
+                    assert(caizi::IOManager::Send(conn, buf, n, 0) == n);
+                    caizi::IOManager::GetThis()->closeFd(conn);
+                    close(conn);
+                });
+            }
+        });
+        for(int i = 0; i < clients; ++i){
+            iom.schedule([&echoed, addr, i](){
+                int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+                assert(fd >= 0);
+                assert(!caizi::IOManager::Connect(fd, (const sockaddr*)&addr, sizeof(addr)));
+                std::string msg = "hello " + std::to_string(i);
+                assert(caizi::IOManager::Send(fd, msg.data(), msg.size(), 0) == (ssize_t)msg.size());
+                char buf[64];
+                ssize_t n = caizi::IOManager::Recv(fd, buf, sizeof(buf), 0);
+                if(n == (ssize_t)msg.size() && !memcmp(buf, msg.data(), n)){
+                    ++echoed;
+                }
+                // 对端已关闭
+                assert(caizi::IOManager::Recv(fd, buf, sizeof(buf), 0) == 0);
+                caizi::IOManager::GetThis()->closeFd(fd);
+                close(fd);
+            });
+        }
+    }
+    assert(echoed == clients);
+    close(listenfd);
+    caizi::Config::Lookup<std::string>("iomanager.backend")->setValue("epoll");
+    caizi::Config::Lookup<bool>("iomanager.uring_fixed_files")->setValue(false);
+}
+
+// 协程阻塞在IOManager::Recv时取消读，两种后端都以ECANCELED返回
+void test_cancel_recv(const std::string& backend){
+    caizi::Config::Lookup<std::string>("iomanager.backend")->setValue(backend);
+    int fds[2];
+    assert(!socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds));
+    std::atomic<int> error{0};
+    std::atomic<bool> waiting{false};
+    {
+        caizi::IOManager iom(2, false, "cancel_recv");
+        iom.schedule([&](){
+            char buf[8];
+            waiting = true;
+            ssize_t n = caizi::IOManager::Recv(fds[0], buf, sizeof(buf), 0);
+            error = n < 0 ? errno : 0;
+        });
+        while(!waiting){
+            usleep(100);
+        }
+        usleep(10000);
+        assert(iom.cancelEvent(fds[0], caizi::IOManager::READ));
+    }
+    assert(error == ECANCELED);
+    close(fds[0]);
+    close(fds[1]);
+    caizi::Config::Lookup<std::string>("iomanager.backend")->setValue("epoll");
+}
+
+int main(){
+    test_wait_read();
+    test_cancel();
+    test_timeout_race();
+    test_callback();
+    test_many_fds();
+    test_echo("epoll", false);
+    test_echo("io_uring", false);
+    test_echo("io_uring", true);
+    test_cancel_recv("epoll");
+    test_cancel_recv("io_uring");
+    LOG_INFO(g_logger, "test_iomanager ok\n");
+    return 0;
+}
@@ -1,4 +1,30 @@
 #include "log.h"
+#include "log_binary.h"
+#include "log_json.h"
+#include "util.h"
+#include <cassert>
+#include <cstdio>
+#include <new>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// 统计当前线程的堆分配次数，用于检查日志调用是否分配内存，后台线程(如LogTicker)的分配不计入
+static thread_local uint64_t t_alloc_count = 0;
+void* operator new(size_t size){
+    ++t_alloc_count;
+    void* p = malloc(size);
+    if(!p){
+        throw std::bad_alloc();
+    }
+    return p;
+}
+void operator delete(void* p) noexcept{
+    free(p);
+}
+void operator delete(void* p, size_t) noexcept{
+    free(p);
+}
 
 using namespace std;
 using namespace caizi;
@@ -18,9 +44,594 @@ void test1(){
 
 
 
+// 多线程异步写文件，检查条数与丢弃计数
+void test_async(){
+    const char* path = "/tmp/caizi_test_async.log";
+    remove(path);
+    Logger::ptr logger(new Logger("async"));
+    logger->addAppender(std::make_shared<FileLogAppender>(path));
+    logger->setAsync(true);
+
+    auto worker = AsyncLogWorker::getInstance();
+    worker->setOverflowPolicy(LogOverflowPolicy::BLOCK);
+    std::vector<Thread::ptr> threads;
+    for(int i = 0; i < 4; ++i){
+        threads.push_back(std::make_shared<Thread>([logger](){
+            for(int j = 0; j < 10000; ++j){
+                LOG_INFO(logger, "async " + std::to_string(j) + "\n");
+            }
+        }, "async_" + std::to_string(i)));
+    }
+    for(auto& t : threads){
+        t->join();
+    }
+    worker->flush();
+
+    std::ifstream in(path);
+    std::string line;
+    size_t lines = 0;
+    while(std::getline(in, line)){
+        ++lines;
+    }
+    std::cout << "async lines = " << lines << ", dropped = " << worker->getDroppedCount() << std::endl;
+    assert(lines == 40000);
+    assert(worker->getDroppedCount() == 0);
+}
+
+// 稳态下格式化日志调用不分配堆内存
+void test_zero_alloc(){
+    const char* path = "/tmp/caizi_test_zero_alloc.log";
+    remove(path);
+    Logger::ptr logger(new Logger("zero_alloc"));
+    logger->addAppender(std::make_shared<FileLogAppender>(path));
+    LOG_FMT_INFO(logger, "warm up %d\n", 0);
+
+    uint64_t before = t_alloc_count;
+    for(int i = 0; i < 1000; ++i){
+        LOG_FMT_INFO(logger, "zero alloc %d %s\n", i, "abc");
+        LOG_INFO(logger, "literal message\n");
+    }
+    uint64_t allocs = t_alloc_count - before;
+    std::cout << "allocations in 2000 log calls = " << allocs << std::endl;
+    assert(allocs == 0);
+}
+
+// 级别未启用时不对参数求值
+static int s_evaluated = 0;
+static int touch(){
+    return ++s_evaluated;
+}
+
+void test_level_check(){
+    Logger::ptr logger(new Logger("level_check"));
+    logger->addAppender(std::make_shared<StdoutLogAppender>());
+    logger->setLevel(LogLevel::ERROR);
+
+    uint64_t before = t_alloc_count;
+    LOG_DEBUG(logger, "never " + std::to_string(touch()) + "\n");
+    LOG_FMT_INFO(logger, "never %d\n", touch());
+    assert(s_evaluated == 0);
+    assert(t_alloc_count == before);
+
+    LOG_FMT_ERROR(logger, "enabled %d\n", touch());
+    assert(s_evaluated == 1);
+}
+
+// 编译期格式与运行时格式的输出一致
+static constexpr char kStaticPattern[] = "[%p] %n(%t) %f:%l%s100%% %m";
+
+void test_static_formatter(){
+    LogEventGuard ev(LogLevel::WARN, __FILE__, __LINE__);
+    ev->setContent("static formatter");
+
+    LogFormatter runtime(kStaticPattern);
+    StaticLogFormatter<kStaticPattern> compiled;
+    assert(!runtime.isError());
+    std::string expect = runtime.format(LogLevel::WARN, *ev);
+    std::string actual = compiled.format(LogLevel::WARN, *ev);
+    std::cout << actual << std::endl;
+    assert(expect == actual);
+
+    LogFormatter bad("%p %Q");
+    assert(bad.isError());
+}
+
+// %d输出毫秒精度的本地时间，%r输出启动至今的毫秒数
+void test_datetime(){
+    uint64_t before = GetCurrentMS();
+    LogEventGuard ev(LogLevel::INFO, __FILE__, __LINE__);
+    uint64_t after = GetCurrentMS();
+    // 缓存的时间最多落后一个更新周期
+    assert(ev->getTime() + 50 >= before && ev->getTime() <= after + 50);
+    assert(ev->getElapse() == ev->getTime() - CoarseClock::StartMS());
+
+    char buf[CoarseClock::DATETIME_SIZE + 1] = {0};
+    CoarseClock::FormatDateTime(1000 * 86400 * 365ull + 7, buf);
+    std::string first(buf);
+    CoarseClock::FormatDateTime(1000 * 86400 * 365ull + 999, buf);
+    assert(first.size() == CoarseClock::DATETIME_SIZE);
+    assert(first.substr(19) == ".007" && std::string(buf).substr(19) == ".999");
+    assert(first.substr(0, 19) == std::string(buf).substr(0, 19));
+    assert(first[4] == '-' && first[7] == '-' && first[10] == ' ' && first[13] == ':');
+
+    LogFormatter formatter("%d|%r");
+    std::string line = formatter.format(LogLevel::INFO, *ev);
+    std::cout << line << std::endl;
+    assert(line[CoarseClock::DATETIME_SIZE] == '|');
+    assert(line.substr(CoarseClock::DATETIME_SIZE + 1) == std::to_string(ev->getElapse()));
+
+    static constexpr char kPattern[] = "%d|%r";
+    StaticLogFormatter<kPattern> compiled;
+    assert(compiled.format(LogLevel::INFO, *ev) == line);
+}
+
+// 统计收到的日志条数的输出地
+class CountingAppender : public LogAppender{
+public:
+    typedef std::shared_ptr<CountingAppender> ptr;
+    void log(LogLevel::Level level, const LogEvent& ev) override{
+        m_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    std::atomic<uint64_t> m_count{0};
+};
+
+// 记录收到的日志内容的输出地
+class CaptureAppender : public LogAppender{
+public:
+    typedef std::shared_ptr<CaptureAppender> ptr;
+    void log(LogLevel::Level level, const LogEvent& ev) override{
+        ScopeLock lock(&m_mutex);
+        m_lines.push_back(std::string(ev.getContent()));
+    }
+    size_t size(){
+        ScopeLock lock(&m_mutex);
+        return m_lines.size();
+    }
+    std::vector<std::string> m_lines;
+};
+
+// 长字符串参数、参数超出事件内空间、非字面量格式串和%p的字符串指针
+void test_format_args(){
+    Logger::ptr logger(new Logger("format_args"));
+    auto capture = CaptureAppender::ptr(new CaptureAppender);
+    logger->addAppender(capture);
+
+    std::string big(400, 'x');
+    LOG_FMT_INFO(logger, "big=%s|", big.c_str());
+    assert(capture->m_lines.back() == "big=" + big + "|");
+
+    // 编码后超过CAIZI_LOG_ARGS_SIZE，立即格式化，结果相同
+    LOG_FMT_INFO(logger, "%s %s", big.c_str(), big.c_str());
+    std::string expect = (big + " " + big).substr(0, CAIZI_LOG_CONTENT_SIZE);
+    assert(capture->m_lines.back() == expect);
+    char buf[1024];
+    LOG_FMT_INFO(logger, "%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,"
+                         "%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,"
+                         "%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,"
+                         "%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,",
+                 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19,
+                 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39,
+                 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59,
+                 60, 61, 62, 63, 64, 65, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76, 77, 78, 79);
+    expect.clear();
+    for(int i = 0; i < 80; ++i){
+        expect += std::to_string(i) + ",";
+    }
+    assert(capture->m_lines.back() == expect);
+
+    // 非字面量的格式串立即格式化
+    snprintf(buf, sizeof(buf), "dynamic %%d %%s");
+    const char* format = buf;
+    LOG_FMT_INFO(logger, format, 7, "seven");
+    assert(capture->m_lines.back() == "dynamic 7 seven");
+
+    // %p的char*输出地址，%s的char*输出内容
+    char text[] = "text";
+    const char* ctext = text;
+    LOG_FMT_INFO(logger, "%s %p %*d %p", text, text, 3, 5, ctext);
+    snprintf(buf, sizeof(buf), "%s %p %*d %p", text, (void*)text, 3, 5, (const void*)ctext);
+    assert(capture->m_lines.back() == buf);
+}
+
+// 不由shared_ptr管理的异步日志器退化为同步输出
+void test_async_unowned(){
+    Logger logger("unowned");
+    CountingAppender::ptr counter(new CountingAppender);
+    logger.addAppender(counter);
+    logger.setAsync(true);
+    LogEvent event;
+    event.init(LogLevel::INFO, __FILE__, __LINE__);
+    logger.log(LogLevel::INFO, event);
+    assert(counter->m_count == 1);
+}
+
+// 写日志的同时增删输出地，常驻的输出地一条不漏；日志器表查找返回同名日志器
+void test_appender_snapshot(){
+    Logger::ptr logger(new Logger("snapshot"));
+    CountingAppender::ptr fixed(new CountingAppender);
+    logger->addAppender(fixed);
+
+    std::atomic<bool> stop{false};
+    Thread::ptr writer = std::make_shared<Thread>([logger, &stop](){
+        CountingAppender::ptr temp(new CountingAppender);
+        while(!stop.load()){
+            logger->addAppender(temp);
+            logger->delAppender(temp);
+        }
+    }, "snapshot_writer");
+
+    std::vector<Thread::ptr> threads;
+    for(int i = 0; i < 4; ++i){
+        threads.push_back(std::make_shared<Thread>([logger](){
+            for(int j = 0; j < 20000; ++j){
+                LOG_FMT_INFO(logger, "snapshot %d\n", j);
+            }
+        }, "snapshot_" + std::to_string(i)));
+    }
+    for(auto& t : threads){
+        t->join();
+    }
+    stop = true;
+    writer->join();
+    assert(fixed->m_count == 80000);
+
+    Logger::ptr named = CAIZI_GET_LOGGER("snapshot_named");
+    assert(named->getName() == "snapshot_named");
+    assert(CAIZI_GET_LOGGER("snapshot_named") == named);
+    assert(GET_ROOT_LOGGER()->getName() == "global");
+}
+
+// 旧快照只在读取期间被持有：空闲线程缓存过的输出地在删除后立即释放，读取中的快照等读取结束
+void test_snapshot_lifetime(){
+    Logger::ptr logger(new Logger("lifetime"));
+    CountingAppender::ptr appender(new CountingAppender);
+    logger->addAppender(appender);
+
+    Semaphore logged, reading, release, done;
+    Thread::ptr idle = std::make_shared<Thread>([logger, &logged, &done](){
+        LOG_INFO(logger, "cached\n");
+        logged.notify();
+        done.wait();
+    }, "lifetime_idle");
+    logged.wait();
+    assert(appender->m_count == 1);
+    logger->delAppender(appender);
+    assert(appender.use_count() == 1);
+
+    RcuPtr<std::vector<int>> rcu(std::make_shared<const std::vector<int>>(1, 1));
+    std::weak_ptr<const std::vector<int>> old = rcu.load();
+    Thread::ptr reader = std::make_shared<Thread>([&rcu, &reading, &release](){
+        RcuPtr<std::vector<int>>::ReadGuard data(rcu);
+        reading.notify();
+        release.wait();
+        assert(data->size() == 1 && (*data)[0] == 1);
+    }, "lifetime_reader");
+    reading.wait();
+    rcu.store(std::make_shared<const std::vector<int>>(2, 2));
+    assert(!old.expired());
+    release.notify();
+    reader->join();
+    rcu.synchronize();
+    assert(old.expired());
+    {
+        RcuPtr<std::vector<int>>::ReadGuard data(rcu);
+        assert(data->size() == 2);
+    }
+    done.notify();
+    idle->join();
+}
+
+// 有旧快照等待宽限期时，读取方离开临界区不做回收(不加锁)，旧快照由LogTicker在读取结束后回收
+void test_snapshot_reclaim(){
+    RcuPtr<std::vector<int>> rcu(std::make_shared<const std::vector<int>>(1, 1));
+    std::weak_ptr<const std::vector<int>> old = rcu.load();
+    Semaphore reading, release;
+    Thread::ptr holder = std::make_shared<Thread>([&rcu, &reading, &release](){
+        RcuPtr<std::vector<int>>::ReadGuard data(rcu);
+        reading.notify();
+        release.wait();
+    }, "reclaim_holder");
+    reading.wait();
+    rcu.store(std::make_shared<const std::vector<int>>(2, 2));
+    assert(!old.expired() && RcuDomain::Get().getRetiredCount() > 0);
+
+    uint64_t reclaims = RcuDomain::Get().getReclaimCount();
+    std::vector<Thread::ptr> readers;
+    for(int i = 0; i < 4; ++i){
+        readers.push_back(std::make_shared<Thread>([&rcu](){
+            for(int j = 0; j < 20000; ++j){
+                RcuPtr<std::vector<int>>::ReadGuard data(rcu);
+                assert(data->size() == 2);
+            }
+        }, "reclaim_reader_" + std::to_string(i)));
+    }
+    for(auto& t : readers){
+        t->join();
+    }
+    // 80000次读取期间只有LogTicker的周期回收
+    assert(RcuDomain::Get().getReclaimCount() - reclaims < 1000);
+    assert(!old.expired());
+
+    release.notify();
+    holder->join();
+    for(int i = 0; i < 100 && !old.expired(); ++i){
+        usleep(10 * 1000);
+    }
+    assert(old.expired());
+}
+
+// 限流和采样的调用点：被丢弃时不对参数求值，下一秒报告丢弃条数
+void test_rate_limit(){
+    Logger::ptr logger(new Logger("rate"));
+    CountingAppender::ptr counter(new CountingAppender);
+    logger->addAppender(counter);
+
+    int evaluated = 0;
+    auto touch = [&evaluated](){ return ++evaluated; };
+    for(int i = 0; i < 1000; ++i){
+        LOG_SAMPLE_INFO(logger, 10, "sample " + std::to_string(touch()) + "\n");
+    }
+    assert(counter->m_count == 100);
+    assert(evaluated == 100);
+
+    counter->m_count = 0;
+    evaluated = 0;
+    // 从一秒的开始处测试，保证循环落在同一个窗口内
+    while(CoarseClock::NowMS() % 1000 > 100){
+        usleep(1000);
+    }
+    // 同一个调用点
+    auto backend_down = [&](){
+        LOG_FMT_RATE_ERROR(logger, 5, "backend down %d\n", touch());
+    };
+    CaptureAppender::ptr capture(new CaptureAppender);
+    logger->addAppender(capture);
+    for(int i = 0; i < 10000; ++i){
+        backend_down();
+    }
+    assert(counter->m_count == 5);
+    assert(evaluated == 5);
+
+    // 洪峰停止后不再有日志，窗口结束后后台线程仍会输出丢弃报告
+    for(int i = 0; i < 300 && capture->size() < 6; ++i){
+        usleep(10 * 1000);
+    }
+    assert(capture->size() == 6);
+    assert(capture->m_lines[5] == "suppressed 9995 messages\n");
+    // 已经报告过，下一条日志前不再重复
+    backend_down();
+    assert(capture->size() == 7);
+    assert(capture->m_lines[6] == "backend down 6\n");
+
+    // 丢弃报告只出现一次，不论由后台线程还是下一条放行的日志报告
+    while(CoarseClock::NowMS() % 1000 > 100){
+        usleep(1000);
+    }
+    for(int i = 0; i < 10; ++i){
+        backend_down();
+    }
+    size_t before = capture->size();
+    uint64_t now = CoarseClock::NowMS();
+    usleep((1000 - now % 1000 + 5) * 1000);
+    backend_down();
+    for(int i = 0; i < 100 && capture->size() < before + 2; ++i){
+        usleep(10 * 1000);
+    }
+    usleep(50 * 1000);
+    assert(capture->size() == before + 2);
+
+    // 同一个调用点用于不同的日志器，丢弃条数分别报告给各自的日志器
+    Logger::ptr other(new Logger("rate_other"));
+    CaptureAppender::ptr other_capture(new CaptureAppender);
+    other->addAppender(other_capture);
+    auto shared_site = [](Logger::ptr l){
+        LOG_FMT_RATE_ERROR(l, 5, "shared site %s\n", l->getName().c_str());
+    };
+    while(CoarseClock::NowMS() % 1000 > 100){
+        usleep(1000);
+    }
+    before = capture->size();
+    for(int i = 0; i < 100; ++i){
+        shared_site(logger);
+    }
+    for(int i = 0; i < 50; ++i){
+        shared_site(other);
+    }
+    assert(capture->size() == before + 5);
+    assert(other_capture->size() == 0);
+    for(int i = 0; i < 300 && (capture->size() < before + 6 || other_capture->size() < 1); ++i){
+        usleep(10 * 1000);
+    }
+    assert(capture->size() == before + 6);
+    assert(capture->m_lines[before + 5] == "suppressed 95 messages\n");
+    assert(other_capture->size() == 1);
+    assert(other_capture->m_lines[0] == "suppressed 50 messages\n");
+}
+
+static size_t file_size(const std::string& path){
+    struct stat st;
+    return ::stat(path.c_str(), &st) == 0 ? st.st_size : 0;
+}
+
+// 缓冲写出与按大小滚动
+void test_file_appender(){
+    std::string dir = "/tmp/caizi_test_rotate";
+    system(("rm -rf " + dir + " && mkdir -p " + dir).c_str());
+    std::string path = dir + "/rotate.log";
+
+    Logger::ptr logger(new Logger("rotate"));
+    FileLogAppender::ptr appender = std::make_shared<FileLogAppender>(path);
+    appender->setFlushInterval(60 * 1000);
+    logger->addAppender(appender);
+
+    // 普通日志留在缓冲区，ERROR日志立即写出
+    LOG_INFO(logger, "buffered\n");
+    assert(file_size(path) == 0);
+    LOG_ERROR(logger, "urgent\n");
+    assert(file_size(path) > 0);
+
+    appender->setRotateSize(4096);
+    for(int i = 0; i < 1000; ++i){
+        LOG_FMT_INFO(logger, "rotate line %d\n", i);
+    }
+    logger->flush();
+    assert(file_size(path) <= 4096);
+
+    int files = 0;
+    DIR* d = opendir(dir.c_str());
+    while(struct dirent* ent = readdir(d)){
+        if(ent->d_name[0] != '.'){
+            ++files;
+        }
+    }
+    closedir(d);
+    std::cout << "rotated files = " << files << std::endl;
+    assert(files > 1);
+
+    // 没有后续日志时，缓冲的日志也会在flush_interval之后由后台线程写出
+    std::string idle_path = dir + "/idle.log";
+    FileLogAppender::ptr idle = std::make_shared<FileLogAppender>(idle_path);
+    idle->setFlushInterval(100);
+    Logger::ptr idle_logger(new Logger("idle"));
+    idle_logger->addAppender(idle);
+    LOG_INFO(idle_logger, "first\n");
+    LOG_INFO(idle_logger, "trailing\n");
+    size_t size = file_size(idle_path);
+    for(int i = 0; i < 100 && file_size(idle_path) == size; ++i){
+        usleep(10 * 1000);
+    }
+    std::ifstream in(idle_path);
+    std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    assert(content.find("trailing") != std::string::npos);
+}
+
+// 结构化字段按类型输出为JSON行，文本格式用%k输出key=value
+void test_json_appender(){
+    const char* path = "/tmp/caizi_test_json.log";
+    remove(path);
+    Logger::ptr logger(new Logger("json"));
+    logger->addAppender(std::make_shared<JsonLogAppender>(path));
+
+    std::string req_path = "/index \"a\"";
+    LOG_KV_INFO(logger, "request done\n", "path", req_path, "status", 200, "cost_ms", 1.5,
+                "ok", true, "size", (uint64_t)1 << 40);
+    logger->logFields(LogLevel::WARN, "tab\there", "ctl", "\x01");
+    logger->flush();
+
+    std::ifstream in(path);
+    std::string line1;
+    std::string line2;
+    std::getline(in, line1);
+    std::getline(in, line2);
+    std::cout << line1 << std::endl << line2 << std::endl;
+    assert(line1.find("\"level\":\"INFO\"") != std::string::npos);
+    assert(line1.find("\"msg\":\"request done\",\"path\":\"/index \\\"a\\\"\",\"status\":200,"
+                      "\"cost_ms\":1.5,\"ok\":true,\"size\":1099511627776}") != std::string::npos);
+    assert(line2.find("\"msg\":\"tab\\there\",\"ctl\":\"\\u0001\"}") != std::string::npos);
+
+    // 超出行缓冲区时截断并标记，仍是完整的一行JSON
+    JsonLogFormatter json;
+    LogEventGuard long_ev(LogLevel::INFO, __FILE__, __LINE__);
+    std::string quotes(CAIZI_LOG_CONTENT_SIZE, '"');
+    long_ev->setContent(quotes);
+    std::string field(200, '\x01');
+    long_ev->setFields("a", field, "b", field, "c", false, "d", 1.0);
+    std::string line = json.format(LogLevel::INFO, *long_ev);
+    assert(line.size() <= CAIZI_LOG_LINE_SIZE);
+    assert(line.find("\"c\":false,\"d\":1}") != std::string::npos);
+    LogEventGuard huge_ev(LogLevel::INFO, __FILE__, __LINE__);
+    huge_ev->setContent(quotes);
+    for(int i = 0; i < 10; ++i){
+        huge_ev->addField("k" + std::to_string(i), std::string(20, '\x02'));
+    }
+    LogBuffer buffer;
+    buffer.append(std::string(CAIZI_LOG_LINE_SIZE - 800, ' '));
+    json.format(buffer, LogLevel::INFO, *huge_ev);
+    std::string_view tail = buffer.view().substr(CAIZI_LOG_LINE_SIZE - 800);
+    assert(tail.size() > 100 && tail.substr(tail.size() - 19) == ",\"truncated\":true}\n");
+    assert(tail.find("\"msg\":\"\\\"") != std::string::npos);
+
+    LogEventGuard ev(LogLevel::INFO, __FILE__, __LINE__);
+    ev->setFields("a", 1, "b", "x y", "c", -2, "d", true);
+    LogFormatter formatter("%m|%k");
+    assert(formatter.format(LogLevel::INFO, *ev) == "|a=1 b=x y c=-2 d=true");
+    static constexpr char kPattern[] = "%m|%k";
+    StaticLogFormatter<kPattern> compiled;
+    assert(compiled.format(LogLevel::INFO, *ev) == "|a=1 b=x y c=-2 d=true");
+
+    // 字段空间不足时丢弃放不下的字段，已写入的字段保持完整
+    std::string big(200, 'x');
+    ev->setFields("big", big, "next", big, "n", 1);
+    LogArgReader reader(ev->getFields());
+    LogArgValue val;
+    size_t count = 0;
+    while(reader.next(val)){
+        ++count;
+    }
+    assert(count == 4);
+}
+
+// 二进制输出地写入的事件可以解码回相同的文本
+void test_binary_appender(){
+    std::string dir = "/tmp/caizi_test_binary";
+    system(("rm -rf " + dir + " && mkdir -p " + dir).c_str());
+    std::string base = dir + "/app.blog";
+
+    Logger::ptr logger(new Logger("binary"));
+    BinaryLogAppender::ptr appender = std::make_shared<BinaryLogAppender>(base, LogLevel::DEBUG, 4096);
+    logger->addAppender(appender);
+
+    std::vector<std::string> expect;
+    char buf[256];
+    for(int i = 0; i < 100; ++i){
+        LOG_FMT_INFO(logger, "req %d %-6s %5.2f %llu %x %c|", i, "path", i * 0.5, 1ull << 40, 255, 'z');
+        snprintf(buf, sizeof(buf), "req %d %-6s %5.2f %llu %x %c|", i, "path", i * 0.5, 1ull << 40, 255, 'z');
+        expect.push_back(buf);
+        LOG_WARN(logger, "plain " + std::to_string(i));
+        expect.push_back("plain " + std::to_string(i));
+    }
+    std::string segment = appender->getSegmentPath();
+    appender.reset();
+    logger->clearAppedners();
+
+    // 4KB的文件段放不下200条日志，会切换多个文件段
+    size_t index = 0;
+    for(int seg = 0; ; ++seg){
+        snprintf(buf, sizeof(buf), "%s.%06d", base.c_str(), seg);
+        BinaryLogReader reader;
+        if(!reader.open(buf)){
+            assert(seg > 1);
+            break;
+        }
+        LogEvent ev;
+        while(reader.next(ev)){
+            assert(index < expect.size());
+            assert(ev.getContent() == expect[index]);
+            assert(strstr(ev.getFilename(), "test_log.cpp"));
+            ++index;
+        }
+    }
+    std::cout << "binary events decoded = " << index << std::endl;
+    assert(index == expect.size());
+}
+
 int main(){
 
     test1();
+    test_async();
+    test_zero_alloc();
+    test_level_check();
+    test_format_args();
+    test_static_formatter();
+    test_datetime();
+    test_async_unowned();
+    test_appender_snapshot();
+    test_snapshot_lifetime();
+    test_snapshot_reclaim();
+    test_rate_limit();
+    test_file_appender();
+    test_binary_appender();
+    test_json_appender();
     auto logger = GET_ROOT_LOGGER();
     LOG_INFO(logger, "test\n");
     return 0;
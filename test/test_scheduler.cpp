@@ -0,0 +1,119 @@
+#include "scheduler.h"
+#include "log.h"
+#include <assert.h>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <unistd.h>
+
+static caizi::Logger::ptr g_logger = CAIZI_GET_ROOT_LOGGER();
+
+// 大量任务分散到多个工作线程执行，任务里再调度的任务由其他线程窃取
+void test_many_tasks(){
+    std::atomic<int> count{0};
+    std::mutex mutex;
+    std::set<int> threads;
+    caizi::Scheduler sc(4, false, "many");
+    sc.start();
+    for(int i = 0; i < 100; ++i){
+        sc.schedule([&](){
+            for(int j = 0; j < 100; ++j){
+                caizi::Scheduler::GetThis()->schedule([&](){
+                    ++count;
+                    usleep(10);
+                    std::lock_guard<std::mutex> lock(mutex);
+                    threads.insert(caizi::Thread::GetThisId());
+                });
+            }
+            ++count;
+        });
+    }
+    sc.stop();
+    assert(count == 100 * 101);
+    assert(threads.size() > 1);
+}
+
+// 协程让出后继续执行，READY的协程重新调度，HOLD的协程由其他任务唤醒
+void test_yield(){
+    std::atomic<int> steps{0};
+    caizi::Scheduler sc(2, false, "yield");
+    sc.start();
+    caizi::Fiber::ptr holder;
+    std::atomic<bool> parked{false};
+    sc.schedule([&](){
+        ++steps;
+        caizi::Fiber::YieldToReady();
+        ++steps;
+        holder = caizi::Fiber::GetThis();
+        parked = true;
+        caizi::Fiber::YieldToHole();
+        ++steps;
+    });
+    while(!parked){
+        usleep(100);
+    }
+    // 等协程真正让出后再次调度它
+    usleep(1000);
+    assert(steps == 2);
+    sc.schedule(holder);
+    holder.reset();
+    sc.stop();
+    assert(steps == 3);
+}
+
+// 指定线程的任务只在该线程执行，switchTo切换协程所在线程
+void test_pinned(){
+    caizi::Scheduler sc(3, false, "pinned");
+    sc.start();
+    std::atomic<int> target{-1};
+    sc.schedule([&](){ target = caizi::Thread::GetThisId(); });
+    while(target == -1){
+        usleep(100);
+    }
+    std::atomic<int> wrong{0};
+    std::atomic<int> done{0};
+    for(int i = 0; i < 200; ++i){
+        sc.schedule([&](){
+            if(caizi::Thread::GetThisId() != target){
+                ++wrong;
+            }
+            ++done;
+        }, target);
+    }
+    sc.schedule([&](){
+        caizi::Scheduler::GetThis()->switchTo(target);
+        if(caizi::Thread::GetThisId() != target){
+            ++wrong;
+        }
+        ++done;
+    });
+    sc.stop();
+    assert(done == 201);
+    assert(wrong == 0);
+}
+
+// use_caller：调用线程在stop中参与调度
+void test_use_caller(){
+    std::atomic<int> count{0};
+    std::atomic<bool> caller_ran{false};
+    int caller = caizi::Thread::GetThisId();
+    caizi::Scheduler sc(2, true, "caller");
+    sc.start();
+    for(int i = 0; i < 1000; ++i){
+        sc.schedule([&](){ ++count; });
+    }
+    sc.schedule([&](){ caller_ran = caizi::Thread::GetThisId() == caller; }, caller);
+    sc.stop();
+    assert(count == 1000);
+    assert(caller_ran);
+    assert(caizi::Scheduler::GetThis() == &sc);
+}
+
+int main(){
+    test_many_tasks();
+    test_yield();
+    test_pinned();
+    test_use_caller();
+    LOG_INFO(g_logger, "test_scheduler ok\n");
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include "simd_codec.h"
+#include "bytearray.h"
+#include "log.h"
+#include "random_values.h"
+#include <assert.h>
+#include <random>
+#include <vector>
+
+static caizi::Logger::ptr g_logger = CAIZI_GET_ROOT_LOGGER();
+
+static std::mt19937_64 s_rng(42);
+
+// 各种长度和非对齐的起始位置，结果和逐个byteswap相同
+template<class T>
+void test_byteswap(){
+    std::vector<T> values = caizi::RandomValues<T>(s_rng, 200);
+    for(size_t offset = 0; offset < 3; ++offset){
+        for(size_t count = 0; count + offset <= values.size(); count += 7){
+            const T* src = values.data() + offset;
+            std::vector<T> dst(count + 1, 0);
+            caizi::ByteswapArray(dst.data(), src, count);
+            for(size_t i = 0; i < count; ++i){
+                assert(dst[i] == caizi::byteswap(src[i]));
+            }
+            // 不写出范围之外
+            assert(dst[count] == 0);
+            // 原地转换
+            std::vector<T> inplace(src, src + count);
+            caizi::ByteswapArray(inplace.data(), inplace.data(), count);
+            assert(inplace == std::vector<T>(dst.begin(), dst.begin() + count));
+            caizi::ByteswapArrayOnLittleEndian(inplace.data(), inplace.data(), count);
+            for(size_t i = 0; i < count; ++i){
+                assert(inplace[i] == caizi::byteswapOnLitterEndian(dst[i]));
+            }
+        }
+    }
+}
+
+// 编码结果和ByteArray逐个写入的字节相同，解码后和原值相同
+template<class T>
+void test_varint_values(const std::vector<T>& values, size_t max_size){
+    std::vector<uint8_t> buf(values.size() * max_size + 1, 0xcc);
+    size_t len = caizi::VarintEncodeArray(values.data(), values.size(), buf.data());
+    caizi::ByteArray ba;
+    for(auto v : values){
+        if(sizeof(T) == 4){
+            ba.writeUint32(v);
+        }else{
+            ba.writeUint64(v);
+        }
+    }
+    ba.setPosition(0);
+    assert(ba.toString() == std::string((char*)buf.data(), len));
+
+    // 后面还有其它数据时只消耗需要的字节
+    buf[len] = 0x01;
+    std::vector<T> out(values.size() + 1, 7);
+    assert(caizi::VarintDecodeArray(buf.data(), len + 1, out.data(), values.size()) == (int64_t)len);
+    assert(std::vector<T>(out.begin(), out.begin() + values.size()) == values);
+    assert(out[values.size()] == 7);
+
+    // 数据不足
+    if(!values.empty()){
+        assert(caizi::VarintDecodeArray(buf.data(), len - 1, out.data(), values.size()) == -1);
+    }
+}
+
+template<class T>
+void test_varint(size_t max_size){
+    for(size_t count : {0, 1, 3, 4, 5, 17, 64, 1000}){
+        test_varint_values(caizi::RandomValues<T>(s_rng, count), max_size);
+        // 全部是单字节的值
+        std::vector<T> small;
+        for(size_t i = 0; i < count; ++i){
+            small.push_back(s_rng() % 128);
+        }
+        test_varint_values(small, max_size);
+    }
+    // 各长度的边界值
+    std::vector<T> edges;
+    for(int bits = 0; bits <= (int)sizeof(T) * 8; ++bits){
+        T v = bits == (int)sizeof(T) * 8 ? (T)~(T)0 : (T)(((T)1 << bits) - 1);
+        edges.push_back(v);
+        edges.push_back(v + 1);
+    }
+    test_varint_values(edges, max_size);
+
+    // 超过最大长度
+    std::vector<uint8_t> bad(max_size + 1 + 32, 0x80);
+    bad[max_size] = 0x01;
+    T out[4];
+    assert(caizi::VarintDecodeArray(bad.data(), bad.size(), out, 1) == -1);
+    bad[max_size - 1] = 0x01;
+    assert(caizi::VarintDecodeArray(bad.data(), bad.size(), out, 1) == (int64_t)max_size);
+}
+
+int main(){
+    caizi::SimdLevel cpu = caizi::GetCpuSimdLevel();
+    assert(caizi::GetSimdLevel() == cpu);
+    LOG_FMT_INFO(g_logger, "cpu simd level: %s\n", caizi::SimdLevelToString(cpu));
+    for(int level = 0; level <= (int)cpu; ++level){
+        assert(caizi::SetSimdLevel((caizi::SimdLevel)level) == (caizi::SimdLevel)level);
+        test_byteswap<uint16_t>();
+        test_byteswap<uint32_t>();
+        test_byteswap<uint64_t>();
+        test_varint<uint32_t>(caizi::kMaxVarint32Size);
+        test_varint<uint64_t>(caizi::kMaxVarint64Size);
+    }
+    // 不超过CPU支持的级别
+    assert(caizi::SetSimdLevel(caizi::SimdLevel::AVX2) == cpu);
+    LOG_INFO(g_logger, "test_simd_codec ok\n");
+    return 0;
+}
@@ -0,0 +1,241 @@
+#include "socket.h"
+#include "config.h"
+#include "iomanager.h"
+#include "log.h"
+#include <assert.h>
+#include <atomic>
+#include <fcntl.h>
+#include <netinet/tcp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+
+static caizi::Logger::ptr g_logger = CAIZI_GET_ROOT_LOGGER();
+
+static caizi::Address::ptr Loopback(uint16_t port = 0){
+    return caizi::Address::ptr(new caizi::IPv4Address(INADDR_LOOPBACK, port));
+}
+
+// 监听回环地址，返回实际绑定的地址
+static caizi::Socket::ptr Listen(caizi::Address::ptr& addr){
+    caizi::Socket::ptr sock = caizi::Socket::CreateTCPSocket();
+    assert(sock->bind(Loopback()));
+    assert(sock->listen());
+    addr = sock->getLocalAddress();
+    assert(std::dynamic_pointer_cast<caizi::IPv4Address>(addr)->get_port() != 0);
+    return sock;
+}
+
+// 在协程中建立一对相连的Socket
+static void ConnectPair(caizi::Socket::ptr& client, caizi::Socket::ptr& server){
+    caizi::Address::ptr addr;
+    caizi::Socket::ptr listener = Listen(addr);
+    client = caizi::Socket::createTCP(addr);
+    assert(client->connect(addr));
+    server = listener->accept();
+    assert(server);
+}
+
+// 读满len字节
+static std::string RecvAll(caizi::Socket::ptr sock, size_t len){
+    std::string data(len, '\0');
+    size_t got = 0;
+    while(got < len){
+        int n = sock->recv(&data[got], len - got);
+        assert(n > 0);
+        got += n;
+    }
+    return data;
+}
+
+// 地址、选项、iovec收发
+void test_tcp(const std::string& backend){
+    caizi::Config::Lookup<std::string>("iomanager.backend")->setValue(backend);
+    std::atomic<bool> finished{false};
+    {
+        caizi::IOManager iom(1, false, "tcp");
+        iom.schedule([&](){
+            caizi::Socket::ptr client, server;
+            ConnectPair(client, server);
+            assert(client->isValid() && client->isConnect());
+            assert(client->getError() == 0);
+            assert(*client->getLocalAddress() == *server->getRemoteAddress());
+            assert(client->getRemoteAddress()->toString() == server->getLocalAddress()->toString());
+            assert(client->toString().find("remote_address=127.0.0.1") != std::string::npos);
+
+            int nodelay = 0;
+            assert(server->getOption(IPPROTO_TCP, TCP_NODELAY, nodelay) && nodelay);
+            // 框架设置的非阻塞对用户不可见
+            assert(!(fcntl(server->getSocket(), F_GETFL) & O_NONBLOCK));
+
+            char head[] = "hello ";
+            char body[] = "world";
+            iovec out[2] = {{head, 6}, {body, 5}};
+            assert(client->send(out, 2) == 11);
+            char a[4] = {0}, b[8] = {0};
+            iovec in[2] = {{a, 3}, {b, 8}};
+            assert(server->recv(in, 2, MSG_WAITALL) == 11);
+            assert(std::string(a, 3) == "hel" && std::string(b, 8) == "lo world");
+
+            // 没有数据时按接收超时返回
+            server->setRecvTimeout(50);
+            assert(server->getRecvTimeout() == 50);
+            char c;
+            assert(server->recv(&c, 1) == -1 && errno == ETIMEDOUT);
+            server->setRecvTimeout(-1);
+            assert(server->getRecvTimeout() == -1);
+
+            client->close();
+            assert(!client->isValid());
+            assert(server->recv(&c, 1) == 0);
+            finished = true;
+        });
+    }
+    assert(finished);
+    caizi::Config::Lookup<std::string>("iomanager.backend")->setValue("epoll");
+}
+
+// UDP的sendTo/recvFrom
+void test_udp(){
+    std::atomic<bool> finished{false};
+    {
+        caizi::IOManager iom(1, false, "udp");
+        iom.schedule([&](){
+            caizi::Socket::ptr receiver = caizi::Socket::CreateUDPSocket();
+            assert(receiver->bind(Loopback()));
+            caizi::Socket::ptr sender = caizi::Socket::CreateUDPSocket();
+            assert(sender->bind(Loopback()));
+            assert(sender->sendTo("ping", 4, receiver->getLocalAddress()) == 4);
+            char buf[16] = {0};
+            caizi::Address::ptr from(new caizi::IPv4Address());
+            assert(receiver->recvFrom(buf, sizeof(buf), from) == 4);
+            assert(std::string(buf) == "ping");
+            assert(from->toString() == sender->getLocalAddress()->toString());
+            finished = true;
+        });
+    }
+    assert(finished);
+}
+
+// Unix域套接字(抽象地址)
+void test_unix(){
+    std::atomic<bool> finished{false};
+    {
+        caizi::IOManager iom(1, false, "unix");
+        iom.schedule([&](){
+            std::string path = std::string(1, '\0') + "caizi_test_socket_" + std::to_string(getpid());
+            caizi::Address::ptr addr(new caizi::UnixAddress(path));
+            caizi::Socket::ptr listener(new caizi::Socket(caizi::Socket::Unix, caizi::Socket::TCP));
+            assert(listener->bind(addr));
+            assert(listener->listen());
+            assert(std::static_pointer_cast<caizi::UnixAddress>(listener->getLocalAddress())->getPath() == path);
+            caizi::Socket::ptr client(new caizi::Socket(caizi::Socket::Unix, caizi::Socket::TCP));
+            assert(client->connect(addr));
+            caizi::Socket::ptr server = listener->accept();
+            assert(server);
+            assert(client->send("unix", 4) == 4);
+            assert(RecvAll(server, 4) == "unix");
+            finished = true;
+        });
+    }
+    assert(finished);
+}
+
+// sendFile：普通文件走sendfile，管道走splice
+void test_send_file(){
+    char path[] = "/tmp/caizi_test_socket_XXXXXX";
+    int file = mkstemp(path);
+    assert(file != -1);
+    unlink(path);
+    std::string content;
+    for(int i = 0; i < 100000; ++i){
+        content.push_back('a' + i % 26);
+    }
+    assert(write(file, content.data(), content.size()) == (ssize_t)content.size());
+    int pipefd[2];
+    assert(!pipe(pipefd));
+
+    std::atomic<bool> finished{false};
+    {
+        caizi::IOManager iom(1, false, "sendfile");
+        iom.schedule([&](){
+            caizi::Socket::ptr client, server;
+            ConnectPair(client, server);
+            caizi::IOManager::GetThis()->schedule([&, server](){
+                assert(server->sendFile(file, 10, content.size() - 10) == (int64_t)content.size() - 10);
+                // 超出文件末尾时返回实际发送的字节数
+                assert(server->sendFile(file, content.size() - 5, 100) == 5);
+                assert(server->sendFile(pipefd[0], -1, 4) == 4);
+            });
+            assert(RecvAll(client, content.size() - 10) == content.substr(10));
+            assert(RecvAll(client, 5) == content.substr(content.size() - 5));
+            // 管道稍后才有数据
+            usleep(10 * 1000);
+            assert(write(pipefd[1], "pipe", 4) == 4);
+            assert(RecvAll(client, 4) == "pipe");
+            finished = true;
+        });
+    }
+    assert(finished);
+    close(file);
+    close(pipefd[0]);
+    close(pipefd[1]);
+}
+
+// MSG_ZEROCOPY：对端读完后所有发送都收到完成通知
+void test_zero_copy(){
+    std::atomic<bool> finished{false};
+    {
+        caizi::IOManager iom(1, false, "zerocopy");
+        iom.schedule([&](){
+            caizi::Socket::ptr client, server;
+            ConnectPair(client, server);
+            if(!server->setZeroCopy(true)){
+                LOG_INFO(g_logger, "SO_ZEROCOPY not supported, skip\n");
+                finished = true;
+                return;
+            }
+            assert(server->isZeroCopy());
+            const size_t block = 64 * 1024;
+            const int count = 8;
+            std::vector<char> data(block, 'z');
+            caizi::IOManager::GetThis()->schedule([client, block, count](){
+                std::string all = RecvAll(client, block * count + 3);
+                assert(all == std::string(block * count, 'z') + "end");
+            });
+            uint32_t seq = 0;
+            for(int i = 0; i < count; ++i){
+                size_t sent = 0;
+                while(sent < block){
+                    int n = server->sendZeroCopy(&data[sent], block - sent, &seq);
+                    assert(n > 0);
+                    sent += n;
+                }
+            }
+            assert(seq >= (uint32_t)count);
+            // 小块数据直接复制发送，不增加序号
+            uint32_t small_seq = 0;
+            assert(server->sendZeroCopy("end", 3, &small_seq) == 3);
+            assert(small_seq == seq);
+            assert(server->waitZeroCopy(seq, 5000));
+            assert(server->reapZeroCopy() == seq);
+            assert(server->getZeroCopyCopied() <= seq);
+            finished = true;
+        });
+    }
+    assert(finished);
+}
+
+int main(){
+    test_tcp("epoll");
+    test_tcp("io_uring");
+    test_udp();
+    test_unix();
+    test_send_file();
+    test_zero_copy();
+    LOG_INFO(g_logger, "test_socket ok\n");
+    return 0;
+}
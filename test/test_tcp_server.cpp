@@ -0,0 +1,213 @@
+#include "tcp_server.h"
+#include "log.h"
+#include "thread.h"
+#include <assert.h>
+#include <atomic>
+#include <map>
+#include <set>
+#include <string.h>
+#include <unistd.h>
+
+static caizi::Logger::ptr g_logger = CAIZI_GET_ROOT_LOGGER();
+
+// 回显服务器，记录每个连接在哪个线程上处理，以及处理过程中是否换过线程
+class EchoServer : public caizi::TcpServer{
+public:
+    typedef std::shared_ptr<EchoServer> ptr;
+    EchoServer(caizi::IOManager* worker): caizi::TcpServer(worker, "echo"){}
+
+    std::map<pid_t, int> getHandled(){
+        caizi::ScopeLock lock(&m_mutex);
+        return m_handled;
+    }
+    std::set<pid_t> getAcceptThreads(){
+        caizi::ScopeLock lock(&m_mutex);
+        return m_acceptThreads;
+    }
+    int getMigrated() const{ return m_migrated; }
+    int getRounds() const{ return m_rounds; }
+
+protected:
+    void startAccept(caizi::Socket::ptr sock) override{
+        {
+            caizi::ScopeLock lock(&m_mutex);
+            m_acceptThreads.insert(caizi::Thread::GetThisId());
+        }
+        caizi::TcpServer::startAccept(sock);
+    }
+
+    void handleClient(caizi::Socket::ptr client) override{
+        pid_t thread = caizi::Thread::GetThisId();
+        {
+            caizi::ScopeLock lock(&m_mutex);
+            ++m_handled[thread];
+        }
+        char buf[256];
+        while(true){
+            int n = client->recv(buf, sizeof(buf));
+            if(caizi::Thread::GetThisId() != thread){
+                ++m_migrated;
+            }
+            if(n <= 0){
+                break;
+            }
+            assert(client->send(buf, n) == n);
+            if(caizi::Thread::GetThisId() != thread){
+                ++m_migrated;
+            }
+            ++m_rounds;
+        }
+    }
+
+private:
+    caizi::Mutex m_mutex;
+    std::map<pid_t, int> m_handled;
+    std::set<pid_t> m_acceptThreads;
+    std::atomic<int> m_migrated{0};
+    std::atomic<int> m_rounds{0};
+};
+
+// 不在IOManager中的阻塞客户端，在一个连接上往返rounds次
+static bool Echo(caizi::Address::ptr addr, const std::string& msg, int rounds = 1){
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    assert(fd != -1);
+    if(connect(fd, addr->getAddr(), addr->getAddrLen())){
+        close(fd);
+        return false;
+    }
+    for(int i = 0; i < rounds; ++i){
+        // 服务器停止时已经完成握手的连接会被重置
+        if(write(fd, msg.data(), msg.size()) != (ssize_t)msg.size()){
+            close(fd);
+            return false;
+        }
+        std::string reply(msg.size(), '\0');
+        size_t got = 0;
+        while(got < msg.size()){
+            ssize_t n = read(fd, &reply[got], msg.size() - got);
+            if(n <= 0){
+                break;
+            }
+            got += n;
+        }
+        if(reply != msg){
+            close(fd);
+            return false;
+        }
+    }
+    close(fd);
+    return true;
+}
+
+// 每个工作线程一个SO_REUSEPORT监听套接字，连接分散到多个线程并在接受它的线程上处理
+void test_reuse_port(){
+    const size_t workers = 4;
+    const int clients = 200;
+    caizi::IOManager iom(workers, false, "server");
+    EchoServer::ptr server(new EchoServer(&iom));
+    assert(server->bind(caizi::Address::ptr(new caizi::IPv4Address(INADDR_LOOPBACK, 0))));
+    assert(server->getSocks().size() == workers);
+    caizi::Address::ptr addr = server->getAddresses()[0];
+    for(auto& sock : server->getSocks()){
+        // 端口为0时所有套接字共用同一个端口
+        assert(sock->getLocalAddress()->toString() == addr->toString());
+        int reuse = 0;
+        assert(sock->getOption(SOL_SOCKET, SO_REUSEPORT, reuse) && reuse);
+    }
+    assert(server->start());
+    for(int i = 0; i < clients; ++i){
+        assert(Echo(addr, "hello " + std::to_string(i)));
+    }
+    // 最后一个连接关闭前它的处理协程可能还没有记录，等待全部记录
+    while(true){
+        int total = 0;
+        for(auto& it : server->getHandled()){
+            total += it.second;
+        }
+        if(total == clients){
+            break;
+        }
+        usleep(1000);
+    }
+    std::set<pid_t> accept_threads = server->getAcceptThreads();
+    assert(accept_threads.size() == workers);
+    std::map<pid_t, int> handled = server->getHandled();
+    assert(handled.size() > 1);
+    for(auto& it : handled){
+        // 连接只在监听线程上处理
+        assert(accept_threads.count(it.first));
+        LOG_FMT_INFO(g_logger, "thread %d handled %d\n", it.first, it.second);
+    }
+    LOG_INFO(g_logger, server->toString());
+
+    server->stop();
+    assert(server->isStop());
+    assert(server->getSocks().empty());
+    // 监听套接字在工作线程上关闭后不再接受连接
+    while(Echo(addr, "x")){
+        usleep(1000);
+    }
+}
+
+// 多个客户端线程并发地在每个连接上多次往返，处理协程每次挂起后都回到原来的线程
+void test_pinned_connections(){
+    const size_t workers = 4;
+    const int client_threads = 8;
+    const int connections = 25;
+    const int rounds = 10;
+    caizi::IOManager iom(workers, false, "pinned");
+    EchoServer::ptr server(new EchoServer(&iom));
+    assert(server->bind(caizi::Address::ptr(new caizi::IPv4Address(INADDR_LOOPBACK, 0))));
+    assert(server->start());
+    caizi::Address::ptr addr = server->getAddresses()[0];
+    std::vector<caizi::Thread::ptr> threads;
+    for(int i = 0; i < client_threads; ++i){
+        threads.push_back(std::make_shared<caizi::Thread>([addr, i](){
+            for(int j = 0; j < connections; ++j){
+                assert(Echo(addr, "round trip " + std::to_string(i) + " " + std::to_string(j), rounds));
+            }
+        }, "client_" + std::to_string(i)));
+    }
+    for(auto& t : threads){
+        t->join();
+    }
+    while(server->getRounds() != client_threads * connections * rounds){
+        usleep(1000);
+    }
+    assert(server->getMigrated() == 0);
+    server->stop();
+}
+
+// use_caller时调用线程不监听，绑定失败时返回失败的地址
+void test_use_caller(){
+    caizi::IOManager iom(3, true, "caller");
+    EchoServer::ptr server(new EchoServer(&iom));
+    std::vector<caizi::Address::ptr> addrs;
+    std::vector<caizi::Address::ptr> fails;
+    addrs.push_back(caizi::Address::ptr(new caizi::IPv4Address(INADDR_LOOPBACK, 0)));
+    assert(server->bind(addrs, fails));
+    assert(fails.empty());
+    assert(server->getSocks().size() == 2);
+    assert(server->start());
+    caizi::Address::ptr addr = server->getAddresses()[0];
+    for(int i = 0; i < 20; ++i){
+        assert(Echo(addr, "caller"));
+    }
+    server->stop();
+
+    EchoServer::ptr bad(new EchoServer(&iom));
+    addrs.clear();
+    // 不是本机的地址
+    addrs.push_back(caizi::Address::ptr(new caizi::IPv4Address(0x0afffffe, 0)));
+    assert(!bad->bind(addrs, fails));
+    assert(fails.size() == 1);
+    assert(bad->getSocks().empty());
+}
+
+int main(){
+    test_reuse_port();
+    test_pinned_connections();
+    test_use_caller();
+    LOG_INFO(g_logger, "test_tcp_server ok\n");
+    return 0;
+}
@@ -0,0 +1,206 @@
+#include "iomanager.h"
+#include "config.h"
+#include "log.h"
+#include "timer.h"
+#include <assert.h>
+#include <atomic>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+static caizi::Logger::ptr g_logger = CAIZI_GET_ROOT_LOGGER();
+
+// 允许的触发延迟
+static const uint64_t SLACK_MS = 100;
+
+class TestTimerManager : public caizi::TimerManager{
+public:
+    std::atomic<int> front{0};
+protected:
+    void onTimerInsertedAtFront() override{ ++front; }
+};
+
+// 不经过IOManager直接检查时间轮的添加、取消和下一次超时
+void test_manager(){
+    TestTimerManager manager;
+    assert(!manager.hasTimer());
+    assert(manager.getNextTimer() == ~0ull);
+
+    // 位于不同层的定时器
+    auto t1 = manager.addTimer(20000, [](){});
+    assert(manager.front == 1);
+    uint64_t next = manager.getNextTimer();
+    assert(next > 0 && next <= 20000);
+    auto t2 = manager.addTimer(100, [](){});
+    assert(manager.front == 2);
+    assert(manager.getNextTimer() <= 100);
+    // 比等待中的超时晚，不需要通知
+    auto t3 = manager.addTimer(5000, [](){});
+    assert(manager.front == 2);
+
+    assert(t2->cancel());
+    assert(!t2->cancel());
+    assert(t1->cancel());
+    assert(t3->cancel());
+    assert(!manager.hasTimer());
+    assert(manager.getNextTimer() == ~0ull);
+
+    // 到期的回调
+    std::atomic<int> fired{0};
+    manager.addTimer(0, [&](){ ++fired; });
+    manager.addTimer(30, [&](){ ++fired; });
+    usleep(1000);
+    std::vector<std::function<void()>> cbs;
+    manager.listExpiredCb(cbs);
+    assert(cbs.size() == 1);
+    usleep(40 * 1000);
+    manager.listExpiredCb(cbs);
+    assert(cbs.size() == 2);
+    for(auto& cb : cbs){
+        cb();
+    }
+    assert(fired == 2);
+    assert(!manager.hasTimer());
+
+    // 大量定时器，取消一半，剩下的全部到期
+    std::vector<caizi::Timer::ptr> timers;
+    const int count = 100000;
+    for(int i = 0; i < count; ++i){
+        timers.push_back(manager.addTimer(i % 700, [&](){ ++fired; }));
+    }
+    for(int i = 0; i < count; i += 2){
+        assert(timers[i]->cancel());
+    }
+    fired = 0;
+    cbs.clear();
+    uint64_t start = caizi::TimerManager::NowMS();
+    while(manager.hasTimer()){
+        assert(caizi::TimerManager::NowMS() - start < 700 + SLACK_MS * 10);
+        usleep(5000);
+        manager.listExpiredCb(cbs);
+    }
+    for(auto& cb : cbs){
+        cb();
+    }
+    assert(fired == count / 2);
+}
+
+// 在IOManager中触发，跨越第0层的定时器经过级联后按时触发
+void test_fire(){
+    std::vector<uint64_t> delays = {1, 10, 50, 255, 256, 300, 700};
+    std::vector<std::atomic<uint64_t>> fired(delays.size());
+    uint64_t start = caizi::TimerManager::NowMS();
+    {
+        caizi::IOManager iom(2, false, "timer");
+        for(size_t i = 0; i < delays.size(); ++i){
+            fired[i] = 0;
+            iom.addTimer(delays[i], [&, i](){
+                fired[i] = caizi::TimerManager::NowMS();
+            });
+        }
+    }
+    for(size_t i = 0; i < delays.size(); ++i){
+        uint64_t elapsed = fired[i] - start;
+        LOG_FMT_INFO(g_logger, "timer %lu ms fired after %lu ms\n", delays[i], elapsed);
+        assert(fired[i] && elapsed >= delays[i] && elapsed <= delays[i] + SLACK_MS);
+    }
+}
+
+// 取消、循环、条件定时器、重置
+void test_cancel_recurring_condition(){
+    std::atomic<int> cancelled{0};
+    std::atomic<int> recurring{0};
+    std::atomic<int> dead{0};
+    std::atomic<int> alive{0};
+    std::atomic<uint64_t> reset_at{0};
+    uint64_t start = caizi::TimerManager::NowMS();
+    {
+        caizi::IOManager iom(2, false, "timer");
+        auto timer = iom.addTimer(50, [&](){ ++cancelled; });
+        assert(timer->cancel());
+
+        caizi::Timer::ptr rtimer;
+        rtimer = iom.addTimer(10, [&](){
+            if(++recurring == 5){
+                rtimer->cancel();
+            }
+        }, true);
+
+        std::shared_ptr<int> owner_dead = std::make_shared<int>(0);
+        std::shared_ptr<int> owner_alive = std::make_shared<int>(0);
+        iom.addConditionTimer(20, [&](){ ++dead; }, owner_dead);
+        iom.addConditionTimer(20, [&](){ ++alive; }, owner_alive);
+        owner_dead.reset();
+
+        auto long_timer = iom.addTimer(5000, [&](){
+            reset_at = caizi::TimerManager::NowMS();
+        });
+        assert(long_timer->reset(30, true));
+        usleep(50 * 1000);
+    }
+    assert(cancelled == 0);
+    assert(recurring == 5);
+    assert(dead == 0);
+    assert(alive == 1);
+    assert(reset_at && reset_at - start < 30 + SLACK_MS);
+}
+
+// 带超时的IO在两种后端上都以ETIMEDOUT失败
+void test_io_timeout(const std::string& backend){
+    caizi::Config::Lookup<std::string>("iomanager.backend")->setValue(backend);
+    int fds[2];
+    assert(!socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds));
+    int listenfd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    // 抽象命名空间
+    snprintf(addr.sun_path + 1, sizeof(addr.sun_path) - 1, "caizi_test_timer_%d", getpid());
+    socklen_t len = offsetof(sockaddr_un, sun_path) + 1 + strlen(addr.sun_path + 1);
+    assert(!bind(listenfd, (sockaddr*)&addr, len));
+    assert(!listen(listenfd, 16));
+
+    std::atomic<int> recv_error{0};
+    std::atomic<int> accept_error{0};
+    std::atomic<uint64_t> recv_elapsed{0};
+    std::atomic<int> received{0};
+    {
+        caizi::IOManager iom(2, false, "io_timeout");
+        iom.schedule([&](){
+            char buf[8];
+            uint64_t start = caizi::TimerManager::NowMS();
+            ssize_t n = caizi::IOManager::Recv(fds[0], buf, sizeof(buf), 0, 50);
+            recv_error = n < 0 ? errno : 0;
+            recv_elapsed = caizi::TimerManager::NowMS() - start;
+            // 超时之后同一个fd可以继续使用
+            assert(write(fds[1], "x", 1) == 1);
+            received = caizi::IOManager::Recv(fds[0], buf, sizeof(buf), 0, 1000);
+        });
+        iom.schedule([&](){
+            int rt = caizi::IOManager::Accept(listenfd, nullptr, nullptr, 0, 30);
+            accept_error = rt < 0 ? errno : 0;
+        });
+    }
+    assert(recv_error == ETIMEDOUT);
+    assert(recv_elapsed >= 50 && recv_elapsed < 50 + SLACK_MS);
+    assert(received == 1);
+    assert(accept_error == ETIMEDOUT);
+    close(fds[0]);
+    close(fds[1]);
+    close(listenfd);
+    caizi::Config::Lookup<std::string>("iomanager.backend")->setValue("epoll");
+}
+
+int main(){
+    test_manager();
+    test_fire();
+    test_cancel_recurring_condition();
+    test_io_timeout("epoll");
+    test_io_timeout("io_uring");
+    LOG_INFO(g_logger, "test_timer ok\n");
+    return 0;
+}
@@ -0,0 +1,56 @@
+/*
+    caizi_logcat: 把BinaryLogAppender写出的文件段解码为文本
+    用法: caizi_logcat [-p pattern] segment...
+    pattern与LogFormatter相同，默认与Logger的默认格式一致
+*/
+#include "log_binary.h"
+#include <unistd.h>
+
+using namespace caizi;
+
+static void usage(const char* prog){
+    fprintf(stderr, "usage: %s [-p pattern] segment...\n", prog);
+}
+
+int main(int argc, char** argv){
+    std::string pattern = CAIZI_LOG_DEFAULT_PATTERN;
+    int opt;
+    while((opt = getopt(argc, argv, "p:h")) != -1){
+        switch(opt){
+            case 'p':
+                pattern = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if(optind >= argc){
+        usage(argv[0]);
+        return 1;
+    }
+
+    LogFormatter formatter(pattern);
+    if(formatter.isError()){
+        fprintf(stderr, "invalid pattern: %s\n", pattern.c_str());
+        return 1;
+    }
+
+    int ret = 0;
+    LogEvent ev;
+    LogBuffer line;
+    for(int i = optind; i < argc; ++i){
+        BinaryLogReader reader;
+        if(!reader.open(argv[i])){
+            fprintf(stderr, "cannot open segment: %s\n", argv[i]);
+            ret = 1;
+            continue;
+        }
+        while(reader.next(ev)){
+            line.reset();
+            formatter.format(line, ev.getLevel(), ev);
+            fwrite(line.data(), 1, line.size(), stdout);
+        }
+    }
+    return ret;
+}